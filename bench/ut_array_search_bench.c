@@ -0,0 +1,117 @@
+#include "ut_array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define QUERIES 1000000
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static int compare_int(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* The textbook search, with a branch on every compare. */
+static size_t lower_bound(ut_array_t *a, const void *key)
+{
+	size_t lo = 0, hi = ut_array_length(a), mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (compare_int(ut_array_get(a, mid), key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Nanoseconds per lower bound of random keys in n sorted ints, from L1
+ * sized arrays to many times the LLC. The branchless search is run with
+ * the inline compare of ut_type_int and with a called one.
+ */
+static void bench1(int n)
+{
+	static const struct ut_type called = {
+		.size = sizeof(int),
+		.compare = compare_int,
+	};
+	ut_array_t *a, *b;
+	size_t *indexes, sum[5] = { 0 };
+	double times[5];
+	clock_t start;
+	int *keys, i, x;
+
+	a = ut_array_new(ut_type_int());
+	b = ut_array_new(&called);
+	for (i = 0; i < n; i++) {
+		x = i * 2;
+		ut_array_push(a, &x);
+		ut_array_push(b, &x);
+	}
+
+	keys = malloc(QUERIES * sizeof(int));
+	indexes = malloc(QUERIES * sizeof(size_t));
+	srand(1);
+	for (i = 0; i < QUERIES; i++)
+		keys[i] = rand() % (2 * n - 1);
+
+	start = clock();
+	for (i = 0; i < QUERIES; i++)
+		sum[0] += lower_bound(a, &keys[i]);
+	times[0] = elapsed(start);
+
+	start = clock();
+	for (i = 0; i < QUERIES; i++)
+		sum[1] += ut_array_lower_bound(b, &keys[i]);
+	times[1] = elapsed(start);
+
+	start = clock();
+	for (i = 0; i < QUERIES; i++)
+		sum[2] += ut_array_lower_bound(a, &keys[i]);
+	times[2] = elapsed(start);
+
+	start = clock();
+	ut_array_lower_bound_many(a, keys, QUERIES, indexes);
+	for (i = 0; i < QUERIES; i++)
+		sum[3] += indexes[i];
+	times[3] = elapsed(start);
+
+	/* Sums values, as Eytzinger indexes are not ranks. */
+	ut_array_to_eytzinger(a);
+	start = clock();
+	for (i = 0; i < QUERIES; i++)
+		sum[4] += *(int *)ut_array_get(
+			a, ut_array_eytzinger_lower_bound(a, &keys[i])) / 2;
+	times[4] = elapsed(start);
+
+	for (i = 1; i < 5 && sum[i] == sum[0]; i++)
+		;
+
+	printf("%9d ints  plain %6.1f  called %6.1f  inline %6.1f"
+	       "  batched %6.1f  eytzinger %6.1f ns%s\n",
+	       n, times[0] * 1e3, times[1] * 1e3, times[2] * 1e3,
+	       times[3] * 1e3, times[4] * 1e3, i < 5 ? "  MISMATCH" : "");
+
+	free(indexes);
+	free(keys);
+	ut_array_delete(b);
+	ut_array_delete(a);
+}
+
+int main()
+{
+	int n;
+
+	for (n = 1 << 10; n <= 1 << 26; n <<= 2)
+		bench1(n);
+	return 0;
+}
@@ -0,0 +1,166 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static int compare_int(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int compare_int_by(const void *a, const void *b, void *ctx)
+{
+	(void)ctx;
+	return compare_int(a, b);
+}
+
+static void fill(int *data, int n, int pattern)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (pattern == 0)
+			data[i] = rand();
+		else if (pattern == 1)
+			data[i] = rand() % 16;
+		else if (pattern == 2)
+			data[i] = i;
+		else
+			data[i] = n - i;
+	}
+}
+
+static ut_array_t *array_of(const int *data, int n)
+{
+	ut_array_t *a = ut_array_new(ut_type_int());
+	int i;
+
+	for (i = 0; i < n; i++)
+		ut_array_push(a, &data[i]);
+	return a;
+}
+
+/*
+ * qsort against pdqsort (sort_by, so the radix path stays out), the
+ * radix sort ut_array_sort takes for ints, and the stable sort, which
+ * is a radix sort for ints as well.
+ */
+static void bench1(int n, int pattern)
+{
+	static const char *names[] = { "random", "few", "sorted", "reversed" };
+	ut_array_t *a;
+	int *data;
+	clock_t start;
+	double times[4];
+	int i;
+
+	data = malloc(n * sizeof(int));
+	srand(1);
+	fill(data, n, pattern);
+
+	start = clock();
+	qsort(data, n, sizeof(int), compare_int);
+	times[0] = elapsed(start);
+
+	for (i = 0; i < 3; i++) {
+		srand(1);
+		fill(data, n, pattern);
+		a = array_of(data, n);
+		start = clock();
+		if (i == 0)
+			ut_array_sort_by(a, compare_int_by, NULL);
+		else if (i == 1)
+			ut_array_sort(a);
+		else
+			ut_array_sort_stable(a);
+		times[i + 1] = elapsed(start);
+		ut_array_delete(a);
+	}
+
+	printf("%8d %-8s  qsort %7.3fs  pdqsort %7.3fs  radix %7.3fs"
+	       "  stable %7.3fs\n",
+	       n, names[pattern], times[0], times[1], times[2], times[3]);
+	free(data);
+}
+
+static int compare_ulong(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Parallel sorts of n random 64-bit keys by thread count, wall clock time.
+ * ut_type_ulong takes the radix sort, a type with the same compare the
+ * merge of sorted chunks.
+ */
+static void bench2(int n, unsigned threads)
+{
+	static const struct ut_type keys = {
+		.size = sizeof(unsigned long),
+		.compare = compare_ulong,
+	};
+	ut_array_t *radix, *merge;
+	unsigned long x;
+	double start, times[2];
+	int i;
+
+	radix = ut_array_new(ut_type_ulong());
+	merge = ut_array_new(&keys);
+	srand(2);
+	for (i = 0; i < n; i++) {
+		x = (unsigned long)rand() << 33 ^ (unsigned long)rand() << 11 ^
+		    rand();
+		ut_array_push(radix, &x);
+		ut_array_push(merge, &x);
+	}
+
+	start = now();
+	ut_array_sort_parallel(radix, threads, 0);
+	times[0] = now() - start;
+
+	start = now();
+	ut_array_sort_parallel(merge, threads, 0);
+	times[1] = now() - start;
+
+	printf("%8d keys %2u threads  radix %7.3fs  merge %7.3fs\n", n,
+	       threads, times[0], times[1]);
+
+	ut_array_delete(merge);
+	ut_array_delete(radix);
+}
+
+int main()
+{
+	unsigned threads;
+	int pattern;
+
+	for (pattern = 0; pattern < 4; pattern++) {
+		bench1(100000, pattern);
+		bench1(1000000, pattern);
+		bench1(10000000, pattern);
+	}
+
+	for (threads = 1; threads <= 32; threads *= 2)
+		bench2(20000000, threads);
+	return 0;
+}
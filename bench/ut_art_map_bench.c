@@ -0,0 +1,131 @@
+#include "ut_art_map.h"
+#include "ut_string.h"
+#include "ut_tree_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*
+ * Each map gets its own copy of the n keys, stride bytes apart, as removing
+ * a key drops it.
+ */
+static void bench1(const char *name, const struct ut_type *type,
+		   void *tree_keys, void *art_keys, size_t stride, int n)
+{
+	ut_tree_map_t *tree;
+	ut_art_map_t *art;
+	struct ut_iter *iter;
+	char *key;
+	long sum = 0;
+	int i;
+	clock_t start;
+
+	tree = ut_tree_map_new(type, ut_type_int());
+	art = ut_art_map_new(type, ut_type_int());
+
+	start = clock();
+	for (i = 0, key = tree_keys; i < n; i++, key += stride)
+		ut_tree_map_insert(tree, key, &i);
+	printf("%-7s %8d  insert   tree %8.3fs", name, n, elapsed(start));
+
+	start = clock();
+	for (i = 0, key = art_keys; i < n; i++, key += stride)
+		ut_art_map_insert(art, key, &i);
+	printf("  art %8.3fs\n", elapsed(start));
+
+	start = clock();
+	for (i = 0, key = tree_keys; i < n; i++, key += stride)
+		sum += *(int *)ut_tree_map_get(tree, key);
+	printf("%-7s %8d  get      tree %8.3fs", name, n, elapsed(start));
+
+	start = clock();
+	for (i = 0, key = art_keys; i < n; i++, key += stride)
+		sum -= *(int *)ut_art_map_get(art, key);
+	printf("  art %8.3fs\n", elapsed(start));
+
+	start = clock();
+	iter = ut_tree_map_iter_new(tree);
+	while (iter->next(iter))
+		sum++;
+	ut_tree_map_iter_delete(iter);
+	printf("%-7s %8d  iterate  tree %8.3fs", name, n, elapsed(start));
+
+	start = clock();
+	iter = ut_art_map_iter_new(art);
+	while (iter->next(iter))
+		sum--;
+	ut_art_map_iter_delete(iter);
+	printf("  art %8.3fs\n", elapsed(start));
+
+	if (sum)
+		puts("Error! The maps disagree!");
+
+	start = clock();
+	for (i = 0, key = tree_keys; i < n; i++, key += stride)
+		ut_tree_map_remove(tree, key);
+	printf("%-7s %8d  remove   tree %8.3fs", name, n, elapsed(start));
+
+	start = clock();
+	for (i = 0, key = art_keys; i < n; i++, key += stride)
+		ut_art_map_remove(art, key);
+	printf("  art %8.3fs\n", elapsed(start));
+
+	ut_tree_map_delete(tree);
+	ut_art_map_delete(art);
+}
+
+static void shuffle(int *keys, int n)
+{
+	int i, j, tmp;
+
+	for (i = n - 1; i > 0; i--) {
+		j = rand() % (i + 1);
+		tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+}
+
+static void bench2(int n)
+{
+	struct ut_string *tree_strings, *art_strings;
+	int *ints, i;
+	char buf[32];
+
+	ints = malloc(n * sizeof(int));
+	tree_strings = malloc(n * sizeof(struct ut_string));
+	art_strings = malloc(n * sizeof(struct ut_string));
+
+	/* Distinct keys in random order, so that each insert adds one. */
+	srand(1);
+	for (i = 0; i < n; i++)
+		ints[i] = i;
+	shuffle(ints, n);
+
+	for (i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), "user:%08d", ints[i]);
+		ut_string_init(&tree_strings[i], buf);
+		ut_string_init(&art_strings[i], buf);
+	}
+
+	bench1("int", ut_type_int(), ints, ints, sizeof(int), n);
+	bench1("string", ut_type_string(), tree_strings, art_strings,
+	       sizeof(struct ut_string), n);
+
+	free(art_strings);
+	free(tree_strings);
+	free(ints);
+}
+
+int main()
+{
+	bench2(1000);
+	bench2(100000);
+	bench2(1000000);
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include "ut_btree_map.h"
+#include "ut_tree_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench1(int n)
+{
+	ut_tree_map_t *tree;
+	ut_btree_map_t *btree;
+	struct ut_iter *iter;
+	int *keys, i;
+	long sum;
+	clock_t start;
+
+	keys = malloc(n * sizeof(int));
+	srand(1);
+	for (i = 0; i < n; i++)
+		keys[i] = rand();
+
+	tree = ut_tree_map_new(ut_type_int(), ut_type_int());
+	btree = ut_btree_map_new(ut_type_int(), ut_type_int());
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		ut_tree_map_insert(tree, &keys[i], &i);
+	printf("%9d  insert   tree %8.3fs", n, elapsed(start));
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		ut_btree_map_insert(btree, &keys[i], &i);
+	printf("  btree %8.3fs\n", elapsed(start));
+
+	sum = 0;
+	start = clock();
+	for (i = 0; i < n; i++)
+		sum += *(int *)ut_tree_map_get(tree, &keys[i]);
+	printf("%9d  get      tree %8.3fs", n, elapsed(start));
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		sum -= *(int *)ut_btree_map_get(btree, &keys[i]);
+	printf("  btree %8.3fs\n", elapsed(start));
+
+	start = clock();
+	iter = ut_tree_map_iter_new(tree);
+	while (iter->next(iter))
+		sum++;
+	ut_tree_map_iter_delete(iter);
+	printf("%9d  iterate  tree %8.3fs", n, elapsed(start));
+
+	start = clock();
+	iter = ut_btree_map_iter_new(btree);
+	while (iter->next(iter))
+		sum--;
+	ut_btree_map_iter_delete(iter);
+	printf("  btree %8.3fs\n", elapsed(start));
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		ut_tree_map_remove(tree, &keys[i]);
+	printf("%9d  remove   tree %8.3fs", n, elapsed(start));
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		ut_btree_map_remove(btree, &keys[i]);
+	printf("  btree %8.3fs\n", elapsed(start));
+
+	if (sum)
+		puts("Error! The maps disagree!");
+
+	ut_tree_map_delete(tree);
+	ut_btree_map_delete(btree);
+	free(keys);
+}
+
+int main()
+{
+	bench1(1000);
+	bench1(100000);
+	bench1(1000000);
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include "ut_flat_map.h"
+#include "ut_tree_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void shuffle(int *keys, int n)
+{
+	int i, j, tmp;
+
+	for (i = n - 1; i > 0; i--) {
+		j = rand() % (i + 1);
+		tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+}
+
+/* Builds each map from n random keys, then looks all of them up. */
+static void bench1(int n)
+{
+	ut_tree_map_t *tree;
+	ut_flat_map_t *flat, *batch;
+	int *keys, i;
+	long sum = 0;
+	clock_t start;
+
+	keys = malloc(n * sizeof(int));
+	srand(1);
+	for (i = 0; i < n; i++)
+		keys[i] = i;
+	shuffle(keys, n);
+
+	tree = ut_tree_map_new(ut_type_int(), ut_type_int());
+	flat = ut_flat_map_new(ut_type_int(), ut_type_int());
+	batch = ut_flat_map_new(ut_type_int(), ut_type_int());
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		ut_tree_map_insert(tree, &keys[i], &i);
+	printf("%8d  insert  tree %8.3fs", n, elapsed(start));
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		ut_flat_map_insert(flat, &keys[i], &i);
+	ut_flat_map_first(flat);
+	printf("  flat %8.3fs", elapsed(start));
+
+	/* The same keys in batches of a thousand. */
+	start = clock();
+	for (i = 0; i < n; i += 1000) {
+		ut_flat_map_insert_many(batch, &keys[i], &keys[i],
+					n - i < 1000 ? n - i : 1000);
+	}
+	printf("  batch %8.3fs\n", elapsed(start));
+
+	shuffle(keys, n);
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		sum += *(int *)ut_tree_map_get(tree, &keys[i]);
+	printf("%8d  get     tree %8.3fs", n, elapsed(start));
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		sum -= *(int *)ut_flat_map_get(flat, &keys[i]);
+	printf("  flat %8.3fs\n", elapsed(start));
+
+	if (sum || ut_flat_map_length(batch) != (size_t)n)
+		puts("Error! The maps disagree!");
+
+	ut_tree_map_delete(tree);
+	ut_flat_map_delete(flat);
+	ut_flat_map_delete(batch);
+	free(keys);
+}
+
+int main()
+{
+	bench1(1000);
+	bench1(10000);
+	bench1(100000);
+	return 0;
+}
@@ -0,0 +1,192 @@
+#include "ut_heap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void sift_down(int *heap, int len, int i)
+{
+	int l, r, m, tmp;
+
+	while (i * 2 + 1 < len) {
+		l = i * 2 + 1;
+		r = i * 2 + 2;
+		m = i;
+
+		if (heap[l] > heap[m])
+			m = l;
+		if (r < len && heap[r] > heap[m])
+			m = r;
+		if (m == i)
+			break;
+
+		tmp = heap[m];
+		heap[m] = heap[i];
+		heap[i] = tmp;
+		i = m;
+	}
+}
+
+/* The push the heap used to have, which rebuilt it after every element. */
+static void old_push(int *heap, int *len, int element)
+{
+	int i;
+
+	heap[(*len)++] = element;
+	for (i = *len >> 1; i >= 0; i--)
+		sift_down(heap, *len, i);
+}
+
+static void bench1(int n)
+{
+	ut_heap_t *heap;
+	int *data, *old, i, len = 0;
+	clock_t start;
+
+	data = malloc(n * sizeof(int));
+	srand(1);
+	for (i = 0; i < n; i++)
+		data[i] = rand();
+
+	printf("%8d  push", n);
+	if (n <= 20000) {
+		old = malloc(n * sizeof(int));
+		start = clock();
+		for (i = 0; i < n; i++)
+			old_push(old, &len, data[i]);
+		printf("  old %8.3fs", elapsed(start));
+		free(old);
+	} else {
+		printf("  old %9s", "-");
+	}
+
+	heap = ut_heap_new(ut_type_int());
+	start = clock();
+	for (i = 0; i < n; i++)
+		ut_heap_push(heap, &data[i]);
+	printf("  push %8.3fs", elapsed(start));
+	ut_heap_delete(heap);
+
+	start = clock();
+	heap = ut_heap_from_array(ut_type_int(), data, n);
+	printf("  from_array %8.3fs\n", elapsed(start));
+
+	/* Taking the top and putting back a new one, as a scheduler does. */
+	start = clock();
+	for (i = 0; i < n; i++) {
+		ut_heap_pop(heap);
+		ut_heap_push(heap, &data[i]);
+	}
+	printf("%8d  update  pop+push %8.3fs", n, elapsed(start));
+
+	start = clock();
+	for (i = 0; i < n; i++)
+		ut_heap_replace_top(heap, &data[i]);
+	printf("  replace_top %8.3fs\n", elapsed(start));
+
+	ut_heap_delete(heap);
+	free(data);
+}
+
+/* Timers of 4, 16 and 64 bytes, ordered by their deadline. */
+struct timer16 {
+	long deadline;
+	long data;
+};
+
+struct timer64 {
+	long deadline;
+	long data[7];
+};
+
+static int compare_deadline(const void *a, const void *b)
+{
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static const struct ut_type timer16_type = {
+	.size = sizeof(struct timer16),
+	.compare = compare_deadline,
+};
+
+static const struct ut_type timer64_type = {
+	.size = sizeof(struct timer64),
+	.compare = compare_deadline,
+};
+
+/*
+ * A timer queue at a steady size: the earliest timer fires and is
+ * rescheduled about as far out as the others, so it sinks deep.
+ */
+static void bench2_run(const struct ut_type *type, size_t arity, int n)
+{
+	ut_heap_t *heap;
+	long timer[8] = { 0 };
+	int *deadline = (int *)timer, i;
+	clock_t start;
+
+	heap = ut_heap_new_min(type);
+	ut_heap_set_arity(heap, arity);
+	ut_heap_reserve(heap, n);
+
+	srand(1);
+	for (i = 0; i < n; i++) {
+		if (type->size == sizeof(int))
+			*deadline = rand() % (RAND_MAX / 4);
+		else
+			timer[0] = rand();
+		ut_heap_push(heap, timer);
+	}
+
+	start = clock();
+	for (i = 0; i < n; i++) {
+		memcpy(timer, ut_heap_peek(heap), type->size);
+		if (type->size == sizeof(int))
+			*deadline += rand() % (RAND_MAX / 4);
+		else
+			timer[0] += rand();
+		ut_heap_replace_top(heap, timer);
+	}
+	printf("  %8.3fs", elapsed(start));
+
+	ut_heap_delete(heap);
+}
+
+static void bench2(int n)
+{
+	static const size_t arities[] = { 2, 4, 8, 16 };
+	const struct ut_type *types[] = {
+		ut_type_int(),
+		&timer16_type,
+		&timer64_type,
+	};
+	size_t i, j;
+
+	for (i = 0; i < 3; i++) {
+		printf("%8d  %2zu bytes", n, types[i]->size);
+		for (j = 0; j < 4; j++)
+			bench2_run(types[i], arities[j], n);
+		putchar('\n');
+	}
+}
+
+int main()
+{
+	bench1(1000);
+	bench1(20000);
+	bench1(1000000);
+
+	printf("%8s  %8s  %9s  %9s  %9s  %9s\n", "timers", "element", "d = 2",
+	       "d = 4", "d = 8", "d = 16");
+	bench2(10000);
+	bench2(1000000);
+	bench2(4000000);
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include "ut_mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ROUNDS 20000000
+
+/* Keeps the results of the comparisons alive. */
+static volatile long sink;
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* The byte at a time swap that ut_memswap replaced. */
+static void byte_swap(void *a, void *b, size_t size)
+{
+	uint8_t tmp;
+	size_t i = 0;
+	for (; i < size; i++) {
+		tmp = ((uint8_t *)a)[i];
+		((uint8_t *)a)[i] = ((uint8_t *)b)[i];
+		((uint8_t *)b)[i] = tmp;
+	}
+}
+
+static void bench1(size_t size)
+{
+	/* Volatile so the calls stay opaque and are not folded away. */
+	void (*volatile swap)(void *, void *, size_t) = &byte_swap;
+	static uint8_t buf[4096];
+	uint8_t *a = buf, *b = buf + 2048;
+	size_t i, rounds = ROUNDS / (size / 16 + 1);
+	long equal = 0;
+	clock_t start;
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		swap(a, b, size);
+	printf("%5zu  swap  bytes %7.3fs", size, elapsed(start));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		ut_memswap(a, b, size);
+	printf("  ut %7.3fs", elapsed(start));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		memmove(a + (i & 1), a + 1 - (i & 1), size);
+	printf("  move libc %7.3fs", elapsed(start));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		ut_memmove(a + (i & 1), a + 1 - (i & 1), size);
+	printf("  ut %7.3fs", elapsed(start));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		equal += !memcmp(a + (i & 7), b + (i & 15), size);
+	printf("  eq libc %7.3fs", elapsed(start));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		equal += ut_memeq(a + (i & 7), b + (i & 15), size);
+	printf("  ut %7.3fs\n", elapsed(start));
+
+	sink = equal;
+}
+
+int main()
+{
+	size_t sizes[] = { 1, 4, 8, 12, 16, 24, 32, 64, 200, 1024 };
+	size_t i;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		bench1(sizes[i]);
+	return 0;
+}
@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_heap.h"
+#include "ut_multi_queue.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PREFILL 100000
+#define OPS 200000
+
+struct worker {
+	ut_multi_queue_t *queue;
+	ut_heap_t *heap;
+	pthread_mutex_t *lock;
+	unsigned seed;
+};
+
+/* Threads run at once, so time on the wall clock rather than the CPU. */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned next_rand(unsigned *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+/* A scheduler loop: take the next job, queue a later one. */
+static void *queue_worker(void *arg)
+{
+	struct worker *w = arg;
+	int i, x;
+
+	for (i = 0; i < OPS; i++) {
+		ut_multi_queue_pop(w->queue, &x);
+		x += 1 + next_rand(&w->seed) % 1000;
+		ut_multi_queue_push(w->queue, &x);
+	}
+
+	return NULL;
+}
+
+static void *heap_worker(void *arg)
+{
+	struct worker *w = arg;
+	int i, x;
+
+	for (i = 0; i < OPS; i++) {
+		pthread_mutex_lock(w->lock);
+		x = *(int *)ut_heap_peek(w->heap);
+		ut_heap_pop(w->heap);
+		x += 1 + next_rand(&w->seed) % 1000;
+		ut_heap_push(w->heap, &x);
+		pthread_mutex_unlock(w->lock);
+	}
+
+	return NULL;
+}
+
+static double run(void *(*fn)(void *), struct worker *proto, int threads)
+{
+	pthread_t ids[16];
+	struct worker workers[16];
+	double start;
+	int i;
+
+	start = now();
+	for (i = 0; i < threads; i++) {
+		workers[i] = *proto;
+		workers[i].seed = i + 1;
+		pthread_create(&ids[i], NULL, fn, &workers[i]);
+	}
+
+	for (i = 0; i < threads; i++)
+		pthread_join(ids[i], NULL);
+
+	return now() - start;
+}
+
+/* Throughput of a locked heap against c heaps per thread. */
+static void bench1(int threads)
+{
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	struct worker proto;
+	double heap, queue[2];
+	int i, c, x;
+
+	proto.heap = ut_heap_new_min(ut_type_int());
+	for (i = 0; i < PREFILL; i++) {
+		x = i * 10;
+		ut_heap_push(proto.heap, &x);
+	}
+	proto.lock = &lock;
+	heap = run(heap_worker, &proto, threads);
+	ut_heap_delete(proto.heap);
+
+	for (c = 2; c <= 4; c += 2) {
+		proto.queue =
+			ut_multi_queue_new_min(ut_type_int(), c * threads);
+		for (i = 0; i < PREFILL; i++) {
+			x = i * 10;
+			ut_multi_queue_push(proto.queue, &x);
+		}
+		queue[c / 2 - 1] = run(queue_worker, &proto, threads);
+		ut_multi_queue_delete(proto.queue);
+	}
+
+	printf("%2d threads  locked heap %8.3fs  c=2 %8.3fs  c=4 %8.3fs\n",
+	       threads, heap, queue[0], queue[1]);
+}
+
+/* How many smaller keys are still queued, kept in a Fenwick tree. */
+static int rank_of(const int *tree, int key)
+{
+	int rank = 0;
+
+	for (; key > 0; key -= key & -key)
+		rank += tree[key];
+
+	return rank;
+}
+
+static void rank_update(int *tree, int n, int key, int delta)
+{
+	for (key++; key <= n; key += key & -key)
+		tree[key] += delta;
+}
+
+/*
+ * Rank error of relaxed pops with as many heaps as c threads would use:
+ * how many queued keys were better than the one popped.
+ */
+static void bench2(int queues, int n)
+{
+	ut_multi_queue_t *queue;
+	int *tree, i, x, rank, worst = 0;
+	double sum = 0;
+
+	tree = calloc(n + 1, sizeof(int));
+	queue = ut_multi_queue_new_min(ut_type_int(), queues);
+	for (i = 0; i < n; i++) {
+		x = (int)(((long long)i * 7919) % n);
+		ut_multi_queue_push(queue, &x);
+		rank_update(tree, n, x, 1);
+	}
+
+	while (ut_multi_queue_pop(queue, &x)) {
+		rank = rank_of(tree, x);
+		rank_update(tree, n, x, -1);
+		sum += rank;
+		if (rank > worst)
+			worst = rank;
+	}
+
+	printf("%3d heaps  %8d keys  mean rank error %8.2f  max %6d\n", queues,
+	       n, sum / n, worst);
+
+	ut_multi_queue_delete(queue);
+	free(tree);
+}
+
+int main()
+{
+	int i;
+
+	for (i = 1; i <= 16; i *= 2)
+		bench1(i);
+
+	for (i = 2; i <= 64; i *= 2)
+		bench2(i, 1000000);
+
+	return 0;
+}
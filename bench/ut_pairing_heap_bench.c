@@ -0,0 +1,107 @@
+#include "ut_heap.h"
+#include "ut_pairing_heap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* n random pushes, then pops until empty. */
+static void bench1(int n)
+{
+	ut_pairing_heap_t *pairing;
+	ut_heap_t *heap;
+	int *data, i;
+	clock_t start;
+
+	data = malloc(n * sizeof(int));
+	srand(1);
+	for (i = 0; i < n; i++)
+		data[i] = rand();
+
+	start = clock();
+	heap = ut_heap_new(ut_type_int());
+	for (i = 0; i < n; i++)
+		ut_heap_push(heap, &data[i]);
+	while (!ut_heap_is_empty(heap))
+		ut_heap_pop(heap);
+	ut_heap_delete(heap);
+	printf("%8d  push and pop  heap %8.3fs", n, elapsed(start));
+
+	start = clock();
+	pairing = ut_pairing_heap_new(ut_type_int());
+	for (i = 0; i < n; i++)
+		ut_pairing_heap_push(pairing, &data[i], NULL);
+	while (!ut_pairing_heap_is_empty(pairing))
+		ut_pairing_heap_pop(pairing);
+	ut_pairing_heap_delete(pairing);
+	printf("  pairing %8.3fs\n", elapsed(start));
+
+	free(data);
+}
+
+/*
+ * Merging k heaps of n elements each into the first one. The array heap
+ * takes a batch push of everything in the other heap.
+ */
+static void bench2(int k, int n)
+{
+	ut_pairing_heap_t **pairings;
+	ut_heap_t **heaps;
+	int *data, i, j;
+	double heap_time, pairing_time;
+	clock_t start;
+
+	data = malloc(n * sizeof(int));
+	heaps = malloc(k * sizeof(ut_heap_t *));
+	pairings = malloc(k * sizeof(ut_pairing_heap_t *));
+
+	srand(2);
+	for (i = 0; i < k; i++) {
+		heaps[i] = ut_heap_new(ut_type_int());
+		pairings[i] = ut_pairing_heap_new(ut_type_int());
+		for (j = 0; j < n; j++) {
+			data[j] = rand();
+			ut_heap_push(heaps[i], &data[j]);
+			ut_pairing_heap_push(pairings[i], &data[j], NULL);
+		}
+	}
+
+	start = clock();
+	for (i = 1; i < k; i++) {
+		ut_heap_push_many(heaps[0], ut_heap_peek(heaps[i]),
+				  ut_heap_length(heaps[i]));
+		ut_heap_clear(heaps[i]);
+	}
+	heap_time = elapsed(start);
+
+	start = clock();
+	for (i = 1; i < k; i++)
+		ut_pairing_heap_meld(pairings[0], pairings[i]);
+	pairing_time = elapsed(start);
+
+	printf("%5d heaps of %6d  meld  heap %8.3fs  pairing %8.3fs\n", k, n,
+	       heap_time, pairing_time);
+
+	for (i = 0; i < k; i++) {
+		ut_heap_delete(heaps[i]);
+		ut_pairing_heap_delete(pairings[i]);
+	}
+
+	free(pairings);
+	free(heaps);
+	free(data);
+}
+
+int main()
+{
+	bench1(100000);
+	bench1(1000000);
+	bench1(4000000);
+	bench2(1000, 1000);
+	bench2(100, 100000);
+	return 0;
+}
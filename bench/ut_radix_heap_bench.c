@@ -0,0 +1,209 @@
+#include "ut_heap.h"
+#include "ut_pairing_heap.h"
+#include "ut_radix_heap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEGREE 8
+
+struct visit {
+	uint64_t dist;
+	int vertex;
+};
+
+/* A random graph with DEGREE edges out of every vertex. */
+struct graph {
+	int n;
+	int *to;
+	uint32_t *weight;
+};
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static int compare_visit(const void *a, const void *b)
+{
+	uint64_t x = ((const struct visit *)a)->dist;
+	uint64_t y = ((const struct visit *)b)->dist;
+
+	return (x < y) - (x > y);
+}
+
+static const struct ut_type visit_type = {
+	.size = sizeof(struct visit),
+	.compare = compare_visit,
+};
+
+/* The array heap cannot decrease a key, stale visits are skipped. */
+static uint64_t dijkstra_heap(const struct graph *g, uint64_t *dist)
+{
+	ut_heap_t *heap;
+	struct visit v, next;
+	uint64_t sum = 0;
+	int i, e;
+
+	for (i = 0; i < g->n; i++)
+		dist[i] = UINT64_MAX;
+
+	heap = ut_heap_new_by(&visit_type, compare_visit);
+	v.dist = 0;
+	v.vertex = 0;
+	dist[0] = 0;
+	ut_heap_push(heap, &v);
+
+	while (!ut_heap_is_empty(heap)) {
+		v = *(struct visit *)ut_heap_peek(heap);
+		ut_heap_pop(heap);
+		if (v.dist > dist[v.vertex])
+			continue;
+
+		sum += v.dist;
+		for (e = v.vertex * DEGREE; e < (v.vertex + 1) * DEGREE; e++) {
+			next.vertex = g->to[e];
+			next.dist = v.dist + g->weight[e];
+			if (next.dist < dist[next.vertex]) {
+				dist[next.vertex] = next.dist;
+				ut_heap_push(heap, &next);
+			}
+		}
+	}
+
+	ut_heap_delete(heap);
+	return sum;
+}
+
+static uint64_t dijkstra_pairing(const struct graph *g, uint64_t *dist)
+{
+	struct ut_pairing_node **nodes, **node;
+	ut_pairing_heap_t *heap;
+	struct visit v, next, *queued;
+	uint64_t sum = 0;
+	int i, e;
+
+	nodes = calloc(g->n, sizeof(struct ut_pairing_node *));
+	for (i = 0; i < g->n; i++)
+		dist[i] = UINT64_MAX;
+
+	heap = ut_pairing_heap_new_by(&visit_type, compare_visit);
+	v.dist = 0;
+	v.vertex = 0;
+	dist[0] = 0;
+	ut_pairing_heap_push(heap, &v, &nodes[0]);
+
+	while (!ut_pairing_heap_is_empty(heap)) {
+		v = *(struct visit *)ut_pairing_heap_peek(heap);
+		ut_pairing_heap_pop(heap);
+		nodes[v.vertex] = NULL;
+		sum += v.dist;
+
+		for (e = v.vertex * DEGREE; e < (v.vertex + 1) * DEGREE; e++) {
+			next.vertex = g->to[e];
+			next.dist = v.dist + g->weight[e];
+			if (next.dist >= dist[next.vertex])
+				continue;
+
+			dist[next.vertex] = next.dist;
+			node = &nodes[next.vertex];
+			if (*node) {
+				queued = ut_pairing_heap_get(*node);
+				queued->dist = next.dist;
+				ut_pairing_heap_update(heap, *node);
+			} else {
+				ut_pairing_heap_push(heap, &next, node);
+			}
+		}
+	}
+
+	ut_pairing_heap_delete(heap);
+	free(nodes);
+	return sum;
+}
+
+static uint64_t dijkstra_radix(const struct graph *g, uint64_t *dist)
+{
+	ut_radix_heap_t *heap;
+	uint64_t d, nd, sum = 0;
+	int i, e, u, w;
+
+	for (i = 0; i < g->n; i++)
+		dist[i] = UINT64_MAX;
+
+	heap = ut_radix_heap_new(ut_type_int());
+	u = 0;
+	dist[0] = 0;
+	ut_radix_heap_push(heap, 0, &u);
+
+	while (!ut_radix_heap_is_empty(heap)) {
+		u = *(int *)ut_radix_heap_peek(heap, &d);
+		ut_radix_heap_pop(heap);
+		if (d > dist[u])
+			continue;
+
+		sum += d;
+		for (e = u * DEGREE; e < (u + 1) * DEGREE; e++) {
+			w = g->to[e];
+			nd = d + g->weight[e];
+			if (nd < dist[w]) {
+				dist[w] = nd;
+				ut_radix_heap_push(heap, nd, &w);
+			}
+		}
+	}
+
+	ut_radix_heap_delete(heap);
+	return sum;
+}
+
+static void bench1(int n, uint32_t max_weight)
+{
+	struct graph g;
+	uint64_t *dist, sums[3];
+	double times[3];
+	clock_t start;
+	int i;
+
+	g.n = n;
+	g.to = malloc((size_t)n * DEGREE * sizeof(int));
+	g.weight = malloc((size_t)n * DEGREE * sizeof(uint32_t));
+	dist = malloc(n * sizeof(uint64_t));
+
+	srand(1);
+	for (i = 0; i < n * DEGREE; i++) {
+		g.to[i] = rand() % n;
+		g.weight[i] = 1 + rand() % max_weight;
+	}
+
+	start = clock();
+	sums[0] = dijkstra_heap(&g, dist);
+	times[0] = elapsed(start);
+
+	start = clock();
+	sums[1] = dijkstra_pairing(&g, dist);
+	times[1] = elapsed(start);
+
+	start = clock();
+	sums[2] = dijkstra_radix(&g, dist);
+	times[2] = elapsed(start);
+
+	printf("%8d vertices  weights to %8u  heap %8.3fs  pairing %8.3fs"
+	       "  radix %8.3fs%s\n",
+	       n, max_weight, times[0], times[1], times[2],
+	       sums[0] == sums[1] && sums[1] == sums[2] ? "" : "  MISMATCH");
+
+	free(dist);
+	free(g.weight);
+	free(g.to);
+}
+
+int main()
+{
+	bench1(100000, 100);
+	bench1(100000, 1000000);
+	bench1(1000000, 100);
+	bench1(1000000, 1000000);
+	return 0;
+}
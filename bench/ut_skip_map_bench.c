@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_skip_map.h"
+#include "ut_tree_map.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define KEYS 100000
+#define OPS 400000
+
+struct worker {
+	ut_skip_map_t *skip;
+	ut_tree_map_t *tree;
+	pthread_mutex_t *lock;
+	unsigned seed;
+	int reads;
+};
+
+/* Threads run at once, so time on the wall clock rather than the CPU. */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned next_rand(unsigned *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static void *skip_worker(void *arg)
+{
+	struct worker *w = arg;
+	int i, key, value;
+	unsigned r;
+
+	for (i = 0; i < OPS; i++) {
+		r = next_rand(&w->seed);
+		key = r % (KEYS * 2);
+		if ((int)(r >> 20) % 100 < w->reads)
+			ut_skip_map_load(w->skip, &key, &value);
+		else if (r & 1)
+			ut_skip_map_insert(w->skip, &key, &i);
+		else
+			ut_skip_map_remove(w->skip, &key);
+	}
+
+	return NULL;
+}
+
+static void *tree_worker(void *arg)
+{
+	struct worker *w = arg;
+	int i, key;
+	unsigned r;
+
+	for (i = 0; i < OPS; i++) {
+		r = next_rand(&w->seed);
+		key = r % (KEYS * 2);
+		pthread_mutex_lock(w->lock);
+		if ((int)(r >> 20) % 100 < w->reads)
+			ut_tree_map_get(w->tree, &key);
+		else if (r & 1)
+			ut_tree_map_insert(w->tree, &key, &i);
+		else
+			ut_tree_map_remove(w->tree, &key);
+		pthread_mutex_unlock(w->lock);
+	}
+
+	return NULL;
+}
+
+static double run(void *(*fn)(void *), struct worker *proto, int threads)
+{
+	pthread_t ids[16];
+	struct worker workers[16];
+	double start;
+	int i;
+
+	start = now();
+	for (i = 0; i < threads; i++) {
+		workers[i] = *proto;
+		workers[i].seed = i + 1;
+		pthread_create(&ids[i], NULL, fn, &workers[i]);
+	}
+
+	for (i = 0; i < threads; i++)
+		pthread_join(ids[i], NULL);
+
+	return now() - start;
+}
+
+static void bench1(int threads, int reads)
+{
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	struct worker proto;
+	double skip, tree;
+	int i;
+
+	proto.skip = ut_skip_map_new(ut_type_int(), ut_type_int());
+	proto.tree = ut_tree_map_new(ut_type_int(), ut_type_int());
+	proto.lock = &lock;
+	proto.reads = reads;
+
+	for (i = 0; i < KEYS * 2; i += 2) {
+		ut_skip_map_insert(proto.skip, &i, &i);
+		ut_tree_map_insert(proto.tree, &i, &i);
+	}
+
+	skip = run(skip_worker, &proto, threads);
+	tree = run(tree_worker, &proto, threads);
+
+	printf("%2d threads  %3d%% reads  skip %8.3fs  locked tree %8.3fs\n",
+	       threads, reads, skip, tree);
+
+	ut_skip_map_delete(proto.skip);
+	ut_tree_map_delete(proto.tree);
+}
+
+int main()
+{
+	int threads, i;
+	int reads[] = { 90, 50, 10 };
+
+	for (threads = 1; threads <= 8; threads *= 2) {
+		for (i = 0; i < 3; i++)
+			bench1(threads, reads[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,177 @@
+#include "ut_heap.h"
+#include "ut_indexed_heap.h"
+#include "ut_timer_wheel.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* A thousand ticks, a thousand new connections each. */
+#define TICKS 1000
+#define PER_TICK 1000
+#define TIMERS (TICKS * PER_TICK)
+
+/* Connections time out after 30s of 1ms ticks, most close well before. */
+#define TIMEOUT 30000
+#define LIFETIME 100
+
+struct timeout {
+	uint64_t expires;
+	int id;
+};
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static int compare_timeout(const void *a, const void *b)
+{
+	uint64_t x = ((const struct timeout *)a)->expires;
+	uint64_t y = ((const struct timeout *)b)->expires;
+
+	return (x < y) - (x > y);
+}
+
+static const struct ut_type timeout_type = {
+	.size = sizeof(struct timeout),
+};
+
+static void bench_wheel(const uint64_t *expires, const char *closed)
+{
+	static struct ut_timer *timers[TIMERS];
+	ut_timer_wheel_t *wheel;
+	ut_array_t *expired;
+	size_t fired = 0;
+	clock_t start;
+	int t, i, id;
+
+	start = clock();
+	wheel = ut_timer_wheel_new(ut_type_int(), 0);
+	expired = ut_array_new(ut_type_int());
+
+	for (t = 0; t < TICKS + TIMEOUT * 2; t++) {
+		for (i = 0; t < TICKS && i < PER_TICK; i++) {
+			id = t * PER_TICK + i;
+			ut_timer_wheel_schedule(wheel, expires[id], &id,
+						&timers[id]);
+		}
+
+		for (i = 0; t >= LIFETIME && t - LIFETIME < TICKS &&
+			    i < PER_TICK;
+		     i++) {
+			id = (t - LIFETIME) * PER_TICK + i;
+			if (closed[id])
+				ut_timer_wheel_cancel(wheel, timers[id]);
+		}
+
+		ut_timer_wheel_expire(wheel, t, expired);
+		fired += ut_array_length(expired);
+		ut_array_clear(expired);
+	}
+
+	ut_array_delete(expired);
+	ut_timer_wheel_delete(wheel);
+	printf("  wheel %8.3fs (%zu fired)", elapsed(start), fired);
+}
+
+/* A heap cannot cancel, closed connections are skipped when they pop. */
+static void bench_heap(const uint64_t *expires, const char *closed)
+{
+	ut_heap_t *heap;
+	struct timeout timeout, *top;
+	size_t fired = 0;
+	clock_t start;
+	int t, i;
+
+	start = clock();
+	heap = ut_heap_new_by(&timeout_type, compare_timeout);
+
+	for (t = 0; t < TICKS + TIMEOUT * 2; t++) {
+		for (i = 0; t < TICKS && i < PER_TICK; i++) {
+			timeout.id = t * PER_TICK + i;
+			timeout.expires = expires[timeout.id];
+			ut_heap_push(heap, &timeout);
+		}
+
+		while ((top = ut_heap_peek(heap)) &&
+		       top->expires <= (uint64_t)t) {
+			fired += !closed[top->id];
+			ut_heap_pop(heap);
+		}
+	}
+
+	ut_heap_delete(heap);
+	printf("  heap %8.3fs (%zu fired)", elapsed(start), fired);
+}
+
+static void bench_indexed_heap(const uint64_t *expires, const char *closed)
+{
+	static size_t handles[TIMERS];
+	ut_indexed_heap_t *heap;
+	struct timeout timeout, *top;
+	size_t fired = 0;
+	clock_t start;
+	int t, i, id;
+
+	start = clock();
+	heap = ut_indexed_heap_new_by(&timeout_type, compare_timeout);
+
+	for (t = 0; t < TICKS + TIMEOUT * 2; t++) {
+		for (i = 0; t < TICKS && i < PER_TICK; i++) {
+			timeout.id = t * PER_TICK + i;
+			timeout.expires = expires[timeout.id];
+			ut_indexed_heap_push(heap, &timeout,
+					     &handles[timeout.id]);
+		}
+
+		for (i = 0; t >= LIFETIME && t - LIFETIME < TICKS &&
+			    i < PER_TICK;
+		     i++) {
+			id = (t - LIFETIME) * PER_TICK + i;
+			if (closed[id])
+				ut_indexed_heap_remove(heap, handles[id]);
+		}
+
+		while ((top = ut_indexed_heap_peek(heap)) &&
+		       top->expires <= (uint64_t)t) {
+			fired++;
+			ut_indexed_heap_pop(heap);
+		}
+	}
+
+	ut_indexed_heap_delete(heap);
+	printf("  indexed heap %8.3fs (%zu fired)\n", elapsed(start), fired);
+}
+
+/* 1M timeouts, of which the given share is cancelled early. */
+static void bench1(int cancel)
+{
+	uint64_t *expires;
+	char *closed;
+	int i;
+
+	expires = malloc(TIMERS * sizeof(uint64_t));
+	closed = malloc(TIMERS);
+	srand(1);
+	for (i = 0; i < TIMERS; i++) {
+		expires[i] = i / PER_TICK + TIMEOUT + rand() % 1000;
+		closed[i] = rand() % 100 < cancel;
+	}
+
+	printf("%3d%% cancelled", cancel);
+	bench_wheel(expires, closed);
+	bench_heap(expires, closed);
+	bench_indexed_heap(expires, closed);
+
+	free(expires);
+	free(closed);
+}
+
+int main()
+{
+	bench1(0);
+	bench1(90);
+	bench1(99);
+	return 0;
+}
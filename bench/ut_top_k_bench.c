@@ -0,0 +1,62 @@
+#include "ut_array.h"
+#include "ut_heap.h"
+#include "ut_top_k.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* The k greatest of n random ints, three ways. */
+static void bench1(int n, int k)
+{
+	ut_top_k_t *top;
+	ut_heap_t *heap;
+	ut_array_t *array;
+	int *data, i;
+	clock_t start;
+
+	data = malloc(n * sizeof(int));
+	srand(1);
+	for (i = 0; i < n; i++)
+		data[i] = rand();
+
+	start = clock();
+	heap = ut_heap_new(ut_type_int());
+	for (i = 0; i < n; i++)
+		ut_heap_push(heap, &data[i]);
+	for (i = 0; i < k; i++)
+		ut_heap_pop(heap);
+	ut_heap_delete(heap);
+	printf("%9d  k %5d  heap %8.3fs", n, k, elapsed(start));
+
+	start = clock();
+	array = ut_array_new(ut_type_int());
+	ut_array_reserve(array, n);
+	for (i = 0; i < n; i++)
+		ut_array_push(array, &data[i]);
+	ut_array_nth_element(array, n - k);
+	ut_array_delete(array);
+	printf("  nth_element %8.3fs", elapsed(start));
+
+	start = clock();
+	top = ut_top_k_new(ut_type_int(), k);
+	for (i = 0; i < n; i++)
+		ut_top_k_push(top, &data[i]);
+	ut_top_k_delete(top);
+	printf("  top_k %8.3fs\n", elapsed(start));
+
+	free(data);
+}
+
+int main()
+{
+	bench1(100000, 10);
+	bench1(4000000, 10);
+	bench1(4000000, 1000);
+	bench1(4000000, 100000);
+	return 0;
+}
@@ -0,0 +1,167 @@
+#include "ut_tree_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench1(int n)
+{
+	ut_tree_map_t *map;
+	int i, key;
+	clock_t start;
+
+	map = ut_tree_map_new(ut_type_int(), ut_type_int());
+
+	srand(1);
+	start = clock();
+	for (i = 0; i < n; i++) {
+		key = rand();
+		ut_tree_map_insert(map, &key, &i);
+	}
+	printf("%9d  insert %8.3fs", n, elapsed(start));
+
+	start = clock();
+	ut_tree_map_clear(map);
+	printf("  clear %8.3fs\n", elapsed(start));
+
+	ut_tree_map_delete(map);
+}
+
+static void bench2(int n)
+{
+	ut_tree_map_t *map;
+	int i, key;
+	clock_t start;
+
+	map = ut_tree_map_new(ut_type_int(), ut_type_int());
+
+	srand(1);
+	for (i = 0; i < n; i++) {
+		key = rand() % (n * 2);
+		ut_tree_map_insert(map, &key, &i);
+	}
+
+	/* Keep the size steady while entries come and go. */
+	start = clock();
+	for (i = 0; i < n * 4; i++) {
+		key = rand() % (n * 2);
+		if (i & 1)
+			ut_tree_map_remove(map, &key);
+		else
+			ut_tree_map_insert(map, &key, &i);
+	}
+	printf("%9d  churn  %8.3fs\n", n, elapsed(start));
+
+	ut_tree_map_delete(map);
+}
+
+static void shuffle(long *keys, int n)
+{
+	long tmp;
+	int i, j;
+
+	for (i = n - 1; i > 0; i--) {
+		j = rand() % (i + 1);
+		tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+}
+
+static void bench3_insert(const char *name, long *keys, int n, bool hinted)
+{
+	ut_tree_map_t *map;
+	struct ut_pair hint = { NULL, NULL };
+	int i;
+	clock_t start;
+
+	map = ut_tree_map_new(ut_type_long(), ut_type_int());
+
+	start = clock();
+	for (i = 0; i < n; i++) {
+		if (hinted)
+			ut_tree_map_insert_hint(map, &hint, &keys[i], &i);
+		else
+			ut_tree_map_insert(map, &keys[i], &i);
+	}
+	printf("  %s %8.3fs", name, elapsed(start));
+
+	ut_tree_map_delete(map);
+}
+
+/*
+ * Timestamps that mostly arrive in order, every hundredth one a little
+ * late, against the same keys in random order.
+ */
+static void bench3(int n)
+{
+	long *keys, ts = 1700000000000L;
+	int i;
+
+	keys = malloc(n * sizeof(long));
+
+	srand(1);
+	for (i = 0; i < n; i++) {
+		ts += 1 + rand() % 10;
+		keys[i] = rand() % 100 ? ts : ts - rand() % 1000;
+	}
+
+	printf("%9d  timestamps", n);
+	bench3_insert("finger", keys, n, false);
+	bench3_insert("hint", keys, n, true);
+	shuffle(keys, n);
+	bench3_insert("random", keys, n, false);
+	putchar('\n');
+
+	free(keys);
+}
+
+/* Splits the map at a random key and joins the halves back. */
+static void bench4(int n)
+{
+	ut_tree_map_t *map, *right;
+	int *keys, i, key, rounds = 10000;
+	clock_t start;
+
+	keys = malloc(n * sizeof(int));
+	for (i = 0; i < n; i++)
+		keys[i] = i;
+
+	map = ut_tree_map_from_sorted(ut_type_int(), ut_type_int(), keys, keys,
+				      n);
+
+	srand(1);
+	start = clock();
+	for (i = 0; i < rounds; i++) {
+		key = rand() % n;
+		right = ut_tree_map_split(map, &key);
+		ut_tree_map_join(map, right);
+		ut_tree_map_delete(right);
+	}
+	printf("%9d  split and join %8.3fus\n", n,
+	       elapsed(start) * 1e6 / rounds);
+
+	ut_tree_map_delete(map);
+	free(keys);
+}
+
+int main()
+{
+	bench1(1000);
+	bench1(100000);
+	bench1(1000000);
+	bench2(1000);
+	bench2(100000);
+	bench2(1000000);
+	bench3(1000);
+	bench3(100000);
+	bench3(1000000);
+	bench4(1000);
+	bench4(100000);
+	bench4(1000000);
+	return 0;
+}
@@ -6,6 +6,9 @@
 
 typedef struct __ut_array ut_array_t;
 
+/* An order that needs more than the elements, like a table to look in. */
+typedef int (*ut_array_compare_fn)(const void *a, const void *b, void *ctx);
+
 ut_array_t *ut_array_new(const struct ut_type *element);
 
 void ut_array_delete(ut_array_t *self);
@@ -22,6 +25,121 @@ int ut_array_insert(ut_array_t *self, size_t index, const void *data);
 
 void ut_array_remove(ut_array_t *self, size_t index);
 
+/*
+ * The range operations below take n elements from data, which must not
+ * point into the array, and move the elements after the range once.
+ */
+
+/* Pushes the n elements at data. */
+int ut_array_extend(ut_array_t *self, const void *data, size_t n);
+
+/* Inserts the n elements at data before index, which may be the length. */
+int ut_array_insert_range(ut_array_t *self, size_t index, const void *data,
+			  size_t n);
+
+/* Removes the up to n elements from index. */
+void ut_array_remove_range(ut_array_t *self, size_t index, size_t n);
+
+/* Removes the element at index in O(1), the last one takes its place. */
+void ut_array_swap_remove(ut_array_t *self, size_t index);
+
+/* Removes the elements from len on. */
+void ut_array_truncate(ut_array_t *self, size_t len);
+
+/*
+ * Truncates or grows to len elements. New ones are copies of fill, or zero
+ * bytes if it is NULL. Copies are not deep, so with a drop only a fill
+ * that is safe to drop many times, like an empty value, makes sense.
+ */
+int ut_array_resize(ut_array_t *self, size_t len, const void *fill);
+
+/*
+ * Replaces the up to removed elements from index with the n elements at
+ * data. Returns UT_ERANGE if index is past the length, UT_ENOMEM if the
+ * array cannot grow, with the array unchanged in both cases.
+ */
+int ut_array_splice(ut_array_t *self, size_t index, size_t removed,
+		    const void *data, size_t n);
+
+/*
+ * Reorders the elements so that the one at n is the one a sort by the
+ * element compare would put there, with none greater before it and none
+ * less after it. Expected O(n), never worse than O(n log n).
+ */
+void ut_array_nth_element(ut_array_t *self, size_t n);
+
+/*
+ * Moves the k least elements to the front in ascending order, leaving the
+ * rest in no particular order, in O(n + k log k).
+ */
+void ut_array_partial_sort(ut_array_t *self, size_t k);
+
+/*
+ * Sorts by the element compare with pattern-defeating quicksort, O(n log n)
+ * at worst and linear on sorted, reversed and all equal input. Arrays of
+ * ut_type_int, uint, long, ulong, float or double elements are radix
+ * sorted instead, without calling compare at all.
+ */
+void ut_array_sort(ut_array_t *self);
+
+/*
+ * Sorts keeping equal elements in their order, with a merge sort that
+ * needs a buffer as large as the array, or a radix sort for the built-in
+ * integer types. Returns UT_ENOMEM if the buffer cannot be had.
+ */
+int ut_array_sort_stable(ut_array_t *self);
+
+/* Sorts by compare, which is passed ctx, as ut_array_sort does. */
+void ut_array_sort_by(ut_array_t *self, ut_array_compare_fn compare,
+		      void *ctx);
+
+/*
+ * Sorts as ut_array_sort does on up to threads threads, one per online CPU
+ * if 0, giving each at least grain elements, or 65536 if 0. Radix sorted
+ * types take a parallel radix sort, others a merge of chunks sorted in
+ * parallel, so compare must be safe to call from several threads. Needs a
+ * buffer as large as the array, and sorts on one thread without it.
+ */
+void ut_array_sort_parallel(ut_array_t *self, unsigned threads,
+			    size_t grain);
+
+/*
+ * The index of the first element not less than key in a sorted array, or
+ * the length if there is none. Built-in integer types are compared inline.
+ */
+size_t ut_array_lower_bound(const ut_array_t *self, const void *key);
+
+/* The index of the first element greater than key, or the length. */
+size_t ut_array_upper_bound(const ut_array_t *self, const void *key);
+
+/* The indexes from the first element equal to key to past the last one. */
+void ut_array_equal_range(const ut_array_t *self, const void *key,
+			  size_t *first, size_t *last);
+
+/*
+ * Sets indexes[i] to the lower bound of the ith of the n keys, running
+ * several searches at once so that their cache misses overlap.
+ */
+void ut_array_lower_bound_many(const ut_array_t *self, const void *keys,
+			       size_t n, size_t *indexes);
+
+/*
+ * Lays a sorted array out in the order of a breadth first walk of its
+ * binary search tree, where the elements of the first steps of every
+ * search share cache lines. Returns UT_ENOMEM if the copy cannot be had.
+ */
+int ut_array_to_eytzinger(ut_array_t *self);
+
+/* Sorts an array laid out by ut_array_to_eytzinger back. */
+int ut_array_from_eytzinger(ut_array_t *self);
+
+/*
+ * The index in an array laid out by ut_array_to_eytzinger of the least
+ * element not less than key, or the length if there is none.
+ */
+size_t ut_array_eytzinger_lower_bound(const ut_array_t *self,
+				      const void *key);
+
 void *ut_array_get(ut_array_t *self, size_t index);
 
 void *ut_array_first(ut_array_t *self);
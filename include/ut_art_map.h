@@ -0,0 +1,52 @@
+#ifndef _UT_ART_MAP_H
+#define _UT_ART_MAP_H
+
+#include "ut_iter.h"
+#include "ut_pair.h"
+#include "ut_type.h"
+
+/*
+ * An ordered map based on an adaptive radix tree. Keys are compared byte
+ * by byte instead of through the compare function of their type, so the
+ * key type must be ut_type_string() or one of the integer types, which are
+ * stored big endian with the sign bit flipped so that the bytes sort like
+ * the numbers. Strings sort by their bytes, shorter strings first.
+ */
+typedef struct __ut_art_map ut_art_map_t;
+
+/* Returns NULL if the key type has no byte order. */
+ut_art_map_t *ut_art_map_new(const struct ut_type *key,
+			     const struct ut_type *value);
+
+void ut_art_map_delete(ut_art_map_t *self);
+
+void ut_art_map_clear(ut_art_map_t *self);
+
+int ut_art_map_insert(ut_art_map_t *self, const void *key, const void *value);
+
+void ut_art_map_remove(ut_art_map_t *self, const void *key);
+
+void *ut_art_map_get(ut_art_map_t *self, const void *key);
+
+struct ut_pair ut_art_map_get_key_value(ut_art_map_t *self, const void *key);
+
+struct ut_pair ut_art_map_first(ut_art_map_t *self);
+
+struct ut_pair ut_art_map_last(ut_art_map_t *self);
+
+size_t ut_art_map_length(const ut_art_map_t *self);
+
+bool ut_art_map_is_empty(const ut_art_map_t *self);
+
+struct ut_iter *ut_art_map_iter_new(ut_art_map_t *map);
+
+/*
+ * Iterates over the keys whose bytes start with the len bytes of prefix.
+ * For string keys those are the leading characters.
+ */
+struct ut_iter *ut_art_map_prefix_iter_new(ut_art_map_t *map,
+					   const void *prefix, size_t len);
+
+void ut_art_map_iter_delete(struct ut_iter *self);
+
+#endif /* ut_art_map.h */
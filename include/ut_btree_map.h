@@ -0,0 +1,35 @@
+#ifndef _UT_BTREE_MAP_H
+#define _UT_BTREE_MAP_H
+
+#include "ut_iter.h"
+#include "ut_pair.h"
+#include "ut_type.h"
+
+typedef struct __ut_btree_map ut_btree_map_t;
+
+ut_btree_map_t *ut_btree_map_new(const struct ut_type *key,
+				 const struct ut_type *value);
+
+void ut_btree_map_delete(ut_btree_map_t *self);
+
+void ut_btree_map_clear(ut_btree_map_t *self);
+
+int ut_btree_map_insert(ut_btree_map_t *self, const void *key,
+			const void *value);
+
+void ut_btree_map_remove(ut_btree_map_t *self, const void *key);
+
+void *ut_btree_map_get(ut_btree_map_t *self, const void *key);
+
+struct ut_pair ut_btree_map_get_key_value(ut_btree_map_t *self,
+					  const void *key);
+
+size_t ut_btree_map_length(const ut_btree_map_t *self);
+
+bool ut_btree_map_is_empty(const ut_btree_map_t *self);
+
+struct ut_iter *ut_btree_map_iter_new(ut_btree_map_t *map);
+
+void ut_btree_map_iter_delete(struct ut_iter *self);
+
+#endif /* ut_btree_map.h */
@@ -26,6 +26,31 @@ int ut_deque_insert(ut_deque_t *self, size_t index, const void *data);
 
 void ut_deque_remove(ut_deque_t *self, size_t index);
 
+/*
+ * The range operations below take n elements from data, which must not
+ * point into the deque, and move the shorter side of the range once, in
+ * up to three runs where it wraps around.
+ */
+
+/* Pushes the n elements at data to the back. */
+int ut_deque_extend(ut_deque_t *self, const void *data, size_t n);
+
+/* Pushes the n elements at data to the front, keeping their order. */
+int ut_deque_extend_front(ut_deque_t *self, const void *data, size_t n);
+
+/* Inserts the n elements at data before index, which may be the length. */
+int ut_deque_insert_range(ut_deque_t *self, size_t index, const void *data,
+			  size_t n);
+
+/* Removes the up to n elements from index. */
+void ut_deque_remove_range(ut_deque_t *self, size_t index, size_t n);
+
+/* Removes the elements from len on. */
+void ut_deque_truncate(ut_deque_t *self, size_t len);
+
+/* Removes elements from the front until len are left. */
+void ut_deque_truncate_front(ut_deque_t *self, size_t len);
+
 void *ut_deque_get(ut_deque_t *self, size_t index);
 
 void *ut_deque_front(ut_deque_t *self);
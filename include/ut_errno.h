@@ -5,5 +5,6 @@
 #define UT_EINVAL 1
 #define UT_ENOMEM 2
 #define UT_ERANGE 3
+#define UT_EEXIST 4
 
 #endif /* ut_errno.h */
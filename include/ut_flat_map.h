@@ -0,0 +1,102 @@
+#ifndef _UT_FLAT_MAP_H
+#define _UT_FLAT_MAP_H
+
+#include "ut_iter.h"
+#include "ut_pair.h"
+#include "ut_type.h"
+
+/*
+ * An ordered map that keeps its keys and values sorted in two contiguous
+ * arrays, for data that is read far more often than it changes. New keys
+ * first go to a short unsorted tail, which is sorted and merged into the
+ * rest in one pass once it is full, or as soon as the order is needed.
+ */
+typedef struct __ut_flat_map ut_flat_map_t;
+
+ut_flat_map_t *ut_flat_map_new(const struct ut_type *key,
+			       const struct ut_type *value);
+
+/*
+ * Creates a map from n keys in strictly ascending order and their values
+ * in O(n). Returns NULL if the keys are not sorted or not unique.
+ */
+ut_flat_map_t *ut_flat_map_from_sorted(const struct ut_type *key,
+				       const struct ut_type *value,
+				       const void *keys, const void *values,
+				       size_t n);
+
+void ut_flat_map_delete(ut_flat_map_t *self);
+
+void ut_flat_map_clear(ut_flat_map_t *self);
+
+int ut_flat_map_insert(ut_flat_map_t *self, const void *key,
+		       const void *value);
+
+/*
+ * Inserts n keys and values in O(n log n + m) for m keys in the map. The
+ * map takes all of them, where a key is already there or repeats, the
+ * last value wins and the extra key is dropped.
+ */
+int ut_flat_map_insert_many(ut_flat_map_t *self, const void *keys,
+			    const void *values, size_t n);
+
+void ut_flat_map_remove(ut_flat_map_t *self, const void *key);
+
+void ut_flat_map_pop_first(ut_flat_map_t *self);
+
+void ut_flat_map_pop_last(ut_flat_map_t *self);
+
+/*
+ * Pointers into the map stay valid until the map changes, or one of the
+ * calls below that needs the order merges the tail.
+ */
+void *ut_flat_map_get(ut_flat_map_t *self, const void *key);
+
+struct ut_pair ut_flat_map_get_key_value(ut_flat_map_t *self,
+					 const void *key);
+
+struct ut_pair ut_flat_map_first(ut_flat_map_t *self);
+
+struct ut_pair ut_flat_map_last(ut_flat_map_t *self);
+
+/* The first entry whose key is not less than key. */
+struct ut_pair ut_flat_map_lower_bound(ut_flat_map_t *self, const void *key);
+
+/* The first entry whose key is greater than key. */
+struct ut_pair ut_flat_map_upper_bound(ut_flat_map_t *self, const void *key);
+
+/* The last entry whose key is not greater than key. */
+struct ut_pair ut_flat_map_floor(ut_flat_map_t *self, const void *key);
+
+/* The first entry whose key is not less than key. */
+struct ut_pair ut_flat_map_ceiling(ut_flat_map_t *self, const void *key);
+
+/* The entry with index smallest keys before it, in O(1). */
+struct ut_pair ut_flat_map_select(ut_flat_map_t *self, size_t index);
+
+/* The number of keys less than key. */
+size_t ut_flat_map_rank(ut_flat_map_t *self, const void *key);
+
+/* The number of keys in [from, to). A NULL bound is unbounded. */
+size_t ut_flat_map_count_range(ut_flat_map_t *self, const void *from,
+			       const void *to);
+
+size_t ut_flat_map_length(const ut_flat_map_t *self);
+
+bool ut_flat_map_is_empty(const ut_flat_map_t *self);
+
+struct ut_iter *ut_flat_map_iter_new(ut_flat_map_t *map);
+
+struct ut_iter *ut_flat_map_rev_iter_new(ut_flat_map_t *map);
+
+/* Iterates over the keys in [from, to). A NULL bound is unbounded. */
+struct ut_iter *ut_flat_map_range_iter_new(ut_flat_map_t *map,
+					   const void *from, const void *to);
+
+struct ut_iter *ut_flat_map_range_rev_iter_new(ut_flat_map_t *map,
+					       const void *from,
+					       const void *to);
+
+void ut_flat_map_iter_delete(struct ut_iter *self);
+
+#endif /* ut_flat_map.h */
@@ -4,20 +4,72 @@
 #include "ut_iter.h"
 #include "ut_type.h"
 
+/*
+ * A d-ary heap on a contiguous array, binary by default. The top is the
+ * greatest element by default, push and pop are O(log n).
+ */
 typedef struct __ut_heap ut_heap_t;
 
+typedef int (*ut_heap_compare_fn)(const void *a, const void *b);
+
 ut_heap_t *ut_heap_new(const struct ut_type *element);
 
+/* Creates a heap whose top is the least element. */
+ut_heap_t *ut_heap_new_min(const struct ut_type *element);
+
+/* Creates a heap whose top is the greatest element by compare. */
+ut_heap_t *ut_heap_new_by(const struct ut_type *element,
+			  ut_heap_compare_fn compare);
+
+/* Creates a max heap from n elements in O(n). The heap takes them. */
+ut_heap_t *ut_heap_from_array(const struct ut_type *element, const void *data,
+			      size_t n);
+
 void ut_heap_delete(ut_heap_t *self);
 
+/*
+ * Sets how many children each node has, from 2 to 64, and reorders the
+ * heap in O(n). A wider heap is flatter, so a pop touches fewer cache lines
+ * for more compares. The children of a node are kept on one line when
+ * arity times the element size is 64 bytes, like 8 longs or 16 ints.
+ */
+int ut_heap_set_arity(ut_heap_t *self, size_t arity);
+
+size_t ut_heap_arity(const ut_heap_t *self);
+
 void ut_heap_clear(ut_heap_t *self);
 
 int ut_heap_reserve(ut_heap_t *self, size_t additional);
 
 int ut_heap_push(ut_heap_t *self, const void *data);
 
+/*
+ * Pushes n elements. A batch larger than the heap is heapified in place in
+ * O(n + len) rather than sifted up one by one.
+ */
+int ut_heap_push_many(ut_heap_t *self, const void *data, size_t n);
+
 void ut_heap_pop(ut_heap_t *self);
 
+/*
+ * Pops the top into data instead of dropping it, so the caller owns it.
+ * Returns false if the heap is empty.
+ */
+bool ut_heap_pop_into(ut_heap_t *self, void *data);
+
+/*
+ * Drops the top and puts data in its place with a single sift down, which
+ * is cheaper than a pop followed by a push. Pushes onto an empty heap.
+ */
+int ut_heap_replace_top(ut_heap_t *self, const void *data);
+
+/*
+ * Pushes the element at data and pops the top into data in one step, so
+ * the caller owns what comes back. If data itself would be the top, the
+ * heap is left alone.
+ */
+void ut_heap_pushpop(ut_heap_t *self, void *data);
+
 void *ut_heap_peek(ut_heap_t *self);
 
 size_t ut_heap_capacity(const ut_heap_t *self);
@@ -26,8 +78,16 @@ size_t ut_heap_length(const ut_heap_t *self);
 
 bool ut_heap_is_empty(const ut_heap_t *self);
 
+/* Iterates over the elements in storage order, not in priority order. */
 struct ut_iter *ut_heap_iter_new(ut_heap_t *heap);
 
+/*
+ * Pops the elements one by one in priority order as it goes, O(log n)
+ * each. The caller owns every element it gets, which stays valid until
+ * the next push. Deleted with ut_heap_iter_delete.
+ */
+struct ut_iter *ut_heap_drain_iter_new(ut_heap_t *heap);
+
 void ut_heap_iter_delete(struct ut_iter *self);
 
 #endif /* ut_heap.h */
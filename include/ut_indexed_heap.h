@@ -0,0 +1,76 @@
+#ifndef _UT_INDEXED_HEAP_H
+#define _UT_INDEXED_HEAP_H
+
+#include "ut_heap.h"
+#include "ut_iter.h"
+#include "ut_type.h"
+
+/*
+ * A binary heap whose elements can be reached by a handle after they are
+ * pushed, to change their priority or take them out in O(log n). The
+ * elements are kept in heap order in one array, so sifting compares
+ * neighbours in memory, and two arrays of indices map handles to positions
+ * and back.
+ */
+typedef struct __ut_indexed_heap ut_indexed_heap_t;
+
+ut_indexed_heap_t *ut_indexed_heap_new(const struct ut_type *element);
+
+/* Creates a heap whose top is the least element. */
+ut_indexed_heap_t *ut_indexed_heap_new_min(const struct ut_type *element);
+
+/* Creates a heap whose top is the greatest element by compare. */
+ut_indexed_heap_t *ut_indexed_heap_new_by(const struct ut_type *element,
+					  ut_heap_compare_fn compare);
+
+void ut_indexed_heap_delete(ut_indexed_heap_t *self);
+
+void ut_indexed_heap_clear(ut_indexed_heap_t *self);
+
+int ut_indexed_heap_reserve(ut_indexed_heap_t *self, size_t additional);
+
+/*
+ * Pushes data and stores its handle in handle if not NULL. A handle stays
+ * valid until its element is popped or removed, after which it may be
+ * given out again.
+ */
+int ut_indexed_heap_push(ut_indexed_heap_t *self, const void *data,
+			 size_t *handle);
+
+void ut_indexed_heap_pop(ut_indexed_heap_t *self);
+
+void *ut_indexed_heap_peek(ut_indexed_heap_t *self);
+
+/* The handle of the top, or SIZE_MAX if the heap is empty. */
+size_t ut_indexed_heap_peek_handle(const ut_indexed_heap_t *self);
+
+bool ut_indexed_heap_contains(const ut_indexed_heap_t *self, size_t handle);
+
+/*
+ * The element of handle, or NULL if handle is not in the heap. It moves
+ * whenever the heap changes.
+ */
+void *ut_indexed_heap_get(ut_indexed_heap_t *self, size_t handle);
+
+/*
+ * Restores the order after the element of handle was changed in place, in
+ * either direction.
+ */
+void ut_indexed_heap_update(ut_indexed_heap_t *self, size_t handle);
+
+/* Drops the element of handle and puts data in its place. */
+int ut_indexed_heap_replace(ut_indexed_heap_t *self, size_t handle,
+			    const void *data);
+
+void ut_indexed_heap_remove(ut_indexed_heap_t *self, size_t handle);
+
+size_t ut_indexed_heap_length(const ut_indexed_heap_t *self);
+
+bool ut_indexed_heap_is_empty(const ut_indexed_heap_t *self);
+
+/* Iterates over the elements in storage order, not in priority order. */
+struct ut_iter *ut_indexed_heap_iter_new(ut_indexed_heap_t *heap);
+
+void ut_indexed_heap_iter_delete(struct ut_iter *self);
+
+#endif /* ut_indexed_heap.h */
@@ -0,0 +1,135 @@
+#ifndef _UT_MEM_H
+#define _UT_MEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Memory primitives for element sizes only known at run time. The common
+ * element sizes get their own paths, larger blocks are handled in 32 byte
+ * chunks. Fixed size memcpy calls compile to plain loads and stores, which
+ * are vector registers for 16 and 32 bytes on most targets.
+ */
+
+#define UT_MEM_CHUNK 32
+
+/*
+ * The strictest alignment of any basic type, what C11 calls
+ * _Alignof(max_align_t). Elements placed after a header start at a
+ * multiple of it, as they would in memory from malloc.
+ */
+union ut_mem_max_align {
+	long double ld;
+	long long ll;
+	double d;
+	void *p;
+	void (*fp)(void);
+};
+
+struct ut_mem_max_align_probe {
+	char c;
+	union ut_mem_max_align u;
+};
+
+#define UT_MEM_MAX_ALIGN offsetof(struct ut_mem_max_align_probe, u)
+
+/* Rounds n up to a multiple of UT_MEM_MAX_ALIGN. */
+#define UT_MEM_ALIGN(n) \
+	(((n) + UT_MEM_MAX_ALIGN - 1) & ~(UT_MEM_MAX_ALIGN - 1))
+
+static inline void ut_memswap_fixed(uint8_t *a, uint8_t *b, size_t size)
+{
+	uint8_t tmp[UT_MEM_CHUNK];
+
+	memcpy(tmp, a, size);
+	memcpy(a, b, size);
+	memcpy(b, tmp, size);
+}
+
+static inline void ut_memswap(void *a, void *b, size_t size)
+{
+	uint8_t *x = a, *y = b;
+	uint64_t tmp;
+
+	switch (size) {
+	case 4:
+		ut_memswap_fixed(x, y, 4);
+		return;
+	case 8:
+		ut_memswap_fixed(x, y, 8);
+		return;
+	case 16:
+		ut_memswap_fixed(x, y, 16);
+		return;
+	case 32:
+		ut_memswap_fixed(x, y, 32);
+		return;
+	}
+
+	for (; size >= UT_MEM_CHUNK; size -= UT_MEM_CHUNK) {
+		ut_memswap_fixed(x, y, UT_MEM_CHUNK);
+		x += UT_MEM_CHUNK;
+		y += UT_MEM_CHUNK;
+	}
+
+	for (; size >= sizeof(tmp); size -= sizeof(tmp)) {
+		memcpy(&tmp, x, sizeof(tmp));
+		memcpy(x, y, sizeof(tmp));
+		memcpy(y, &tmp, sizeof(tmp));
+		x += sizeof(tmp);
+		y += sizeof(tmp);
+	}
+
+	for (; size; size--) {
+		tmp = *x;
+		*x++ = *y;
+		*y++ = (uint8_t)tmp;
+	}
+}
+
+/* Moves size bytes from src to dst, the two may overlap. */
+static inline void ut_memmove(void *dst, const void *src, size_t size)
+{
+	uint8_t tmp[16];
+
+	switch (size) {
+	case 4:
+		memcpy(tmp, src, 4);
+		memcpy(dst, tmp, 4);
+		return;
+	case 8:
+		memcpy(tmp, src, 8);
+		memcpy(dst, tmp, 8);
+		return;
+	case 16:
+		memcpy(tmp, src, 16);
+		memcpy(dst, tmp, 16);
+		return;
+	}
+
+	memmove(dst, src, size);
+}
+
+static inline bool ut_memeq(const void *a, const void *b, size_t size)
+{
+	uint64_t p[2], q[2];
+
+	switch (size) {
+	case 4:
+		return !memcmp(a, b, 4);
+	case 8:
+		memcpy(p, a, 8);
+		memcpy(q, b, 8);
+		return p[0] == q[0];
+	case 16:
+		memcpy(p, a, 16);
+		memcpy(q, b, 16);
+		return !((p[0] ^ q[0]) | (p[1] ^ q[1]));
+	}
+
+	return !memcmp(a, b, size);
+}
+
+#endif /* ut_mem.h */
@@ -0,0 +1,53 @@
+#ifndef _UT_MULTI_QUEUE_H
+#define _UT_MULTI_QUEUE_H
+
+#include "ut_heap.h"
+#include "ut_type.h"
+
+/*
+ * A priority queue for many threads made of several heaps, each behind its
+ * own lock (a MultiQueue). A push goes to a random heap, a pop takes the
+ * better top of two random heaps, and a thread that finds a heap locked
+ * simply picks another. Pops are relaxed: what comes out is near the top
+ * rather than the top itself, the more heaps the further off it may be.
+ * Two to four heaps per thread keep contention low.
+ */
+typedef struct __ut_multi_queue ut_multi_queue_t;
+
+/* Returns NULL if queues is 0. The top is the greatest element. */
+ut_multi_queue_t *ut_multi_queue_new(const struct ut_type *element,
+				     size_t queues);
+
+/* Creates a queue whose top is the least element. */
+ut_multi_queue_t *ut_multi_queue_new_min(const struct ut_type *element,
+					 size_t queues);
+
+/* Creates a queue whose top is the greatest element by compare. */
+ut_multi_queue_t *ut_multi_queue_new_by(const struct ut_type *element,
+					size_t queues,
+					ut_heap_compare_fn compare);
+
+/* No other thread may use the queue any more. */
+void ut_multi_queue_delete(ut_multi_queue_t *self);
+
+/* The queue takes the element at data. */
+int ut_multi_queue_push(ut_multi_queue_t *self, const void *data);
+
+/*
+ * Moves an element near the top into data, which the caller then owns.
+ * Returns false once the queue is empty.
+ */
+bool ut_multi_queue_pop(ut_multi_queue_t *self, void *data);
+
+/*
+ * Moves the top itself into data. Every heap is locked for the pop, so it
+ * does not scale, but it gives the order of a single heap when needed.
+ */
+bool ut_multi_queue_pop_strict(ut_multi_queue_t *self, void *data);
+
+/* Only exact while no other thread pushes or pops. */
+size_t ut_multi_queue_length(const ut_multi_queue_t *self);
+
+bool ut_multi_queue_is_empty(const ut_multi_queue_t *self);
+
+#endif /* ut_multi_queue.h */
@@ -0,0 +1,67 @@
+#ifndef _UT_PAIRING_HEAP_H
+#define _UT_PAIRING_HEAP_H
+
+#include "ut_heap.h"
+#include "ut_type.h"
+
+/*
+ * A pairing heap: a tree of nodes where every parent is above its
+ * children. Push and meld link two trees in O(1), pop pairs up the
+ * children of the top in amortized O(log n). Nodes come from a pool and
+ * stay put, so a pushed element can be reached through its node to move
+ * it up or take it out. The top is the greatest element by default.
+ */
+typedef struct __ut_pairing_heap ut_pairing_heap_t;
+
+/* A pushed element, valid until it is popped or removed. */
+struct ut_pairing_node;
+
+ut_pairing_heap_t *ut_pairing_heap_new(const struct ut_type *element);
+
+/* Creates a heap whose top is the least element. */
+ut_pairing_heap_t *ut_pairing_heap_new_min(const struct ut_type *element);
+
+/* Creates a heap whose top is the greatest element by compare. */
+ut_pairing_heap_t *ut_pairing_heap_new_by(const struct ut_type *element,
+					  ut_heap_compare_fn compare);
+
+void ut_pairing_heap_delete(ut_pairing_heap_t *self);
+
+void ut_pairing_heap_clear(ut_pairing_heap_t *self);
+
+/* Pushes data and stores its node in node if not NULL. */
+int ut_pairing_heap_push(ut_pairing_heap_t *self, const void *data,
+			 struct ut_pairing_node **node);
+
+void ut_pairing_heap_pop(ut_pairing_heap_t *self);
+
+void *ut_pairing_heap_peek(ut_pairing_heap_t *self);
+
+/* The element of node, which may be changed in place. */
+void *ut_pairing_heap_get(struct ut_pairing_node *node);
+
+/*
+ * Restores the order after the element of node was changed in place to
+ * move it toward the top, a decrease key in a min heap. Amortized
+ * O(log n). An element that moves away from the top has to be removed and
+ * pushed again.
+ */
+void ut_pairing_heap_update(ut_pairing_heap_t *self,
+			    struct ut_pairing_node *node);
+
+void ut_pairing_heap_remove(ut_pairing_heap_t *self,
+			    struct ut_pairing_node *node);
+
+/*
+ * Moves every element of other into self in O(1), leaving other empty.
+ * The nodes keep working with self. From then on the two heaps allocate
+ * from the same pool. Returns UT_EINVAL unless both have the same element
+ * type and order.
+ */
+int ut_pairing_heap_meld(ut_pairing_heap_t *self, ut_pairing_heap_t *other);
+
+size_t ut_pairing_heap_length(const ut_pairing_heap_t *self);
+
+bool ut_pairing_heap_is_empty(const ut_pairing_heap_t *self);
+
+#endif /* ut_pairing_heap.h */
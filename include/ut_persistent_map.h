@@ -0,0 +1,58 @@
+#ifndef _UT_PERSISTENT_MAP_H
+#define _UT_PERSISTENT_MAP_H
+
+#include "ut_iter.h"
+#include "ut_pair.h"
+#include "ut_type.h"
+
+/*
+ * A persistent ordered map. Every handle is an immutable version: insert
+ * and remove leave it untouched and return a new version, which shares all
+ * nodes off the changed path with the old one. Nodes and the key value
+ * pairs in them are reference counted atomically, so versions can be read,
+ * copied and deleted from any number of threads.
+ */
+typedef struct __ut_persistent_map ut_persistent_map_t;
+
+/* Creates an empty version. */
+ut_persistent_map_t *ut_persistent_map_new(const struct ut_type *key,
+					   const struct ut_type *value);
+
+/* Releases a version, the nodes it shares with others are kept alive. */
+void ut_persistent_map_delete(ut_persistent_map_t *self);
+
+/* Returns another handle of the same version in O(1). */
+ut_persistent_map_t *
+ut_persistent_map_snapshot(const ut_persistent_map_t *self);
+
+/*
+ * Returns a new version with key mapped to value in O(log n), or NULL if
+ * out of memory. The map takes ownership of key and value.
+ */
+ut_persistent_map_t *ut_persistent_map_insert(const ut_persistent_map_t *self,
+					      const void *key,
+					      const void *value);
+
+/* Returns a new version without key, or NULL if out of memory. */
+ut_persistent_map_t *ut_persistent_map_remove(const ut_persistent_map_t *self,
+					      const void *key);
+
+/* Values are shared between versions and must not be modified. */
+void *ut_persistent_map_get(const ut_persistent_map_t *self, const void *key);
+
+struct ut_pair ut_persistent_map_get_key_value(const ut_persistent_map_t *self,
+					       const void *key);
+
+struct ut_pair ut_persistent_map_first(const ut_persistent_map_t *self);
+
+struct ut_pair ut_persistent_map_last(const ut_persistent_map_t *self);
+
+size_t ut_persistent_map_length(const ut_persistent_map_t *self);
+
+bool ut_persistent_map_is_empty(const ut_persistent_map_t *self);
+
+struct ut_iter *ut_persistent_map_iter_new(const ut_persistent_map_t *map);
+
+void ut_persistent_map_iter_delete(struct ut_iter *self);
+
+#endif /* ut_persistent_map.h */
@@ -0,0 +1,48 @@
+#ifndef _UT_POOL_H
+#define _UT_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A pool of fixed size objects. Objects are carved out of slabs and freed
+ * objects are kept on a freelist for reuse. Slabs are only returned to the
+ * system by a clear, or when the last owner of a shared pool deletes it.
+ * Objects are aligned as malloc aligns its memory. The owners of a shared
+ * pool may use it from different threads, alloc and free then take a lock.
+ */
+typedef struct __ut_pool ut_pool_t;
+
+ut_pool_t *ut_pool_new(size_t size);
+
+/* Drops one reference, the slabs go away with the last one. */
+void ut_pool_delete(ut_pool_t *self);
+
+/* Adds a reference for another owner and returns the pool. */
+ut_pool_t *ut_pool_share(ut_pool_t *self);
+
+bool ut_pool_is_shared(const ut_pool_t *self);
+
+/*
+ * Merges the slabs and free objects of other into self in O(1), from then
+ * on both pools allocate from the same slabs. Returns UT_EINVAL if the
+ * strides differ.
+ */
+int ut_pool_merge(ut_pool_t *self, ut_pool_t *other);
+
+/*
+ * Releases all slabs, every object of the pool becomes invalid. Only for a
+ * pool that is not shared.
+ */
+void ut_pool_clear(ut_pool_t *self);
+
+void *ut_pool_alloc(ut_pool_t *self);
+
+/* Allocates n objects contiguously, each stride bytes from the previous. */
+void *ut_pool_alloc_block(ut_pool_t *self, size_t n);
+
+void ut_pool_free(ut_pool_t *self, void *ptr);
+
+size_t ut_pool_stride(const ut_pool_t *self);
+
+#endif /* ut_pool.h */
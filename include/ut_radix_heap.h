@@ -0,0 +1,41 @@
+#ifndef _UT_RADIX_HEAP_H
+#define _UT_RADIX_HEAP_H
+
+#include "ut_type.h"
+#include <stdint.h>
+
+/*
+ * A monotone min heap of elements with unsigned 64 bit keys, for uses like
+ * Dijkstra where no key pushed is less than the last one popped. Elements
+ * sit in 65 buckets by the highest bit in which their key differs from the
+ * last popped key, and each element moves to lower buckets at most 64
+ * times in all, so push is O(1) and pop amortized O(log C) for keys that
+ * span C. Keys are never compared one against another beyond that.
+ */
+typedef struct __ut_radix_heap ut_radix_heap_t;
+
+ut_radix_heap_t *ut_radix_heap_new(const struct ut_type *element);
+
+void ut_radix_heap_delete(ut_radix_heap_t *self);
+
+void ut_radix_heap_clear(ut_radix_heap_t *self);
+
+/*
+ * Pushes data with key, the heap takes it. Returns UT_ERANGE if key is less
+ * than the key last popped, or peeked at.
+ */
+int ut_radix_heap_push(ut_radix_heap_t *self, uint64_t key, const void *data);
+
+void ut_radix_heap_pop(ut_radix_heap_t *self);
+
+/* The element with the least key and that key in key if not NULL. */
+void *ut_radix_heap_peek(ut_radix_heap_t *self, uint64_t *key);
+
+/* The least key a push may still use. */
+uint64_t ut_radix_heap_last(const ut_radix_heap_t *self);
+
+size_t ut_radix_heap_length(const ut_radix_heap_t *self);
+
+bool ut_radix_heap_is_empty(const ut_radix_heap_t *self);
+
+#endif /* ut_radix_heap.h */
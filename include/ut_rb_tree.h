@@ -0,0 +1,146 @@
+#ifndef _UT_RB_TREE_H
+#define _UT_RB_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * An intrusive red-black tree. Objects embed a struct ut_rb_node and are
+ * linked into the tree in place, the tree never allocates or copies. An
+ * object with several nodes can be kept in several trees at once. This is
+ * the balancing engine that ut_tree_map and ut_tree_set are built on.
+ * Every node keeps the size of its subtree, for O(log n) select, rank and
+ * split.
+ */
+
+struct ut_rb_node {
+	struct ut_rb_node *parent;
+	struct ut_rb_node *left;
+	struct ut_rb_node *right;
+	int color;
+	size_t size;
+};
+
+/* Orders two linked objects by their nodes. */
+typedef int (*ut_rb_compare_fn)(const struct ut_rb_node *a,
+				const struct ut_rb_node *b);
+
+/* Orders a search key against a linked object. */
+typedef int (*ut_rb_search_fn)(const void *key, const struct ut_rb_node *node);
+
+/* Hands back a node that a set operation dropped from the result. */
+typedef void (*ut_rb_release_fn)(struct ut_rb_node *node, void *arg);
+
+struct ut_rb_tree {
+	struct ut_rb_node *root;
+	size_t len;
+	ut_rb_compare_fn compare;
+};
+
+/* The object of type that contains node as its member. */
+#define ut_rb_entry(node, type, member) \
+	((type *)((char *)(node) - offsetof(type, member)))
+
+void ut_rb_tree_init(struct ut_rb_tree *self, ut_rb_compare_fn compare);
+
+/* The same as ut_rb_tree_init, every tree keeps its subtree sizes now. */
+void ut_rb_tree_init_ranked(struct ut_rb_tree *self, ut_rb_compare_fn compare);
+
+/*
+ * Links node into the tree. Returns NULL on success, or the node already in
+ * the tree that compares equal, in which case node is left unlinked.
+ */
+struct ut_rb_node *ut_rb_tree_insert(struct ut_rb_tree *self,
+				     struct ut_rb_node *node);
+
+/*
+ * Links node as the child of parent at link, which must be the empty child
+ * pointer a search ended on (or &self->root for an empty tree), and
+ * rebalances. For callers that do their own search.
+ */
+void ut_rb_tree_link(struct ut_rb_tree *self, struct ut_rb_node *node,
+		     struct ut_rb_node *parent, struct ut_rb_node **link);
+
+/* Unlinks node, no other node of the tree moves in memory. */
+void ut_rb_tree_remove(struct ut_rb_tree *self, struct ut_rb_node *node);
+
+/*
+ * Empties the tree in O(n), passing every node to release, which may free
+ * it. No link of a node is read after it is released.
+ */
+void ut_rb_tree_clear(struct ut_rb_tree *self, ut_rb_release_fn release,
+		      void *arg);
+
+/*
+ * Links n nodes which are stride bytes apart, starting at base, into an
+ * empty tree in O(n). The nodes must already be in ascending order.
+ */
+void ut_rb_tree_build(struct ut_rb_tree *self, void *base, size_t stride,
+		      size_t n);
+
+/*
+ * Moves node and every node after it into right, which is initialized like
+ * self, in O(log n). A NULL node leaves right empty.
+ */
+void ut_rb_tree_split(struct ut_rb_tree *self, struct ut_rb_node *node,
+		      struct ut_rb_tree *right);
+
+/*
+ * Moves every node of right, which must all be after the nodes of self, to
+ * the end of self in O(log n).
+ */
+void ut_rb_tree_join(struct ut_rb_tree *self, struct ut_rb_tree *right);
+
+/*
+ * The set operations need a compare function. They leave the result in
+ * self and other empty, and pass every node that is in neither to release.
+ * Of two equal nodes, the one of self is kept. O(m log(n / m + 1)) for the
+ * smaller size m, by divide and conquer over split and join.
+ */
+void ut_rb_tree_union(struct ut_rb_tree *self, struct ut_rb_tree *other,
+		      ut_rb_release_fn release, void *arg);
+
+void ut_rb_tree_intersection(struct ut_rb_tree *self,
+			     struct ut_rb_tree *other,
+			     ut_rb_release_fn release, void *arg);
+
+void ut_rb_tree_difference(struct ut_rb_tree *self, struct ut_rb_tree *other,
+			   ut_rb_release_fn release, void *arg);
+
+struct ut_rb_node *ut_rb_tree_find(const struct ut_rb_tree *self,
+				   const void *key, ut_rb_search_fn search);
+
+/* The first node that is not less than key. */
+struct ut_rb_node *ut_rb_tree_lower_bound(const struct ut_rb_tree *self,
+					  const void *key,
+					  ut_rb_search_fn search);
+
+/* The first node that is greater than key. */
+struct ut_rb_node *ut_rb_tree_upper_bound(const struct ut_rb_tree *self,
+					  const void *key,
+					  ut_rb_search_fn search);
+
+struct ut_rb_node *ut_rb_tree_first(const struct ut_rb_tree *self);
+
+struct ut_rb_node *ut_rb_tree_last(const struct ut_rb_tree *self);
+
+struct ut_rb_node *ut_rb_tree_next(const struct ut_rb_node *node);
+
+struct ut_rb_node *ut_rb_tree_prev(const struct ut_rb_node *node);
+
+/*
+ * The node at position index in ascending order in O(log n), or NULL if out
+ * of range.
+ */
+struct ut_rb_node *ut_rb_tree_select(const struct ut_rb_tree *self,
+				     size_t index);
+
+/* The position of a linked node in ascending order, in O(log n). */
+size_t ut_rb_tree_rank(const struct ut_rb_tree *self,
+		       const struct ut_rb_node *node);
+
+size_t ut_rb_tree_length(const struct ut_rb_tree *self);
+
+bool ut_rb_tree_is_empty(const struct ut_rb_tree *self);
+
+#endif /* ut_rb_tree.h */
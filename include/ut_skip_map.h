@@ -0,0 +1,65 @@
+#ifndef _UT_SKIP_MAP_H
+#define _UT_SKIP_MAP_H
+
+#include "ut_iter.h"
+#include "ut_pair.h"
+#include "ut_type.h"
+
+/*
+ * An ordered map based on a lock-free skip list, which any number of
+ * threads may read and update at once. Removed entries are first marked
+ * and then unlinked, their memory is reclaimed once no thread can still
+ * see them (epoch based reclamation).
+ *
+ * Pointers into the map are only safe while the calling thread is pinned.
+ * Every call pins on its own, ut_skip_map_pin and ut_skip_map_unpin let the
+ * caller keep the map pinned across several calls. Pins nest.
+ */
+typedef struct __ut_skip_map ut_skip_map_t;
+
+ut_skip_map_t *ut_skip_map_new(const struct ut_type *key,
+			       const struct ut_type *value);
+
+/* No other thread may use the map any more. */
+void ut_skip_map_delete(ut_skip_map_t *self);
+
+int ut_skip_map_pin(ut_skip_map_t *self);
+
+void ut_skip_map_unpin(ut_skip_map_t *self);
+
+/*
+ * Inserts key if it is not in the map yet, returns UT_EEXIST otherwise.
+ * Values are never changed in place, a new value takes a remove first.
+ */
+int ut_skip_map_insert(ut_skip_map_t *self, const void *key,
+		       const void *value);
+
+/* Returns true if this call removed key. */
+bool ut_skip_map_remove(ut_skip_map_t *self, const void *key);
+
+/* The value stays valid until the calling thread unpins. */
+void *ut_skip_map_get(ut_skip_map_t *self, const void *key);
+
+/* Copies the value of key out, returns false if there is none. */
+bool ut_skip_map_load(ut_skip_map_t *self, const void *key, void *value);
+
+/* Exact only while no other thread changes the map. */
+size_t ut_skip_map_length(const ut_skip_map_t *self);
+
+bool ut_skip_map_is_empty(const ut_skip_map_t *self);
+
+/*
+ * Iterators are weakly consistent: they see every entry that stays in the
+ * map for the whole iteration, and may or may not see concurrent changes.
+ * An iterator keeps its thread pinned until it is deleted, on the thread
+ * that created it.
+ */
+struct ut_iter *ut_skip_map_iter_new(ut_skip_map_t *map);
+
+/* Iterates over the keys in [from, to), NULL leaves that side unbounded. */
+struct ut_iter *ut_skip_map_range_iter_new(ut_skip_map_t *map,
+					   const void *from, const void *to);
+
+void ut_skip_map_iter_delete(struct ut_iter *self);
+
+#endif /* ut_skip_map.h */
@@ -0,0 +1,54 @@
+#ifndef _UT_THREAD_H
+#define _UT_THREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per thread records for objects that many threads use at once. All
+ * registries share one thread key, so any number of them may exist. A
+ * thread gets a record the first time it uses a registry, records of
+ * exited threads are handed to later ones, and a record is freed once both
+ * its registry and its last thread let go of it.
+ */
+struct ut_thread_record {
+	struct ut_thread_record *next;
+	const struct ut_thread_registry *owner;
+	uint64_t seed;
+	size_t refs;
+	int in_use;
+	int dead;
+};
+
+struct ut_thread_registry {
+	struct ut_thread_record *records;
+	size_t size;
+};
+
+/* Records are size bytes, of a struct that starts with a ut_thread_record. */
+void ut_thread_registry_init(struct ut_thread_registry *self, size_t size);
+
+/*
+ * Calls fini, unless NULL, on every record before letting go of it. No
+ * thread may use the registry any more.
+ */
+void ut_thread_registry_destroy(struct ut_thread_registry *self,
+				void (*fini)(struct ut_thread_record *rec,
+					     void *arg),
+				void *arg);
+
+/*
+ * The record of the calling thread, zeroed past the header when new.
+ * Returns NULL if out of memory.
+ */
+struct ut_thread_record *
+ut_thread_registry_get(struct ut_thread_registry *self);
+
+/* The newest record, other threads may add records meanwhile. */
+struct ut_thread_record *
+ut_thread_registry_first(struct ut_thread_registry *self);
+
+/* The next number of the xorshift64* generator of rec. */
+uint64_t ut_thread_random(struct ut_thread_record *rec);
+
+#endif
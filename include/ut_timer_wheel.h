@@ -0,0 +1,72 @@
+#ifndef _UT_TIMER_WHEEL_H
+#define _UT_TIMER_WHEEL_H
+
+#include "ut_array.h"
+#include "ut_type.h"
+#include <stdint.h>
+
+/*
+ * A hierarchical timing wheel: timers with an element each, due at a tick
+ * given as a 64 bit integer. Every level has 64 slots, each 64 times as
+ * wide as those of the level below. A timer is put in the slot of the
+ * highest tick digit in which it differs from the current tick, and moves
+ * down a level whenever the wheel reaches its slot. Scheduling and
+ * cancelling are O(1), the timers come from a pool rather than malloc.
+ */
+typedef struct __ut_timer_wheel ut_timer_wheel_t;
+
+/* A scheduled timer, valid until it expires or is cancelled. */
+struct ut_timer;
+
+/* Creates a wheel whose current tick is now. */
+ut_timer_wheel_t *ut_timer_wheel_new(const struct ut_type *element,
+				     uint64_t now);
+
+void ut_timer_wheel_delete(ut_timer_wheel_t *self);
+
+/* Cancels every timer. */
+void ut_timer_wheel_clear(ut_timer_wheel_t *self);
+
+/*
+ * Schedules data, which the wheel takes, to expire at tick expires, and
+ * stores its timer in timer if not NULL. A tick that has already passed
+ * expires with the next call to ut_timer_wheel_expire.
+ */
+int ut_timer_wheel_schedule(ut_timer_wheel_t *self, uint64_t expires,
+			    const void *data, struct ut_timer **timer);
+
+/* Moves timer to tick expires, keeping its element. */
+void ut_timer_wheel_reschedule(ut_timer_wheel_t *self, struct ut_timer *timer,
+			       uint64_t expires);
+
+/* Drops the element of timer. */
+void ut_timer_wheel_cancel(ut_timer_wheel_t *self, struct ut_timer *timer);
+
+void *ut_timer_wheel_get(struct ut_timer *timer);
+
+uint64_t ut_timer_wheel_expires(const struct ut_timer *timer);
+
+/*
+ * Advances the wheel to tick now and moves the elements of all timers due
+ * by then to the end of expired, which has the element type of the wheel.
+ * Ticks without timers are skipped rather than stepped through. Timers due
+ * at the same tick come out in no particular order. On UT_ENOMEM the wheel
+ * stops at the tick it was at, and the timers not moved yet stay due.
+ */
+int ut_timer_wheel_expire(ut_timer_wheel_t *self, uint64_t now,
+			  ut_array_t *expired);
+
+uint64_t ut_timer_wheel_now(const ut_timer_wheel_t *self);
+
+/*
+ * A tick before which no timer expires, or UINT64_MAX if there is none,
+ * to sleep until. It is earlier than the first expiry when timers have to
+ * move down a level first.
+ */
+uint64_t ut_timer_wheel_next_tick(const ut_timer_wheel_t *self);
+
+size_t ut_timer_wheel_length(const ut_timer_wheel_t *self);
+
+bool ut_timer_wheel_is_empty(const ut_timer_wheel_t *self);
+
+#endif /* ut_timer_wheel.h */
@@ -0,0 +1,48 @@
+#ifndef _UT_TOP_K_H
+#define _UT_TOP_K_H
+
+#include "ut_iter.h"
+#include "ut_type.h"
+
+/*
+ * Collects the k greatest elements of a stream in O(n log k) time and O(k)
+ * space. Once k elements are kept, anything not above the least of them is
+ * turned away with a single compare.
+ */
+typedef struct __ut_top_k ut_top_k_t;
+
+/* Returns NULL if k is 0. */
+ut_top_k_t *ut_top_k_new(const struct ut_type *element, size_t k);
+
+/* Creates a collector of the k least elements. */
+ut_top_k_t *ut_top_k_new_min(const struct ut_type *element, size_t k);
+
+void ut_top_k_delete(ut_top_k_t *self);
+
+void ut_top_k_clear(ut_top_k_t *self);
+
+/*
+ * Offers data to the collector, which takes it. An element that is turned
+ * away, or pushed out by a better one, is dropped.
+ */
+int ut_top_k_push(ut_top_k_t *self, const void *data);
+
+/*
+ * The worst element kept, which the next one has to beat, or NULL while
+ * fewer than k are kept.
+ */
+void *ut_top_k_threshold(ut_top_k_t *self);
+
+size_t ut_top_k_length(const ut_top_k_t *self);
+
+bool ut_top_k_is_empty(const ut_top_k_t *self);
+
+/*
+ * Takes the kept elements out from the worst to the best, as
+ * ut_heap_drain_iter_new does, leaving the collector empty.
+ */
+struct ut_iter *ut_top_k_drain_iter_new(ut_top_k_t *top_k);
+
+void ut_top_k_iter_delete(struct ut_iter *self);
+
+#endif /* ut_top_k.h */
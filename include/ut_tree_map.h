@@ -12,24 +12,126 @@ typedef struct __ut_tree_entry ut_tree_entry_t;
 ut_tree_map_t *ut_tree_map_new(const struct ut_type *key,
 			       const struct ut_type *value);
 
+/* The same as ut_tree_map_new, every map has O(log n) select and rank now. */
+ut_tree_map_t *ut_tree_map_new_ranked(const struct ut_type *key,
+				      const struct ut_type *value);
+
+/*
+ * Creates a map from n keys in strictly ascending order and their values
+ * in O(n), with all entries in one allocation. Returns NULL if the keys are
+ * not sorted or not unique.
+ */
+ut_tree_map_t *ut_tree_map_from_sorted(const struct ut_type *key,
+				       const struct ut_type *value,
+				       const void *keys, const void *values,
+				       size_t n);
+
 void ut_tree_map_delete(ut_tree_map_t *self);
 
 void ut_tree_map_clear(ut_tree_map_t *self);
 
+/*
+ * Moves the entries whose keys are not less than key into a new map, and
+ * returns it, in O(log n). The two maps allocate from the same pool from
+ * then on, and each may still be used from its own thread.
+ */
+ut_tree_map_t *ut_tree_map_split(ut_tree_map_t *self, const void *key);
+
+/*
+ * Moves all entries of other to the end of self in O(log n). Every key of
+ * other must be greater than every key of self, otherwise UT_EINVAL is
+ * returned and nothing moves. Both maps must have the same types. other is
+ * left empty and shares the pool of self.
+ */
+int ut_tree_map_join(ut_tree_map_t *self, ut_tree_map_t *other);
+
+/*
+ * The set operations leave their result in self and other empty, with the
+ * same requirements as join. Where both maps hold a key, the entry of self
+ * is kept. They split other around the root of self and recurse on both
+ * halves, O(m log(n / m + 1)) for the smaller size m.
+ */
+int ut_tree_map_union(ut_tree_map_t *self, ut_tree_map_t *other);
+
+int ut_tree_map_intersection(ut_tree_map_t *self, ut_tree_map_t *other);
+
+/* Removes every key of other from self. */
+int ut_tree_map_difference(ut_tree_map_t *self, ut_tree_map_t *other);
+
+/*
+ * Tries next to the entry of the previous insertion first, so keys that
+ * arrive in or near ascending (or descending) order are placed with one or
+ * two compares instead of a search from the root.
+ */
 int ut_tree_map_insert(ut_tree_map_t *self, const void *key, const void *value);
 
+/*
+ * Inserts key with hint->key, an entry of this map as returned by the other
+ * calls, as the guess for its position, searching from the root only if key
+ * does not go right before or after it. A NULL hint or hint->key is no
+ * guess. On success hint is set to the inserted entry, ready for the next
+ * key.
+ */
+int ut_tree_map_insert_hint(ut_tree_map_t *self, struct ut_pair *hint,
+			    const void *key, const void *value);
+
 void ut_tree_map_remove(ut_tree_map_t *self, const void *key);
 
+void ut_tree_map_pop_first(ut_tree_map_t *self);
+
+void ut_tree_map_pop_last(ut_tree_map_t *self);
+
+/*
+ * Entries never move, so the returned pointers stay valid until their own
+ * key is removed or the map is cleared, whatever else is inserted or
+ * removed in between.
+ */
 void *ut_tree_map_get(ut_tree_map_t *self, const void *key);
 
 struct ut_pair ut_tree_map_get_key_value(ut_tree_map_t *self, const void *key);
 
+struct ut_pair ut_tree_map_first(ut_tree_map_t *self);
+
+struct ut_pair ut_tree_map_last(ut_tree_map_t *self);
+
+/* The first entry whose key is not less than key. */
+struct ut_pair ut_tree_map_lower_bound(ut_tree_map_t *self, const void *key);
+
+/* The first entry whose key is greater than key. */
+struct ut_pair ut_tree_map_upper_bound(ut_tree_map_t *self, const void *key);
+
+/* The last entry whose key is not greater than key. */
+struct ut_pair ut_tree_map_floor(ut_tree_map_t *self, const void *key);
+
+/* The first entry whose key is not less than key. */
+struct ut_pair ut_tree_map_ceiling(ut_tree_map_t *self, const void *key);
+
+/* The entry with index smallest keys before it. */
+struct ut_pair ut_tree_map_select(ut_tree_map_t *self, size_t index);
+
+/* The number of keys less than key. */
+size_t ut_tree_map_rank(ut_tree_map_t *self, const void *key);
+
+/* The number of keys in [from, to). A NULL bound is unbounded. */
+size_t ut_tree_map_count_range(ut_tree_map_t *self, const void *from,
+			       const void *to);
+
 size_t ut_tree_map_length(const ut_tree_map_t *self);
 
 bool ut_tree_map_is_empty(const ut_tree_map_t *self);
 
 struct ut_iter *ut_tree_map_iter_new(ut_tree_map_t *map);
 
+struct ut_iter *ut_tree_map_rev_iter_new(ut_tree_map_t *map);
+
+/* Iterates over the keys in [from, to). A NULL bound is unbounded. */
+struct ut_iter *ut_tree_map_range_iter_new(ut_tree_map_t *map,
+					   const void *from, const void *to);
+
+struct ut_iter *ut_tree_map_range_rev_iter_new(ut_tree_map_t *map,
+					       const void *from,
+					       const void *to);
+
 void ut_tree_map_iter_delete(struct ut_iter *self);
 
 #endif /* ut_tree_map.h */
@@ -8,22 +8,99 @@ typedef struct __ut_tree_set ut_tree_set_t;
 
 ut_tree_set_t *ut_tree_set_new(const struct ut_type *element);
 
+/* The same as ut_tree_set_new, every set has O(log n) select and rank now. */
+ut_tree_set_t *ut_tree_set_new_ranked(const struct ut_type *element);
+
+/*
+ * Creates a set from n elements in strictly ascending order in O(n).
+ * Returns NULL if the elements are not sorted or not unique.
+ */
+ut_tree_set_t *ut_tree_set_from_sorted(const struct ut_type *element,
+				       const void *data, size_t n);
+
 void ut_tree_set_delete(ut_tree_set_t *self);
 
 void ut_tree_set_clear(ut_tree_set_t *self);
 
+/*
+ * Moves the elements that are not less than data into a new set, and
+ * returns it, in O(log n). The two sets share one pool from then on, and
+ * each may still be used from its own thread.
+ */
+ut_tree_set_t *ut_tree_set_split(ut_tree_set_t *self, const void *data);
+
+/*
+ * Moves all elements of other, which must be greater than every element of
+ * self, to the end of self in O(log n). Returns UT_EINVAL otherwise.
+ */
+int ut_tree_set_join(ut_tree_set_t *self, ut_tree_set_t *other);
+
+/* The set operations leave their result in self and other empty. */
+int ut_tree_set_union(ut_tree_set_t *self, ut_tree_set_t *other);
+
+int ut_tree_set_intersection(ut_tree_set_t *self, ut_tree_set_t *other);
+
+int ut_tree_set_difference(ut_tree_set_t *self, ut_tree_set_t *other);
+
 int ut_tree_set_insert(ut_tree_set_t *self, const void *data);
 
+/*
+ * Inserts data with *hint, an element of this set, as the guess for its
+ * position, like ut_tree_map_insert_hint, and sets *hint to the inserted
+ * element.
+ */
+int ut_tree_set_insert_hint(ut_tree_set_t *self, void **hint, const void *data);
+
 void ut_tree_set_remove(ut_tree_set_t *self, const void *data);
 
+void ut_tree_set_pop_first(ut_tree_set_t *self);
+
+void ut_tree_set_pop_last(ut_tree_set_t *self);
+
 void *ut_tree_set_get(ut_tree_set_t *self, const void *data);
 
+void *ut_tree_set_first(ut_tree_set_t *self);
+
+void *ut_tree_set_last(ut_tree_set_t *self);
+
+/* The first element that is not less than data. */
+void *ut_tree_set_lower_bound(ut_tree_set_t *self, const void *data);
+
+/* The first element that is greater than data. */
+void *ut_tree_set_upper_bound(ut_tree_set_t *self, const void *data);
+
+/* The last element that is not greater than data. */
+void *ut_tree_set_floor(ut_tree_set_t *self, const void *data);
+
+/* The first element that is not less than data. */
+void *ut_tree_set_ceiling(ut_tree_set_t *self, const void *data);
+
+/* The element with index smaller elements before it. */
+void *ut_tree_set_select(ut_tree_set_t *self, size_t index);
+
+/* The number of elements less than data. */
+size_t ut_tree_set_rank(ut_tree_set_t *self, const void *data);
+
+/* The number of elements in [from, to). A NULL bound is unbounded. */
+size_t ut_tree_set_count_range(ut_tree_set_t *self, const void *from,
+			       const void *to);
+
 size_t ut_tree_set_length(const ut_tree_set_t *self);
 
 bool ut_tree_set_is_empty(const ut_tree_set_t *self);
 
 struct ut_iter *ut_tree_set_iter_new(ut_tree_set_t *set);
 
+struct ut_iter *ut_tree_set_rev_iter_new(ut_tree_set_t *set);
+
+/* Iterates over the elements in [from, to). A NULL bound is unbounded. */
+struct ut_iter *ut_tree_set_range_iter_new(ut_tree_set_t *set,
+					   const void *from, const void *to);
+
+struct ut_iter *ut_tree_set_range_rev_iter_new(ut_tree_set_t *set,
+					       const void *from,
+					       const void *to);
+
 void ut_tree_set_iter_delete(struct ut_iter *self);
 
 #endif /* ut_tree_set.h */
@@ -1,7 +1,12 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "ut_array.h"
 #include "ut_errno.h"
+#include "ut_mem.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 struct __ut_array {
 	uint8_t *ptr;
@@ -24,8 +29,969 @@ static inline void *ut_array_index(ut_array_t *self, size_t index)
 static inline void ut_array_move(ut_array_t *self, size_t n, size_t from,
 				 size_t to)
 {
-	memcpy(ut_array_index(self, to), ut_array_index(self, from),
-	       n * self->element->size);
+	ut_memmove(ut_array_index(self, to), ut_array_index(self, from),
+		   n * self->element->size);
+}
+
+static void ut_array_drop_range(ut_array_t *self, size_t index, size_t n)
+{
+	if (!self->element->drop)
+		return;
+
+	for (; n; n--, index++)
+		self->element->drop(ut_array_index(self, index));
+}
+
+/* Below this many elements, selection falls back to insertion sort. */
+#define UT_ARRAY_SMALL_SORT 16
+
+/* Below this many, pdqsort insertion sorts and picks a median of three. */
+#define UT_ARRAY_INSERTION_SORT 24
+#define UT_ARRAY_NINTHER 128
+
+/* How many elements a presorted run may move before the attempt stops. */
+#define UT_ARRAY_PARTIAL_LIMIT 8
+
+/* Below this many elements, radix sort does not pay for its counting. */
+#define UT_ARRAY_RADIX_MIN 256
+
+/* The least a thread of a parallel sort gets unless told otherwise. */
+#define UT_ARRAY_PARALLEL_GRAIN 65536
+
+/* How many searches a batched search runs side by side. */
+#define UT_ARRAY_SEARCH_BATCH 16
+
+/*
+ * What a sort runs on: the elements and the order, either the compare of
+ * the element type or one given with a context. The order is taken from a
+ * copy of these fields rather than the array, so that the sort loops only
+ * load them once.
+ */
+struct ut_array_sorter {
+	uint8_t *base;
+	size_t size;
+	int (*compare)(const void *, const void *);
+	ut_array_compare_fn by;
+	void *ctx;
+};
+
+static inline void ut_array_sorter_init(struct ut_array_sorter *s,
+					ut_array_t *self,
+					ut_array_compare_fn by, void *ctx)
+{
+	s->base = self->ptr;
+	s->size = self->element->size;
+	s->compare = self->element->compare;
+	s->by = by;
+	s->ctx = ctx;
+}
+
+static inline void *ut_array_sorter_at(const struct ut_array_sorter *s,
+				       size_t i)
+{
+	return s->base + i * s->size;
+}
+
+static inline bool ut_array_sorter_below(const struct ut_array_sorter *s,
+					 const void *x, const void *y)
+{
+	return (s->by ? s->by(x, y, s->ctx) : s->compare(x, y)) < 0;
+}
+
+static inline bool ut_array_sorter_less(const struct ut_array_sorter *s,
+					size_t a, size_t b)
+{
+	return ut_array_sorter_below(s, ut_array_sorter_at(s, a),
+				     ut_array_sorter_at(s, b));
+}
+
+static inline void ut_array_sorter_swap(const struct ut_array_sorter *s,
+					size_t a, size_t b)
+{
+	ut_memswap(ut_array_sorter_at(s, a), ut_array_sorter_at(s, b), s->size);
+}
+
+static void ut_array_insertion_sort(const struct ut_array_sorter *s,
+				    size_t lo, size_t hi)
+{
+	size_t i, j;
+
+	for (i = lo + 1; i < hi; i++) {
+		for (j = i; j > lo && ut_array_sorter_less(s, j, j - 1); j--)
+			ut_array_sorter_swap(s, j - 1, j);
+	}
+}
+
+/*
+ * Insertion sorts [lo, hi) unless that takes more than a few moves, for
+ * parts that look sorted already. Returns whether it got to the end.
+ */
+static bool ut_array_partial_insertion_sort(const struct ut_array_sorter *s,
+					    size_t lo, size_t hi)
+{
+	size_t i, j, moves = 0;
+
+	for (i = lo + 1; i < hi; i++) {
+		for (j = i; j > lo && ut_array_sorter_less(s, j, j - 1); j--)
+			ut_array_sorter_swap(s, j - 1, j);
+
+		moves += i - j;
+		if (moves > UT_ARRAY_PARTIAL_LIMIT)
+			return false;
+	}
+
+	return true;
+}
+
+/* Sifts down i in the max heap of the n elements from lo. */
+static void ut_array_sift_down(const struct ut_array_sorter *s, size_t lo,
+			       size_t n, size_t i)
+{
+	size_t c;
+
+	while ((c = i * 2 + 1) < n) {
+		if (c + 1 < n && ut_array_sorter_less(s, lo + c, lo + c + 1))
+			c++;
+
+		if (!ut_array_sorter_less(s, lo + i, lo + c))
+			break;
+
+		ut_array_sorter_swap(s, lo + c, lo + i);
+		i = c;
+	}
+}
+
+static void ut_array_heap_sort(const struct ut_array_sorter *s, size_t lo,
+			       size_t hi)
+{
+	size_t n = hi - lo, i;
+
+	for (i = n / 2; i-- > 0;)
+		ut_array_sift_down(s, lo, n, i);
+
+	while (n > 1) {
+		ut_array_sorter_swap(s, lo, lo + --n);
+		ut_array_sift_down(s, lo, n, 0);
+	}
+}
+
+/* Orders the elements at a, b and c. */
+static void ut_array_sort3(const struct ut_array_sorter *s, size_t a,
+			   size_t b, size_t c)
+{
+	if (ut_array_sorter_less(s, b, a))
+		ut_array_sorter_swap(s, a, b);
+	if (ut_array_sorter_less(s, c, b)) {
+		ut_array_sorter_swap(s, b, c);
+		if (ut_array_sorter_less(s, b, a))
+			ut_array_sorter_swap(s, a, b);
+	}
+}
+
+/*
+ * Partitions [lo, hi) around the median of its first, middle and last
+ * elements and returns where the pivot ends up. Elements equal to the
+ * pivot go to both sides, so runs of them still split evenly.
+ */
+static size_t ut_array_partition(const struct ut_array_sorter *s, size_t lo,
+				 size_t hi)
+{
+	size_t mid = lo + (hi - lo) / 2, i = lo, j = hi;
+
+	ut_array_sort3(s, lo, mid, hi - 1);
+	ut_array_sorter_swap(s, lo, mid);
+
+	for (;;) {
+		do {
+			i++;
+		} while (i < hi && ut_array_sorter_less(s, i, lo));
+
+		do {
+			j--;
+		} while (ut_array_sorter_less(s, lo, j));
+
+		if (i >= j)
+			break;
+
+		ut_array_sorter_swap(s, i, j);
+	}
+
+	ut_array_sorter_swap(s, lo, j);
+	return j;
+}
+
+/*
+ * Partitions [lo, hi) around the pivot at lo, elements equal to it go to
+ * the right. Sets *sorted if no element had to move.
+ */
+static size_t ut_array_partition_right(const struct ut_array_sorter *s,
+				       size_t lo, size_t hi, bool *sorted)
+{
+	size_t first = lo + 1, last = hi;
+
+	while (first < hi && ut_array_sorter_less(s, first, lo))
+		first++;
+
+	while (last > first && !ut_array_sorter_less(s, last - 1, lo))
+		last--;
+
+	*sorted = first >= last;
+	while (first < last) {
+		ut_array_sorter_swap(s, first, --last);
+		while (ut_array_sorter_less(s, ++first, lo))
+			;
+		while (last > first && !ut_array_sorter_less(s, last - 1, lo))
+			last--;
+	}
+
+	ut_array_sorter_swap(s, lo, first - 1);
+	return first - 1;
+}
+
+/*
+ * Partitions [lo, hi) around the pivot at lo, elements equal to it go to
+ * the left. Used when the pivot equals the element before the range, so
+ * that all of them are done with at once.
+ */
+static size_t ut_array_partition_left(const struct ut_array_sorter *s,
+				      size_t lo, size_t hi)
+{
+	size_t first = lo, last = hi;
+
+	while (last - 1 > lo && ut_array_sorter_less(s, lo, last - 1))
+		last--;
+
+	while (first + 1 < last && !ut_array_sorter_less(s, lo, first + 1))
+		first++;
+
+	while (first + 1 < last) {
+		ut_array_sorter_swap(s, first + 1, last - 1);
+		last--;
+		while (ut_array_sorter_less(s, lo, last - 1))
+			last--;
+		while (first + 1 < last &&
+		       !ut_array_sorter_less(s, lo, first + 1))
+			first++;
+	}
+
+	ut_array_sorter_swap(s, lo, last - 1);
+	return last - 1;
+}
+
+/*
+ * Pattern-defeating quicksort. Sorted and reversed runs finish in a
+ * linear pass, many equal elements in one, and after too many unbalanced
+ * partitions the rest is heap sorted, so the worst case is O(n log n).
+ * leftmost is false when the element before lo is a pivot, which is no
+ * greater than anything in the range.
+ */
+static void ut_array_pdqsort(const struct ut_array_sorter *s, size_t lo,
+			     size_t hi, int bad, bool leftmost)
+{
+	size_t n, mid, pivot, left, right;
+	bool sorted;
+
+	for (;;) {
+		n = hi - lo;
+		if (n < UT_ARRAY_INSERTION_SORT) {
+			ut_array_insertion_sort(s, lo, hi);
+			return;
+		}
+
+		mid = lo + n / 2;
+		if (n > UT_ARRAY_NINTHER) {
+			ut_array_sort3(s, lo, mid, hi - 1);
+			ut_array_sort3(s, lo + 1, mid - 1, hi - 2);
+			ut_array_sort3(s, lo + 2, mid + 1, hi - 3);
+			ut_array_sort3(s, mid - 1, mid, mid + 1);
+			ut_array_sorter_swap(s, lo, mid);
+		} else {
+			ut_array_sort3(s, mid, lo, hi - 1);
+		}
+
+		if (!leftmost && !ut_array_sorter_less(s, lo - 1, lo)) {
+			lo = ut_array_partition_left(s, lo, hi) + 1;
+			continue;
+		}
+
+		pivot = ut_array_partition_right(s, lo, hi, &sorted);
+		left = pivot - lo;
+		right = hi - pivot - 1;
+
+		if (left < n / 8 || right < n / 8) {
+			if (!--bad) {
+				ut_array_heap_sort(s, lo, hi);
+				return;
+			}
+
+			/* Breaks up the pattern that made the pivot bad. */
+			if (left >= UT_ARRAY_INSERTION_SORT) {
+				ut_array_sorter_swap(s, lo, lo + left / 4);
+				ut_array_sorter_swap(s, pivot - 1,
+						     pivot - left / 4);
+			}
+			if (right >= UT_ARRAY_INSERTION_SORT) {
+				ut_array_sorter_swap(s, pivot + 1,
+						     pivot + 1 + right / 4);
+				ut_array_sorter_swap(s, hi - 1,
+						     hi - right / 4);
+			}
+		} else if (sorted &&
+			   ut_array_partial_insertion_sort(s, lo, pivot) &&
+			   ut_array_partial_insertion_sort(s, pivot + 1, hi)) {
+			return;
+		}
+
+		ut_array_pdqsort(s, lo, pivot, bad, leftmost);
+		lo = pivot + 1;
+		leftmost = false;
+	}
+}
+
+/*
+ * Merges the sorted runs [a, a + n) and [b, b + m) into dst, taking from
+ * the left run on ties so that equal elements keep their order.
+ */
+static void ut_array_merge(const struct ut_array_sorter *s, const uint8_t *a,
+			   size_t n, const uint8_t *b, size_t m, uint8_t *dst)
+{
+	const uint8_t *end_a = a + n * s->size, *end_b = b + m * s->size;
+
+	while (a < end_a && b < end_b) {
+		if (ut_array_sorter_below(s, b, a)) {
+			memcpy(dst, b, s->size);
+			b += s->size;
+		} else {
+			memcpy(dst, a, s->size);
+			a += s->size;
+		}
+		dst += s->size;
+	}
+
+	memcpy(dst, a, end_a - a);
+	memcpy(dst + (end_a - a), b, end_b - b);
+}
+
+/*
+ * Bottom-up merge sort of n elements: insertion sorted runs, then merge
+ * passes back and forth between the array and buf.
+ */
+static void ut_array_merge_sort(const struct ut_array_sorter *s, uint8_t *buf,
+				size_t n)
+{
+	uint8_t *src = s->base, *dst = buf, *tmp;
+	size_t width, lo, mid, hi;
+
+	for (lo = 0; lo < n; lo += UT_ARRAY_SMALL_SORT) {
+		hi = lo + UT_ARRAY_SMALL_SORT;
+		ut_array_insertion_sort(s, lo, hi < n ? hi : n);
+	}
+
+	for (width = UT_ARRAY_SMALL_SORT; width < n; width *= 2) {
+		for (lo = 0; lo < n; lo += 2 * width) {
+			mid = lo + width < n ? lo + width : n;
+			hi = mid + width < n ? mid + width : n;
+			ut_array_merge(s, src + lo * s->size, mid - lo,
+				       src + mid * s->size, hi - mid,
+				       dst + lo * s->size);
+		}
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	if (src != s->base)
+		memcpy(s->base, src, n * s->size);
+}
+
+/*
+ * Radix sort keys are the elements as unsigned integers in the same order:
+ * signed ones with the sign bit flipped, floating point ones with the sign
+ * bit flipped if clear and every bit flipped if set.
+ */
+enum ut_array_radix_mode {
+	UT_ARRAY_RADIX_UNSIGNED,
+	UT_ARRAY_RADIX_SIGNED,
+	UT_ARRAY_RADIX_FLOAT,
+};
+
+static inline uint32_t ut_array_radix_key32(uint32_t x, int mode)
+{
+	if (mode == UT_ARRAY_RADIX_SIGNED)
+		return x ^ 0x80000000u;
+
+	if (mode == UT_ARRAY_RADIX_FLOAT)
+		return x ^ (-(x >> 31) | 0x80000000u);
+
+	return x;
+}
+
+static inline uint32_t ut_array_radix_value32(uint32_t x, int mode)
+{
+	if (mode == UT_ARRAY_RADIX_SIGNED)
+		return x ^ 0x80000000u;
+
+	if (mode == UT_ARRAY_RADIX_FLOAT)
+		return x ^ (((x >> 31) - 1) | 0x80000000u);
+
+	return x;
+}
+
+static inline uint64_t ut_array_radix_key64(uint64_t x, int mode)
+{
+	const uint64_t sign = (uint64_t)1 << 63;
+
+	if (mode == UT_ARRAY_RADIX_SIGNED)
+		return x ^ sign;
+
+	if (mode == UT_ARRAY_RADIX_FLOAT)
+		return x ^ (-(x >> 63) | sign);
+
+	return x;
+}
+
+static inline uint64_t ut_array_radix_value64(uint64_t x, int mode)
+{
+	const uint64_t sign = (uint64_t)1 << 63;
+
+	if (mode == UT_ARRAY_RADIX_SIGNED)
+		return x ^ sign;
+
+	if (mode == UT_ARRAY_RADIX_FLOAT)
+		return x ^ (((x >> 63) - 1) | sign);
+
+	return x;
+}
+
+/*
+ * LSD radix sort on bytes. All byte counts are taken in the pass that
+ * turns elements into keys, and a byte that is the same in every key
+ * needs no pass of its own.
+ */
+static void ut_array_radix_sort32(uint32_t *a, uint32_t *buf, size_t n,
+				  int mode)
+{
+	size_t counts[4][256], i, sum, c;
+	uint32_t *src = a, *dst = buf, *tmp;
+	unsigned p, shift;
+
+	memset(counts, 0, sizeof(counts));
+	for (i = 0; i < n; i++) {
+		a[i] = ut_array_radix_key32(a[i], mode);
+		for (p = 0; p < 4; p++)
+			counts[p][(a[i] >> (p * 8)) & 255]++;
+	}
+
+	for (p = 0; p < 4; p++) {
+		shift = p * 8;
+		if (counts[p][(src[0] >> shift) & 255] == n)
+			continue;
+
+		for (sum = 0, i = 0; i < 256; i++) {
+			c = counts[p][i];
+			counts[p][i] = sum;
+			sum += c;
+		}
+
+		for (i = 0; i < n; i++)
+			dst[counts[p][(src[i] >> shift) & 255]++] = src[i];
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	for (i = 0; i < n; i++)
+		a[i] = ut_array_radix_value32(src[i], mode);
+}
+
+static void ut_array_radix_sort64(uint64_t *a, uint64_t *buf, size_t n,
+				  int mode)
+{
+	size_t counts[8][256], i, sum, c;
+	uint64_t *src = a, *dst = buf, *tmp;
+	unsigned p, shift;
+
+	memset(counts, 0, sizeof(counts));
+	for (i = 0; i < n; i++) {
+		a[i] = ut_array_radix_key64(a[i], mode);
+		for (p = 0; p < 8; p++)
+			counts[p][(a[i] >> (p * 8)) & 255]++;
+	}
+
+	for (p = 0; p < 8; p++) {
+		shift = p * 8;
+		if (counts[p][(src[0] >> shift) & 255] == n)
+			continue;
+
+		for (sum = 0, i = 0; i < 256; i++) {
+			c = counts[p][i];
+			counts[p][i] = sum;
+			sum += c;
+		}
+
+		for (i = 0; i < n; i++)
+			dst[counts[p][(src[i] >> shift) & 255]++] = src[i];
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	for (i = 0; i < n; i++)
+		a[i] = ut_array_radix_value64(src[i], mode);
+}
+
+/*
+ * Finds the radix sort key of the built-in int, uint, long, ulong, float
+ * and double types, whose order is known. The compare of float and double
+ * takes close values as equal, so they are left to the stable sort, where
+ * radix order could swap such a pair.
+ */
+static bool ut_array_radix_mode(const ut_array_t *self, bool stable,
+				int *mode)
+{
+	const struct ut_type *t = self->element;
+
+	if (t == ut_type_int() || t == ut_type_long())
+		*mode = UT_ARRAY_RADIX_SIGNED;
+	else if (t == ut_type_uint() || t == ut_type_ulong())
+		*mode = UT_ARRAY_RADIX_UNSIGNED;
+	else if (!stable && (t == ut_type_float() || t == ut_type_double()))
+		*mode = UT_ARRAY_RADIX_FLOAT;
+	else
+		return false;
+
+	return t->size == sizeof(uint32_t) || t->size == sizeof(uint64_t);
+}
+
+/*
+ * Radix sorts arrays of the types above. Returns false for any other type,
+ * for short arrays and if the buffer cannot be had.
+ */
+static bool ut_array_radix_sort(ut_array_t *self, bool stable)
+{
+	size_t size = self->element->size;
+	int mode;
+	void *buf;
+
+	if (self->len < UT_ARRAY_RADIX_MIN ||
+	    !ut_array_radix_mode(self, stable, &mode))
+		return false;
+
+	buf = malloc(self->len * size);
+	if (!buf)
+		return false;
+
+	if (size == sizeof(uint32_t))
+		ut_array_radix_sort32((uint32_t *)self->ptr, buf, self->len,
+				      mode);
+	else
+		ut_array_radix_sort64((uint64_t *)self->ptr, buf, self->len,
+				      mode);
+
+	free(buf);
+	return true;
+}
+
+/*
+ * A parallel sort splits the array in one chunk per thread. Each thread
+ * then works on its own chunk in every phase, with barriers in between.
+ * Radix sorts count the digits of each chunk, and every thread scatters
+ * its chunk from where the counts of lower digits and of lower chunks end.
+ * Other types have their chunks sorted, then merged in pairs of runs,
+ * each thread writing its share of the output of every round.
+ */
+struct ut_array_parallel {
+	struct ut_array_sorter s;
+	uint8_t *buf;
+	size_t n;
+	unsigned threads;
+	int mode;
+	size_t (*counts)[256];
+	pthread_barrier_t barrier;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	bool started;
+};
+
+struct ut_array_parallel_worker {
+	struct ut_array_parallel *par;
+	unsigned id;
+	pthread_t thread;
+};
+
+/* Where chunk i starts, and where the last one ends for i = threads. */
+static inline size_t ut_array_chunk(const struct ut_array_parallel *par,
+				    unsigned i)
+{
+	return par->n / par->threads * i +
+	       par->n % par->threads * i / par->threads;
+}
+
+static inline unsigned ut_array_parallel_digit(const uint8_t *p,
+					       size_t size, unsigned shift)
+{
+	if (size == sizeof(uint32_t))
+		return (*(const uint32_t *)p >> shift) & 255;
+
+	return (*(const uint64_t *)p >> shift) & 255;
+}
+
+static void ut_array_parallel_radix(struct ut_array_parallel *par,
+				    unsigned id)
+{
+	size_t lo = ut_array_chunk(par, id);
+	size_t hi = ut_array_chunk(par, id + 1);
+	size_t size = par->s.size, offsets[256], *counts = par->counts[id];
+	uint8_t *src = par->s.base, *dst = par->buf, *tmp, *p;
+	unsigned shift, t, d;
+	size_t i, sum;
+	bool skip;
+
+	for (i = lo; i < hi; i++) {
+		p = src + i * size;
+		if (size == sizeof(uint32_t))
+			*(uint32_t *)p = ut_array_radix_key32(*(uint32_t *)p,
+							      par->mode);
+		else
+			*(uint64_t *)p = ut_array_radix_key64(*(uint64_t *)p,
+							      par->mode);
+	}
+
+	for (shift = 0; shift < size * 8; shift += 8) {
+		memset(counts, 0, sizeof(par->counts[id]));
+		for (i = lo; i < hi; i++)
+			counts[ut_array_parallel_digit(src + i * size, size,
+						       shift)]++;
+
+		pthread_barrier_wait(&par->barrier);
+
+		/* No pass for a digit that is the same in every key. */
+		d = ut_array_parallel_digit(src, size, shift);
+		for (sum = 0, t = 0; t < par->threads; t++)
+			sum += par->counts[t][d];
+		skip = sum == par->n;
+
+		for (sum = 0, d = 0; d < 256; d++) {
+			for (t = 0; t < par->threads; t++) {
+				if (t == id)
+					offsets[d] = sum;
+				sum += par->counts[t][d];
+			}
+		}
+
+		pthread_barrier_wait(&par->barrier);
+		if (skip)
+			continue;
+
+		for (i = lo; i < hi; i++) {
+			p = src + i * size;
+			d = ut_array_parallel_digit(p, size, shift);
+			memcpy(dst + offsets[d]++ * size, p, size);
+		}
+
+		pthread_barrier_wait(&par->barrier);
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	for (i = lo; i < hi; i++) {
+		p = par->s.base + i * size;
+		if (size == sizeof(uint32_t))
+			*(uint32_t *)p = ut_array_radix_value32(
+				*(uint32_t *)(src + i * size), par->mode);
+		else
+			*(uint64_t *)p = ut_array_radix_value64(
+				*(uint64_t *)(src + i * size), par->mode);
+	}
+}
+
+/*
+ * Finds how many of the first i elements of merging a and b come from a,
+ * taking from a on ties as ut_array_merge does.
+ */
+static size_t ut_array_parallel_split(const struct ut_array_sorter *s,
+				      const uint8_t *a, size_t n,
+				      const uint8_t *b, size_t m, size_t i)
+{
+	size_t lo = i > m ? i - m : 0, hi = i < n ? i : n, j;
+
+	while (lo < hi) {
+		j = lo + (hi - lo) / 2;
+		if (ut_array_sorter_below(s, b + (i - j - 1) * s->size,
+					  a + j * s->size))
+			hi = j;
+		else
+			lo = j + 1;
+	}
+
+	return lo;
+}
+
+static void ut_array_parallel_merge(struct ut_array_parallel *par,
+				    unsigned id)
+{
+	const struct ut_array_sorter *s = &par->s;
+	size_t lo = ut_array_chunk(par, id);
+	size_t hi = ut_array_chunk(par, id + 1);
+	size_t first, mid, last, from, to, j0, j1, n;
+	uint8_t *src = s->base, *dst = par->buf, *tmp, *a, *b;
+	unsigned width, run;
+	int bad = 0;
+
+	for (n = hi - lo; n > 1; n >>= 1)
+		bad++;
+	if (hi - lo > 1)
+		ut_array_pdqsort(s, lo, hi, bad, true);
+
+	for (width = 1; width < par->threads; width *= 2) {
+		pthread_barrier_wait(&par->barrier);
+
+		/* Merges the part of every pair of runs this thread writes. */
+		for (run = 0; run < par->threads; run += 2 * width) {
+			first = ut_array_chunk(par, run);
+			mid = last = par->n;
+			if (run + width < par->threads)
+				mid = ut_array_chunk(par, run + width);
+			if (run + 2 * width < par->threads)
+				last = ut_array_chunk(par, run + 2 * width);
+
+			from = lo > first ? lo : first;
+			to = hi < last ? hi : last;
+			if (from >= to)
+				continue;
+
+			a = src + first * s->size;
+			b = src + mid * s->size;
+			j0 = ut_array_parallel_split(s, a, mid - first, b,
+						     last - mid, from - first);
+			j1 = ut_array_parallel_split(s, a, mid - first, b,
+						     last - mid, to - first);
+			ut_array_merge(s, a + j0 * s->size, j1 - j0,
+				       b + (from - first - j0) * s->size,
+				       (to - from) - (j1 - j0),
+				       dst + from * s->size);
+		}
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	/* The others may still read the array in their last round. */
+	if (src != s->base) {
+		pthread_barrier_wait(&par->barrier);
+		memcpy(s->base + lo * s->size, src + lo * s->size,
+		       (hi - lo) * s->size);
+	}
+}
+
+static void *ut_array_parallel_run(void *arg)
+{
+	struct ut_array_parallel_worker *worker = arg;
+	struct ut_array_parallel *par = worker->par;
+
+	pthread_mutex_lock(&par->lock);
+	while (!par->started)
+		pthread_cond_wait(&par->start, &par->lock);
+	pthread_mutex_unlock(&par->lock);
+
+	if (par->mode >= 0)
+		ut_array_parallel_radix(par, worker->id);
+	else
+		ut_array_parallel_merge(par, worker->id);
+
+	return NULL;
+}
+
+/*
+ * Runs the sort on the calling thread and threads - 1 more. Threads that
+ * cannot be started are done without, as the chunks are only cut once the
+ * number of threads is known.
+ */
+static void ut_array_parallel_sort(struct ut_array_parallel *par,
+				   unsigned threads)
+{
+	struct ut_array_parallel_worker *workers;
+	unsigned i, started = 1;
+
+	workers = malloc(threads * sizeof(*workers));
+	if (!workers)
+		threads = 1;
+
+	par->started = false;
+	pthread_mutex_init(&par->lock, NULL);
+	pthread_cond_init(&par->start, NULL);
+
+	for (i = 1; i < threads; i++) {
+		workers[i].par = par;
+		workers[i].id = i;
+		if (pthread_create(&workers[i].thread, NULL,
+				   ut_array_parallel_run, &workers[i]))
+			break;
+		started++;
+	}
+
+	par->threads = started;
+	pthread_barrier_init(&par->barrier, NULL, started);
+
+	pthread_mutex_lock(&par->lock);
+	par->started = true;
+	pthread_cond_broadcast(&par->start);
+	pthread_mutex_unlock(&par->lock);
+
+	if (par->mode >= 0)
+		ut_array_parallel_radix(par, 0);
+	else
+		ut_array_parallel_merge(par, 0);
+
+	for (i = 1; i < started; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	pthread_barrier_destroy(&par->barrier);
+	pthread_cond_destroy(&par->start);
+	pthread_mutex_destroy(&par->lock);
+	free(workers);
+}
+
+/*
+ * A search for where key goes: before elements greater than it for an
+ * upper bound, before those not less for a lower bound. Built-in integer
+ * types are compared as radix sort keys, without a call to compare, which
+ * is also the order ut_array_sort puts them in.
+ */
+struct ut_array_probe {
+	const void *key;
+	int (*compare)(const void *, const void *);
+	uint64_t bits;
+	size_t size;
+	int mode;
+	bool upper;
+};
+
+static void ut_array_probe_init(struct ut_array_probe *probe,
+				const ut_array_t *self, const void *key,
+				bool upper)
+{
+	uint32_t x32;
+	uint64_t x64;
+
+	probe->key = key;
+	probe->compare = self->element->compare;
+	probe->size = self->element->size;
+	probe->upper = upper;
+
+	if (!ut_array_radix_mode(self, true, &probe->mode)) {
+		probe->mode = -1;
+	} else if (probe->size == sizeof(uint32_t)) {
+		memcpy(&x32, key, sizeof(x32));
+		probe->bits = ut_array_radix_key32(x32, probe->mode);
+	} else {
+		memcpy(&x64, key, sizeof(x64));
+		probe->bits = ut_array_radix_key64(x64, probe->mode);
+	}
+}
+
+/* Whether the element at p comes before where the key goes. */
+static inline bool ut_array_probe_before(const struct ut_array_probe *probe,
+					 const uint8_t *p)
+{
+	uint64_t x;
+	int cmp;
+
+	if (probe->mode < 0) {
+		cmp = probe->compare(p, probe->key);
+		return probe->upper ? cmp <= 0 : cmp < 0;
+	}
+
+	if (probe->size == sizeof(uint32_t))
+		x = ut_array_radix_key32(*(const uint32_t *)p, probe->mode);
+	else
+		x = ut_array_radix_key64(*(const uint64_t *)p, probe->mode);
+
+	return probe->upper ? x <= probe->bits : x < probe->bits;
+}
+
+/*
+ * Binary search that halves the range the same way whatever the compare
+ * says, so the only data dependent step is an add the compiler does
+ * without a branch.
+ */
+static size_t ut_array_bound(const ut_array_t *self, const void *key,
+			     bool upper)
+{
+	struct ut_array_probe probe;
+	size_t base = 0, n = self->len, half;
+	const uint8_t *p;
+
+	if (!n)
+		return 0;
+
+	ut_array_probe_init(&probe, self, key, upper);
+	while (n > 1) {
+		half = n / 2;
+		p = self->ptr + (base + half) * probe.size;
+		base += ut_array_probe_before(&probe, p) * half;
+		n -= half;
+	}
+
+	p = self->ptr + base * probe.size;
+	return base + ut_array_probe_before(&probe, p);
+}
+
+/*
+ * Lays the n sorted elements of src out in dst in the order of a breadth
+ * first walk of the tree a binary search goes down, the root at 1 and the
+ * children of k at 2k and 2k + 1. Returns the next element of src.
+ */
+static size_t ut_array_eytzinger_fill(uint8_t *dst, const uint8_t *src,
+				      size_t size, size_t n, size_t i,
+				      size_t k)
+{
+	if (k > n)
+		return i;
+
+	i = ut_array_eytzinger_fill(dst, src, size, n, i, 2 * k);
+	memcpy(dst + (k - 1) * size, src + i * size, size);
+	return ut_array_eytzinger_fill(dst, src, size, n, i + 1, 2 * k + 1);
+}
+
+/* The other way around, dst sorted from src in the tree order. */
+static size_t ut_array_eytzinger_drain(uint8_t *dst, const uint8_t *src,
+				       size_t size, size_t n, size_t i,
+				       size_t k)
+{
+	if (k > n)
+		return i;
+
+	i = ut_array_eytzinger_drain(dst, src, size, n, i, 2 * k);
+	memcpy(dst + i * size, src + (k - 1) * size, size);
+	return ut_array_eytzinger_drain(dst, src, size, n, i + 1, 2 * k + 1);
+}
+
+static int ut_array_eytzinger_layout(ut_array_t *self, bool back)
+{
+	size_t size = self->element->size;
+	uint8_t *buf;
+
+	if (self->len < 2)
+		return UT_OK;
+
+	buf = malloc(self->cap * size);
+	if (!buf)
+		return UT_ENOMEM;
+
+	if (back)
+		ut_array_eytzinger_drain(buf, self->ptr, size, self->len, 0, 1);
+	else
+		ut_array_eytzinger_fill(buf, self->ptr, size, self->len, 0, 1);
+
+	free(self->ptr);
+	self->ptr = buf;
+	return UT_OK;
 }
 
 ut_array_t *ut_array_new(const struct ut_type *element)
@@ -149,6 +1115,349 @@ void ut_array_remove(ut_array_t *self, size_t index)
 	self->len--;
 }
 
+int ut_array_extend(ut_array_t *self, const void *data, size_t n)
+{
+	return ut_array_splice(self, self->len, 0, data, n);
+}
+
+int ut_array_insert_range(ut_array_t *self, size_t index, const void *data,
+			  size_t n)
+{
+	return ut_array_splice(self, index, 0, data, n);
+}
+
+void ut_array_remove_range(ut_array_t *self, size_t index, size_t n)
+{
+	if (index < self->len)
+		ut_array_splice(self, index, n, NULL, 0);
+}
+
+void ut_array_swap_remove(ut_array_t *self, size_t index)
+{
+	if (index >= self->len)
+		return;
+
+	ut_array_drop_range(self, index, 1);
+	self->len--;
+	if (index < self->len)
+		memcpy(ut_array_index(self, index),
+		       ut_array_index(self, self->len), self->element->size);
+}
+
+void ut_array_truncate(ut_array_t *self, size_t len)
+{
+	if (len >= self->len)
+		return;
+
+	ut_array_drop_range(self, len, self->len - len);
+	self->len = len;
+}
+
+int ut_array_resize(ut_array_t *self, size_t len, const void *fill)
+{
+	size_t size = self->element->size;
+
+	if (len <= self->len) {
+		ut_array_truncate(self, len);
+		return UT_OK;
+	}
+
+	if (ut_array_reserve(self, len - self->len))
+		return UT_ENOMEM;
+
+	if (!fill) {
+		memset(ut_array_index(self, self->len), 0,
+		       (len - self->len) * size);
+		self->len = len;
+		return UT_OK;
+	}
+
+	for (; self->len < len; self->len++)
+		memcpy(ut_array_index(self, self->len), fill, size);
+	return UT_OK;
+}
+
+int ut_array_splice(ut_array_t *self, size_t index, size_t removed,
+		    const void *data, size_t n)
+{
+	size_t tail;
+
+	if (!data && n)
+		return UT_EINVAL;
+
+	if (index > self->len)
+		return UT_ERANGE;
+
+	if (removed > self->len - index)
+		removed = self->len - index;
+
+	if (n > removed && ut_array_reserve(self, n - removed))
+		return UT_ENOMEM;
+
+	ut_array_drop_range(self, index, removed);
+	tail = self->len - index - removed;
+	if (tail && n != removed)
+		ut_array_move(self, tail, index + removed, index + n);
+
+	if (n)
+		memcpy(ut_array_index(self, index), data,
+		       n * self->element->size);
+
+	self->len = self->len - removed + n;
+	return UT_OK;
+}
+
+void ut_array_nth_element(ut_array_t *self, size_t n)
+{
+	struct ut_array_sorter s;
+	size_t lo = 0, hi = self->len, p, depth = 0;
+
+	if (n >= self->len)
+		return;
+
+	ut_array_sorter_init(&s, self, NULL, NULL);
+	for (p = self->len; p > 1; p >>= 1)
+		depth += 2;
+
+	while (hi - lo > UT_ARRAY_SMALL_SORT) {
+		/* Bad pivots, bound the work by sorting what is left. */
+		if (!depth--) {
+			ut_array_heap_sort(&s, lo, hi);
+			return;
+		}
+
+		p = ut_array_partition(&s, lo, hi);
+		if (p == n)
+			return;
+
+		if (n < p)
+			hi = p;
+		else
+			lo = p + 1;
+	}
+
+	ut_array_insertion_sort(&s, lo, hi);
+}
+
+void ut_array_partial_sort(ut_array_t *self, size_t k)
+{
+	struct ut_array_sorter s;
+
+	if (k > self->len)
+		k = self->len;
+
+	if (k < 2) {
+		if (k)
+			ut_array_nth_element(self, 0);
+		return;
+	}
+
+	/* The kth least is in place, with everything less before it. */
+	ut_array_nth_element(self, k - 1);
+	ut_array_sorter_init(&s, self, NULL, NULL);
+	ut_array_heap_sort(&s, 0, k - 1);
+}
+
+void ut_array_sort(ut_array_t *self)
+{
+	if (!ut_array_radix_sort(self, false))
+		ut_array_sort_by(self, NULL, NULL);
+}
+
+int ut_array_sort_stable(ut_array_t *self)
+{
+	struct ut_array_sorter s;
+	uint8_t *buf;
+
+	if (self->len < 2 || ut_array_radix_sort(self, true))
+		return UT_OK;
+
+	ut_array_sorter_init(&s, self, NULL, NULL);
+	if (self->len <= UT_ARRAY_SMALL_SORT) {
+		ut_array_insertion_sort(&s, 0, self->len);
+		return UT_OK;
+	}
+
+	buf = malloc(self->len * self->element->size);
+	if (!buf)
+		return UT_ENOMEM;
+
+	ut_array_merge_sort(&s, buf, self->len);
+	free(buf);
+	return UT_OK;
+}
+
+void ut_array_sort_by(ut_array_t *self, ut_array_compare_fn compare,
+		      void *ctx)
+{
+	struct ut_array_sorter s;
+	size_t n;
+	int bad = 0;
+
+	if (self->len < 2)
+		return;
+
+	for (n = self->len; n > 1; n >>= 1)
+		bad++;
+
+	ut_array_sorter_init(&s, self, compare, ctx);
+	ut_array_pdqsort(&s, 0, self->len, bad, true);
+}
+
+void ut_array_sort_parallel(ut_array_t *self, unsigned threads,
+			    size_t grain)
+{
+	struct ut_array_parallel par;
+	long cpus;
+
+	if (!threads) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (unsigned)cpus : 1;
+	}
+
+	if (!grain)
+		grain = UT_ARRAY_PARALLEL_GRAIN;
+
+	if (threads > self->len / grain)
+		threads = self->len / grain;
+
+	if (threads < 2) {
+		ut_array_sort(self);
+		return;
+	}
+
+	par.buf = malloc(self->len * self->element->size);
+	par.counts = malloc(threads * sizeof(*par.counts));
+	if (!par.buf || !par.counts) {
+		free(par.counts);
+		free(par.buf);
+		ut_array_sort(self);
+		return;
+	}
+
+	ut_array_sorter_init(&par.s, self, NULL, NULL);
+	par.n = self->len;
+	if (!ut_array_radix_mode(self, false, &par.mode))
+		par.mode = -1;
+
+	ut_array_parallel_sort(&par, threads);
+	free(par.counts);
+	free(par.buf);
+}
+
+size_t ut_array_lower_bound(const ut_array_t *self, const void *key)
+{
+	return ut_array_bound(self, key, false);
+}
+
+size_t ut_array_upper_bound(const ut_array_t *self, const void *key)
+{
+	return ut_array_bound(self, key, true);
+}
+
+void ut_array_equal_range(const ut_array_t *self, const void *key,
+			  size_t *first, size_t *last)
+{
+	*first = ut_array_bound(self, key, false);
+	*last = ut_array_bound(self, key, true);
+}
+
+void ut_array_lower_bound_many(const ut_array_t *self, const void *keys,
+			       size_t n, size_t *indexes)
+{
+	struct ut_array_probe probes[UT_ARRAY_SEARCH_BATCH];
+	size_t base[UT_ARRAY_SEARCH_BATCH], size = self->element->size;
+	size_t i, j, m, len, half;
+	const uint8_t *p;
+	bool before;
+
+	for (i = 0; i < n; i += m) {
+		m = n - i < UT_ARRAY_SEARCH_BATCH ? n - i
+						   : UT_ARRAY_SEARCH_BATCH;
+		if (!self->len) {
+			memset(indexes + i, 0, m * sizeof(size_t));
+			continue;
+		}
+
+		for (j = 0; j < m; j++) {
+			p = (const uint8_t *)keys + (i + j) * size;
+			ut_array_probe_init(&probes[j], self, p, false);
+			base[j] = 0;
+		}
+
+		/*
+		 * All searches halve alike, so each step starts the loads of
+		 * every search before it waits on the first of them.
+		 */
+		for (len = self->len; len > 1; len -= half) {
+			half = len / 2;
+			for (j = 0; j < m; j++)
+				__builtin_prefetch(self->ptr +
+						   (base[j] + half) * size);
+
+			for (j = 0; j < m; j++) {
+				p = self->ptr + (base[j] + half) * size;
+				before = ut_array_probe_before(&probes[j], p);
+				base[j] += before * half;
+			}
+		}
+
+		for (j = 0; j < m; j++) {
+			p = self->ptr + base[j] * size;
+			indexes[i + j] = base[j] +
+					 ut_array_probe_before(&probes[j], p);
+		}
+	}
+}
+
+int ut_array_to_eytzinger(ut_array_t *self)
+{
+	return ut_array_eytzinger_layout(self, false);
+}
+
+int ut_array_from_eytzinger(ut_array_t *self)
+{
+	return ut_array_eytzinger_layout(self, true);
+}
+
+/*
+ * Goes down from the root, right past elements less than key, and then
+ * back up past the right turns to the last left one. The descendants four
+ * levels down of k sit together from 16k, fetched before they are needed.
+ * The buffer is not aligned to a line, so the block of descendants may
+ * straddle two lines and both are fetched.
+ */
+size_t ut_array_eytzinger_lower_bound(const ut_array_t *self,
+				      const void *key)
+{
+	struct ut_array_probe probe;
+	size_t n = self->len, k = 1, span = 2, last;
+	const uint8_t *p;
+
+	if (!n)
+		return 0;
+
+	ut_array_probe_init(&probe, self, key, false);
+	while (span < 16 && span * 2 * probe.size <= 64)
+		span *= 2;
+
+	while (k <= n) {
+		if (k * span <= n) {
+			last = k * span + span - 1;
+			if (last > n)
+				last = n;
+			__builtin_prefetch(self->ptr +
+					   (k * span - 1) * probe.size);
+			__builtin_prefetch(self->ptr + last * probe.size - 1);
+		}
+		p = self->ptr + (k - 1) * probe.size;
+		k = 2 * k + ut_array_probe_before(&probe, p);
+	}
+
+	k >>= __builtin_ctzll(~(unsigned long long)k) + 1;
+	return k ? k - 1 : n;
+}
+
 void *ut_array_get(ut_array_t *self, size_t index)
 {
 	if (index >= self->len)
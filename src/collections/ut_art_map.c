@@ -0,0 +1,1159 @@
+#include "ut_art_map.h"
+#include "ut_errno.h"
+#include "ut_pool.h"
+#include "ut_string.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define UT_ART_NODE4 0
+#define UT_ART_NODE16 1
+#define UT_ART_NODE48 2
+#define UT_ART_NODE256 3
+
+/*
+ * Prefixes longer than this are only stored in part. Lookups skip the rest
+ * and compare the whole key once they reach a leaf, inserts and removals
+ * read the rest from any leaf below the node.
+ */
+#define UT_ART_MAX_PREFIX 10
+
+/* Shrink a little below the size a node grows at, so they do not flap. */
+#define UT_ART_SHRINK16 3
+#define UT_ART_SHRINK48 12
+#define UT_ART_SHRINK256 37
+
+/*
+ * A child is either an inner node or a leaf, leaves are tagged in the
+ * lowest bit. A leaf is hung as high as its key is unique, so a path only
+ * has inner nodes where keys branch.
+ */
+struct ut_art_node {
+	uint8_t type;
+	uint16_t count;
+	size_t prefix_len;
+	uint8_t prefix[UT_ART_MAX_PREFIX];
+	/* The key that ends right after the prefix, it sorts first. */
+	struct ut_art_leaf *leaf;
+};
+
+struct ut_art_node4 {
+	struct ut_art_node base;
+	uint8_t keys[4];
+	struct ut_art_node *children[4];
+};
+
+struct ut_art_node16 {
+	struct ut_art_node base;
+	uint8_t keys[16];
+	struct ut_art_node *children[16];
+};
+
+/* index holds the position of the child of each byte plus one. */
+struct ut_art_node48 {
+	struct ut_art_node base;
+	uint8_t index[256];
+	struct ut_art_node *children[48];
+};
+
+struct ut_art_node256 {
+	struct ut_art_node base;
+	struct ut_art_node *children[256];
+};
+
+/* The key and the value follow the leaf. */
+struct ut_art_leaf {
+	const uint8_t *bytes;
+	size_t len;
+	uint8_t buf[sizeof(uint64_t)];
+};
+
+struct __ut_art_map {
+	struct ut_art_node *root;
+	size_t len;
+	ut_pool_t *pool;
+	size_t width;
+	bool is_signed;
+	const struct ut_type *key;
+	const struct ut_type *value;
+};
+
+struct ut_art_frame {
+	struct ut_art_node *node;
+	int pos;
+};
+
+struct __ut_art_map_iter {
+	struct ut_iter base;
+	ut_art_map_t *map;
+	struct ut_art_frame *stack;
+	size_t top;
+	size_t cap;
+	struct ut_art_leaf *pending;
+	struct ut_pair kv;
+};
+
+static const struct {
+	const struct ut_type *(*type)(void);
+	bool is_signed;
+} ut_art_ints[] = {
+	{ ut_type_char, true },	  { ut_type_short, true },
+	{ ut_type_int, true },	  { ut_type_long, true },
+	{ ut_type_uchar, false }, { ut_type_ushort, false },
+	{ ut_type_uint, false },  { ut_type_ulong, false },
+};
+
+static inline bool ut_art_is_leaf(const struct ut_art_node *node)
+{
+	return (uintptr_t)node & 1;
+}
+
+static inline struct ut_art_leaf *ut_art_leaf_of(const struct ut_art_node *node)
+{
+	return (struct ut_art_leaf *)((uintptr_t)node & ~(uintptr_t)1);
+}
+
+static inline struct ut_art_node *ut_art_tag(const struct ut_art_leaf *leaf)
+{
+	return (struct ut_art_node *)((uintptr_t)leaf | 1);
+}
+
+static inline void *ut_art_leaf_key(struct ut_art_leaf *self)
+{
+	return (uint8_t *)self + sizeof(struct ut_art_leaf);
+}
+
+static inline void *ut_art_leaf_value(ut_art_map_t *map,
+				      struct ut_art_leaf *self)
+{
+	return (uint8_t *)ut_art_leaf_key(self) + map->key->size;
+}
+
+static inline bool ut_art_leaf_matches(const struct ut_art_leaf *self,
+				       const uint8_t *bytes, size_t len)
+{
+	return self->len == len && memcmp(self->bytes, bytes, len) == 0;
+}
+
+static struct ut_pair ut_art_leaf_pair(ut_art_map_t *map,
+				       struct ut_art_leaf *leaf)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (leaf) {
+		kv.key = ut_art_leaf_key(leaf);
+		kv.value = ut_art_leaf_value(map, leaf);
+	}
+
+	return kv;
+}
+
+/* Points *len bytes that sort like key, using buf for integers. */
+static const uint8_t *ut_art_map_encode(const ut_art_map_t *self,
+					const void *key, uint8_t *buf,
+					size_t *len)
+{
+	const struct ut_string *s;
+	uint64_t v;
+	uint32_t v32;
+	uint16_t v16;
+	size_t i;
+
+	if (!self->width) {
+		s = key;
+		*len = s->len;
+		return (const uint8_t *)s->ptr;
+	}
+
+	switch (self->width) {
+	case 1:
+		v = *(const uint8_t *)key;
+		break;
+	case 2:
+		memcpy(&v16, key, 2);
+		v = v16;
+		break;
+	case 4:
+		memcpy(&v32, key, 4);
+		v = v32;
+		break;
+	default:
+		memcpy(&v, key, 8);
+		break;
+	}
+
+	if (self->is_signed)
+		v ^= (uint64_t)1 << (self->width * 8 - 1);
+
+	for (i = 0; i < self->width; i++)
+		buf[i] = v >> ((self->width - 1 - i) * 8);
+
+	*len = self->width;
+	return buf;
+}
+
+static struct ut_art_leaf *ut_art_map_new_leaf(ut_art_map_t *self,
+					       const void *key,
+					       const void *value)
+{
+	struct ut_art_leaf *leaf = ut_pool_alloc(self->pool);
+
+	if (!leaf)
+		return NULL;
+
+	memcpy(ut_art_leaf_key(leaf), key, self->key->size);
+	memcpy(ut_art_leaf_value(self, leaf), value, self->value->size);
+	leaf->bytes = ut_art_map_encode(self, ut_art_leaf_key(leaf), leaf->buf,
+					&leaf->len);
+	return leaf;
+}
+
+static void ut_art_map_free_leaf(ut_art_map_t *self, struct ut_art_leaf *leaf)
+{
+	if (self->key->drop)
+		self->key->drop(ut_art_leaf_key(leaf));
+
+	if (self->value->drop)
+		self->value->drop(ut_art_leaf_value(self, leaf));
+
+	ut_pool_free(self->pool, leaf);
+}
+
+static struct ut_art_node *ut_art_node_new(uint8_t type)
+{
+	static const size_t sizes[] = {
+		sizeof(struct ut_art_node4),
+		sizeof(struct ut_art_node16),
+		sizeof(struct ut_art_node48),
+		sizeof(struct ut_art_node256),
+	};
+	struct ut_art_node *node = calloc(1, sizes[type]);
+
+	if (node)
+		node->type = type;
+
+	return node;
+}
+
+/* Copies the header of src into dst, which is of another type. */
+static void ut_art_node_copy_header(struct ut_art_node *dst,
+				    const struct ut_art_node *src)
+{
+	dst->count = src->count;
+	dst->prefix_len = src->prefix_len;
+	memcpy(dst->prefix, src->prefix, UT_ART_MAX_PREFIX);
+	dst->leaf = src->leaf;
+}
+
+static void ut_art_node_set_prefix(struct ut_art_node *self,
+				   const uint8_t *bytes, size_t len)
+{
+	self->prefix_len = len;
+	memcpy(self->prefix, bytes,
+	       len < UT_ART_MAX_PREFIX ? len : UT_ART_MAX_PREFIX);
+}
+
+static struct ut_art_node **ut_art_node_find_child(struct ut_art_node *self,
+						   uint8_t byte)
+{
+	struct ut_art_node4 *n4;
+	struct ut_art_node16 *n16;
+	struct ut_art_node48 *n48;
+	struct ut_art_node256 *n256;
+	int i;
+#ifdef __SSE2__
+	__m128i cmp;
+	unsigned mask;
+#endif
+
+	switch (self->type) {
+	case UT_ART_NODE4:
+		n4 = (struct ut_art_node4 *)self;
+		for (i = 0; i < self->count; i++) {
+			if (n4->keys[i] == byte)
+				return &n4->children[i];
+		}
+		return NULL;
+	case UT_ART_NODE16:
+		n16 = (struct ut_art_node16 *)self;
+#ifdef __SSE2__
+		/* Compare all 16 keys at once, the first match is the only. */
+		cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte),
+				     _mm_loadu_si128((__m128i *)n16->keys));
+		mask = _mm_movemask_epi8(cmp) & ((1u << self->count) - 1);
+		if (!mask)
+			return NULL;
+		for (i = 0; !(mask & 1); i++)
+			mask >>= 1;
+		return &n16->children[i];
+#else
+		for (i = 0; i < self->count; i++) {
+			if (n16->keys[i] == byte)
+				return &n16->children[i];
+		}
+		return NULL;
+#endif
+	case UT_ART_NODE48:
+		n48 = (struct ut_art_node48 *)self;
+		i = n48->index[byte];
+		return i ? &n48->children[i - 1] : NULL;
+	default:
+		n256 = (struct ut_art_node256 *)self;
+		return n256->children[byte] ? &n256->children[byte] : NULL;
+	}
+}
+
+/*
+ * Returns the child after position *pos in byte order and advances *pos,
+ * or NULL when there is none.
+ */
+static struct ut_art_node *ut_art_node_next_child(struct ut_art_node *self,
+						  int *pos)
+{
+	struct ut_art_node48 *n48;
+	struct ut_art_node256 *n256;
+	int i;
+
+	switch (self->type) {
+	case UT_ART_NODE4:
+		if (*pos >= self->count)
+			return NULL;
+		return ((struct ut_art_node4 *)self)->children[(*pos)++];
+	case UT_ART_NODE16:
+		if (*pos >= self->count)
+			return NULL;
+		return ((struct ut_art_node16 *)self)->children[(*pos)++];
+	case UT_ART_NODE48:
+		n48 = (struct ut_art_node48 *)self;
+		while (*pos < 256) {
+			i = n48->index[(*pos)++];
+			if (i)
+				return n48->children[i - 1];
+		}
+		return NULL;
+	default:
+		n256 = (struct ut_art_node256 *)self;
+		while (*pos < 256) {
+			if (n256->children[*pos])
+				return n256->children[(*pos)++];
+			(*pos)++;
+		}
+		return NULL;
+	}
+}
+
+static struct ut_art_node *ut_art_node_last_child(struct ut_art_node *self)
+{
+	struct ut_art_node48 *n48;
+	struct ut_art_node256 *n256;
+	int i;
+
+	switch (self->type) {
+	case UT_ART_NODE4:
+		return ((struct ut_art_node4 *)self)->children[self->count - 1];
+	case UT_ART_NODE16:
+		return ((struct ut_art_node16 *)self)
+			->children[self->count - 1];
+	case UT_ART_NODE48:
+		n48 = (struct ut_art_node48 *)self;
+		for (i = 255; !n48->index[i]; i--)
+			;
+		return n48->children[n48->index[i] - 1];
+	default:
+		n256 = (struct ut_art_node256 *)self;
+		for (i = 255; !n256->children[i]; i--)
+			;
+		return n256->children[i];
+	}
+}
+
+static struct ut_art_leaf *ut_art_node_first(struct ut_art_node *node)
+{
+	int pos;
+
+	while (node && !ut_art_is_leaf(node)) {
+		if (node->leaf)
+			return node->leaf;
+		pos = 0;
+		node = ut_art_node_next_child(node, &pos);
+	}
+
+	return !node ? NULL : ut_art_leaf_of(node);
+}
+
+static struct ut_art_leaf *ut_art_node_last(struct ut_art_node *node)
+{
+	while (node && !ut_art_is_leaf(node)) {
+		if (!node->count)
+			return node->leaf;
+		node = ut_art_node_last_child(node);
+	}
+
+	return !node ? NULL : ut_art_leaf_of(node);
+}
+
+/*
+ * The number of prefix bytes of self that match bytes from depth on. Bytes
+ * beyond the stored part of the prefix are read from a leaf below.
+ */
+static size_t ut_art_node_prefix_mismatch(struct ut_art_node *self,
+					  const uint8_t *bytes, size_t len,
+					  size_t depth)
+{
+	struct ut_art_leaf *leaf;
+	size_t i, max;
+
+	max = self->prefix_len < len - depth ? self->prefix_len : len - depth;
+
+	for (i = 0; i < max && i < UT_ART_MAX_PREFIX; i++) {
+		if (self->prefix[i] != bytes[depth + i])
+			return i;
+	}
+
+	if (i == max)
+		return i;
+
+	leaf = ut_art_node_first(self);
+	for (; i < max; i++) {
+		if (leaf->bytes[depth + i] != bytes[depth + i])
+			return i;
+	}
+
+	return i;
+}
+
+/* Adds a child to a node that has room for it, keeping the keys sorted. */
+static void ut_art_node_add_child(struct ut_art_node *self, uint8_t byte,
+				  struct ut_art_node *child)
+{
+	struct ut_art_node4 *n4;
+	struct ut_art_node16 *n16;
+	struct ut_art_node48 *n48;
+	uint8_t *keys;
+	struct ut_art_node **children;
+	int i, pos;
+
+	switch (self->type) {
+	case UT_ART_NODE4:
+	case UT_ART_NODE16:
+		if (self->type == UT_ART_NODE4) {
+			n4 = (struct ut_art_node4 *)self;
+			keys = n4->keys;
+			children = n4->children;
+		} else {
+			n16 = (struct ut_art_node16 *)self;
+			keys = n16->keys;
+			children = n16->children;
+		}
+
+		for (pos = 0; pos < self->count && keys[pos] < byte; pos++)
+			;
+		for (i = self->count; i > pos; i--) {
+			keys[i] = keys[i - 1];
+			children[i] = children[i - 1];
+		}
+		keys[pos] = byte;
+		children[pos] = child;
+		break;
+	case UT_ART_NODE48:
+		n48 = (struct ut_art_node48 *)self;
+		for (pos = 0; n48->children[pos]; pos++)
+			;
+		n48->children[pos] = child;
+		n48->index[byte] = pos + 1;
+		break;
+	default:
+		((struct ut_art_node256 *)self)->children[byte] = child;
+		break;
+	}
+
+	self->count++;
+}
+
+/* Replaces the full node at *ref with one of the next larger type. */
+static int ut_art_node_grow(struct ut_art_node **ref)
+{
+	struct ut_art_node *self = *ref, *node;
+	struct ut_art_node48 *n48;
+	struct ut_art_node256 *n256;
+	int pos, byte;
+
+	node = ut_art_node_new(self->type + 1);
+	if (!node)
+		return UT_ENOMEM;
+
+	ut_art_node_copy_header(node, self);
+
+	switch (self->type) {
+	case UT_ART_NODE4:
+		memcpy(((struct ut_art_node16 *)node)->keys,
+		       ((struct ut_art_node4 *)self)->keys, 4);
+		memcpy(((struct ut_art_node16 *)node)->children,
+		       ((struct ut_art_node4 *)self)->children,
+		       4 * sizeof(struct ut_art_node *));
+		break;
+	case UT_ART_NODE16:
+		n48 = (struct ut_art_node48 *)node;
+		for (pos = 0; pos < 16; pos++) {
+			byte = ((struct ut_art_node16 *)self)->keys[pos];
+			n48->children[pos] =
+				((struct ut_art_node16 *)self)->children[pos];
+			n48->index[byte] = pos + 1;
+		}
+		break;
+	default:
+		n48 = (struct ut_art_node48 *)self;
+		n256 = (struct ut_art_node256 *)node;
+		for (byte = 0; byte < 256; byte++) {
+			if (n48->index[byte])
+				n256->children[byte] =
+					n48->children[n48->index[byte] - 1];
+		}
+		break;
+	}
+
+	free(self);
+	*ref = node;
+	return UT_OK;
+}
+
+/*
+ * Replaces a node that is left with a single entry by that entry. An inner
+ * child takes over the prefix of the node and the byte in between.
+ */
+static void ut_art_node_collapse(struct ut_art_node **ref)
+{
+	struct ut_art_node4 *self = (struct ut_art_node4 *)*ref;
+	struct ut_art_node *child;
+	uint8_t prefix[UT_ART_MAX_PREFIX];
+	size_t len;
+
+	if (!self->base.count) {
+		*ref = ut_art_tag(self->base.leaf);
+		free(self);
+		return;
+	}
+
+	child = self->children[0];
+
+	if (!ut_art_is_leaf(child)) {
+		len = self->base.prefix_len < UT_ART_MAX_PREFIX ?
+			      self->base.prefix_len :
+			      UT_ART_MAX_PREFIX;
+		memcpy(prefix, self->base.prefix, len);
+		if (len < UT_ART_MAX_PREFIX)
+			prefix[len++] = self->keys[0];
+		if (len < UT_ART_MAX_PREFIX) {
+			memcpy(prefix + len, child->prefix,
+			       UT_ART_MAX_PREFIX - len);
+		}
+
+		memcpy(child->prefix, prefix, UT_ART_MAX_PREFIX);
+		child->prefix_len += self->base.prefix_len + 1;
+	}
+
+	*ref = child;
+	free(self);
+}
+
+/* Replaces the node at *ref, which got too empty, by a smaller one. */
+static void ut_art_node_shrink(struct ut_art_node **ref)
+{
+	struct ut_art_node *self = *ref, *node;
+	struct ut_art_node16 *n16;
+	struct ut_art_node48 *n48;
+	struct ut_art_node256 *n256;
+	int pos, byte;
+
+	/* Shrinking only makes the node smaller, so just keep it on OOM. */
+	node = ut_art_node_new(self->type - 1);
+	if (!node)
+		return;
+
+	ut_art_node_copy_header(node, self);
+
+	switch (self->type) {
+	case UT_ART_NODE16:
+		memcpy(((struct ut_art_node4 *)node)->keys,
+		       ((struct ut_art_node16 *)self)->keys, self->count);
+		memcpy(((struct ut_art_node4 *)node)->children,
+		       ((struct ut_art_node16 *)self)->children,
+		       self->count * sizeof(struct ut_art_node *));
+		break;
+	case UT_ART_NODE48:
+		n48 = (struct ut_art_node48 *)self;
+		n16 = (struct ut_art_node16 *)node;
+		for (byte = 0, pos = 0; byte < 256; byte++) {
+			if (n48->index[byte]) {
+				n16->keys[pos] = byte;
+				n16->children[pos++] =
+					n48->children[n48->index[byte] - 1];
+			}
+		}
+		break;
+	default:
+		n256 = (struct ut_art_node256 *)self;
+		n48 = (struct ut_art_node48 *)node;
+		for (byte = 0, pos = 0; byte < 256; byte++) {
+			if (n256->children[byte]) {
+				n48->children[pos] = n256->children[byte];
+				n48->index[byte] = ++pos;
+			}
+		}
+		break;
+	}
+
+	free(self);
+	*ref = node;
+}
+
+/* Removes the child of byte from the node at *ref. */
+static void ut_art_node_remove_child(struct ut_art_node **ref, uint8_t byte)
+{
+	struct ut_art_node *self = *ref;
+	struct ut_art_node48 *n48;
+	uint8_t *keys;
+	struct ut_art_node **children;
+	int i;
+
+	switch (self->type) {
+	case UT_ART_NODE4:
+	case UT_ART_NODE16:
+		if (self->type == UT_ART_NODE4) {
+			keys = ((struct ut_art_node4 *)self)->keys;
+			children = ((struct ut_art_node4 *)self)->children;
+		} else {
+			keys = ((struct ut_art_node16 *)self)->keys;
+			children = ((struct ut_art_node16 *)self)->children;
+		}
+
+		for (i = 0; keys[i] != byte; i++)
+			;
+		for (self->count--; i < self->count; i++) {
+			keys[i] = keys[i + 1];
+			children[i] = children[i + 1];
+		}
+		break;
+	case UT_ART_NODE48:
+		n48 = (struct ut_art_node48 *)self;
+		n48->children[n48->index[byte] - 1] = NULL;
+		n48->index[byte] = 0;
+		self->count--;
+		break;
+	default:
+		((struct ut_art_node256 *)self)->children[byte] = NULL;
+		self->count--;
+		break;
+	}
+
+	if (self->type == UT_ART_NODE4) {
+		if (self->count + (self->leaf != NULL) == 1)
+			ut_art_node_collapse(ref);
+	} else if ((self->type == UT_ART_NODE16 &&
+		    self->count == UT_ART_SHRINK16) ||
+		   (self->type == UT_ART_NODE48 &&
+		    self->count == UT_ART_SHRINK48) ||
+		   (self->type == UT_ART_NODE256 &&
+		    self->count == UT_ART_SHRINK256)) {
+		ut_art_node_shrink(ref);
+	}
+}
+
+/* Hangs leaf into a new node whose prefix ends at depth. */
+static void ut_art_node_attach(struct ut_art_node *self,
+			       struct ut_art_leaf *leaf, size_t depth)
+{
+	if (leaf->len == depth)
+		self->leaf = leaf;
+	else
+		ut_art_node_add_child(self, leaf->bytes[depth],
+				      ut_art_tag(leaf));
+}
+
+static void ut_art_node_free(ut_art_map_t *map, struct ut_art_node *node)
+{
+	struct ut_art_node *child;
+	int pos = 0;
+
+	if (!node)
+		return;
+
+	if (ut_art_is_leaf(node)) {
+		ut_art_map_free_leaf(map, ut_art_leaf_of(node));
+		return;
+	}
+
+	while ((child = ut_art_node_next_child(node, &pos)))
+		ut_art_node_free(map, child);
+
+	if (node->leaf)
+		ut_art_map_free_leaf(map, node->leaf);
+
+	free(node);
+}
+
+static struct ut_art_leaf *ut_art_map_find(ut_art_map_t *self,
+					   const void *key)
+{
+	struct ut_art_node *node = self->root, **child;
+	struct ut_art_leaf *leaf;
+	const uint8_t *bytes;
+	uint8_t buf[sizeof(uint64_t)];
+	size_t len, depth = 0;
+
+	bytes = ut_art_map_encode(self, key, buf, &len);
+
+	while (node) {
+		if (ut_art_is_leaf(node)) {
+			leaf = ut_art_leaf_of(node);
+			return ut_art_leaf_matches(leaf, bytes, len) ? leaf :
+								       NULL;
+		}
+
+		/* Only the stored part of the prefix is checked here. */
+		if (node->prefix_len) {
+			if (node->prefix_len > len - depth ||
+			    memcmp(node->prefix, bytes + depth,
+				   node->prefix_len < UT_ART_MAX_PREFIX ?
+					   node->prefix_len :
+					   UT_ART_MAX_PREFIX) != 0)
+				return NULL;
+			depth += node->prefix_len;
+		}
+
+		if (depth == len) {
+			leaf = node->leaf;
+			return leaf && ut_art_leaf_matches(leaf, bytes, len) ?
+				       leaf :
+				       NULL;
+		}
+
+		child = ut_art_node_find_child(node, bytes[depth++]);
+		node = child ? *child : NULL;
+	}
+
+	return NULL;
+}
+
+ut_art_map_t *ut_art_map_new(const struct ut_type *key,
+			     const struct ut_type *value)
+{
+	ut_art_map_t *self;
+	size_t i, n = sizeof(ut_art_ints) / sizeof(ut_art_ints[0]);
+
+	if (!key || !value)
+		return NULL;
+
+	for (i = 0; i < n && ut_art_ints[i].type() != key; i++)
+		;
+
+	if (i == n && key != ut_type_string())
+		return NULL;
+
+	self = malloc(sizeof(ut_art_map_t));
+	if (!self)
+		return NULL;
+
+	self->pool = ut_pool_new(sizeof(struct ut_art_leaf) + key->size +
+				 value->size);
+	if (!self->pool) {
+		free(self);
+		return NULL;
+	}
+
+	self->root = NULL;
+	self->len = 0;
+	self->width = i == n ? 0 : key->size;
+	self->is_signed = i == n ? false : ut_art_ints[i].is_signed;
+	self->key = key;
+	self->value = value;
+	return self;
+}
+
+void ut_art_map_delete(ut_art_map_t *self)
+{
+	ut_art_map_clear(self);
+	ut_pool_delete(self->pool);
+	free(self);
+}
+
+void ut_art_map_clear(ut_art_map_t *self)
+{
+	ut_art_node_free(self, self->root);
+	ut_pool_clear(self->pool);
+	self->root = NULL;
+	self->len = 0;
+}
+
+int ut_art_map_insert(ut_art_map_t *self, const void *key, const void *value)
+{
+	struct ut_art_node **ref = &self->root, **child, *node, *inner;
+	struct ut_art_leaf *leaf, *old;
+	const uint8_t *bytes;
+	uint8_t buf[sizeof(uint64_t)], byte;
+	size_t len, depth = 0, i, rest;
+
+	if (!key || !value)
+		return UT_EINVAL;
+
+	bytes = ut_art_map_encode(self, key, buf, &len);
+
+	while ((node = *ref) && !ut_art_is_leaf(node)) {
+		i = ut_art_node_prefix_mismatch(node, bytes, len, depth);
+
+		if (i < node->prefix_len) {
+			/*
+			 * The key leaves the prefix after i bytes, a new node
+			 * takes those and the old one keeps the rest.
+			 */
+			inner = ut_art_node_new(UT_ART_NODE4);
+			leaf = inner ? ut_art_map_new_leaf(self, key, value) :
+				       NULL;
+			if (!leaf) {
+				free(inner);
+				return UT_ENOMEM;
+			}
+
+			ut_art_node_set_prefix(inner, bytes + depth, i);
+
+			rest = node->prefix_len - i - 1;
+			if (node->prefix_len <= UT_ART_MAX_PREFIX) {
+				byte = node->prefix[i];
+				memmove(node->prefix, node->prefix + i + 1,
+					rest);
+				node->prefix_len = rest;
+			} else {
+				old = ut_art_node_first(node);
+				byte = old->bytes[depth + i];
+				ut_art_node_set_prefix(
+					node, old->bytes + depth + i + 1, rest);
+			}
+
+			ut_art_node_add_child(inner, byte, node);
+			ut_art_node_attach(inner, leaf, depth + i);
+			*ref = inner;
+			self->len++;
+			return UT_OK;
+		}
+
+		depth += node->prefix_len;
+
+		if (depth == len) {
+			if (node->leaf) {
+				old = node->leaf;
+				if (self->value->drop)
+					self->value->drop(
+						ut_art_leaf_value(self, old));
+				memcpy(ut_art_leaf_value(self, old), value,
+				       self->value->size);
+				return UT_OK;
+			}
+
+			node->leaf = ut_art_map_new_leaf(self, key, value);
+			if (!node->leaf)
+				return UT_ENOMEM;
+			self->len++;
+			return UT_OK;
+		}
+
+		child = ut_art_node_find_child(node, bytes[depth]);
+		if (!child)
+			break;
+
+		ref = child;
+		depth++;
+	}
+
+	if (node && ut_art_is_leaf(node) &&
+	    ut_art_leaf_matches(ut_art_leaf_of(node), bytes, len)) {
+		old = ut_art_leaf_of(node);
+		if (self->value->drop)
+			self->value->drop(ut_art_leaf_value(self, old));
+		memcpy(ut_art_leaf_value(self, old), value, self->value->size);
+		return UT_OK;
+	}
+
+	leaf = ut_art_map_new_leaf(self, key, value);
+	if (!leaf)
+		return UT_ENOMEM;
+
+	if (!node) {
+		*ref = ut_art_tag(leaf);
+	} else if (ut_art_is_leaf(node)) {
+		/* Lazy expansion: two leaves only branch where they differ. */
+		inner = ut_art_node_new(UT_ART_NODE4);
+		if (!inner) {
+			ut_pool_free(self->pool, leaf);
+			return UT_ENOMEM;
+		}
+
+		old = ut_art_leaf_of(node);
+		for (i = depth; i < len && i < old->len; i++) {
+			if (old->bytes[i] != bytes[i])
+				break;
+		}
+
+		ut_art_node_set_prefix(inner, bytes + depth, i - depth);
+		ut_art_node_attach(inner, old, i);
+		ut_art_node_attach(inner, leaf, i);
+		*ref = inner;
+	} else {
+		if ((node->type == UT_ART_NODE4 && node->count == 4) ||
+		    (node->type == UT_ART_NODE16 && node->count == 16) ||
+		    (node->type == UT_ART_NODE48 && node->count == 48)) {
+			if (ut_art_node_grow(ref)) {
+				ut_pool_free(self->pool, leaf);
+				return UT_ENOMEM;
+			}
+		}
+
+		ut_art_node_add_child(*ref, bytes[depth], ut_art_tag(leaf));
+	}
+
+	self->len++;
+	return UT_OK;
+}
+
+void ut_art_map_remove(ut_art_map_t *self, const void *key)
+{
+	struct ut_art_node **ref = &self->root, **child, *node;
+	struct ut_art_leaf *leaf = NULL;
+	const uint8_t *bytes;
+	uint8_t buf[sizeof(uint64_t)];
+	size_t len, depth = 0;
+
+	if (!key)
+		return;
+
+	bytes = ut_art_map_encode(self, key, buf, &len);
+
+	while ((node = *ref)) {
+		if (ut_art_is_leaf(node)) {
+			/* Only a leaf at the root is reached this way. */
+			leaf = ut_art_leaf_of(node);
+			if (!ut_art_leaf_matches(leaf, bytes, len))
+				return;
+			*ref = NULL;
+			break;
+		}
+
+		if (node->prefix_len) {
+			if (node->prefix_len > len - depth ||
+			    memcmp(node->prefix, bytes + depth,
+				   node->prefix_len < UT_ART_MAX_PREFIX ?
+					   node->prefix_len :
+					   UT_ART_MAX_PREFIX) != 0)
+				return;
+			depth += node->prefix_len;
+		}
+
+		if (depth == len) {
+			leaf = node->leaf;
+			if (!leaf || !ut_art_leaf_matches(leaf, bytes, len))
+				return;
+			node->leaf = NULL;
+			if (node->type == UT_ART_NODE4 && node->count == 1)
+				ut_art_node_collapse(ref);
+			break;
+		}
+
+		child = ut_art_node_find_child(node, bytes[depth]);
+		if (!child)
+			return;
+
+		if (ut_art_is_leaf(*child)) {
+			leaf = ut_art_leaf_of(*child);
+			if (!ut_art_leaf_matches(leaf, bytes, len))
+				return;
+			ut_art_node_remove_child(ref, bytes[depth]);
+			break;
+		}
+
+		ref = child;
+		depth++;
+	}
+
+	if (leaf) {
+		ut_art_map_free_leaf(self, leaf);
+		self->len--;
+	}
+}
+
+void *ut_art_map_get(ut_art_map_t *self, const void *key)
+{
+	return ut_art_map_get_key_value(self, key).value;
+}
+
+struct ut_pair ut_art_map_get_key_value(ut_art_map_t *self, const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	return ut_art_leaf_pair(self, ut_art_map_find(self, key));
+}
+
+struct ut_pair ut_art_map_first(ut_art_map_t *self)
+{
+	return ut_art_leaf_pair(self, ut_art_node_first(self->root));
+}
+
+struct ut_pair ut_art_map_last(ut_art_map_t *self)
+{
+	return ut_art_leaf_pair(self, ut_art_node_last(self->root));
+}
+
+size_t ut_art_map_length(const ut_art_map_t *self)
+{
+	return self->len;
+}
+
+bool ut_art_map_is_empty(const ut_art_map_t *self)
+{
+	return self->len == 0;
+}
+
+static bool ut_art_map_iter_push(struct __ut_art_map_iter *self,
+				 struct ut_art_node *node)
+{
+	struct ut_art_frame *stack;
+
+	if (self->top == self->cap) {
+		stack = realloc(self->stack,
+				self->cap * 2 * sizeof(struct ut_art_frame));
+		if (!stack)
+			return false;
+		self->stack = stack;
+		self->cap *= 2;
+	}
+
+	self->stack[self->top].node = node;
+	self->stack[self->top].pos = -1;
+	self->top++;
+	return true;
+}
+
+/* A depth first walk, each node yields its own leaf before its children. */
+static void *ut_art_map_iter_next(struct __ut_art_map_iter *self)
+{
+	struct ut_art_frame *frame;
+	struct ut_art_node *child;
+	struct ut_art_leaf *leaf = self->pending;
+
+	self->pending = NULL;
+
+	while (!leaf && self->top) {
+		frame = &self->stack[self->top - 1];
+
+		if (frame->pos < 0) {
+			frame->pos = 0;
+			leaf = frame->node->leaf;
+			continue;
+		}
+
+		child = ut_art_node_next_child(frame->node, &frame->pos);
+		if (!child)
+			self->top--;
+		else if (ut_art_is_leaf(child))
+			leaf = ut_art_leaf_of(child);
+		else if (!ut_art_map_iter_push(self, child))
+			return NULL;
+	}
+
+	if (!leaf)
+		return NULL;
+
+	self->kv = ut_art_leaf_pair(self->map, leaf);
+	return &self->kv;
+}
+
+static struct ut_iter *ut_art_map_iter_new_at(ut_art_map_t *map,
+					      struct ut_art_node *node)
+{
+	struct __ut_art_map_iter *self;
+
+	self = malloc(sizeof(struct __ut_art_map_iter));
+	if (!self)
+		return NULL;
+
+	self->cap = 16;
+	self->stack = malloc(self->cap * sizeof(struct ut_art_frame));
+	if (!self->stack) {
+		free(self);
+		return NULL;
+	}
+
+	self->base.next = (void *)&ut_art_map_iter_next;
+	self->map = map;
+	self->top = 0;
+	self->pending = NULL;
+
+	if (node && ut_art_is_leaf(node))
+		self->pending = ut_art_leaf_of(node);
+	else if (node)
+		ut_art_map_iter_push(self, node);
+
+	return (struct ut_iter *)self;
+}
+
+struct ut_iter *ut_art_map_iter_new(ut_art_map_t *map)
+{
+	if (!map)
+		return NULL;
+
+	return ut_art_map_iter_new_at(map, map->root);
+}
+
+struct ut_iter *ut_art_map_prefix_iter_new(ut_art_map_t *map,
+					   const void *prefix, size_t len)
+{
+	struct ut_art_node *node, **child;
+	struct ut_art_leaf *leaf;
+	const uint8_t *bytes = prefix;
+	size_t depth = 0, n;
+
+	if (!map || (len && !prefix))
+		return NULL;
+
+	node = map->root;
+
+	/* Descend until the prefix is used up, the rest is the subtree. */
+	while (node && depth < len) {
+		if (ut_art_is_leaf(node)) {
+			leaf = ut_art_leaf_of(node);
+			if (leaf->len < len ||
+			    memcmp(leaf->bytes + depth, bytes + depth,
+				   len - depth) != 0)
+				node = NULL;
+			break;
+		}
+
+		if (node->prefix_len) {
+			n = node->prefix_len < len - depth ? node->prefix_len :
+							     len - depth;
+			leaf = ut_art_node_first(node);
+			if (memcmp(leaf->bytes + depth, bytes + depth, n)) {
+				node = NULL;
+				break;
+			}
+			depth += node->prefix_len;
+			if (depth >= len)
+				break;
+		}
+
+		child = ut_art_node_find_child(node, bytes[depth++]);
+		node = child ? *child : NULL;
+	}
+
+	return ut_art_map_iter_new_at(map, node);
+}
+
+void ut_art_map_iter_delete(struct ut_iter *self)
+{
+	free(((struct __ut_art_map_iter *)self)->stack);
+	free(self);
+}
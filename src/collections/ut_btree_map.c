@@ -0,0 +1,649 @@
+#include "ut_btree_map.h"
+#include "ut_errno.h"
+#include "ut_mem.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Keys of a node take about four cache lines, so that the binary search
+ * inside a node touches few lines and a lookup only misses once per level.
+ */
+#define UT_BTREE_NODE_BYTES 256
+#define UT_BTREE_MIN_ORDER 4
+#define UT_BTREE_MAX_ORDER 64
+
+typedef struct __ut_btree_node ut_btree_node_t;
+
+/* Where the keys of a node start, aligned as malloc would align them. */
+#define UT_BTREE_KEYS UT_MEM_ALIGN(sizeof(ut_btree_node_t))
+
+/* The scratch key and value follow the map, aligned the same way. */
+#define UT_BTREE_SCRATCH UT_MEM_ALIGN(sizeof(ut_btree_map_t))
+
+struct __ut_btree_map {
+	ut_btree_node_t *root;
+	ut_btree_node_t *head;
+	size_t len;
+	size_t order;
+	size_t offset;
+	void *scratch;
+	const struct ut_type *key;
+	const struct ut_type *value;
+};
+
+/*
+ * Every node stores its keys contiguously after the header. A leaf
+ * then stores the values, an inner node the children. Leaves are linked
+ * in key order. The separator key i of an inner node is a copy of the
+ * smallest key in the subtree of child i + 1.
+ */
+struct __ut_btree_node {
+	bool leaf;
+	size_t len;
+	ut_btree_node_t *next;
+};
+
+struct __ut_btree_map_iter {
+	struct ut_iter base;
+	ut_btree_map_t *map;
+	ut_btree_node_t *curr;
+	size_t index;
+	struct ut_pair kv;
+};
+
+static inline void *ut_btree_node_key(ut_btree_map_t *self,
+				      ut_btree_node_t *node, size_t index)
+{
+	return (uint8_t *)node + UT_BTREE_KEYS + index * self->key->size;
+}
+
+static inline void *ut_btree_node_value(ut_btree_map_t *self,
+					ut_btree_node_t *node, size_t index)
+{
+	return (uint8_t *)node + self->offset + index * self->value->size;
+}
+
+static inline ut_btree_node_t **ut_btree_node_children(ut_btree_map_t *self,
+						       ut_btree_node_t *node)
+{
+	return (ut_btree_node_t **)((uint8_t *)node + self->offset);
+}
+
+static inline size_t ut_btree_node_min(ut_btree_map_t *self,
+				       ut_btree_node_t *node)
+{
+	return node->leaf ? self->order >> 1 : (self->order - 1) >> 1;
+}
+
+static inline void ut_btree_node_move_keys(ut_btree_map_t *self,
+					   ut_btree_node_t *dst, size_t to,
+					   ut_btree_node_t *src, size_t from,
+					   size_t n)
+{
+	ut_memmove(ut_btree_node_key(self, dst, to),
+		   ut_btree_node_key(self, src, from), n * self->key->size);
+}
+
+static inline void ut_btree_node_move_values(ut_btree_map_t *self,
+					     ut_btree_node_t *dst, size_t to,
+					     ut_btree_node_t *src, size_t from,
+					     size_t n)
+{
+	ut_memmove(ut_btree_node_value(self, dst, to),
+		   ut_btree_node_value(self, src, from), n * self->value->size);
+}
+
+static inline void ut_btree_node_move_children(ut_btree_map_t *self,
+					       ut_btree_node_t *dst, size_t to,
+					       ut_btree_node_t *src,
+					       size_t from, size_t n)
+{
+	ut_memmove(ut_btree_node_children(self, dst) + to,
+		   ut_btree_node_children(self, src) + from,
+		   n * sizeof(ut_btree_node_t *));
+}
+
+static ut_btree_node_t *ut_btree_node_new(ut_btree_map_t *self, bool leaf)
+{
+	ut_btree_node_t *node;
+	size_t size;
+
+	if (leaf)
+		size = self->offset + self->order * self->value->size;
+	else
+		size = self->offset +
+		       (self->order + 1) * sizeof(ut_btree_node_t *);
+
+	node = malloc(size);
+	if (!node)
+		return NULL;
+
+	node->leaf = leaf;
+	node->len = 0;
+	node->next = NULL;
+	return node;
+}
+
+static void ut_btree_node_delete(ut_btree_map_t *self, ut_btree_node_t *node)
+{
+	ut_btree_node_t **children;
+	size_t i;
+
+	if (!node->leaf) {
+		children = ut_btree_node_children(self, node);
+		for (i = 0; i <= node->len; i++)
+			ut_btree_node_delete(self, children[i]);
+	} else {
+		for (i = 0; i < node->len; i++) {
+			if (self->key->drop)
+				self->key->drop(
+					ut_btree_node_key(self, node, i));
+			if (self->value->drop)
+				self->value->drop(
+					ut_btree_node_value(self, node, i));
+		}
+	}
+
+	free(node);
+}
+
+static size_t ut_btree_node_search(ut_btree_map_t *self, ut_btree_node_t *node,
+				   const void *key, bool *found)
+{
+	size_t lo = 0, hi = node->len, mid;
+	int cmp;
+
+	*found = false;
+
+	while (lo < hi) {
+		mid = lo + ((hi - lo) >> 1);
+		cmp = self->key->compare(key,
+					 ut_btree_node_key(self, node, mid));
+
+		if (cmp > 0) {
+			lo = mid + 1;
+		} else if (cmp < 0) {
+			hi = mid;
+		} else {
+			*found = true;
+			return mid;
+		}
+	}
+
+	return lo;
+}
+
+static inline size_t ut_btree_node_child_index(ut_btree_map_t *self,
+					       ut_btree_node_t *node,
+					       const void *key)
+{
+	bool found;
+	size_t index = ut_btree_node_search(self, node, key, &found);
+
+	return found ? index + 1 : index;
+}
+
+/* Splits the full child at index of a parent that is not full. */
+static int ut_btree_map_split_child(ut_btree_map_t *self,
+				    ut_btree_node_t *parent, size_t index)
+{
+	ut_btree_node_t *child, *right;
+	size_t mid;
+
+	child = ut_btree_node_children(self, parent)[index];
+	right = ut_btree_node_new(self, child->leaf);
+	if (!right)
+		return UT_ENOMEM;
+
+	ut_btree_node_move_keys(self, parent, index + 1, parent, index,
+				parent->len - index);
+	ut_btree_node_move_children(self, parent, index + 2, parent, index + 1,
+				    parent->len - index);
+
+	if (child->leaf) {
+		/*
+		 *     [ . ]              [ . c . ]
+		 *       |        -->       |   |
+		 *  [ a b c d ]        [ a b ] [ c d ]
+		 */
+		mid = child->len - (child->len >> 1);
+		right->len = child->len - mid;
+		ut_btree_node_move_keys(self, right, 0, child, mid, right->len);
+		ut_btree_node_move_values(self, right, 0, child, mid,
+					  right->len);
+		right->next = child->next;
+		child->next = right;
+		memcpy(ut_btree_node_key(self, parent, index),
+		       ut_btree_node_key(self, right, 0), self->key->size);
+	} else {
+		/*
+		 *     [ . ]              [ . c . ]
+		 *       |        -->       |   |
+		 *  [ a b c d ]        [ a b ] [ d ]
+		 */
+		mid = child->len >> 1;
+		right->len = child->len - mid - 1;
+		ut_btree_node_move_keys(self, right, 0, child, mid + 1,
+					right->len);
+		ut_btree_node_move_children(self, right, 0, child, mid + 1,
+					    right->len + 1);
+		memcpy(ut_btree_node_key(self, parent, index),
+		       ut_btree_node_key(self, child, mid), self->key->size);
+	}
+
+	child->len = mid;
+	ut_btree_node_children(self, parent)[index + 1] = right;
+	parent->len++;
+	return UT_OK;
+}
+
+static void ut_btree_map_merge_children(ut_btree_map_t *self,
+					ut_btree_node_t *parent, size_t index)
+{
+	ut_btree_node_t *left, *right;
+
+	left = ut_btree_node_children(self, parent)[index];
+	right = ut_btree_node_children(self, parent)[index + 1];
+
+	if (left->leaf) {
+		ut_btree_node_move_keys(self, left, left->len, right, 0,
+					right->len);
+		ut_btree_node_move_values(self, left, left->len, right, 0,
+					  right->len);
+		left->len += right->len;
+		left->next = right->next;
+	} else {
+		ut_btree_node_move_keys(self, left, left->len, parent, index,
+					1);
+		ut_btree_node_move_keys(self, left, left->len + 1, right, 0,
+					right->len);
+		ut_btree_node_move_children(self, left, left->len + 1, right, 0,
+					    right->len + 1);
+		left->len += right->len + 1;
+	}
+
+	ut_btree_node_move_keys(self, parent, index, parent, index + 1,
+				parent->len - index - 1);
+	ut_btree_node_move_children(self, parent, index + 1, parent, index + 2,
+				    parent->len - index - 1);
+	parent->len--;
+	free(right);
+}
+
+static void ut_btree_map_borrow_left(ut_btree_map_t *self,
+				     ut_btree_node_t *parent, size_t index)
+{
+	ut_btree_node_t *left, *child;
+
+	left = ut_btree_node_children(self, parent)[index - 1];
+	child = ut_btree_node_children(self, parent)[index];
+
+	ut_btree_node_move_keys(self, child, 1, child, 0, child->len);
+
+	if (child->leaf) {
+		ut_btree_node_move_values(self, child, 1, child, 0, child->len);
+		ut_btree_node_move_keys(self, child, 0, left, left->len - 1, 1);
+		ut_btree_node_move_values(self, child, 0, left, left->len - 1,
+					  1);
+		ut_btree_node_move_keys(self, parent, index - 1, child, 0, 1);
+	} else {
+		ut_btree_node_move_children(self, child, 1, child, 0,
+					    child->len + 1);
+		ut_btree_node_move_keys(self, child, 0, parent, index - 1, 1);
+		ut_btree_node_move_children(self, child, 0, left, left->len, 1);
+		ut_btree_node_move_keys(self, parent, index - 1, left,
+					left->len - 1, 1);
+	}
+
+	left->len--;
+	child->len++;
+}
+
+static void ut_btree_map_borrow_right(ut_btree_map_t *self,
+				      ut_btree_node_t *parent, size_t index)
+{
+	ut_btree_node_t *child, *right;
+
+	child = ut_btree_node_children(self, parent)[index];
+	right = ut_btree_node_children(self, parent)[index + 1];
+
+	if (child->leaf) {
+		ut_btree_node_move_keys(self, child, child->len, right, 0, 1);
+		ut_btree_node_move_values(self, child, child->len, right, 0, 1);
+		ut_btree_node_move_keys(self, right, 0, right, 1,
+					right->len - 1);
+		ut_btree_node_move_values(self, right, 0, right, 1,
+					  right->len - 1);
+		ut_btree_node_move_keys(self, parent, index, right, 0, 1);
+	} else {
+		ut_btree_node_move_keys(self, child, child->len, parent, index,
+					1);
+		ut_btree_node_move_children(self, child, child->len + 1, right,
+					    0, 1);
+		ut_btree_node_move_keys(self, parent, index, right, 0, 1);
+		ut_btree_node_move_keys(self, right, 0, right, 1,
+					right->len - 1);
+		ut_btree_node_move_children(self, right, 0, right, 1,
+					    right->len);
+	}
+
+	right->len--;
+	child->len++;
+}
+
+/*
+ * Makes sure the child at index can lose a key, and returns the index of
+ * the child that now covers its key range.
+ */
+static size_t ut_btree_map_fill_child(ut_btree_map_t *self,
+				      ut_btree_node_t *parent, size_t index)
+{
+	ut_btree_node_t **children = ut_btree_node_children(self, parent);
+	size_t min = ut_btree_node_min(self, children[index]);
+
+	if (index > 0 && children[index - 1]->len > min) {
+		ut_btree_map_borrow_left(self, parent, index);
+		return index;
+	}
+
+	if (index < parent->len && children[index + 1]->len > min) {
+		ut_btree_map_borrow_right(self, parent, index);
+		return index;
+	}
+
+	if (index > 0) {
+		ut_btree_map_merge_children(self, parent, index - 1);
+		return index - 1;
+	}
+
+	ut_btree_map_merge_children(self, parent, index);
+	return index;
+}
+
+/* Replaces the separator equal to key by the new minimum of its subtree. */
+static void ut_btree_map_fix_separator(ut_btree_map_t *self, const void *key)
+{
+	ut_btree_node_t *node = self->root, *child;
+	size_t index;
+	bool found;
+
+	while (!node->leaf) {
+		index = ut_btree_node_search(self, node, key, &found);
+
+		if (found) {
+			child = ut_btree_node_children(self, node)[index + 1];
+			while (!child->leaf)
+				child = ut_btree_node_children(self, child)[0];
+
+			memcpy(ut_btree_node_key(self, node, index),
+			       ut_btree_node_key(self, child, 0),
+			       self->key->size);
+			return;
+		}
+
+		node = ut_btree_node_children(self, node)[index];
+	}
+}
+
+ut_btree_map_t *ut_btree_map_new(const struct ut_type *key,
+				 const struct ut_type *value)
+{
+	ut_btree_map_t *self;
+	size_t order;
+
+	if (!key || !key->size || !value)
+		return NULL;
+
+	self = malloc(UT_BTREE_SCRATCH + key->size + value->size);
+	if (!self)
+		return NULL;
+
+	order = UT_BTREE_NODE_BYTES / key->size;
+	if (order < UT_BTREE_MIN_ORDER)
+		order = UT_BTREE_MIN_ORDER;
+	if (order > UT_BTREE_MAX_ORDER)
+		order = UT_BTREE_MAX_ORDER;
+
+	self->root = NULL;
+	self->head = NULL;
+	self->len = 0;
+	self->order = order;
+	self->offset = UT_MEM_ALIGN(UT_BTREE_KEYS + order * key->size);
+	self->scratch = (uint8_t *)self + UT_BTREE_SCRATCH;
+	self->key = key;
+	self->value = value;
+	return self;
+}
+
+void ut_btree_map_delete(ut_btree_map_t *self)
+{
+	ut_btree_map_clear(self);
+	free(self);
+}
+
+void ut_btree_map_clear(ut_btree_map_t *self)
+{
+	if (!self->root)
+		return;
+
+	ut_btree_node_delete(self, self->root);
+	self->root = NULL;
+	self->head = NULL;
+	self->len = 0;
+}
+
+int ut_btree_map_insert(ut_btree_map_t *self, const void *key,
+			const void *value)
+{
+	ut_btree_node_t *node, *root, *child;
+	void *sep, *old_value;
+	size_t index;
+	bool found;
+
+	if (!key || !value)
+		return UT_EINVAL;
+
+	if (!self->root) {
+		self->root = ut_btree_node_new(self, true);
+		if (!self->root)
+			return UT_ENOMEM;
+		self->head = self->root;
+	}
+
+	/* Split full nodes on the way down, so a split never propagates up. */
+	if (self->root->len == self->order) {
+		root = ut_btree_node_new(self, false);
+		if (!root)
+			return UT_ENOMEM;
+
+		ut_btree_node_children(self, root)[0] = self->root;
+		if (ut_btree_map_split_child(self, root, 0)) {
+			free(root);
+			return UT_ENOMEM;
+		}
+		self->root = root;
+	}
+
+	node = self->root;
+
+	while (!node->leaf) {
+		index = ut_btree_node_child_index(self, node, key);
+		child = ut_btree_node_children(self, node)[index];
+
+		if (child->len == self->order) {
+			if (ut_btree_map_split_child(self, node, index))
+				return UT_ENOMEM;
+
+			sep = ut_btree_node_key(self, node, index);
+			if (self->key->compare(key, sep) >= 0)
+				index++;
+		}
+
+		node = ut_btree_node_children(self, node)[index];
+	}
+
+	index = ut_btree_node_search(self, node, key, &found);
+
+	if (found) {
+		old_value = ut_btree_node_value(self, node, index);
+		if (self->value->drop)
+			self->value->drop(old_value);
+		memcpy(old_value, value, self->value->size);
+		return UT_OK;
+	}
+
+	ut_btree_node_move_keys(self, node, index + 1, node, index,
+				node->len - index);
+	ut_btree_node_move_values(self, node, index + 1, node, index,
+				  node->len - index);
+	memcpy(ut_btree_node_key(self, node, index), key, self->key->size);
+	memcpy(ut_btree_node_value(self, node, index), value,
+	       self->value->size);
+	node->len++;
+	self->len++;
+	return UT_OK;
+}
+
+void ut_btree_map_remove(ut_btree_map_t *self, const void *key)
+{
+	ut_btree_node_t *node, *root, *child;
+	void *old_key, *old_value;
+	size_t index;
+	bool found;
+
+	if (!key || !self->root)
+		return;
+
+	/* Fill thin nodes on the way down, so a leaf never underflows. */
+	node = self->root;
+
+	while (!node->leaf) {
+		index = ut_btree_node_child_index(self, node, key);
+		child = ut_btree_node_children(self, node)[index];
+
+		if (child->len <= ut_btree_node_min(self, child))
+			index = ut_btree_map_fill_child(self, node, index);
+
+		node = ut_btree_node_children(self, node)[index];
+	}
+
+	index = ut_btree_node_search(self, node, key, &found);
+
+	if (found) {
+		old_key = self->scratch;
+		old_value = (uint8_t *)self->scratch + self->key->size;
+		memcpy(old_key, ut_btree_node_key(self, node, index),
+		       self->key->size);
+		memcpy(old_value, ut_btree_node_value(self, node, index),
+		       self->value->size);
+
+		ut_btree_node_move_keys(self, node, index, node, index + 1,
+					node->len - index - 1);
+		ut_btree_node_move_values(self, node, index, node, index + 1,
+					  node->len - index - 1);
+		node->len--;
+		self->len--;
+
+		if (index == 0 && node->len)
+			ut_btree_map_fix_separator(self, old_key);
+
+		if (self->key->drop)
+			self->key->drop(old_key);
+		if (self->value->drop)
+			self->value->drop(old_value);
+	}
+
+	root = self->root;
+
+	if (!root->leaf && !root->len) {
+		self->root = ut_btree_node_children(self, root)[0];
+		free(root);
+	} else if (root->leaf && !root->len) {
+		self->root = NULL;
+		self->head = NULL;
+		free(root);
+	}
+}
+
+void *ut_btree_map_get(ut_btree_map_t *self, const void *key)
+{
+	return ut_btree_map_get_key_value(self, key).value;
+}
+
+struct ut_pair ut_btree_map_get_key_value(ut_btree_map_t *self,
+					  const void *key)
+{
+	ut_btree_node_t *node;
+	size_t index;
+	bool found;
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key || !self->root)
+		return kv;
+
+	node = self->root;
+
+	while (!node->leaf) {
+		index = ut_btree_node_child_index(self, node, key);
+		node = ut_btree_node_children(self, node)[index];
+	}
+
+	index = ut_btree_node_search(self, node, key, &found);
+
+	if (found) {
+		kv.key = ut_btree_node_key(self, node, index);
+		kv.value = ut_btree_node_value(self, node, index);
+	}
+
+	return kv;
+}
+
+size_t ut_btree_map_length(const ut_btree_map_t *self)
+{
+	return self->len;
+}
+
+bool ut_btree_map_is_empty(const ut_btree_map_t *self)
+{
+	return self->len == 0;
+}
+
+static void *ut_btree_map_iter_next(struct __ut_btree_map_iter *self)
+{
+	while (self->curr && self->index >= self->curr->len) {
+		self->curr = self->curr->next;
+		self->index = 0;
+	}
+
+	if (!self->curr)
+		return NULL;
+
+	self->kv.key = ut_btree_node_key(self->map, self->curr, self->index);
+	self->kv.value =
+		ut_btree_node_value(self->map, self->curr, self->index);
+	self->index++;
+	return &self->kv;
+}
+
+struct ut_iter *ut_btree_map_iter_new(ut_btree_map_t *map)
+{
+	struct __ut_btree_map_iter *self;
+
+	if (!map)
+		return NULL;
+
+	self = malloc(sizeof(struct __ut_btree_map_iter));
+	if (!self)
+		return NULL;
+
+	self->base.next = (void *)&ut_btree_map_iter_next;
+	self->map = map;
+	self->curr = map->head;
+	self->index = 0;
+	return (struct ut_iter *)self;
+}
+
+void ut_btree_map_iter_delete(struct ut_iter *self)
+{
+	free(self);
+}
@@ -1,6 +1,7 @@
 #include "ut_deque.h"
 #include "ut_array.h"
 #include "ut_errno.h"
+#include "ut_mem.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,8 +31,8 @@ static inline void *ut_array_index(ut_array_t *self, size_t index)
 static inline void ut_array_move(ut_array_t *self, size_t n, size_t from,
 				 size_t to)
 {
-	memcpy(ut_array_index(self, to), ut_array_index(self, from),
-	       n * self->element->size);
+	ut_memmove(ut_array_index(self, to), ut_array_index(self, from),
+		   n * self->element->size);
 }
 
 static inline void *ut_deque_index(ut_deque_t *self, size_t index)
@@ -53,6 +54,61 @@ static inline void ut_deque_head_add(ut_deque_t *self)
 	self->head %= self->buf.cap;
 }
 
+/*
+ * Moves the n elements from logical index from to logical index to, which
+ * may overlap and wrap around. Each step moves the longest run where
+ * neither side wraps, going from the back when moving up.
+ */
+static void ut_deque_shift(ut_deque_t *self, size_t from, size_t to,
+			   size_t n)
+{
+	size_t cap = self->buf.cap, src, dst, run;
+
+	if (from < to) {
+		while (n) {
+			src = (self->head + from + n - 1) % cap + 1;
+			dst = (self->head + to + n - 1) % cap + 1;
+			run = n < src ? n : src;
+			run = run < dst ? run : dst;
+			ut_array_move(&self->buf, run, src - run, dst - run);
+			n -= run;
+		}
+	} else if (from > to) {
+		while (n) {
+			src = (self->head + from) % cap;
+			dst = (self->head + to) % cap;
+			run = n < cap - src ? n : cap - src;
+			run = run < cap - dst ? run : cap - dst;
+			ut_array_move(&self->buf, run, src, dst);
+			from += run;
+			to += run;
+			n -= run;
+		}
+	}
+}
+
+/* Copies the n elements at data to logical index at, in up to two runs. */
+static void ut_deque_copy_in(ut_deque_t *self, size_t at, const void *data,
+			     size_t n)
+{
+	size_t size = self->buf.element->size, pos, run;
+
+	pos = (self->head + at) % self->buf.cap;
+	run = n < self->buf.cap - pos ? n : self->buf.cap - pos;
+	memcpy(ut_array_index(&self->buf, pos), data, run * size);
+	memcpy(self->buf.ptr, (const uint8_t *)data + run * size,
+	       (n - run) * size);
+}
+
+static void ut_deque_drop_range(ut_deque_t *self, size_t index, size_t n)
+{
+	if (!self->buf.element->drop)
+		return;
+
+	for (; n; n--, index++)
+		self->buf.element->drop(ut_deque_index(self, index));
+}
+
 ut_deque_t *ut_deque_new(const struct ut_type *element)
 {
 	ut_deque_t *self;
@@ -268,6 +324,92 @@ void ut_deque_remove(ut_deque_t *self, size_t index)
 	self->buf.len--;
 }
 
+int ut_deque_extend(ut_deque_t *self, const void *data, size_t n)
+{
+	return ut_deque_insert_range(self, self->buf.len, data, n);
+}
+
+int ut_deque_extend_front(ut_deque_t *self, const void *data, size_t n)
+{
+	return ut_deque_insert_range(self, 0, data, n);
+}
+
+/*
+ * Makes room by moving whichever side of index is shorter, the front one
+ * down together with the head or the back one up.
+ */
+int ut_deque_insert_range(ut_deque_t *self, size_t index, const void *data,
+			  size_t n)
+{
+	if (!data && n)
+		return UT_EINVAL;
+
+	if (index > self->buf.len)
+		return UT_ERANGE;
+
+	if (!n)
+		return UT_OK;
+
+	if (ut_deque_reserve(self, n))
+		return UT_ENOMEM;
+
+	if (index < self->buf.len - index) {
+		self->head = (self->head + self->buf.cap - n) % self->buf.cap;
+		ut_deque_shift(self, n, 0, index);
+	} else {
+		ut_deque_shift(self, index, index + n, self->buf.len - index);
+	}
+
+	ut_deque_copy_in(self, index, data, n);
+	self->buf.len += n;
+	return UT_OK;
+}
+
+/* Closes the gap by moving whichever side of it is shorter. */
+void ut_deque_remove_range(ut_deque_t *self, size_t index, size_t n)
+{
+	size_t tail;
+
+	if (index >= self->buf.len)
+		return;
+
+	if (n > self->buf.len - index)
+		n = self->buf.len - index;
+
+	ut_deque_drop_range(self, index, n);
+	tail = self->buf.len - index - n;
+	if (index < tail) {
+		ut_deque_shift(self, 0, n, index);
+		self->head = (self->head + n) % self->buf.cap;
+	} else {
+		ut_deque_shift(self, index + n, index, tail);
+	}
+
+	self->buf.len -= n;
+}
+
+void ut_deque_truncate(ut_deque_t *self, size_t len)
+{
+	if (len >= self->buf.len)
+		return;
+
+	ut_deque_drop_range(self, len, self->buf.len - len);
+	self->buf.len = len;
+}
+
+void ut_deque_truncate_front(ut_deque_t *self, size_t len)
+{
+	size_t n;
+
+	if (len >= self->buf.len)
+		return;
+
+	n = self->buf.len - len;
+	ut_deque_drop_range(self, 0, n);
+	self->head = (self->head + n) % self->buf.cap;
+	self->buf.len = len;
+}
+
 void *ut_deque_get(ut_deque_t *self, size_t index)
 {
 	if (index >= self->buf.len)
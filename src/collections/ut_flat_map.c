@@ -0,0 +1,665 @@
+#include "ut_flat_map.h"
+#include "ut_array.h"
+#include "ut_errno.h"
+#include "ut_mem.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The longest the unsorted tail gets before it is merged. Lookups scan it
+ * linearly, so it stays short.
+ */
+#define UT_FLAT_MAP_TAIL 32
+
+/*
+ * Keys and values are stored in arrays whose element types have no drop,
+ * the map drops them itself, so that moving them around never does. The
+ * first sorted entries are in order, the rest is the tail. Keys in the tail
+ * are unique and not in the sorted part.
+ */
+struct __ut_flat_map {
+	ut_array_t *keys;
+	ut_array_t *values;
+	size_t sorted;
+	uint8_t *scratch;
+	struct ut_type raw_key;
+	struct ut_type raw_value;
+	const struct ut_type *key;
+	const struct ut_type *value;
+};
+
+struct __ut_flat_map_iter {
+	struct ut_iter base;
+	ut_flat_map_t *map;
+	size_t curr;
+	size_t end;
+	bool rev;
+	struct ut_pair kv;
+};
+
+static inline uint8_t *ut_flat_map_key_at(ut_flat_map_t *self, size_t index)
+{
+	return (uint8_t *)ut_array_get(self->keys, 0) +
+	       index * self->key->size;
+}
+
+static inline uint8_t *ut_flat_map_value_at(ut_flat_map_t *self,
+					    size_t index)
+{
+	return (uint8_t *)ut_array_get(self->values, 0) +
+	       index * self->value->size;
+}
+
+static struct ut_pair ut_flat_map_pair(ut_flat_map_t *self, size_t index)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (index < ut_array_length(self->keys)) {
+		kv.key = ut_flat_map_key_at(self, index);
+		kv.value = ut_flat_map_value_at(self, index);
+	}
+
+	return kv;
+}
+
+static void ut_flat_map_drop_at(ut_flat_map_t *self, size_t index)
+{
+	if (self->key->drop)
+		self->key->drop(ut_flat_map_key_at(self, index));
+
+	if (self->value->drop)
+		self->value->drop(ut_flat_map_value_at(self, index));
+}
+
+static void ut_flat_map_update(ut_flat_map_t *self, void *dst,
+			       const void *value)
+{
+	if (self->value->drop)
+		self->value->drop(dst);
+
+	memcpy(dst, value, self->value->size);
+}
+
+/*
+ * The number of sorted keys less than (or equal to) key. The loop only
+ * chooses between two offsets, so it compiles to a conditional move rather
+ * than a branch the predictor has to guess.
+ */
+static size_t ut_flat_map_search(ut_flat_map_t *self, const void *key,
+				 bool equal)
+{
+	const uint8_t *keys, *base;
+	size_t n = self->sorted, half, size = self->key->size;
+	int limit = equal ? 0 : -1;
+
+	if (!n)
+		return 0;
+
+	keys = base = ut_flat_map_key_at(self, 0);
+
+	while (n > 1) {
+		half = n >> 1;
+		base += (self->key->compare(base + half * size, key) <= limit) *
+			half * size;
+		n -= half;
+	}
+
+	return (base - keys) / size +
+	       (self->key->compare(base, key) <= limit);
+}
+
+/* The index of key, in the sorted part or in the tail, or the length. */
+static size_t ut_flat_map_find(ut_flat_map_t *self, const void *key)
+{
+	size_t i, len = ut_array_length(self->keys);
+
+	i = ut_flat_map_search(self, key, false);
+	if (i < self->sorted &&
+	    self->key->compare(ut_flat_map_key_at(self, i), key) == 0)
+		return i;
+
+	for (i = self->sorted; i < len; i++) {
+		if (self->key->compare(ut_flat_map_key_at(self, i), key) == 0)
+			return i;
+	}
+
+	return len;
+}
+
+static inline void ut_flat_map_copy(ut_flat_map_t *self, uint8_t *dk,
+				    uint8_t *dv, size_t to, const uint8_t *sk,
+				    const uint8_t *sv, size_t from)
+{
+	size_t ks = self->key->size, vs = self->value->size;
+
+	memcpy(dk + to * ks, sk + from * ks, ks);
+	memcpy(dv + to * vs, sv + from * vs, vs);
+}
+
+/*
+ * Sorts the n entries at keys and values stably. tk and tv have room for
+ * n entries each and hold the result.
+ */
+static void ut_flat_map_sort(ut_flat_map_t *self, uint8_t *keys,
+			     uint8_t *values, size_t n, uint8_t *tk,
+			     uint8_t *tv)
+{
+	uint8_t *sk = keys, *sv = values, *dk = tk, *dv = tv, *tmp;
+	size_t ks = self->key->size, width, lo, mid, hi, i, j, w;
+
+	for (width = 1; width < n; width <<= 1) {
+		for (lo = 0; lo < n; lo += width << 1) {
+			mid = lo + width < n ? lo + width : n;
+			hi = mid + width < n ? mid + width : n;
+
+			for (i = lo, j = mid, w = lo; w < hi; w++) {
+				if (j >= hi ||
+				    (i < mid &&
+				     self->key->compare(sk + i * ks,
+							sk + j * ks) <= 0))
+					ut_flat_map_copy(self, dk, dv, w, sk,
+							 sv, i++);
+				else
+					ut_flat_map_copy(self, dk, dv, w, sk,
+							 sv, j++);
+			}
+		}
+
+		tmp = sk, sk = dk, dk = tmp;
+		tmp = sv, sv = dv, dv = tmp;
+	}
+
+	if (sk != tk) {
+		memcpy(tk, sk, n * ks);
+		memcpy(tv, sv, n * self->value->size);
+	}
+}
+
+/*
+ * Sorts the tail into tk and tv, then merges it into the sorted part from
+ * the back, so that every entry moves at most once.
+ */
+static void ut_flat_map_merge(ut_flat_map_t *self, uint8_t *tk, uint8_t *tv)
+{
+	uint8_t *keys, *values;
+	size_t ks = self->key->size, vs = self->value->size;
+	size_t len = ut_array_length(self->keys), n, m, i, j, w;
+	int cmp;
+
+	n = len - self->sorted;
+	if (!n)
+		return;
+
+	keys = ut_flat_map_key_at(self, 0);
+	values = ut_flat_map_value_at(self, 0);
+	ut_flat_map_sort(self, keys + self->sorted * ks,
+			 values + self->sorted * vs, n, tk, tv);
+
+	/* A repeated key keeps its last value. */
+	for (i = 1, m = 1; i < n; i++) {
+		if (self->key->compare(tk + (m - 1) * ks, tk + i * ks) == 0) {
+			if (self->key->drop)
+				self->key->drop(tk + (m - 1) * ks);
+			if (self->value->drop)
+				self->value->drop(tv + (m - 1) * vs);
+			m--;
+		}
+		ut_flat_map_copy(self, tk, tv, m++, tk, tv, i);
+	}
+
+	i = self->sorted;
+	j = m;
+	w = self->sorted + m;
+
+	while (j) {
+		cmp = i ? self->key->compare(keys + (i - 1) * ks,
+					     tk + (j - 1) * ks) :
+			  -1;
+
+		if (cmp > 0) {
+			i--;
+			ut_flat_map_copy(self, keys, values, --w, keys, values,
+					 i);
+		} else if (cmp == 0) {
+			/* The sorted key stays, with the new value. */
+			i--;
+			j--;
+			if (self->key->drop)
+				self->key->drop(tk + j * ks);
+			ut_flat_map_update(self, values + i * vs, tv + j * vs);
+			ut_flat_map_copy(self, keys, values, --w, keys, values,
+					 i);
+		} else {
+			j--;
+			ut_flat_map_copy(self, keys, values, --w, tk, tv, j);
+		}
+	}
+
+	/* Keys that were already there left a gap after the untouched part. */
+	if (w > i) {
+		ut_memmove(keys + i * ks, keys + w * ks,
+			   (self->sorted + m - w) * ks);
+		ut_memmove(values + i * vs, values + w * vs,
+			   (self->sorted + m - w) * vs);
+	}
+
+	self->sorted = i + self->sorted + m - w;
+	while (ut_array_length(self->keys) > self->sorted) {
+		ut_array_pop(self->keys);
+		ut_array_pop(self->values);
+	}
+}
+
+/* Brings the whole map in order, for the calls that need positions. */
+static void ut_flat_map_flush(ut_flat_map_t *self)
+{
+	ut_flat_map_merge(self, self->scratch,
+			  self->scratch + UT_FLAT_MAP_TAIL * self->key->size);
+}
+
+/* Removes the entry at index, which is already dropped. */
+static void ut_flat_map_erase(ut_flat_map_t *self, size_t index)
+{
+	size_t last = ut_array_length(self->keys) - 1;
+
+	if (index < self->sorted) {
+		ut_array_remove(self->keys, index);
+		ut_array_remove(self->values, index);
+		self->sorted--;
+		return;
+	}
+
+	/* The tail has no order, the last entry takes the place. */
+	if (index != last) {
+		ut_flat_map_copy(self, ut_flat_map_key_at(self, 0),
+				 ut_flat_map_value_at(self, 0), index,
+				 ut_flat_map_key_at(self, 0),
+				 ut_flat_map_value_at(self, 0), last);
+	}
+
+	ut_array_pop(self->keys);
+	ut_array_pop(self->values);
+}
+
+ut_flat_map_t *ut_flat_map_new(const struct ut_type *key,
+			       const struct ut_type *value)
+{
+	ut_flat_map_t *self;
+
+	if (!key || !key->size || !value || !value->size)
+		return NULL;
+
+	self = malloc(sizeof(ut_flat_map_t));
+	if (!self)
+		return NULL;
+
+	self->raw_key = *key;
+	self->raw_key.drop = NULL;
+	self->raw_value = *value;
+	self->raw_value.drop = NULL;
+	self->key = key;
+	self->value = value;
+	self->sorted = 0;
+
+	self->keys = ut_array_new(&self->raw_key);
+	self->values = ut_array_new(&self->raw_value);
+	self->scratch = malloc(UT_FLAT_MAP_TAIL * (key->size + value->size));
+
+	if (!self->keys || !self->values || !self->scratch) {
+		if (self->keys)
+			ut_array_delete(self->keys);
+		if (self->values)
+			ut_array_delete(self->values);
+		free(self->scratch);
+		free(self);
+		return NULL;
+	}
+
+	return self;
+}
+
+ut_flat_map_t *ut_flat_map_from_sorted(const struct ut_type *key,
+				       const struct ut_type *value,
+				       const void *keys, const void *values,
+				       size_t n)
+{
+	ut_flat_map_t *self;
+	size_t i;
+
+	if (!key || !key->size || !value || (n && (!keys || !values)))
+		return NULL;
+
+	for (i = 1; i < n; i++) {
+		if (key->compare((uint8_t *)keys + (i - 1) * key->size,
+				 (uint8_t *)keys + i * key->size) >= 0)
+			return NULL;
+	}
+
+	self = ut_flat_map_new(key, value);
+	if (!self || !n)
+		return self;
+
+	if (ut_array_reserve(self->keys, n) ||
+	    ut_array_reserve(self->values, n)) {
+		ut_flat_map_delete(self);
+		return NULL;
+	}
+
+	for (i = 0; i < n; i++) {
+		ut_array_push(self->keys, (uint8_t *)keys + i * key->size);
+		ut_array_push(self->values,
+			      (uint8_t *)values + i * value->size);
+	}
+
+	self->sorted = n;
+	return self;
+}
+
+void ut_flat_map_delete(ut_flat_map_t *self)
+{
+	ut_flat_map_clear(self);
+	ut_array_delete(self->keys);
+	ut_array_delete(self->values);
+	free(self->scratch);
+	free(self);
+}
+
+void ut_flat_map_clear(ut_flat_map_t *self)
+{
+	size_t i, len = ut_array_length(self->keys);
+
+	if (self->key->drop || self->value->drop) {
+		for (i = 0; i < len; i++)
+			ut_flat_map_drop_at(self, i);
+	}
+
+	ut_array_clear(self->keys);
+	ut_array_clear(self->values);
+	self->sorted = 0;
+}
+
+int ut_flat_map_insert(ut_flat_map_t *self, const void *key,
+		       const void *value)
+{
+	size_t i, len = ut_array_length(self->keys);
+
+	if (!key || !value)
+		return UT_EINVAL;
+
+	i = ut_flat_map_find(self, key);
+	if (i < len) {
+		ut_flat_map_update(self, ut_flat_map_value_at(self, i), value);
+		return UT_OK;
+	}
+
+	if (ut_array_push(self->keys, key))
+		return UT_ENOMEM;
+
+	if (ut_array_push(self->values, value)) {
+		ut_array_pop(self->keys);
+		return UT_ENOMEM;
+	}
+
+	if (len + 1 - self->sorted >= UT_FLAT_MAP_TAIL)
+		ut_flat_map_flush(self);
+
+	return UT_OK;
+}
+
+int ut_flat_map_insert_many(ut_flat_map_t *self, const void *keys,
+			    const void *values, size_t n)
+{
+	size_t i, tail, ks = self->key->size, vs = self->value->size;
+	uint8_t *scratch;
+
+	if (!n)
+		return UT_OK;
+
+	if (!keys || !values)
+		return UT_EINVAL;
+
+	/* Everything that can fail happens before the map changes. */
+	tail = ut_array_length(self->keys) - self->sorted + n;
+	scratch = tail <= UT_FLAT_MAP_TAIL ? self->scratch :
+					     malloc(tail * (ks + vs));
+	if (!scratch)
+		return UT_ENOMEM;
+
+	if (ut_array_reserve(self->keys, n) ||
+	    ut_array_reserve(self->values, n)) {
+		if (scratch != self->scratch)
+			free(scratch);
+		return UT_ENOMEM;
+	}
+
+	for (i = 0; i < n; i++) {
+		ut_array_push(self->keys, (uint8_t *)keys + i * ks);
+		ut_array_push(self->values, (uint8_t *)values + i * vs);
+	}
+
+	ut_flat_map_merge(self, scratch, scratch + tail * ks);
+
+	if (scratch != self->scratch)
+		free(scratch);
+
+	return UT_OK;
+}
+
+void ut_flat_map_remove(ut_flat_map_t *self, const void *key)
+{
+	size_t i;
+
+	if (!key)
+		return;
+
+	i = ut_flat_map_find(self, key);
+	if (i == ut_array_length(self->keys))
+		return;
+
+	ut_flat_map_drop_at(self, i);
+	ut_flat_map_erase(self, i);
+}
+
+void ut_flat_map_pop_first(ut_flat_map_t *self)
+{
+	ut_flat_map_flush(self);
+
+	if (!self->sorted)
+		return;
+
+	ut_flat_map_drop_at(self, 0);
+	ut_flat_map_erase(self, 0);
+}
+
+void ut_flat_map_pop_last(ut_flat_map_t *self)
+{
+	ut_flat_map_flush(self);
+
+	if (!self->sorted)
+		return;
+
+	ut_flat_map_drop_at(self, self->sorted - 1);
+	ut_flat_map_erase(self, self->sorted - 1);
+}
+
+void *ut_flat_map_get(ut_flat_map_t *self, const void *key)
+{
+	return ut_flat_map_get_key_value(self, key).value;
+}
+
+struct ut_pair ut_flat_map_get_key_value(ut_flat_map_t *self,
+					 const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	return ut_flat_map_pair(self, ut_flat_map_find(self, key));
+}
+
+struct ut_pair ut_flat_map_first(ut_flat_map_t *self)
+{
+	ut_flat_map_flush(self);
+	return ut_flat_map_pair(self, 0);
+}
+
+struct ut_pair ut_flat_map_last(ut_flat_map_t *self)
+{
+	ut_flat_map_flush(self);
+	return ut_flat_map_pair(self, self->sorted - 1);
+}
+
+struct ut_pair ut_flat_map_lower_bound(ut_flat_map_t *self, const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	ut_flat_map_flush(self);
+	return ut_flat_map_pair(self, ut_flat_map_search(self, key, false));
+}
+
+struct ut_pair ut_flat_map_upper_bound(ut_flat_map_t *self, const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	ut_flat_map_flush(self);
+	return ut_flat_map_pair(self, ut_flat_map_search(self, key, true));
+}
+
+struct ut_pair ut_flat_map_floor(ut_flat_map_t *self, const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	ut_flat_map_flush(self);
+	return ut_flat_map_pair(self, ut_flat_map_search(self, key, true) - 1);
+}
+
+struct ut_pair ut_flat_map_ceiling(ut_flat_map_t *self, const void *key)
+{
+	return ut_flat_map_lower_bound(self, key);
+}
+
+struct ut_pair ut_flat_map_select(ut_flat_map_t *self, size_t index)
+{
+	ut_flat_map_flush(self);
+	return ut_flat_map_pair(self, index);
+}
+
+size_t ut_flat_map_rank(ut_flat_map_t *self, const void *key)
+{
+	if (!key)
+		return 0;
+
+	ut_flat_map_flush(self);
+	return ut_flat_map_search(self, key, false);
+}
+
+size_t ut_flat_map_count_range(ut_flat_map_t *self, const void *from,
+			       const void *to)
+{
+	size_t begin, end;
+
+	ut_flat_map_flush(self);
+	begin = !from ? 0 : ut_flat_map_search(self, from, false);
+	end = !to ? self->sorted : ut_flat_map_search(self, to, false);
+	return end > begin ? end - begin : 0;
+}
+
+size_t ut_flat_map_length(const ut_flat_map_t *self)
+{
+	return ut_array_length(self->keys);
+}
+
+bool ut_flat_map_is_empty(const ut_flat_map_t *self)
+{
+	return ut_array_is_empty(self->keys);
+}
+
+/* Iterates over [curr, end), or backwards over [end, curr). */
+static void *ut_flat_map_iter_next(struct __ut_flat_map_iter *self)
+{
+	if (self->curr == self->end)
+		return NULL;
+
+	if (self->rev)
+		self->kv = ut_flat_map_pair(self->map, --self->curr);
+	else
+		self->kv = ut_flat_map_pair(self->map, self->curr++);
+
+	return &self->kv;
+}
+
+static struct ut_iter *ut_flat_map_iter_new_between(ut_flat_map_t *map,
+						    size_t begin, size_t end,
+						    bool rev)
+{
+	struct __ut_flat_map_iter *self;
+
+	self = malloc(sizeof(struct __ut_flat_map_iter));
+	if (!self)
+		return NULL;
+
+	self->base.next = (void *)&ut_flat_map_iter_next;
+	self->map = map;
+	self->curr = rev ? end : begin;
+	self->end = rev ? begin : end;
+	self->rev = rev;
+	return (struct ut_iter *)self;
+}
+
+static struct ut_iter *ut_flat_map_range_iter(ut_flat_map_t *map,
+					      const void *from,
+					      const void *to, bool rev)
+{
+	size_t begin, end;
+
+	if (!map)
+		return NULL;
+
+	ut_flat_map_flush(map);
+	begin = !from ? 0 : ut_flat_map_search(map, from, false);
+	end = !to ? map->sorted : ut_flat_map_search(map, to, false);
+
+	/* An empty range, from is not less than to. */
+	if (begin > end)
+		begin = end;
+
+	return ut_flat_map_iter_new_between(map, begin, end, rev);
+}
+
+struct ut_iter *ut_flat_map_iter_new(ut_flat_map_t *map)
+{
+	return ut_flat_map_range_iter(map, NULL, NULL, false);
+}
+
+struct ut_iter *ut_flat_map_rev_iter_new(ut_flat_map_t *map)
+{
+	return ut_flat_map_range_iter(map, NULL, NULL, true);
+}
+
+struct ut_iter *ut_flat_map_range_iter_new(ut_flat_map_t *map,
+					   const void *from, const void *to)
+{
+	return ut_flat_map_range_iter(map, from, to, false);
+}
+
+struct ut_iter *ut_flat_map_range_rev_iter_new(ut_flat_map_t *map,
+					       const void *from,
+					       const void *to)
+{
+	return ut_flat_map_range_iter(map, from, to, true);
+}
+
+void ut_flat_map_iter_delete(struct ut_iter *self)
+{
+	free(self);
+}
@@ -1,7 +1,9 @@
 #include "ut_heap.h"
 #include "ut_array.h"
-#include "ut_memswap.h"
+#include "ut_errno.h"
+#include "ut_mem.h"
 #include <stdlib.h>
+#include <string.h>
 
 struct __ut_array {
 	uint8_t *ptr;
@@ -10,8 +12,30 @@ struct __ut_array {
 	const struct ut_type *element;
 };
 
+/* The size of the cache lines that groups of children are aligned to. */
+#define UT_HEAP_LINE 64
+
+#define UT_HEAP_MAX_ARITY 64
+
+/*
+ * A min heap keeps the same compare and reverses its sign. The children of
+ * i are at arity * i + 1 up to arity * i + arity. The heap allocates the
+ * buffer itself, at offset bytes into block, so that element 1 starts on a
+ * cache line. Every group of children then starts on a line too when
+ * arity times the element size is a multiple of 64 bytes.
+ */
 struct __ut_heap {
 	ut_array_t buf;
+	ut_heap_compare_fn compare;
+	bool min;
+	size_t arity;
+	size_t offset;
+	uint8_t *block;
+};
+
+struct __ut_heap_drain_iter {
+	struct ut_iter base;
+	ut_heap_t *heap;
 };
 
 static inline void *ut_array_index(ut_array_t *self, size_t index)
@@ -19,49 +43,100 @@ static inline void *ut_array_index(ut_array_t *self, size_t index)
 	return self->ptr + index * self->element->size;
 }
 
-static inline int ut_array_do_compare(ut_array_t *self, size_t a, size_t b)
-{
-	return self->element->compare(ut_array_index(self, a),
-				      ut_array_index(self, b));
-}
-
 static inline void ut_array_do_swap(ut_array_t *self, size_t a, size_t b)
 {
 	ut_memswap(ut_array_index(self, a), ut_array_index(self, b),
 		   self->element->size);
 }
 
-static void ut_array_sift_down(ut_array_t *self, size_t i)
+/* Whether a belongs above b. */
+static inline bool ut_heap_above(ut_heap_t *self, const void *a,
+				 const void *b)
 {
-	size_t l, r, m;
+	int cmp = self->compare(a, b);
 
-	while (i * 2 + 1 < self->len) {
-		l = i * 2 + 1;
-		r = i * 2 + 2;
-		m = i;
+	return self->min ? cmp < 0 : cmp > 0;
+}
 
-		if (ut_array_do_compare(self, l, m) > 0)
-			m = l;
+static inline bool ut_heap_above_at(ut_heap_t *self, size_t a, size_t b)
+{
+	return ut_heap_above(self, ut_array_index(&self->buf, a),
+			     ut_array_index(&self->buf, b));
+}
+
+/*
+ * Picks the top of each group of children with a select instead of a
+ * branch, then compares it against i once.
+ */
+static void ut_heap_sift_down(ut_heap_t *self, size_t i)
+{
+	size_t c, end, j, m, len = self->buf.len, d = self->arity;
 
-		if (r < self->len) {
-			if (ut_array_do_compare(self, r, m) > 0)
-				m = r;
-		}
+	while ((c = i * d + 1) < len) {
+		end = c + d < len ? c + d : len;
 
-		if (m != i) {
-			ut_array_do_swap(self, m, i);
-			i = m;
-		} else {
+		for (m = c, j = c + 1; j < end; j++)
+			m = ut_heap_above_at(self, j, m) ? j : m;
+
+		if (!ut_heap_above_at(self, m, i))
 			break;
-		}
+
+		ut_array_do_swap(&self->buf, m, i);
+		i = m;
 	}
 }
 
+static void ut_heap_sift_up(ut_heap_t *self, size_t i)
+{
+	size_t parent;
+
+	while (i > 0) {
+		parent = (i - 1) / self->arity;
+		if (!ut_heap_above_at(self, i, parent))
+			break;
+
+		ut_array_do_swap(&self->buf, i, parent);
+		i = parent;
+	}
+}
+
+/* Floyd's construction, sifting down every parent from the last one. */
+static void ut_heap_heapify(ut_heap_t *self)
+{
+	size_t i;
+
+	if (self->buf.len < 2)
+		return;
+
+	i = (self->buf.len - 2) / self->arity + 1;
+	while (i-- > 0)
+		ut_heap_sift_down(self, i);
+}
+
 ut_heap_t *ut_heap_new(const struct ut_type *element)
+{
+	if (!element)
+		return NULL;
+
+	return ut_heap_new_by(element, element->compare);
+}
+
+ut_heap_t *ut_heap_new_min(const struct ut_type *element)
+{
+	ut_heap_t *self = ut_heap_new(element);
+
+	if (self)
+		self->min = true;
+
+	return self;
+}
+
+ut_heap_t *ut_heap_new_by(const struct ut_type *element,
+			  ut_heap_compare_fn compare)
 {
 	ut_heap_t *self;
 
-	if (!element || !element->size)
+	if (!element || !element->size || !compare)
 		return NULL;
 
 	self = malloc(sizeof(ut_heap_t));
@@ -72,12 +147,33 @@ ut_heap_t *ut_heap_new(const struct ut_type *element)
 	self->buf.cap = 0;
 	self->buf.len = 0;
 	self->buf.element = element;
+	self->compare = compare;
+	self->min = false;
+	self->arity = 2;
+	self->offset = (UT_HEAP_LINE - element->size % UT_HEAP_LINE) %
+		       UT_HEAP_LINE;
+	self->block = NULL;
+	return self;
+}
+
+ut_heap_t *ut_heap_from_array(const struct ut_type *element, const void *data,
+			      size_t n)
+{
+	ut_heap_t *self = ut_heap_new(element);
+
+	if (self && ut_heap_push_many(self, data, n)) {
+		ut_heap_delete(self);
+		return NULL;
+	}
+
 	return self;
 }
 
 void ut_heap_delete(ut_heap_t *self)
 {
-	ut_array_delete(&self->buf);
+	ut_array_clear(&self->buf);
+	free(self->block);
+	free(self);
 }
 
 void ut_heap_clear(ut_heap_t *self)
@@ -85,30 +181,104 @@ void ut_heap_clear(ut_heap_t *self)
 	ut_array_clear(&self->buf);
 }
 
+int ut_heap_set_arity(ut_heap_t *self, size_t arity)
+{
+	if (arity < 2 || arity > UT_HEAP_MAX_ARITY)
+		return UT_EINVAL;
+
+	if (arity != self->arity) {
+		self->arity = arity;
+		ut_heap_heapify(self);
+	}
+
+	return UT_OK;
+}
+
+size_t ut_heap_arity(const ut_heap_t *self)
+{
+	return self->arity;
+}
+
+/*
+ * Grows like ut_array_reserve, but into a block with room to place the
+ * elements at the right offset from a line boundary, which malloc does not
+ * align to.
+ */
 int ut_heap_reserve(ut_heap_t *self, size_t additional)
 {
-	return ut_array_reserve(&self->buf, additional);
+	size_t min_cap, new_cap, size = self->buf.element->size;
+	uint8_t *block, *ptr;
+
+	min_cap = self->buf.len + additional;
+	if (self->buf.cap >= min_cap)
+		return UT_OK;
+
+	new_cap = !self->buf.cap ? 8 : self->buf.cap << 1;
+	while (new_cap < min_cap)
+		new_cap <<= 1;
+
+	block = malloc(new_cap * size + 2 * UT_HEAP_LINE);
+	if (!block)
+		return UT_ENOMEM;
+
+	ptr = block + UT_HEAP_LINE - (uintptr_t)block % UT_HEAP_LINE +
+	      self->offset;
+	if (self->buf.len)
+		memcpy(ptr, self->buf.ptr, self->buf.len * size);
+
+	free(self->block);
+	self->block = block;
+	self->buf.ptr = ptr;
+	self->buf.cap = new_cap;
+	return UT_OK;
 }
 
 int ut_heap_push(ut_heap_t *self, const void *data)
 {
-	size_t i;
 	int e;
 
+	if (!data)
+		return UT_EINVAL;
+
+	e = ut_heap_reserve(self, 1);
+	if (e)
+		return e;
+
 	e = ut_array_push(&self->buf, data);
 	if (e)
 		return e;
 
-	if (self->buf.len > 1) {
-		i = self->buf.len >> 1;
-		for (;;) {
-			ut_array_sift_down(&self->buf, i);
-			if (i-- == 0)
-				break;
-		}
+	ut_heap_sift_up(self, self->buf.len - 1);
+	return UT_OK;
+}
+
+int ut_heap_push_many(ut_heap_t *self, const void *data, size_t n)
+{
+	size_t i, len = self->buf.len;
+	int e;
+
+	if (!n)
+		return UT_OK;
+
+	if (!data)
+		return UT_EINVAL;
+
+	e = ut_heap_reserve(self, n);
+	if (e)
+		return e;
+
+	memcpy(ut_array_index(&self->buf, len), data,
+	       n * self->buf.element->size);
+	self->buf.len += n;
+
+	if (n > len) {
+		ut_heap_heapify(self);
+	} else {
+		for (i = len; i < len + n; i++)
+			ut_heap_sift_up(self, i);
 	}
 
-	return e;
+	return UT_OK;
 }
 
 void ut_heap_pop(ut_heap_t *self)
@@ -119,7 +289,57 @@ void ut_heap_pop(ut_heap_t *self)
 	ut_array_pop(&self->buf);
 
 	if (self->buf.len > 1)
-		ut_array_sift_down(&self->buf, 0);
+		ut_heap_sift_down(self, 0);
+}
+
+bool ut_heap_pop_into(ut_heap_t *self, void *data)
+{
+	if (!self->buf.len)
+		return false;
+
+	memcpy(data, ut_array_index(&self->buf, 0), self->buf.element->size);
+	if (--self->buf.len) {
+		memcpy(ut_array_index(&self->buf, 0),
+		       ut_array_index(&self->buf, self->buf.len),
+		       self->buf.element->size);
+		ut_heap_sift_down(self, 0);
+	}
+
+	return true;
+}
+
+int ut_heap_replace_top(ut_heap_t *self, const void *data)
+{
+	void *top;
+
+	if (!data)
+		return UT_EINVAL;
+
+	if (!self->buf.len)
+		return ut_heap_push(self, data);
+
+	top = ut_array_index(&self->buf, 0);
+	if (self->buf.element->drop)
+		self->buf.element->drop(top);
+
+	memcpy(top, data, self->buf.element->size);
+	ut_heap_sift_down(self, 0);
+	return UT_OK;
+}
+
+void ut_heap_pushpop(ut_heap_t *self, void *data)
+{
+	void *top;
+
+	if (!self->buf.len)
+		return;
+
+	top = ut_array_index(&self->buf, 0);
+	if (!ut_heap_above(self, top, data))
+		return;
+
+	ut_memswap(top, data, self->buf.element->size);
+	ut_heap_sift_down(self, 0);
 }
 
 void *ut_heap_peek(ut_heap_t *self)
@@ -142,6 +362,41 @@ bool ut_heap_is_empty(const ut_heap_t *self)
 	return self->buf.len == 0;
 }
 
+/*
+ * Each top is swapped behind the end of the heap, as in heap sort, so the
+ * elements come out in place without copies or drops.
+ */
+static void *ut_heap_drain_iter_next(struct __ut_heap_drain_iter *self)
+{
+	ut_heap_t *heap = self->heap;
+
+	if (!heap->buf.len)
+		return NULL;
+
+	if (--heap->buf.len) {
+		ut_array_do_swap(&heap->buf, 0, heap->buf.len);
+		ut_heap_sift_down(heap, 0);
+	}
+
+	return ut_array_index(&heap->buf, heap->buf.len);
+}
+
+struct ut_iter *ut_heap_drain_iter_new(ut_heap_t *heap)
+{
+	struct __ut_heap_drain_iter *self;
+
+	if (!heap)
+		return NULL;
+
+	self = malloc(sizeof(struct __ut_heap_drain_iter));
+	if (!self)
+		return NULL;
+
+	self->base.next = (void *)&ut_heap_drain_iter_next;
+	self->heap = heap;
+	return &self->base;
+}
+
 struct ut_iter *ut_heap_iter_new(ut_heap_t *heap)
 {
 	return ut_array_iter_new(&heap->buf);
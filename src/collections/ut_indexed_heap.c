@@ -0,0 +1,350 @@
+#include "ut_indexed_heap.h"
+#include "ut_array.h"
+#include "ut_errno.h"
+#include "ut_mem.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A handle that is not in the heap has this bit set in its pos, the rest is
+ * the next free handle, or UT_INDEXED_HEAP_NONE at the end of the list.
+ */
+#define UT_INDEXED_HEAP_FREE ((size_t)1 << (sizeof(size_t) * 8 - 1))
+#define UT_INDEXED_HEAP_NONE (UT_INDEXED_HEAP_FREE - 1)
+
+/*
+ * handles holds the handle at each position and pos the position of each
+ * handle. The element array has a type without drop, as elements are
+ * dropped by the heap and only moved by the array.
+ */
+struct __ut_indexed_heap {
+	ut_array_t *data;
+	size_t *handles;
+	size_t *pos;
+	size_t cap;
+	size_t slots;
+	size_t free;
+	struct ut_type raw;
+	const struct ut_type *element;
+	ut_heap_compare_fn compare;
+	bool min;
+};
+
+static inline void *ut_indexed_heap_at(ut_indexed_heap_t *self, size_t i)
+{
+	return (uint8_t *)ut_array_get(self->data, 0) + i * self->raw.size;
+}
+
+/* Whether the element at a belongs above the one at b. */
+static inline bool ut_indexed_heap_above(ut_indexed_heap_t *self, size_t a,
+					 size_t b)
+{
+	int cmp = self->compare(ut_indexed_heap_at(self, a),
+				ut_indexed_heap_at(self, b));
+
+	return self->min ? cmp < 0 : cmp > 0;
+}
+
+static inline void ut_indexed_heap_swap(ut_indexed_heap_t *self, size_t a,
+					size_t b)
+{
+	size_t h = self->handles[a];
+
+	ut_memswap(ut_indexed_heap_at(self, a), ut_indexed_heap_at(self, b),
+		   self->raw.size);
+	self->handles[a] = self->handles[b];
+	self->handles[b] = h;
+	self->pos[self->handles[a]] = a;
+	self->pos[h] = b;
+}
+
+/* Returns the position the element ends up at. */
+static size_t ut_indexed_heap_sift_up(ut_indexed_heap_t *self, size_t i)
+{
+	size_t parent;
+
+	while (i > 0) {
+		parent = (i - 1) >> 1;
+		if (!ut_indexed_heap_above(self, i, parent))
+			break;
+
+		ut_indexed_heap_swap(self, i, parent);
+		i = parent;
+	}
+
+	return i;
+}
+
+static void ut_indexed_heap_sift_down(ut_indexed_heap_t *self, size_t i)
+{
+	size_t l, r, m, len = ut_array_length(self->data);
+
+	while (i * 2 + 1 < len) {
+		l = i * 2 + 1;
+		r = i * 2 + 2;
+		m = i;
+
+		if (ut_indexed_heap_above(self, l, m))
+			m = l;
+
+		if (r < len && ut_indexed_heap_above(self, r, m))
+			m = r;
+
+		if (m == i)
+			break;
+
+		ut_indexed_heap_swap(self, m, i);
+		i = m;
+	}
+}
+
+static void ut_indexed_heap_fix(ut_indexed_heap_t *self, size_t i)
+{
+	if (ut_indexed_heap_sift_up(self, i) == i)
+		ut_indexed_heap_sift_down(self, i);
+}
+
+/* Drops the element at i, moves the last one there and frees the handle. */
+static void ut_indexed_heap_erase(ut_indexed_heap_t *self, size_t i)
+{
+	size_t h = self->handles[i];
+	size_t last = ut_array_length(self->data) - 1;
+
+	if (self->element->drop)
+		self->element->drop(ut_indexed_heap_at(self, i));
+
+	if (i != last) {
+		memcpy(ut_indexed_heap_at(self, i),
+		       ut_indexed_heap_at(self, last), self->raw.size);
+		self->handles[i] = self->handles[last];
+		self->pos[self->handles[i]] = i;
+	}
+
+	ut_array_pop(self->data);
+	self->pos[h] = UT_INDEXED_HEAP_FREE | self->free;
+	self->free = h;
+
+	if (i != last)
+		ut_indexed_heap_fix(self, i);
+}
+
+ut_indexed_heap_t *ut_indexed_heap_new(const struct ut_type *element)
+{
+	if (!element)
+		return NULL;
+
+	return ut_indexed_heap_new_by(element, element->compare);
+}
+
+ut_indexed_heap_t *ut_indexed_heap_new_min(const struct ut_type *element)
+{
+	ut_indexed_heap_t *self = ut_indexed_heap_new(element);
+
+	if (self)
+		self->min = true;
+
+	return self;
+}
+
+ut_indexed_heap_t *ut_indexed_heap_new_by(const struct ut_type *element,
+					  ut_heap_compare_fn compare)
+{
+	ut_indexed_heap_t *self;
+
+	if (!element || !element->size || !compare)
+		return NULL;
+
+	self = malloc(sizeof(ut_indexed_heap_t));
+	if (!self)
+		return NULL;
+
+	self->raw = *element;
+	self->raw.drop = NULL;
+	self->data = ut_array_new(&self->raw);
+	if (!self->data) {
+		free(self);
+		return NULL;
+	}
+
+	self->handles = NULL;
+	self->pos = NULL;
+	self->cap = 0;
+	self->slots = 0;
+	self->free = UT_INDEXED_HEAP_NONE;
+	self->element = element;
+	self->compare = compare;
+	self->min = false;
+	return self;
+}
+
+void ut_indexed_heap_delete(ut_indexed_heap_t *self)
+{
+	ut_indexed_heap_clear(self);
+	ut_array_delete(self->data);
+	free(self->handles);
+	free(self->pos);
+	free(self);
+}
+
+void ut_indexed_heap_clear(ut_indexed_heap_t *self)
+{
+	size_t i, len = ut_array_length(self->data);
+
+	if (self->element->drop) {
+		for (i = 0; i < len; i++)
+			self->element->drop(ut_indexed_heap_at(self, i));
+	}
+
+	ut_array_clear(self->data);
+	self->slots = 0;
+	self->free = UT_INDEXED_HEAP_NONE;
+}
+
+int ut_indexed_heap_reserve(ut_indexed_heap_t *self, size_t additional)
+{
+	size_t min_cap, new_cap, *handles, *pos;
+	int e;
+
+	e = ut_array_reserve(self->data, additional);
+	if (e)
+		return e;
+
+	/* Free handles are taken first, new ones only past them. */
+	min_cap = ut_array_length(self->data) + additional;
+	if (min_cap < self->slots)
+		min_cap = self->slots;
+
+	if (self->cap >= min_cap)
+		return UT_OK;
+
+	new_cap = !self->cap ? 8 : self->cap << 1;
+	while (new_cap < min_cap)
+		new_cap <<= 1;
+
+	handles = realloc(self->handles, new_cap * sizeof(size_t));
+	if (!handles)
+		return UT_ENOMEM;
+	self->handles = handles;
+
+	pos = realloc(self->pos, new_cap * sizeof(size_t));
+	if (!pos)
+		return UT_ENOMEM;
+	self->pos = pos;
+
+	self->cap = new_cap;
+	return UT_OK;
+}
+
+int ut_indexed_heap_push(ut_indexed_heap_t *self, const void *data,
+			 size_t *handle)
+{
+	size_t h, i = ut_array_length(self->data);
+	int e;
+
+	if (!data)
+		return UT_EINVAL;
+
+	e = ut_indexed_heap_reserve(self, 1);
+	if (e)
+		return e;
+
+	e = ut_array_push(self->data, data);
+	if (e)
+		return e;
+
+	if (self->free != UT_INDEXED_HEAP_NONE) {
+		h = self->free;
+		self->free = self->pos[h] & ~UT_INDEXED_HEAP_FREE;
+	} else {
+		h = self->slots++;
+	}
+
+	self->handles[i] = h;
+	self->pos[h] = i;
+	ut_indexed_heap_sift_up(self, i);
+
+	if (handle)
+		*handle = h;
+
+	return UT_OK;
+}
+
+void ut_indexed_heap_pop(ut_indexed_heap_t *self)
+{
+	if (!ut_array_is_empty(self->data))
+		ut_indexed_heap_erase(self, 0);
+}
+
+void *ut_indexed_heap_peek(ut_indexed_heap_t *self)
+{
+	return ut_array_first(self->data);
+}
+
+size_t ut_indexed_heap_peek_handle(const ut_indexed_heap_t *self)
+{
+	return ut_array_is_empty(self->data) ? SIZE_MAX : self->handles[0];
+}
+
+bool ut_indexed_heap_contains(const ut_indexed_heap_t *self, size_t handle)
+{
+	return handle < self->slots &&
+	       !(self->pos[handle] & UT_INDEXED_HEAP_FREE);
+}
+
+void *ut_indexed_heap_get(ut_indexed_heap_t *self, size_t handle)
+{
+	if (!ut_indexed_heap_contains(self, handle))
+		return NULL;
+
+	return ut_indexed_heap_at(self, self->pos[handle]);
+}
+
+void ut_indexed_heap_update(ut_indexed_heap_t *self, size_t handle)
+{
+	if (ut_indexed_heap_contains(self, handle))
+		ut_indexed_heap_fix(self, self->pos[handle]);
+}
+
+int ut_indexed_heap_replace(ut_indexed_heap_t *self, size_t handle,
+			    const void *data)
+{
+	void *element;
+
+	if (!data || !ut_indexed_heap_contains(self, handle))
+		return UT_EINVAL;
+
+	element = ut_indexed_heap_at(self, self->pos[handle]);
+	if (self->element->drop)
+		self->element->drop(element);
+
+	memcpy(element, data, self->raw.size);
+	ut_indexed_heap_fix(self, self->pos[handle]);
+	return UT_OK;
+}
+
+void ut_indexed_heap_remove(ut_indexed_heap_t *self, size_t handle)
+{
+	if (ut_indexed_heap_contains(self, handle))
+		ut_indexed_heap_erase(self, self->pos[handle]);
+}
+
+size_t ut_indexed_heap_length(const ut_indexed_heap_t *self)
+{
+	return ut_array_length(self->data);
+}
+
+bool ut_indexed_heap_is_empty(const ut_indexed_heap_t *self)
+{
+	return ut_array_is_empty(self->data);
+}
+
+struct ut_iter *ut_indexed_heap_iter_new(ut_indexed_heap_t *heap)
+{
+	return ut_array_iter_new(heap->data);
+}
+
+void ut_indexed_heap_iter_delete(struct ut_iter *self)
+{
+	ut_array_iter_delete(self);
+}
@@ -0,0 +1,298 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_multi_queue.h"
+#include "ut_errno.h"
+#include "ut_thread.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Heaps are padded to whole cache lines so their locks do not share one. */
+#define UT_MULTI_QUEUE_LINE 64
+
+/*
+ * len mirrors the length of the heap. It is written under the lock but
+ * read without it, to pass over empty heaps without locking them.
+ */
+struct ut_multi_queue_slot {
+	pthread_mutex_t lock;
+	ut_heap_t *heap;
+	size_t len;
+};
+
+union ut_multi_queue_padded {
+	struct ut_multi_queue_slot slot;
+	uint8_t pad[(sizeof(struct ut_multi_queue_slot) +
+		     UT_MULTI_QUEUE_LINE - 1) /
+		    UT_MULTI_QUEUE_LINE * UT_MULTI_QUEUE_LINE];
+};
+
+struct __ut_multi_queue {
+	union ut_multi_queue_padded *slots;
+	size_t count;
+	ut_heap_compare_fn compare;
+	bool min;
+	/* Per thread random state, so that threads pick heaps independently. */
+	struct ut_thread_registry threads;
+	void *block;
+};
+
+static struct ut_thread_record *ut_multi_queue_record(ut_multi_queue_t *self)
+{
+	return ut_thread_registry_get(&self->threads);
+}
+
+/* A random heap index below n, without a division. */
+static size_t ut_multi_queue_random(struct ut_thread_record *rec, size_t n)
+{
+	uint64_t x = ut_thread_random(rec);
+
+	return (size_t)(((x >> 32) * (uint64_t)n) >> 32);
+}
+
+static inline struct ut_multi_queue_slot *
+ut_multi_queue_slot(ut_multi_queue_t *self, size_t i)
+{
+	return &self->slots[i].slot;
+}
+
+static inline size_t ut_multi_queue_slot_len(struct ut_multi_queue_slot *slot)
+{
+	return __atomic_load_n(&slot->len, __ATOMIC_RELAXED);
+}
+
+/* Whether the top of heap a belongs above the top of heap b. */
+static bool ut_multi_queue_above(ut_multi_queue_t *self,
+				 struct ut_multi_queue_slot *a,
+				 struct ut_multi_queue_slot *b)
+{
+	int cmp;
+
+	if (!a->len || !b->len)
+		return a->len;
+
+	cmp = self->compare(ut_heap_peek(a->heap), ut_heap_peek(b->heap));
+	return self->min ? cmp < 0 : cmp > 0;
+}
+
+static void ut_multi_queue_take(struct ut_multi_queue_slot *slot, void *data)
+{
+	ut_heap_pop_into(slot->heap, data);
+	__atomic_store_n(&slot->len, slot->len - 1, __ATOMIC_RELAXED);
+}
+
+static ut_multi_queue_t *ut_multi_queue_new_with(const struct ut_type *element,
+						 size_t queues,
+						 ut_heap_compare_fn compare,
+						 bool min)
+{
+	ut_multi_queue_t *self;
+	struct ut_multi_queue_slot *slot;
+
+	if (!element || !element->size || !compare || !queues)
+		return NULL;
+
+	self = malloc(sizeof(ut_multi_queue_t));
+	if (!self)
+		return NULL;
+
+	/* One slot more leaves room to align the first to a line. */
+	self->block = malloc((queues + 1) *
+			     sizeof(union ut_multi_queue_padded));
+	if (!self->block) {
+		free(self);
+		return NULL;
+	}
+
+	self->slots = (void *)(((uintptr_t)self->block +
+				UT_MULTI_QUEUE_LINE - 1) &
+			       ~(uintptr_t)(UT_MULTI_QUEUE_LINE - 1));
+	self->compare = compare;
+	self->min = min;
+	ut_thread_registry_init(&self->threads,
+				sizeof(struct ut_thread_record));
+
+	for (self->count = 0; self->count < queues; self->count++) {
+		slot = ut_multi_queue_slot(self, self->count);
+		slot->heap = min ? ut_heap_new_min(element) :
+				   ut_heap_new_by(element, compare);
+		if (!slot->heap)
+			break;
+
+		pthread_mutex_init(&slot->lock, NULL);
+		slot->len = 0;
+	}
+
+	if (self->count < queues) {
+		ut_multi_queue_delete(self);
+		return NULL;
+	}
+
+	return self;
+}
+
+ut_multi_queue_t *ut_multi_queue_new(const struct ut_type *element,
+				     size_t queues)
+{
+	if (!element)
+		return NULL;
+
+	return ut_multi_queue_new_with(element, queues, element->compare,
+				       false);
+}
+
+ut_multi_queue_t *ut_multi_queue_new_min(const struct ut_type *element,
+					 size_t queues)
+{
+	if (!element)
+		return NULL;
+
+	return ut_multi_queue_new_with(element, queues, element->compare,
+				       true);
+}
+
+ut_multi_queue_t *ut_multi_queue_new_by(const struct ut_type *element,
+					size_t queues,
+					ut_heap_compare_fn compare)
+{
+	return ut_multi_queue_new_with(element, queues, compare, false);
+}
+
+void ut_multi_queue_delete(ut_multi_queue_t *self)
+{
+	struct ut_multi_queue_slot *slot;
+	size_t i;
+
+	ut_thread_registry_destroy(&self->threads, NULL, NULL);
+
+	for (i = 0; i < self->count; i++) {
+		slot = ut_multi_queue_slot(self, i);
+		pthread_mutex_destroy(&slot->lock);
+		ut_heap_delete(slot->heap);
+	}
+
+	free(self->block);
+	free(self);
+}
+
+int ut_multi_queue_push(ut_multi_queue_t *self, const void *data)
+{
+	struct ut_thread_record *rec;
+	struct ut_multi_queue_slot *slot;
+	int err;
+
+	if (!data)
+		return UT_EINVAL;
+
+	rec = ut_multi_queue_record(self);
+	if (!rec)
+		return UT_ENOMEM;
+
+	/* A locked heap is busy, any other one will do as well. */
+	if (self->count == 1) {
+		slot = ut_multi_queue_slot(self, 0);
+		pthread_mutex_lock(&slot->lock);
+	} else {
+		do {
+			slot = ut_multi_queue_slot(
+				self, ut_multi_queue_random(rec, self->count));
+		} while (pthread_mutex_trylock(&slot->lock));
+	}
+
+	err = ut_heap_push(slot->heap, data);
+	if (!err)
+		__atomic_store_n(&slot->len, slot->len + 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock(&slot->lock);
+	return err;
+}
+
+bool ut_multi_queue_pop(ut_multi_queue_t *self, void *data)
+{
+	struct ut_thread_record *rec;
+	struct ut_multi_queue_slot *a, *b, *slot;
+	size_t i, j, misses = 0;
+
+	rec = ut_multi_queue_record(self);
+	if (!rec || self->count == 1)
+		return ut_multi_queue_pop_strict(self, data);
+
+	for (;;) {
+		i = ut_multi_queue_random(rec, self->count);
+		j = ut_multi_queue_random(rec, self->count - 1);
+		j += j >= i;
+		a = ut_multi_queue_slot(self, i);
+		b = ut_multi_queue_slot(self, j);
+
+		/*
+		 * Few elements spread over many heaps are hard to hit by
+		 * chance, so after as many misses as heaps look at all.
+		 */
+		if (!ut_multi_queue_slot_len(a) &&
+		    !ut_multi_queue_slot_len(b)) {
+			if (++misses < self->count)
+				continue;
+			return ut_multi_queue_pop_strict(self, data);
+		}
+
+		if (pthread_mutex_trylock(&a->lock))
+			continue;
+
+		if (pthread_mutex_trylock(&b->lock)) {
+			pthread_mutex_unlock(&a->lock);
+			continue;
+		}
+
+		if (a->len || b->len) {
+			slot = ut_multi_queue_above(self, b, a) ? b : a;
+			ut_multi_queue_take(slot, data);
+			pthread_mutex_unlock(&b->lock);
+			pthread_mutex_unlock(&a->lock);
+			return true;
+		}
+
+		pthread_mutex_unlock(&b->lock);
+		pthread_mutex_unlock(&a->lock);
+	}
+}
+
+bool ut_multi_queue_pop_strict(ut_multi_queue_t *self, void *data)
+{
+	struct ut_multi_queue_slot *best, *slot;
+	bool found;
+	size_t i;
+
+	/* Always locked in index order, relaxed pops only ever try. */
+	best = ut_multi_queue_slot(self, 0);
+	for (i = 0; i < self->count; i++) {
+		slot = ut_multi_queue_slot(self, i);
+		pthread_mutex_lock(&slot->lock);
+		if (ut_multi_queue_above(self, slot, best))
+			best = slot;
+	}
+
+	found = best->len;
+	if (found)
+		ut_multi_queue_take(best, data);
+
+	for (i = 0; i < self->count; i++)
+		pthread_mutex_unlock(&ut_multi_queue_slot(self, i)->lock);
+
+	return found;
+}
+
+size_t ut_multi_queue_length(const ut_multi_queue_t *self)
+{
+	size_t i, len = 0;
+
+	for (i = 0; i < self->count; i++)
+		len += __atomic_load_n(&self->slots[i].slot.len,
+				       __ATOMIC_RELAXED);
+
+	return len;
+}
+
+bool ut_multi_queue_is_empty(const ut_multi_queue_t *self)
+{
+	return !ut_multi_queue_length(self);
+}
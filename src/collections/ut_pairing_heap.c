@@ -0,0 +1,339 @@
+#include "ut_pairing_heap.h"
+#include "ut_errno.h"
+#include "ut_mem.h"
+#include "ut_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Children are a list through next, headed by child. prev is the left
+ * sibling, or the parent for the first child, and NULL for the root. The
+ * element follows the struct at the alignment malloc would give it.
+ */
+struct ut_pairing_node {
+	struct ut_pairing_node *child;
+	struct ut_pairing_node *next;
+	struct ut_pairing_node *prev;
+};
+
+#define UT_PAIRING_DATA UT_MEM_ALIGN(sizeof(struct ut_pairing_node))
+
+/* A min heap keeps the same compare and reverses its sign. */
+struct __ut_pairing_heap {
+	struct ut_pairing_node *root;
+	size_t len;
+	ut_pool_t *pool;
+	const struct ut_type *element;
+	ut_heap_compare_fn compare;
+	bool min;
+};
+
+static inline void *ut_pairing_data(struct ut_pairing_node *node)
+{
+	return (uint8_t *)node + UT_PAIRING_DATA;
+}
+
+/* Whether the element of a belongs above the element of b. */
+static inline bool ut_pairing_heap_above(ut_pairing_heap_t *self,
+					 struct ut_pairing_node *a,
+					 struct ut_pairing_node *b)
+{
+	int cmp = self->compare(ut_pairing_data(a), ut_pairing_data(b));
+
+	return self->min ? cmp < 0 : cmp > 0;
+}
+
+/* Makes the lower of two roots the first child of the other. */
+static struct ut_pairing_node *ut_pairing_heap_link(ut_pairing_heap_t *self,
+						    struct ut_pairing_node *a,
+						    struct ut_pairing_node *b)
+{
+	struct ut_pairing_node *tmp;
+
+	if (!a)
+		return b;
+
+	if (!b)
+		return a;
+
+	if (ut_pairing_heap_above(self, b, a)) {
+		tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	b->next = a->child;
+	if (a->child)
+		a->child->prev = b;
+	b->prev = a;
+	a->child = b;
+	a->next = NULL;
+	a->prev = NULL;
+	return a;
+}
+
+/*
+ * Links a list of siblings into one tree in two passes: pairs from the
+ * left first, then the pairs into one from the right. The pairs are kept
+ * on a stack through next, which reverses them for the second pass.
+ */
+static struct ut_pairing_node *
+ut_pairing_heap_merge_pairs(ut_pairing_heap_t *self,
+			    struct ut_pairing_node *first)
+{
+	struct ut_pairing_node *pairs = NULL, *a, *b, *rest;
+
+	while (first) {
+		a = first;
+		b = a->next;
+		rest = b ? b->next : NULL;
+		a->next = NULL;
+		if (b)
+			b->next = NULL;
+
+		a = ut_pairing_heap_link(self, a, b);
+		a->next = pairs;
+		pairs = a;
+		first = rest;
+	}
+
+	if (!pairs)
+		return NULL;
+
+	a = pairs;
+	pairs = pairs->next;
+	a->next = NULL;
+	while (pairs) {
+		rest = pairs->next;
+		pairs->next = NULL;
+		a = ut_pairing_heap_link(self, a, pairs);
+		pairs = rest;
+	}
+
+	a->prev = NULL;
+	return a;
+}
+
+/* Takes node and its subtree out of the tree it is in. */
+static void ut_pairing_heap_cut(struct ut_pairing_node *node)
+{
+	if (node->prev->child == node)
+		node->prev->child = node->next;
+	else
+		node->prev->next = node->next;
+
+	if (node->next)
+		node->next->prev = node->prev;
+
+	node->next = NULL;
+	node->prev = NULL;
+}
+
+static void ut_pairing_heap_free(ut_pairing_heap_t *self,
+				 struct ut_pairing_node *node)
+{
+	if (self->element->drop)
+		self->element->drop(ut_pairing_data(node));
+
+	ut_pool_free(self->pool, node);
+}
+
+static ut_pairing_heap_t *
+ut_pairing_heap_new_with(const struct ut_type *element,
+			 ut_heap_compare_fn compare, bool min)
+{
+	ut_pairing_heap_t *self;
+
+	if (!element || !element->size || !compare)
+		return NULL;
+
+	self = malloc(sizeof(ut_pairing_heap_t));
+	if (!self)
+		return NULL;
+
+	self->pool = ut_pool_new(UT_PAIRING_DATA + element->size);
+	if (!self->pool) {
+		free(self);
+		return NULL;
+	}
+
+	self->root = NULL;
+	self->len = 0;
+	self->element = element;
+	self->compare = compare;
+	self->min = min;
+	return self;
+}
+
+ut_pairing_heap_t *ut_pairing_heap_new(const struct ut_type *element)
+{
+	if (!element)
+		return NULL;
+
+	return ut_pairing_heap_new_with(element, element->compare, false);
+}
+
+ut_pairing_heap_t *ut_pairing_heap_new_min(const struct ut_type *element)
+{
+	if (!element)
+		return NULL;
+
+	return ut_pairing_heap_new_with(element, element->compare, true);
+}
+
+ut_pairing_heap_t *ut_pairing_heap_new_by(const struct ut_type *element,
+					  ut_heap_compare_fn compare)
+{
+	return ut_pairing_heap_new_with(element, compare, false);
+}
+
+void ut_pairing_heap_delete(ut_pairing_heap_t *self)
+{
+	ut_pairing_heap_clear(self);
+	ut_pool_delete(self->pool);
+	free(self);
+}
+
+void ut_pairing_heap_clear(ut_pairing_heap_t *self)
+{
+	struct ut_pairing_node *node, *last, *next;
+	bool shared = ut_pool_is_shared(self->pool);
+
+	/* Without drops or other owners, the slabs just go away. */
+	if (!shared && !self->element->drop) {
+		ut_pool_clear(self->pool);
+		self->root = NULL;
+		self->len = 0;
+		return;
+	}
+
+	/* Walks the tree as one list, splicing in children on the way. */
+	for (node = self->root; node; node = next) {
+		if (node->child) {
+			for (last = node->child; last->next; last = last->next)
+				;
+			last->next = node->next;
+			node->next = node->child;
+		}
+
+		next = node->next;
+		if (shared)
+			ut_pairing_heap_free(self, node);
+		else
+			self->element->drop(ut_pairing_data(node));
+	}
+
+	if (!shared)
+		ut_pool_clear(self->pool);
+
+	self->root = NULL;
+	self->len = 0;
+}
+
+int ut_pairing_heap_push(ut_pairing_heap_t *self, const void *data,
+			 struct ut_pairing_node **node)
+{
+	struct ut_pairing_node *new_node;
+
+	if (!data)
+		return UT_EINVAL;
+
+	new_node = ut_pool_alloc(self->pool);
+	if (!new_node)
+		return UT_ENOMEM;
+
+	new_node->child = NULL;
+	new_node->next = NULL;
+	new_node->prev = NULL;
+	memcpy(ut_pairing_data(new_node), data, self->element->size);
+
+	self->root = ut_pairing_heap_link(self, self->root, new_node);
+	self->len++;
+
+	if (node)
+		*node = new_node;
+
+	return UT_OK;
+}
+
+void ut_pairing_heap_pop(ut_pairing_heap_t *self)
+{
+	struct ut_pairing_node *root = self->root;
+
+	if (!root)
+		return;
+
+	self->root = ut_pairing_heap_merge_pairs(self, root->child);
+	ut_pairing_heap_free(self, root);
+	self->len--;
+}
+
+void *ut_pairing_heap_peek(ut_pairing_heap_t *self)
+{
+	return self->root ? ut_pairing_data(self->root) : NULL;
+}
+
+void *ut_pairing_heap_get(struct ut_pairing_node *node)
+{
+	return ut_pairing_data(node);
+}
+
+void ut_pairing_heap_update(ut_pairing_heap_t *self,
+			    struct ut_pairing_node *node)
+{
+	if (node == self->root)
+		return;
+
+	/* Still above its children, so its subtree moves as it is. */
+	ut_pairing_heap_cut(node);
+	self->root = ut_pairing_heap_link(self, self->root, node);
+}
+
+void ut_pairing_heap_remove(ut_pairing_heap_t *self,
+			    struct ut_pairing_node *node)
+{
+	struct ut_pairing_node *sub;
+
+	if (node == self->root) {
+		ut_pairing_heap_pop(self);
+		return;
+	}
+
+	ut_pairing_heap_cut(node);
+	sub = ut_pairing_heap_merge_pairs(self, node->child);
+	self->root = ut_pairing_heap_link(self, self->root, sub);
+	ut_pairing_heap_free(self, node);
+	self->len--;
+}
+
+int ut_pairing_heap_meld(ut_pairing_heap_t *self, ut_pairing_heap_t *other)
+{
+	int err;
+
+	if (self->element != other->element ||
+	    self->compare != other->compare || self->min != other->min)
+		return UT_EINVAL;
+
+	if (self == other)
+		return UT_OK;
+
+	err = ut_pool_merge(self->pool, other->pool);
+	if (err)
+		return err;
+
+	self->root = ut_pairing_heap_link(self, self->root, other->root);
+	self->len += other->len;
+	other->root = NULL;
+	other->len = 0;
+	return UT_OK;
+}
+
+size_t ut_pairing_heap_length(const ut_pairing_heap_t *self)
+{
+	return self->len;
+}
+
+bool ut_pairing_heap_is_empty(const ut_pairing_heap_t *self)
+{
+	return !self->len;
+}
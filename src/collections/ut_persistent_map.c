@@ -0,0 +1,564 @@
+#include "ut_persistent_map.h"
+#include "ut_mem.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* An AVL tree of 2^64 entries is less than 93 levels high. */
+#define UT_PERSISTENT_MAX_HEIGHT 96
+
+/*
+ * A key value pair, shared by all the nodes that path copying makes of it,
+ * so its drops run exactly once.
+ */
+struct ut_persistent_pair {
+	size_t refs;
+};
+
+/* The key follows the pair at the alignment malloc would give it. */
+#define UT_PERSISTENT_KEY UT_MEM_ALIGN(sizeof(struct ut_persistent_pair))
+
+/* Nodes are never changed once another node or version refers to them. */
+struct ut_persistent_node {
+	size_t refs;
+	int height;
+	struct ut_persistent_node *left;
+	struct ut_persistent_node *right;
+	struct ut_persistent_pair *pair;
+};
+
+struct __ut_persistent_map {
+	struct ut_persistent_node *root;
+	size_t len;
+	const struct ut_type *key;
+	const struct ut_type *value;
+};
+
+struct __ut_persistent_map_iter {
+	struct ut_iter base;
+	const ut_persistent_map_t *map;
+	size_t top;
+	struct ut_persistent_node *stack[UT_PERSISTENT_MAX_HEIGHT];
+	struct ut_pair kv;
+};
+
+/* Set when an allocation fails part way through building a new version. */
+struct ut_persistent_ctx {
+	const ut_persistent_map_t *map;
+	bool failed;
+};
+
+static inline void ut_persistent_ref(size_t *refs)
+{
+	__atomic_add_fetch(refs, 1, __ATOMIC_RELAXED);
+}
+
+/* Returns true if this was the last reference. */
+static inline bool ut_persistent_unref(size_t *refs)
+{
+	return __atomic_sub_fetch(refs, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+static inline void *ut_persistent_pair_key(struct ut_persistent_pair *self)
+{
+	return (uint8_t *)self + UT_PERSISTENT_KEY;
+}
+
+static inline void *ut_persistent_pair_value(struct ut_persistent_pair *self,
+					     const ut_persistent_map_t *map)
+{
+	return (uint8_t *)ut_persistent_pair_key(self) + map->key->size;
+}
+
+static struct ut_persistent_pair *
+ut_persistent_pair_new(const ut_persistent_map_t *map, const void *key,
+		       const void *value)
+{
+	struct ut_persistent_pair *self;
+
+	self = malloc(UT_PERSISTENT_KEY + map->key->size + map->value->size);
+	if (!self)
+		return NULL;
+
+	self->refs = 1;
+	memcpy(ut_persistent_pair_key(self), key, map->key->size);
+	memcpy(ut_persistent_pair_value(self, map), value, map->value->size);
+	return self;
+}
+
+static struct ut_persistent_pair *
+ut_persistent_pair_get(struct ut_persistent_pair *self)
+{
+	ut_persistent_ref(&self->refs);
+	return self;
+}
+
+static void ut_persistent_pair_put(struct ut_persistent_pair *self,
+				   const ut_persistent_map_t *map)
+{
+	if (!self || !ut_persistent_unref(&self->refs))
+		return;
+
+	if (map->key->drop)
+		map->key->drop(ut_persistent_pair_key(self));
+
+	if (map->value->drop)
+		map->value->drop(ut_persistent_pair_value(self, map));
+
+	free(self);
+}
+
+static struct ut_persistent_node *
+ut_persistent_node_get(struct ut_persistent_node *self)
+{
+	if (self)
+		ut_persistent_ref(&self->refs);
+
+	return self;
+}
+
+static void ut_persistent_node_put(struct ut_persistent_node *self,
+				   const ut_persistent_map_t *map)
+{
+	struct ut_persistent_node *right;
+
+	/* Only the left spine recurses, the right one is walked in a loop. */
+	while (self && ut_persistent_unref(&self->refs)) {
+		ut_persistent_node_put(self->left, map);
+		ut_persistent_pair_put(self->pair, map);
+		right = self->right;
+		free(self);
+		self = right;
+	}
+}
+
+static inline int ut_persistent_height(const struct ut_persistent_node *self)
+{
+	return !self ? 0 : self->height;
+}
+
+/*
+ * Creates a node from references the caller hands over. If out of memory
+ * the references are released and the failure is recorded in ctx.
+ */
+static struct ut_persistent_node *
+ut_persistent_node_new(struct ut_persistent_ctx *ctx,
+		       struct ut_persistent_pair *pair,
+		       struct ut_persistent_node *left,
+		       struct ut_persistent_node *right)
+{
+	struct ut_persistent_node *self;
+	int lh = ut_persistent_height(left);
+	int rh = ut_persistent_height(right);
+
+	self = !pair ? NULL : malloc(sizeof(struct ut_persistent_node));
+	if (!self) {
+		ut_persistent_pair_put(pair, ctx->map);
+		ut_persistent_node_put(left, ctx->map);
+		ut_persistent_node_put(right, ctx->map);
+		ctx->failed = true;
+		return NULL;
+	}
+
+	self->refs = 1;
+	self->height = (lh > rh ? lh : rh) + 1;
+	self->left = left;
+	self->right = right;
+	self->pair = pair;
+	return self;
+}
+
+/*
+ * Creates a node like ut_persistent_node_new, with a single or double
+ * rotation if its subtrees differ in height by two. The rotated nodes are
+ * copied, as they may be shared.
+ *
+ *        p                l                 lr
+ *       / \              / \              /    \
+ *      l   r   -->     ll   p     or     l      p
+ *     / \                  / \          / \    / \
+ *   ll   lr              lr   r       ll  lrl lrr r
+ */
+static struct ut_persistent_node *
+ut_persistent_node_balance(struct ut_persistent_ctx *ctx,
+			   struct ut_persistent_pair *pair,
+			   struct ut_persistent_node *left,
+			   struct ut_persistent_node *right)
+{
+	struct ut_persistent_node *a, *b, *c, *d, *tmp;
+	struct ut_persistent_pair *x, *y;
+	int lh = ut_persistent_height(left);
+	int rh = ut_persistent_height(right);
+
+	if (lh > rh + 1) {
+		if (ut_persistent_height(left->left) >=
+		    ut_persistent_height(left->right)) {
+			a = ut_persistent_node_get(left->left);
+			b = ut_persistent_node_get(left->right);
+			x = ut_persistent_pair_get(left->pair);
+			ut_persistent_node_put(left, ctx->map);
+			return ut_persistent_node_new(
+				ctx, x, a,
+				ut_persistent_node_new(ctx, pair, b, right));
+		}
+
+		tmp = left->right;
+		a = ut_persistent_node_get(left->left);
+		b = ut_persistent_node_get(tmp->left);
+		c = ut_persistent_node_get(tmp->right);
+		x = ut_persistent_pair_get(left->pair);
+		y = ut_persistent_pair_get(tmp->pair);
+		ut_persistent_node_put(left, ctx->map);
+		return ut_persistent_node_new(
+			ctx, y, ut_persistent_node_new(ctx, x, a, b),
+			ut_persistent_node_new(ctx, pair, c, right));
+	}
+
+	if (rh > lh + 1) {
+		if (ut_persistent_height(right->right) >=
+		    ut_persistent_height(right->left)) {
+			d = ut_persistent_node_get(right->right);
+			c = ut_persistent_node_get(right->left);
+			x = ut_persistent_pair_get(right->pair);
+			ut_persistent_node_put(right, ctx->map);
+			return ut_persistent_node_new(
+				ctx, x,
+				ut_persistent_node_new(ctx, pair, left, c), d);
+		}
+
+		tmp = right->left;
+		d = ut_persistent_node_get(right->right);
+		b = ut_persistent_node_get(tmp->left);
+		c = ut_persistent_node_get(tmp->right);
+		x = ut_persistent_pair_get(right->pair);
+		y = ut_persistent_pair_get(tmp->pair);
+		ut_persistent_node_put(right, ctx->map);
+		return ut_persistent_node_new(
+			ctx, y, ut_persistent_node_new(ctx, pair, left, b),
+			ut_persistent_node_new(ctx, x, c, d));
+	}
+
+	return ut_persistent_node_new(ctx, pair, left, right);
+}
+
+/* Returns a copy of node with key mapped to value, added reports a new key. */
+static struct ut_persistent_node *
+ut_persistent_node_insert(struct ut_persistent_ctx *ctx,
+			  struct ut_persistent_node *node, const void *key,
+			  const void *value, bool *added)
+{
+	const ut_persistent_map_t *map = ctx->map;
+	struct ut_persistent_node *left, *right;
+	int cmp;
+
+	if (!node) {
+		*added = true;
+		return ut_persistent_node_new(
+			ctx, ut_persistent_pair_new(map, key, value), NULL,
+			NULL);
+	}
+
+	cmp = map->key->compare(key, ut_persistent_pair_key(node->pair));
+
+	if (cmp == 0) {
+		return ut_persistent_node_new(
+			ctx, ut_persistent_pair_new(map, key, value),
+			ut_persistent_node_get(node->left),
+			ut_persistent_node_get(node->right));
+	}
+
+	if (cmp < 0) {
+		left = ut_persistent_node_insert(ctx, node->left, key, value,
+						 added);
+		right = ut_persistent_node_get(node->right);
+	} else {
+		left = ut_persistent_node_get(node->left);
+		right = ut_persistent_node_insert(ctx, node->right, key, value,
+						  added);
+	}
+
+	return ut_persistent_node_balance(
+		ctx, ut_persistent_pair_get(node->pair), left, right);
+}
+
+/* Returns a copy of node without its first pair, which is handed to min. */
+static struct ut_persistent_node *
+ut_persistent_node_remove_min(struct ut_persistent_ctx *ctx,
+			      struct ut_persistent_node *node,
+			      struct ut_persistent_pair **min)
+{
+	if (!node->left) {
+		*min = ut_persistent_pair_get(node->pair);
+		return ut_persistent_node_get(node->right);
+	}
+
+	return ut_persistent_node_balance(
+		ctx, ut_persistent_pair_get(node->pair),
+		ut_persistent_node_remove_min(ctx, node->left, min),
+		ut_persistent_node_get(node->right));
+}
+
+/* Returns node without key. Nothing is copied if key is not there. */
+static struct ut_persistent_node *
+ut_persistent_node_remove(struct ut_persistent_ctx *ctx,
+			  struct ut_persistent_node *node, const void *key,
+			  bool *removed)
+{
+	const ut_persistent_map_t *map = ctx->map;
+	struct ut_persistent_node *left, *right;
+	struct ut_persistent_pair *min;
+	int cmp;
+
+	if (!node)
+		return NULL;
+
+	cmp = map->key->compare(key, ut_persistent_pair_key(node->pair));
+
+	if (cmp == 0) {
+		*removed = true;
+
+		if (!node->left)
+			return ut_persistent_node_get(node->right);
+		if (!node->right)
+			return ut_persistent_node_get(node->left);
+
+		right = ut_persistent_node_remove_min(ctx, node->right, &min);
+		return ut_persistent_node_balance(
+			ctx, min, ut_persistent_node_get(node->left), right);
+	}
+
+	if (cmp < 0) {
+		left = ut_persistent_node_remove(ctx, node->left, key, removed);
+		if (!*removed) {
+			ut_persistent_node_put(left, map);
+			return ut_persistent_node_get(node);
+		}
+		right = ut_persistent_node_get(node->right);
+	} else {
+		right = ut_persistent_node_remove(ctx, node->right, key,
+						  removed);
+		if (!*removed) {
+			ut_persistent_node_put(right, map);
+			return ut_persistent_node_get(node);
+		}
+		left = ut_persistent_node_get(node->left);
+	}
+
+	return ut_persistent_node_balance(
+		ctx, ut_persistent_pair_get(node->pair), left, right);
+}
+
+static struct ut_persistent_node *
+ut_persistent_map_find(const ut_persistent_map_t *self, const void *key)
+{
+	struct ut_persistent_node *curr = self->root;
+	void *curr_key;
+	int cmp;
+
+	while (curr) {
+		curr_key = ut_persistent_pair_key(curr->pair);
+		cmp = self->key->compare(key, curr_key);
+
+		if (cmp == 0)
+			break;
+
+		curr = cmp < 0 ? curr->left : curr->right;
+	}
+
+	return curr;
+}
+
+static struct ut_pair ut_persistent_map_pair(const ut_persistent_map_t *self,
+					     struct ut_persistent_node *node)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (node) {
+		kv.key = ut_persistent_pair_key(node->pair);
+		kv.value = ut_persistent_pair_value(node->pair, self);
+	}
+
+	return kv;
+}
+
+/* Creates a handle of the version rooted at root, taking over the root. */
+static ut_persistent_map_t *
+ut_persistent_map_wrap(const ut_persistent_map_t *self,
+		       struct ut_persistent_node *root, size_t len)
+{
+	ut_persistent_map_t *version;
+
+	version = malloc(sizeof(ut_persistent_map_t));
+	if (!version) {
+		ut_persistent_node_put(root, self);
+		return NULL;
+	}
+
+	version->root = root;
+	version->len = len;
+	version->key = self->key;
+	version->value = self->value;
+	return version;
+}
+
+ut_persistent_map_t *ut_persistent_map_new(const struct ut_type *key,
+					   const struct ut_type *value)
+{
+	ut_persistent_map_t *self;
+
+	if (!key || !key->size || !value)
+		return NULL;
+
+	self = malloc(sizeof(ut_persistent_map_t));
+	if (!self)
+		return NULL;
+
+	self->root = NULL;
+	self->len = 0;
+	self->key = key;
+	self->value = value;
+	return self;
+}
+
+void ut_persistent_map_delete(ut_persistent_map_t *self)
+{
+	ut_persistent_node_put(self->root, self);
+	free(self);
+}
+
+ut_persistent_map_t *
+ut_persistent_map_snapshot(const ut_persistent_map_t *self)
+{
+	return ut_persistent_map_wrap(self, ut_persistent_node_get(self->root),
+				      self->len);
+}
+
+ut_persistent_map_t *ut_persistent_map_insert(const ut_persistent_map_t *self,
+					      const void *key,
+					      const void *value)
+{
+	struct ut_persistent_ctx ctx = { self, false };
+	struct ut_persistent_node *root;
+	bool added = false;
+
+	if (!key || !value)
+		return NULL;
+
+	root = ut_persistent_node_insert(&ctx, self->root, key, value, &added);
+
+	if (ctx.failed) {
+		ut_persistent_node_put(root, self);
+		return NULL;
+	}
+
+	return ut_persistent_map_wrap(self, root, self->len + added);
+}
+
+ut_persistent_map_t *ut_persistent_map_remove(const ut_persistent_map_t *self,
+					      const void *key)
+{
+	struct ut_persistent_ctx ctx = { self, false };
+	struct ut_persistent_node *root;
+	bool removed = false;
+
+	if (!key)
+		return ut_persistent_map_snapshot(self);
+
+	root = ut_persistent_node_remove(&ctx, self->root, key, &removed);
+
+	if (ctx.failed) {
+		ut_persistent_node_put(root, self);
+		return NULL;
+	}
+
+	return ut_persistent_map_wrap(self, root, self->len - removed);
+}
+
+void *ut_persistent_map_get(const ut_persistent_map_t *self, const void *key)
+{
+	return ut_persistent_map_get_key_value(self, key).value;
+}
+
+struct ut_pair ut_persistent_map_get_key_value(const ut_persistent_map_t *self,
+					       const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	return ut_persistent_map_pair(self, ut_persistent_map_find(self, key));
+}
+
+struct ut_pair ut_persistent_map_first(const ut_persistent_map_t *self)
+{
+	struct ut_persistent_node *curr = self->root;
+
+	while (curr && curr->left)
+		curr = curr->left;
+
+	return ut_persistent_map_pair(self, curr);
+}
+
+struct ut_pair ut_persistent_map_last(const ut_persistent_map_t *self)
+{
+	struct ut_persistent_node *curr = self->root;
+
+	while (curr && curr->right)
+		curr = curr->right;
+
+	return ut_persistent_map_pair(self, curr);
+}
+
+size_t ut_persistent_map_length(const ut_persistent_map_t *self)
+{
+	return self->len;
+}
+
+bool ut_persistent_map_is_empty(const ut_persistent_map_t *self)
+{
+	return self->len == 0;
+}
+
+/* Nodes have no parent pointers, the iterator keeps the path on a stack. */
+static void ut_persistent_map_iter_push(struct __ut_persistent_map_iter *self,
+					struct ut_persistent_node *node)
+{
+	for (; node; node = node->left)
+		self->stack[self->top++] = node;
+}
+
+static void *ut_persistent_map_iter_next(struct __ut_persistent_map_iter *self)
+{
+	struct ut_persistent_node *node;
+
+	if (!self->top)
+		return NULL;
+
+	node = self->stack[--self->top];
+	ut_persistent_map_iter_push(self, node->right);
+	self->kv = ut_persistent_map_pair(self->map, node);
+	return &self->kv;
+}
+
+struct ut_iter *ut_persistent_map_iter_new(const ut_persistent_map_t *map)
+{
+	struct __ut_persistent_map_iter *self;
+
+	if (!map)
+		return NULL;
+
+	self = malloc(sizeof(struct __ut_persistent_map_iter));
+	if (!self)
+		return NULL;
+
+	self->base.next = (void *)&ut_persistent_map_iter_next;
+	self->map = map;
+	self->top = 0;
+	ut_persistent_map_iter_push(self, map->root);
+	return (struct ut_iter *)self;
+}
+
+void ut_persistent_map_iter_delete(struct ut_iter *self)
+{
+	free(self);
+}
@@ -0,0 +1,248 @@
+#include "ut_radix_heap.h"
+#include "ut_array.h"
+#include "ut_errno.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define UT_RADIX_HEAP_BUCKETS 65
+
+/*
+ * Bucket 0 holds keys equal to last, bucket b keys whose highest bit that
+ * differs from last is bit b - 1. Each entry is the key followed by the
+ * element, the buckets have a type without drop as elements are dropped by
+ * the heap and only moved by the arrays. scratch is where an entry is put
+ * together before it is pushed.
+ */
+struct __ut_radix_heap {
+	ut_array_t *buckets[UT_RADIX_HEAP_BUCKETS];
+	size_t len;
+	uint64_t last;
+	uint8_t *scratch;
+	struct ut_type raw;
+	const struct ut_type *element;
+};
+
+static inline unsigned ut_radix_heap_bucket(const ut_radix_heap_t *self,
+					    uint64_t key)
+{
+	return key == self->last ? 0 : 64 - __builtin_clzll(key ^ self->last);
+}
+
+static inline uint64_t ut_radix_heap_key(const void *entry)
+{
+	uint64_t key;
+
+	memcpy(&key, entry, sizeof(key));
+	return key;
+}
+
+static inline void *ut_radix_heap_data(void *entry)
+{
+	return (uint8_t *)entry + sizeof(uint64_t);
+}
+
+/*
+ * Makes the least key the new last and spreads its bucket over the lower
+ * ones. Those keys now share more high bits with last, so every entry
+ * lands in a bucket below the one it came from. Room is made in the lower
+ * buckets first, so that nothing is lost on UT_ENOMEM.
+ */
+static int ut_radix_heap_refill(ut_radix_heap_t *self)
+{
+	size_t counts[UT_RADIX_HEAP_BUCKETS] = { 0 };
+	ut_array_t *bucket;
+	uint8_t *entry;
+	uint64_t key, least, last;
+	size_t i, n;
+	unsigned b, to;
+
+	for (b = 1; !ut_array_length(self->buckets[b]); b++)
+		;
+
+	bucket = self->buckets[b];
+	n = ut_array_length(bucket);
+	entry = ut_array_get(bucket, 0);
+	least = UINT64_MAX;
+	for (i = 0; i < n; i++) {
+		key = ut_radix_heap_key(entry + i * self->raw.size);
+		if (key < least)
+			least = key;
+	}
+
+	last = self->last;
+	self->last = least;
+	for (i = 0; i < n; i++) {
+		key = ut_radix_heap_key(entry + i * self->raw.size);
+		counts[ut_radix_heap_bucket(self, key)]++;
+	}
+
+	for (to = 0; to < b; to++) {
+		if (counts[to] &&
+		    ut_array_reserve(self->buckets[to], counts[to])) {
+			self->last = last;
+			return UT_ENOMEM;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		key = ut_radix_heap_key(entry + i * self->raw.size);
+		ut_array_push(self->buckets[ut_radix_heap_bucket(self, key)],
+			      entry + i * self->raw.size);
+	}
+
+	ut_array_clear(bucket);
+	return UT_OK;
+}
+
+/* Calls drop on the element of every entry. */
+static void ut_radix_heap_drop_all(ut_radix_heap_t *self)
+{
+	ut_array_t *bucket;
+	size_t i, n;
+	unsigned b;
+
+	for (b = 0; b < UT_RADIX_HEAP_BUCKETS; b++) {
+		bucket = self->buckets[b];
+		n = ut_array_length(bucket);
+		for (i = 0; i < n; i++)
+			self->element->drop(
+				ut_radix_heap_data(ut_array_get(bucket, i)));
+	}
+}
+
+ut_radix_heap_t *ut_radix_heap_new(const struct ut_type *element)
+{
+	ut_radix_heap_t *self;
+	unsigned b;
+
+	if (!element || !element->size)
+		return NULL;
+
+	self = malloc(sizeof(ut_radix_heap_t));
+	if (!self)
+		return NULL;
+
+	memset(&self->raw, 0, sizeof(self->raw));
+	self->raw.size = (sizeof(uint64_t) + element->size + 7) & ~(size_t)7;
+	self->element = element;
+	self->len = 0;
+	self->last = 0;
+
+	self->scratch = malloc(self->raw.size);
+	if (!self->scratch) {
+		free(self);
+		return NULL;
+	}
+
+	for (b = 0; b < UT_RADIX_HEAP_BUCKETS; b++) {
+		self->buckets[b] = ut_array_new(&self->raw);
+		if (!self->buckets[b])
+			break;
+	}
+
+	if (b < UT_RADIX_HEAP_BUCKETS) {
+		while (b--)
+			ut_array_delete(self->buckets[b]);
+		free(self->scratch);
+		free(self);
+		return NULL;
+	}
+
+	return self;
+}
+
+void ut_radix_heap_delete(ut_radix_heap_t *self)
+{
+	unsigned b;
+
+	if (self->element->drop)
+		ut_radix_heap_drop_all(self);
+
+	for (b = 0; b < UT_RADIX_HEAP_BUCKETS; b++)
+		ut_array_delete(self->buckets[b]);
+
+	free(self->scratch);
+	free(self);
+}
+
+void ut_radix_heap_clear(ut_radix_heap_t *self)
+{
+	unsigned b;
+
+	if (self->element->drop)
+		ut_radix_heap_drop_all(self);
+
+	for (b = 0; b < UT_RADIX_HEAP_BUCKETS; b++)
+		ut_array_clear(self->buckets[b]);
+
+	self->len = 0;
+	self->last = 0;
+}
+
+int ut_radix_heap_push(ut_radix_heap_t *self, uint64_t key, const void *data)
+{
+	int err;
+
+	if (!data)
+		return UT_EINVAL;
+
+	if (key < self->last)
+		return UT_ERANGE;
+
+	memcpy(self->scratch, &key, sizeof(key));
+	memcpy(ut_radix_heap_data(self->scratch), data, self->element->size);
+	err = ut_array_push(self->buckets[ut_radix_heap_bucket(self, key)],
+			    self->scratch);
+	if (err)
+		return err;
+
+	self->len++;
+	return UT_OK;
+}
+
+void ut_radix_heap_pop(ut_radix_heap_t *self)
+{
+	void *entry;
+
+	if (!self->len)
+		return;
+
+	if (ut_array_is_empty(self->buckets[0]) && ut_radix_heap_refill(self))
+		return;
+
+	entry = ut_array_last(self->buckets[0]);
+	if (self->element->drop)
+		self->element->drop(ut_radix_heap_data(entry));
+
+	ut_array_pop(self->buckets[0]);
+	self->len--;
+}
+
+void *ut_radix_heap_peek(ut_radix_heap_t *self, uint64_t *key)
+{
+	if (!self->len)
+		return NULL;
+
+	if (ut_array_is_empty(self->buckets[0]) && ut_radix_heap_refill(self))
+		return NULL;
+
+	if (key)
+		*key = self->last;
+
+	return ut_radix_heap_data(ut_array_last(self->buckets[0]));
+}
+
+uint64_t ut_radix_heap_last(const ut_radix_heap_t *self)
+{
+	return self->last;
+}
+
+size_t ut_radix_heap_length(const ut_radix_heap_t *self)
+{
+	return self->len;
+}
+
+bool ut_radix_heap_is_empty(const ut_radix_heap_t *self)
+{
+	return !self->len;
+}
@@ -0,0 +1,1118 @@
+#include "ut_rb_tree.h"
+#include <stdint.h>
+
+#define UT_RED 0
+#define UT_BLACK 1
+
+/* A red-black tree of 2^64 nodes is at most 128 levels high. */
+#define UT_RB_MAX_DEPTH 128
+
+/* The state of a union, intersection or difference. */
+struct ut_rb_set_op {
+	ut_rb_compare_fn compare;
+	ut_rb_release_fn release;
+	void *arg;
+	size_t released;
+};
+
+/* A tree split around a key, mid is the node equal to it if any. */
+struct ut_rb_split {
+	struct ut_rb_node *left;
+	struct ut_rb_node *mid;
+	struct ut_rb_node *right;
+	size_t lbh;
+	size_t rbh;
+};
+
+static inline bool ut_rb_node_is_red(const struct ut_rb_node *self)
+{
+	return !self ? false : self->color == UT_RED;
+}
+
+static inline bool ut_rb_node_is_black(const struct ut_rb_node *self)
+{
+	return !self ? true : self->color == UT_BLACK;
+}
+
+static inline bool ut_rb_node_is_root(const struct ut_rb_node *self)
+{
+	return !self ? false : self->parent == NULL;
+}
+
+static inline size_t ut_rb_node_size(const struct ut_rb_node *self)
+{
+	return !self ? 0 : self->size;
+}
+
+static inline void ut_rb_node_resize(struct ut_rb_node *self)
+{
+	self->size = ut_rb_node_size(self->left) +
+		     ut_rb_node_size(self->right) + 1;
+}
+
+static struct ut_rb_node *ut_rb_node_first(const struct ut_rb_node *self)
+{
+	if (self) {
+		while (self->left)
+			self = self->left;
+	}
+
+	return (struct ut_rb_node *)self;
+}
+
+static struct ut_rb_node *ut_rb_node_last(const struct ut_rb_node *self)
+{
+	if (self) {
+		while (self->right)
+			self = self->right;
+	}
+
+	return (struct ut_rb_node *)self;
+}
+
+/* The child pointer of the parent of node, or the root, that holds node. */
+static struct ut_rb_node **ut_rb_tree_link_of(struct ut_rb_tree *self,
+					      struct ut_rb_node *node)
+{
+	if (!node->parent)
+		return &self->root;
+	else if (node == node->parent->left)
+		return &node->parent->left;
+	else
+		return &node->parent->right;
+}
+
+/* Adds diff to the subtree sizes of node and all its ancestors. */
+static void ut_rb_tree_add_size(struct ut_rb_node *node, int diff)
+{
+	for (; node; node = node->parent)
+		node->size += diff;
+}
+
+static void ut_rb_tree_rotate_left(struct ut_rb_tree *self,
+				   struct ut_rb_node *x)
+{
+	struct ut_rb_node *y;
+
+	/*
+	 *    x                y
+	 *   / \      -->     / \
+	 *  xl  y            x   yr
+	 *     / \          / \
+	 *    yl  yr       xl  yl
+	 */
+
+	y = x->right;
+	x->right = y->left;
+
+	if (y->left)
+		y->left->parent = x;
+
+	y->parent = x->parent;
+	*ut_rb_tree_link_of(self, x) = y;
+
+	y->left = x;
+	x->parent = y;
+
+	y->size = x->size;
+	ut_rb_node_resize(x);
+}
+
+static void ut_rb_tree_rotate_right(struct ut_rb_tree *self,
+				    struct ut_rb_node *x)
+{
+	struct ut_rb_node *y;
+
+	/*
+	 *      x            y
+	 *     / \    -->   / \
+	 *    y   xr       yl  x
+	 *   / \              / \
+	 *  yl  yr           yr  xr
+	 */
+
+	y = x->left;
+	x->left = y->right;
+
+	if (y->right)
+		y->right->parent = x;
+
+	y->parent = x->parent;
+	*ut_rb_tree_link_of(self, x) = y;
+
+	y->right = x;
+	x->parent = y;
+
+	y->size = x->size;
+	ut_rb_node_resize(x);
+}
+
+/*
+ * Only the rotations move nodes between subtrees, so they are the only
+ * place in the fixups that keeps the subtree sizes.
+ * Returns true if the black height of the tree grew.
+ */
+static bool ut_rb_tree_fix_insert(struct ut_rb_tree *self,
+				  struct ut_rb_node *node)
+{
+	struct ut_rb_node *parent, *grandparent, *tmp;
+	bool grew;
+
+	while (true) {
+		if (ut_rb_node_is_root(node)) {
+			grew = node->color == UT_RED;
+			node->color = UT_BLACK;
+			return grew;
+		}
+
+		if (ut_rb_node_is_black(node->parent))
+			return false;
+
+		parent = node->parent;
+		grandparent = parent->parent;
+		tmp = grandparent->left;
+
+		if (parent != tmp) { /* parent == grandparent->right */
+			if (ut_rb_node_is_red(tmp)) {
+				/*
+				 * Case 1: Uncle is red.
+				 *
+				 *     g           G
+				 *    / \         / \
+				 *   U   P  -->  u   p
+				 *        \           \
+				 *         N           N
+				 */
+				parent->color = UT_BLACK;
+				tmp->color = UT_BLACK;
+				grandparent->color = UT_RED;
+				node = grandparent;
+				continue;
+			}
+
+			tmp = parent->right;
+
+			if (node != tmp) {
+				/*
+				 * Case 2: Uncle is black and node is parent's
+				 * left child.
+				 *
+				 *    g           g
+				 *   / \         / \
+				 *  u   P  -->  u   N
+				 *     /             \
+				 *    N               P
+				 */
+				ut_rb_tree_rotate_right(self, parent);
+			}
+
+			/*
+			 * Case 3: Uncle is black and node is parent's right
+			 * child.
+			 *
+			 *    g               p
+			 *   / \             / \
+			 *  u   P    -->    G   N
+			 *       \         /
+			 *        N       u
+			 */
+			grandparent->right->color = UT_BLACK;
+			grandparent->color = UT_RED;
+			ut_rb_tree_rotate_left(self, grandparent);
+			return false;
+		} else { /* parent == grandparent->left */
+			tmp = grandparent->right;
+
+			if (ut_rb_node_is_red(tmp)) {
+				parent->color = UT_BLACK;
+				tmp->color = UT_BLACK;
+				grandparent->color = UT_RED;
+				node = grandparent;
+				continue;
+			}
+
+			tmp = parent->left;
+
+			if (node != tmp)
+				ut_rb_tree_rotate_left(self, parent);
+
+			grandparent->left->color = UT_BLACK;
+			grandparent->color = UT_RED;
+			ut_rb_tree_rotate_right(self, grandparent);
+			return false;
+		}
+	}
+}
+
+static void ut_rb_tree_fix_remove(struct ut_rb_tree *self,
+				  struct ut_rb_node *parent)
+{
+	struct ut_rb_node *sibling;
+	struct ut_rb_node *node = NULL;
+
+	while (true) {
+		if (ut_rb_node_is_root(node))
+			break;
+
+		if (ut_rb_node_is_red(node)) {
+			node->color = UT_BLACK;
+			break;
+		}
+
+		if (node == parent->right) {
+			sibling = parent->left;
+
+			if (ut_rb_node_is_red(sibling)) {
+				/*
+				 * Case 1: Sibling is red.
+				 *
+				 *      p            s
+				 *     / \          / \
+				 *    S   n  -->   sl  P
+				 *   / \              / \
+				 *  sl  sr           sr  n
+				 */
+				parent->color = UT_RED;
+				sibling->color = UT_BLACK;
+				ut_rb_tree_rotate_right(self, parent);
+				continue;
+			}
+
+			/*
+			 * Case 2: Sibling is black and has no red children.
+			 *
+			 *      p?            p?
+			 *     / \   -->     / \
+			 *    s   n         S   n
+			 *   / \           / \
+			 *  sl  sr        sl  sr
+			 */
+			if (ut_rb_node_is_black(sibling->left) &&
+			    ut_rb_node_is_black(sibling->right)) {
+				sibling->color = UT_RED;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+
+			if (ut_rb_node_is_red(sibling->left)) {
+				/*
+				 * Case 3: Sibling is black and its left child
+				 * is red.
+				 *
+				 *      p?          s?
+				 *     / \         / \
+				 *    s   n  -->  sl  p
+				 *   / \             / \
+				 *  SL  sr?         sr? n
+				 */
+				sibling->left->color = sibling->color;
+				sibling->color = parent->color;
+				parent->color = UT_BLACK;
+				ut_rb_tree_rotate_right(self, parent);
+				break;
+			} else {
+				/*
+				 * Case 4: Sibling is black and its right child
+				 * is red.
+				 *
+				 *      p?           sr?
+				 *     / \           / \
+				 *    s   n  -->    s   p
+				 *   / \           /     \
+				 *  sl  SR        sl      n
+				 */
+				sibling->right->color = parent->color;
+				parent->color = UT_BLACK;
+				ut_rb_tree_rotate_left(self, sibling);
+				ut_rb_tree_rotate_right(self, parent);
+				break;
+			}
+		} else { /* node == parent->left */
+			sibling = parent->right;
+
+			if (ut_rb_node_is_red(sibling)) {
+				parent->color = UT_RED;
+				sibling->color = UT_BLACK;
+				ut_rb_tree_rotate_left(self, parent);
+				continue;
+			}
+
+			if (ut_rb_node_is_black(sibling->left) &&
+			    ut_rb_node_is_black(sibling->right)) {
+				sibling->color = UT_RED;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+
+			if (ut_rb_node_is_red(sibling->right)) {
+				sibling->right->color = sibling->color;
+				sibling->color = parent->color;
+				parent->color = UT_BLACK;
+				ut_rb_tree_rotate_left(self, parent);
+				break;
+			} else {
+				sibling->left->color = parent->color;
+				parent->color = UT_BLACK;
+				ut_rb_tree_rotate_right(self, sibling);
+				ut_rb_tree_rotate_left(self, parent);
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Builds a perfectly balanced tree from the nodes in [lo, hi). Only the
+ * nodes on the deepest level are red, so every path has the same number of
+ * black nodes.
+ */
+static struct ut_rb_node *ut_rb_tree_build_range(uint8_t *base, size_t stride,
+						 size_t lo, size_t hi,
+						 size_t depth,
+						 size_t max_depth)
+{
+	struct ut_rb_node *node;
+	size_t mid;
+
+	if (lo >= hi)
+		return NULL;
+
+	mid = lo + ((hi - lo) >> 1);
+	node = (struct ut_rb_node *)(base + mid * stride);
+
+	node->color = depth == max_depth && depth ? UT_RED : UT_BLACK;
+	node->size = hi - lo;
+	node->parent = NULL;
+	node->left = ut_rb_tree_build_range(base, stride, lo, mid, depth + 1,
+					    max_depth);
+	node->right = ut_rb_tree_build_range(base, stride, mid + 1, hi,
+					     depth + 1, max_depth);
+
+	if (node->left)
+		node->left->parent = node;
+	if (node->right)
+		node->right->parent = node;
+
+	return node;
+}
+
+/* The number of black nodes on every path from node down to a leaf. */
+static size_t ut_rb_node_black_height(const struct ut_rb_node *node)
+{
+	size_t bh = 0;
+
+	for (; node; node = node->left)
+		bh += ut_rb_node_is_black(node);
+
+	return bh;
+}
+
+/*
+ * Cuts the subtree at node loose as a tree of its own, with a black root.
+ * *bh is the black height of node on entry and of the new tree on return.
+ */
+static struct ut_rb_node *ut_rb_node_detach(struct ut_rb_node *node,
+					    size_t *bh)
+{
+	if (!node)
+		return NULL;
+
+	node->parent = NULL;
+	if (ut_rb_node_is_red(node)) {
+		node->color = UT_BLACK;
+		(*bh)++;
+	}
+
+	return node;
+}
+
+/*
+ * Joins left, mid and right into one tree, every node of left must be less
+ * than mid and every node of right greater. mid is hung into the taller
+ * tree, on its spine at the black height of the shorter one, and fixed up
+ * like an insertion, which costs O(|lbh - rbh| + 1).
+ */
+static struct ut_rb_node *ut_rb_tree_join3(struct ut_rb_node *left,
+					   size_t lbh,
+					   struct ut_rb_node *mid,
+					   struct ut_rb_node *right, size_t rbh,
+					   size_t *bh)
+{
+	struct ut_rb_tree tree;
+	struct ut_rb_node *curr, *parent = NULL;
+	size_t h;
+
+	if (lbh == rbh) {
+		mid->color = UT_BLACK;
+		mid->parent = NULL;
+		mid->left = left;
+		mid->right = right;
+		if (left)
+			left->parent = mid;
+		if (right)
+			right->parent = mid;
+		ut_rb_node_resize(mid);
+		*bh = lbh + 1;
+		return mid;
+	}
+
+	tree.root = lbh > rbh ? left : right;
+	tree.len = 0;
+	tree.compare = NULL;
+
+	curr = tree.root;
+	h = lbh > rbh ? lbh : rbh;
+
+	if (lbh > rbh) {
+		while (!ut_rb_node_is_black(curr) || h != rbh) {
+			h -= ut_rb_node_is_black(curr);
+			parent = curr;
+			curr = curr->right;
+		}
+
+		mid->left = curr;
+		mid->right = right;
+		parent->right = mid;
+	} else {
+		while (!ut_rb_node_is_black(curr) || h != lbh) {
+			h -= ut_rb_node_is_black(curr);
+			parent = curr;
+			curr = curr->left;
+		}
+
+		mid->left = left;
+		mid->right = curr;
+		parent->left = mid;
+	}
+
+	mid->color = UT_RED;
+	mid->parent = parent;
+	if (mid->left)
+		mid->left->parent = mid;
+	if (mid->right)
+		mid->right->parent = mid;
+
+	/* The ancestors of mid gained it and the shorter tree. */
+	ut_rb_node_resize(mid);
+	h = ut_rb_node_size(lbh > rbh ? right : left);
+	ut_rb_tree_add_size(parent, h + 1);
+
+	h = lbh > rbh ? lbh : rbh;
+	*bh = h + ut_rb_tree_fix_insert(&tree, mid);
+	return tree.root;
+}
+
+/* Joins two trees without a node in between, left must be before right. */
+static struct ut_rb_node *ut_rb_tree_join2(struct ut_rb_node *left,
+					   size_t lbh,
+					   struct ut_rb_node *right, size_t rbh,
+					   size_t *bh)
+{
+	struct ut_rb_tree tree;
+	struct ut_rb_node *mid;
+
+	if (!left) {
+		*bh = rbh;
+		return right;
+	}
+
+	if (!right) {
+		*bh = lbh;
+		return left;
+	}
+
+	tree.root = left;
+	tree.len = 1;
+	tree.compare = NULL;
+
+	mid = ut_rb_node_last(left);
+	ut_rb_tree_remove(&tree, mid);
+
+	lbh = ut_rb_node_black_height(tree.root);
+	return ut_rb_tree_join3(tree.root, lbh, mid, right, rbh, bh);
+}
+
+/* Splits the tree at root, of black height bh, around the node key. */
+static void ut_rb_tree_split_key(const struct ut_rb_set_op *op,
+				 struct ut_rb_node *root, size_t bh,
+				 const struct ut_rb_node *key,
+				 struct ut_rb_split *out)
+{
+	struct ut_rb_node *left, *right;
+	size_t lbh, rbh;
+	int cmp;
+
+	if (!root) {
+		out->left = out->mid = out->right = NULL;
+		out->lbh = out->rbh = 0;
+		return;
+	}
+
+	cmp = op->compare(key, root);
+
+	lbh = rbh = bh - ut_rb_node_is_black(root);
+	left = ut_rb_node_detach(root->left, &lbh);
+	right = ut_rb_node_detach(root->right, &rbh);
+
+	if (cmp < 0) {
+		ut_rb_tree_split_key(op, left, lbh, key, out);
+		out->right = ut_rb_tree_join3(out->right, out->rbh, root,
+					      right, rbh, &out->rbh);
+	} else if (cmp > 0) {
+		ut_rb_tree_split_key(op, right, rbh, key, out);
+		out->left = ut_rb_tree_join3(left, lbh, root, out->left,
+					     out->lbh, &out->lbh);
+	} else {
+		out->left = left;
+		out->lbh = lbh;
+		out->mid = root;
+		out->right = right;
+		out->rbh = rbh;
+	}
+}
+
+static void ut_rb_tree_release(struct ut_rb_set_op *op, struct ut_rb_node *node)
+{
+	op->released++;
+	if (op->release)
+		op->release(node, op->arg);
+}
+
+static void ut_rb_tree_release_all(struct ut_rb_set_op *op,
+				   struct ut_rb_node *node)
+{
+	struct ut_rb_node *right;
+
+	if (!node)
+		return;
+
+	ut_rb_tree_release_all(op, node->left);
+	right = node->right;
+	ut_rb_tree_release(op, node);
+	ut_rb_tree_release_all(op, right);
+}
+
+/*
+ * The set operations split b around the root of a and recurse on the two
+ * halves, which share no nodes, so each half could run on its own thread.
+ */
+static struct ut_rb_node *ut_rb_tree_union_of(struct ut_rb_set_op *op,
+					      struct ut_rb_node *a, size_t abh,
+					      struct ut_rb_node *b, size_t bbh,
+					      size_t *bh)
+{
+	struct ut_rb_node *left, *right;
+	struct ut_rb_split split;
+	size_t lbh, rbh;
+
+	if (!a || !b) {
+		*bh = a ? abh : bbh;
+		return a ? a : b;
+	}
+
+	ut_rb_tree_split_key(op, b, bbh, a, &split);
+	if (split.mid)
+		ut_rb_tree_release(op, split.mid);
+
+	lbh = rbh = abh - ut_rb_node_is_black(a);
+	left = ut_rb_node_detach(a->left, &lbh);
+	right = ut_rb_node_detach(a->right, &rbh);
+
+	left = ut_rb_tree_union_of(op, left, lbh, split.left, split.lbh, &lbh);
+	right = ut_rb_tree_union_of(op, right, rbh, split.right, split.rbh,
+				    &rbh);
+
+	return ut_rb_tree_join3(left, lbh, a, right, rbh, bh);
+}
+
+static struct ut_rb_node *
+ut_rb_tree_intersection_of(struct ut_rb_set_op *op, struct ut_rb_node *a,
+			   size_t abh, struct ut_rb_node *b, size_t bbh,
+			   size_t *bh)
+{
+	struct ut_rb_node *left, *right;
+	struct ut_rb_split split;
+	size_t lbh, rbh;
+
+	if (!a || !b) {
+		ut_rb_tree_release_all(op, a ? a : b);
+		*bh = 0;
+		return NULL;
+	}
+
+	ut_rb_tree_split_key(op, b, bbh, a, &split);
+
+	lbh = rbh = abh - ut_rb_node_is_black(a);
+	left = ut_rb_node_detach(a->left, &lbh);
+	right = ut_rb_node_detach(a->right, &rbh);
+
+	left = ut_rb_tree_intersection_of(op, left, lbh, split.left, split.lbh,
+					  &lbh);
+	right = ut_rb_tree_intersection_of(op, right, rbh, split.right,
+					   split.rbh, &rbh);
+
+	if (split.mid) {
+		ut_rb_tree_release(op, split.mid);
+		return ut_rb_tree_join3(left, lbh, a, right, rbh, bh);
+	}
+
+	ut_rb_tree_release(op, a);
+	return ut_rb_tree_join2(left, lbh, right, rbh, bh);
+}
+
+static struct ut_rb_node *ut_rb_tree_difference_of(struct ut_rb_set_op *op,
+						   struct ut_rb_node *a,
+						   size_t abh,
+						   struct ut_rb_node *b,
+						   size_t bbh, size_t *bh)
+{
+	struct ut_rb_node *left, *right;
+	struct ut_rb_split split;
+	size_t lbh, rbh;
+
+	if (!a || !b) {
+		ut_rb_tree_release_all(op, b);
+		*bh = abh;
+		return a;
+	}
+
+	ut_rb_tree_split_key(op, b, bbh, a, &split);
+
+	lbh = rbh = abh - ut_rb_node_is_black(a);
+	left = ut_rb_node_detach(a->left, &lbh);
+	right = ut_rb_node_detach(a->right, &rbh);
+
+	left = ut_rb_tree_difference_of(op, left, lbh, split.left, split.lbh,
+					&lbh);
+	right = ut_rb_tree_difference_of(op, right, rbh, split.right,
+					 split.rbh, &rbh);
+
+	if (split.mid) {
+		ut_rb_tree_release(op, split.mid);
+		ut_rb_tree_release(op, a);
+		return ut_rb_tree_join2(left, lbh, right, rbh, bh);
+	}
+
+	return ut_rb_tree_join3(left, lbh, a, right, rbh, bh);
+}
+
+void ut_rb_tree_init(struct ut_rb_tree *self, ut_rb_compare_fn compare)
+{
+	self->root = NULL;
+	self->len = 0;
+	self->compare = compare;
+}
+
+void ut_rb_tree_init_ranked(struct ut_rb_tree *self, ut_rb_compare_fn compare)
+{
+	ut_rb_tree_init(self, compare);
+}
+
+struct ut_rb_node *ut_rb_tree_insert(struct ut_rb_tree *self,
+				     struct ut_rb_node *node)
+{
+	int cmp;
+	struct ut_rb_node *parent = NULL;
+	struct ut_rb_node **link = &self->root;
+
+	while (*link) {
+		cmp = self->compare(node, *link);
+
+		if (cmp == 0)
+			return *link;
+
+		parent = *link;
+		link = cmp < 0 ? &parent->left : &parent->right;
+	}
+
+	ut_rb_tree_link(self, node, parent, link);
+	return NULL;
+}
+
+void ut_rb_tree_link(struct ut_rb_tree *self, struct ut_rb_node *node,
+		     struct ut_rb_node *parent, struct ut_rb_node **link)
+{
+	node->color = UT_RED;
+	node->size = 1;
+	node->left = NULL;
+	node->right = NULL;
+	node->parent = parent;
+	*link = node;
+
+	ut_rb_tree_add_size(parent, 1);
+
+	ut_rb_tree_fix_insert(self, node);
+	self->len++;
+}
+
+/*
+ * A node with two children is replaced by its successor, which is relinked
+ * into its place, so no other node moves.
+ */
+void ut_rb_tree_remove(struct ut_rb_tree *self, struct ut_rb_node *node)
+{
+	struct ut_rb_node *victim, *child, *parent;
+	int color;
+
+	/* The node whose position really goes away has at most one child. */
+	victim = node->left && node->right ? ut_rb_node_first(node->right) :
+					     node;
+	child = victim->left ? victim->left : victim->right;
+	parent = victim->parent;
+	color = victim->color;
+
+	ut_rb_tree_add_size(parent, -1);
+
+	*ut_rb_tree_link_of(self, victim) = child;
+	if (child)
+		child->parent = parent;
+
+	if (victim != node) {
+		/*
+		 *      N              V
+		 *     / \            / \
+		 *    l   r   -->    l   r
+		 *       /              /
+		 *     ...            ...
+		 *     /              /
+		 *    V              c
+		 *     \
+		 *      c
+		 */
+		if (parent == node)
+			parent = victim;
+
+		victim->color = node->color;
+		victim->size = node->size;
+		victim->left = node->left;
+		victim->right = node->right;
+		victim->parent = node->parent;
+		*ut_rb_tree_link_of(self, node) = victim;
+
+		if (victim->left)
+			victim->left->parent = victim;
+		if (victim->right)
+			victim->right->parent = victim;
+	}
+
+	if (color == UT_BLACK) {
+		if (child)
+			child->color = UT_BLACK;
+		else if (parent)
+			ut_rb_tree_fix_remove(self, parent);
+	}
+
+	self->len--;
+}
+
+/*
+ * Rotates left children up until the node has none, which flattens the
+ * tree into a list along right links. Both links of a node are read
+ * before it is released.
+ */
+void ut_rb_tree_clear(struct ut_rb_tree *self, ut_rb_release_fn release,
+		      void *arg)
+{
+	struct ut_rb_node *node = self->root, *left, *next;
+
+	while (node) {
+		left = node->left;
+		if (left) {
+			node->left = left->right;
+			left->right = node;
+			node = left;
+		} else {
+			next = node->right;
+			release(node, arg);
+			node = next;
+		}
+	}
+
+	self->root = NULL;
+	self->len = 0;
+}
+
+void ut_rb_tree_build(struct ut_rb_tree *self, void *base, size_t stride,
+		      size_t n)
+{
+	size_t max_depth;
+
+	for (max_depth = 0; (n >> max_depth) > 1; max_depth++)
+		;
+
+	self->root = ut_rb_tree_build_range(base, stride, 0, n, 0, max_depth);
+	self->len = n;
+}
+
+struct ut_rb_node *ut_rb_tree_find(const struct ut_rb_tree *self,
+				   const void *key, ut_rb_search_fn search)
+{
+	int cmp;
+	struct ut_rb_node *curr = self->root;
+
+	while (curr) {
+		cmp = search(key, curr);
+
+		if (cmp > 0)
+			curr = curr->right;
+		else if (cmp < 0)
+			curr = curr->left;
+		else
+			break;
+	}
+
+	return curr;
+}
+
+struct ut_rb_node *ut_rb_tree_lower_bound(const struct ut_rb_tree *self,
+					  const void *key,
+					  ut_rb_search_fn search)
+{
+	struct ut_rb_node *curr = self->root;
+	struct ut_rb_node *found = NULL;
+
+	while (curr) {
+		if (search(key, curr) <= 0) {
+			found = curr;
+			curr = curr->left;
+		} else {
+			curr = curr->right;
+		}
+	}
+
+	return found;
+}
+
+struct ut_rb_node *ut_rb_tree_upper_bound(const struct ut_rb_tree *self,
+					  const void *key,
+					  ut_rb_search_fn search)
+{
+	struct ut_rb_node *curr = self->root;
+	struct ut_rb_node *found = NULL;
+
+	while (curr) {
+		if (search(key, curr) < 0) {
+			found = curr;
+			curr = curr->left;
+		} else {
+			curr = curr->right;
+		}
+	}
+
+	return found;
+}
+
+struct ut_rb_node *ut_rb_tree_first(const struct ut_rb_tree *self)
+{
+	return ut_rb_node_first(self->root);
+}
+
+struct ut_rb_node *ut_rb_tree_last(const struct ut_rb_tree *self)
+{
+	return ut_rb_node_last(self->root);
+}
+
+struct ut_rb_node *ut_rb_tree_next(const struct ut_rb_node *node)
+{
+	struct ut_rb_node *parent;
+
+	if (node->right)
+		return ut_rb_node_first(node->right);
+
+	parent = node->parent;
+	while (parent && node == parent->right) {
+		node = parent;
+		parent = parent->parent;
+	}
+
+	return parent;
+}
+
+struct ut_rb_node *ut_rb_tree_prev(const struct ut_rb_node *node)
+{
+	struct ut_rb_node *parent;
+
+	if (node->left)
+		return ut_rb_node_last(node->left);
+
+	parent = node->parent;
+	while (parent && node == parent->left) {
+		node = parent;
+		parent = parent->parent;
+	}
+
+	return parent;
+}
+
+struct ut_rb_node *ut_rb_tree_select(const struct ut_rb_tree *self,
+				     size_t index)
+{
+	struct ut_rb_node *curr;
+	size_t left;
+
+	if (index >= self->len)
+		return NULL;
+
+	curr = self->root;
+
+	while (true) {
+		left = ut_rb_node_size(curr->left);
+
+		if (index < left) {
+			curr = curr->left;
+		} else if (index > left) {
+			index -= left + 1;
+			curr = curr->right;
+		} else {
+			return curr;
+		}
+	}
+}
+
+size_t ut_rb_tree_rank(const struct ut_rb_tree *self,
+		       const struct ut_rb_node *node)
+{
+	size_t rank;
+
+	(void)self;
+
+	/* Everything left of node, plus every ancestor it is right of. */
+	rank = ut_rb_node_size(node->left);
+	for (; node->parent; node = node->parent) {
+		if (node == node->parent->right)
+			rank += ut_rb_node_size(node->parent->left) + 1;
+	}
+
+	return rank;
+}
+
+void ut_rb_tree_split(struct ut_rb_tree *self, struct ut_rb_node *node,
+		      struct ut_rb_tree *right)
+{
+	struct ut_rb_node *path[UT_RB_MAX_DEPTH];
+	size_t bhs[UT_RB_MAX_DEPTH];
+	struct ut_rb_node *left, *sibling, *parent;
+	size_t i, n, bh, lbh, rbh, sbh;
+
+	ut_rb_tree_init(right, self->compare);
+
+	if (!node)
+		return;
+
+	for (n = 0, parent = node; parent; parent = parent->parent)
+		path[n++] = parent;
+
+	/* The black heights along the path, from the root down. */
+	bh = ut_rb_node_black_height(self->root);
+	for (i = n; i-- > 0;) {
+		bhs[i] = bh;
+		bh -= ut_rb_node_is_black(path[i]);
+	}
+
+	lbh = rbh = bhs[0] - ut_rb_node_is_black(node);
+	left = ut_rb_node_detach(node->left, &lbh);
+	sibling = ut_rb_node_detach(node->right, &rbh);
+	right->root = ut_rb_tree_join3(NULL, 0, node, sibling, rbh, &rbh);
+
+	/* Every ancestor goes to the side that its path child is not on. */
+	for (i = 1; i < n; i++) {
+		parent = path[i];
+		sbh = bhs[i] - ut_rb_node_is_black(parent);
+
+		if (parent->left == path[i - 1]) {
+			sibling = ut_rb_node_detach(parent->right, &sbh);
+			right->root = ut_rb_tree_join3(right->root, rbh,
+						       parent, sibling, sbh,
+						       &rbh);
+		} else {
+			sibling = ut_rb_node_detach(parent->left, &sbh);
+			left = ut_rb_tree_join3(sibling, sbh, parent, left,
+						lbh, &lbh);
+		}
+	}
+
+	self->root = left;
+	right->len = ut_rb_node_size(right->root);
+	self->len -= right->len;
+}
+
+void ut_rb_tree_join(struct ut_rb_tree *self, struct ut_rb_tree *right)
+{
+	struct ut_rb_node *mid;
+	size_t lbh, rbh, len;
+
+	if (right->len == 0)
+		return;
+
+	len = self->len + right->len;
+
+	mid = ut_rb_tree_first(right);
+	ut_rb_tree_remove(right, mid);
+
+	lbh = ut_rb_node_black_height(self->root);
+	rbh = ut_rb_node_black_height(right->root);
+	self->root = ut_rb_tree_join3(self->root, lbh, mid, right->root, rbh,
+				      &lbh);
+	self->len = len;
+
+	right->root = NULL;
+	right->len = 0;
+}
+
+/* Runs one of the set operations of self and other into self. */
+static void ut_rb_tree_set_op(struct ut_rb_tree *self, struct ut_rb_tree *other,
+			      ut_rb_release_fn release, void *arg,
+			      struct ut_rb_node *(*fn)(struct ut_rb_set_op *,
+						       struct ut_rb_node *,
+						       size_t,
+						       struct ut_rb_node *,
+						       size_t, size_t *))
+{
+	struct ut_rb_set_op op;
+	size_t abh, bbh;
+
+	op.compare = self->compare;
+	op.release = release;
+	op.arg = arg;
+	op.released = 0;
+
+	abh = ut_rb_node_black_height(self->root);
+	bbh = ut_rb_node_black_height(other->root);
+	self->root = fn(&op, self->root, abh, other->root, bbh, &abh);
+	self->len = self->len + other->len - op.released;
+
+	other->root = NULL;
+	other->len = 0;
+}
+
+void ut_rb_tree_union(struct ut_rb_tree *self, struct ut_rb_tree *other,
+		      ut_rb_release_fn release, void *arg)
+{
+	ut_rb_tree_set_op(self, other, release, arg, ut_rb_tree_union_of);
+}
+
+void ut_rb_tree_intersection(struct ut_rb_tree *self,
+			     struct ut_rb_tree *other,
+			     ut_rb_release_fn release, void *arg)
+{
+	ut_rb_tree_set_op(self, other, release, arg,
+			  ut_rb_tree_intersection_of);
+}
+
+void ut_rb_tree_difference(struct ut_rb_tree *self, struct ut_rb_tree *other,
+			   ut_rb_release_fn release, void *arg)
+{
+	ut_rb_tree_set_op(self, other, release, arg, ut_rb_tree_difference_of);
+}
+
+size_t ut_rb_tree_length(const struct ut_rb_tree *self)
+{
+	return self->len;
+}
+
+bool ut_rb_tree_is_empty(const struct ut_rb_tree *self)
+{
+	return self->len == 0;
+}
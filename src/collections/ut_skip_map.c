@@ -0,0 +1,659 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_skip_map.h"
+#include "ut_errno.h"
+#include "ut_mem.h"
+#include "ut_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* With one level in four promoted, 16 levels cover 2^32 entries. */
+#define UT_SKIP_MAX_LEVEL 16
+
+/* How many nodes a thread retires before it tries to advance the epoch. */
+#define UT_SKIP_RETIRE_BATCH 64
+
+/* Set in a next pointer once its node is removed at that level. */
+#define UT_SKIP_MARK ((uintptr_t)1)
+
+/*
+ * A node is referenced by its inserter until all its levels are linked and
+ * by its remover until all its levels are unlinked. Whoever is done last
+ * retires it.
+ */
+struct ut_skip_node {
+	size_t refs;
+	struct ut_skip_node *limbo;
+	int height;
+	uintptr_t next[];
+};
+
+/* Nodes retired during epoch, waiting for every thread to move past it. */
+struct ut_skip_limbo {
+	size_t epoch;
+	struct ut_skip_node *head;
+};
+
+/*
+ * Per thread state. While pinned, state holds the epoch the thread entered
+ * shifted left by one with the low bit set, and zero otherwise. Records of
+ * exited threads are reused with their limbo lists, which go with the map.
+ */
+struct ut_skip_record {
+	struct ut_thread_record base;
+	size_t state;
+	size_t nesting;
+	size_t retired;
+	struct ut_skip_limbo limbo[3];
+};
+
+struct __ut_skip_map {
+	struct ut_skip_node *head;
+	size_t len;
+	size_t epoch;
+	int level;
+	struct ut_thread_registry threads;
+	const struct ut_type *key;
+	const struct ut_type *value;
+};
+
+struct __ut_skip_map_iter {
+	struct ut_iter base;
+	ut_skip_map_t *map;
+	struct ut_skip_node *curr;
+	const void *to;
+	struct ut_pair kv;
+};
+
+static inline struct ut_skip_node *ut_skip_ptr(uintptr_t next)
+{
+	return (struct ut_skip_node *)(next & ~UT_SKIP_MARK);
+}
+
+static inline uintptr_t ut_skip_load(struct ut_skip_node *node, int level)
+{
+	return __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+}
+
+static inline bool ut_skip_cas(struct ut_skip_node *node, int level,
+			       uintptr_t *expected, uintptr_t desired)
+{
+	return __atomic_compare_exchange_n(&node->next[level], expected,
+					   desired, false, __ATOMIC_ACQ_REL,
+					   __ATOMIC_ACQUIRE);
+}
+
+/* The key follows the links at the alignment malloc would give it. */
+static inline size_t ut_skip_node_size(int height)
+{
+	return UT_MEM_ALIGN(sizeof(struct ut_skip_node) +
+			    height * sizeof(uintptr_t));
+}
+
+static inline void *ut_skip_node_key(struct ut_skip_node *self)
+{
+	return (uint8_t *)self + ut_skip_node_size(self->height);
+}
+
+static inline void *ut_skip_node_value(struct ut_skip_node *self,
+				       const ut_skip_map_t *map)
+{
+	return (uint8_t *)ut_skip_node_key(self) + map->key->size;
+}
+
+static int ut_skip_random_level(struct ut_skip_record *rec)
+{
+	uint64_t x = ut_thread_random(&rec->base);
+	int level = 1;
+
+	while (level < UT_SKIP_MAX_LEVEL && !(x & 3)) {
+		x >>= 2;
+		level++;
+	}
+
+	return level;
+}
+
+static struct ut_skip_node *ut_skip_node_new(ut_skip_map_t *map,
+					     struct ut_skip_record *rec,
+					     const void *key,
+					     const void *value)
+{
+	struct ut_skip_node *self;
+	int height = ut_skip_random_level(rec);
+
+	self = malloc(ut_skip_node_size(height) + map->key->size +
+		      map->value->size);
+	if (!self)
+		return NULL;
+
+	self->refs = 2;
+	self->limbo = NULL;
+	self->height = height;
+	memcpy(ut_skip_node_key(self), key, map->key->size);
+	memcpy(ut_skip_node_value(self, map), value, map->value->size);
+	return self;
+}
+
+static void ut_skip_node_delete(struct ut_skip_node *self,
+				const ut_skip_map_t *map)
+{
+	if (map->key->drop)
+		map->key->drop(ut_skip_node_key(self));
+
+	if (map->value->drop)
+		map->value->drop(ut_skip_node_value(self, map));
+
+	free(self);
+}
+
+/* Returns the record of the calling thread, reusing a free one if any. */
+static struct ut_skip_record *ut_skip_map_record(ut_skip_map_t *self)
+{
+	return (struct ut_skip_record *)ut_thread_registry_get(&self->threads);
+}
+
+static void ut_skip_map_free_limbo(ut_skip_map_t *self,
+				   struct ut_skip_limbo *limbo)
+{
+	struct ut_skip_node *node;
+
+	while (limbo->head) {
+		node = limbo->head;
+		limbo->head = node->limbo;
+		ut_skip_node_delete(node, self);
+	}
+}
+
+/* The epoch only advances once every pinned thread has entered it. */
+static void ut_skip_map_try_advance(ut_skip_map_t *self)
+{
+	struct ut_skip_record *rec;
+	size_t epoch, state;
+
+	epoch = __atomic_load_n(&self->epoch, __ATOMIC_SEQ_CST);
+	rec = (struct ut_skip_record *)ut_thread_registry_first(&self->threads);
+
+	for (; rec; rec = (struct ut_skip_record *)rec->base.next) {
+		state = __atomic_load_n(&rec->state, __ATOMIC_SEQ_CST);
+		if ((state & 1) && (state >> 1) != epoch)
+			return;
+	}
+
+	__atomic_compare_exchange_n(&self->epoch, &epoch, epoch + 1, false,
+				    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+/*
+ * A node retired in epoch e was unlinked before e was read, so threads
+ * that can still see it entered e or earlier. They have all left once the
+ * epoch reaches e + 2.
+ */
+static void ut_skip_map_retire(ut_skip_map_t *self, struct ut_skip_record *rec,
+			       struct ut_skip_node *node)
+{
+	struct ut_skip_limbo *limbo;
+	size_t epoch;
+	int i;
+
+	epoch = __atomic_load_n(&self->epoch, __ATOMIC_SEQ_CST);
+	limbo = &rec->limbo[epoch % 3];
+
+	if (limbo->epoch != epoch) {
+		ut_skip_map_free_limbo(self, limbo);
+		limbo->epoch = epoch;
+	}
+
+	node->limbo = limbo->head;
+	limbo->head = node;
+
+	if (++rec->retired < UT_SKIP_RETIRE_BATCH)
+		return;
+
+	rec->retired = 0;
+	ut_skip_map_try_advance(self);
+	epoch = __atomic_load_n(&self->epoch, __ATOMIC_SEQ_CST);
+
+	for (i = 0; i < 3; i++) {
+		if (rec->limbo[i].epoch + 2 <= epoch)
+			ut_skip_map_free_limbo(self, &rec->limbo[i]);
+	}
+}
+
+static void ut_skip_map_release(ut_skip_map_t *self, struct ut_skip_record *rec,
+				struct ut_skip_node *node)
+{
+	if (__atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0)
+		ut_skip_map_retire(self, rec, node);
+}
+
+static struct ut_skip_record *ut_skip_map_enter(ut_skip_map_t *self)
+{
+	struct ut_skip_record *rec = ut_skip_map_record(self);
+	size_t epoch;
+
+	if (!rec || rec->nesting++)
+		return rec;
+
+	/* Announce the epoch and make sure it did not move meanwhile. */
+	do {
+		epoch = __atomic_load_n(&self->epoch, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&rec->state, epoch << 1 | 1, __ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&self->epoch, __ATOMIC_SEQ_CST) != epoch);
+
+	return rec;
+}
+
+static void ut_skip_map_leave(struct ut_skip_record *rec)
+{
+	if (!--rec->nesting)
+		__atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Finds the predecessor and successor of key on every level, unlinking the
+ * marked nodes it passes. Returns true if the level 0 successor is key.
+ */
+static bool ut_skip_map_find(ut_skip_map_t *self, const void *key,
+			     struct ut_skip_node **preds,
+			     struct ut_skip_node **succs)
+{
+	struct ut_skip_node *pred, *curr;
+	uintptr_t expected, next;
+	int level, top, cmp = 1;
+
+	top = __atomic_load_n(&self->level, __ATOMIC_ACQUIRE);
+
+	for (level = UT_SKIP_MAX_LEVEL - 1; level >= top; level--) {
+		preds[level] = self->head;
+		succs[level] = ut_skip_ptr(ut_skip_load(self->head, level));
+	}
+
+retry:
+	pred = self->head;
+
+	for (level = top - 1; level >= 0; level--) {
+		curr = ut_skip_ptr(ut_skip_load(pred, level));
+
+		while (curr) {
+			next = ut_skip_load(curr, level);
+
+			if (next & UT_SKIP_MARK) {
+				expected = (uintptr_t)curr;
+				if (!ut_skip_cas(pred, level, &expected,
+						 next & ~UT_SKIP_MARK))
+					goto retry;
+
+				curr = ut_skip_ptr(next);
+				continue;
+			}
+
+			cmp = self->key->compare(key, ut_skip_node_key(curr));
+			if (cmp <= 0)
+				break;
+
+			pred = curr;
+			curr = ut_skip_ptr(next);
+		}
+
+		preds[level] = pred;
+		succs[level] = curr;
+	}
+
+	return succs[0] && cmp == 0;
+}
+
+/* Returns the first node not less than key, without changing the list. */
+static struct ut_skip_node *ut_skip_map_seek(ut_skip_map_t *self,
+					     const void *key)
+{
+	struct ut_skip_node *pred, *curr;
+	uintptr_t next;
+	int level, cmp;
+
+	pred = self->head;
+	curr = NULL;
+	level = __atomic_load_n(&self->level, __ATOMIC_ACQUIRE);
+
+	while (level--) {
+		curr = ut_skip_ptr(ut_skip_load(pred, level));
+
+		while (curr) {
+			next = ut_skip_load(curr, level);
+
+			if (next & UT_SKIP_MARK) {
+				curr = ut_skip_ptr(next);
+				continue;
+			}
+
+			cmp = self->key->compare(key, ut_skip_node_key(curr));
+			if (cmp <= 0)
+				break;
+
+			pred = curr;
+			curr = ut_skip_ptr(next);
+		}
+	}
+
+	return curr;
+}
+
+static struct ut_skip_node *ut_skip_map_search(ut_skip_map_t *self,
+					       const void *key)
+{
+	struct ut_skip_node *node = ut_skip_map_seek(self, key);
+
+	if (!node || self->key->compare(key, ut_skip_node_key(node)) != 0)
+		return NULL;
+
+	return ut_skip_load(node, 0) & UT_SKIP_MARK ? NULL : node;
+}
+
+ut_skip_map_t *ut_skip_map_new(const struct ut_type *key,
+			       const struct ut_type *value)
+{
+	ut_skip_map_t *self;
+
+	if (!key || !key->size || !value)
+		return NULL;
+
+	self = malloc(sizeof(ut_skip_map_t));
+	if (!self)
+		return NULL;
+
+	self->head = calloc(1, sizeof(struct ut_skip_node) +
+				       UT_SKIP_MAX_LEVEL * sizeof(uintptr_t));
+	if (!self->head) {
+		free(self);
+		return NULL;
+	}
+
+	self->head->height = UT_SKIP_MAX_LEVEL;
+	self->len = 0;
+	self->epoch = 0;
+	self->level = 1;
+	ut_thread_registry_init(&self->threads, sizeof(struct ut_skip_record));
+	self->key = key;
+	self->value = value;
+	return self;
+}
+
+static void ut_skip_map_fini_record(struct ut_thread_record *base, void *arg)
+{
+	struct ut_skip_record *rec = (struct ut_skip_record *)base;
+	int i;
+
+	for (i = 0; i < 3; i++)
+		ut_skip_map_free_limbo(arg, &rec->limbo[i]);
+}
+
+void ut_skip_map_delete(ut_skip_map_t *self)
+{
+	struct ut_skip_node *node, *next;
+
+	ut_thread_registry_destroy(&self->threads, ut_skip_map_fini_record,
+				   self);
+
+	for (node = ut_skip_ptr(self->head->next[0]); node; node = next) {
+		next = ut_skip_ptr(node->next[0]);
+		ut_skip_node_delete(node, self);
+	}
+
+	free(self->head);
+	free(self);
+}
+
+int ut_skip_map_pin(ut_skip_map_t *self)
+{
+	return ut_skip_map_enter(self) ? UT_OK : UT_ENOMEM;
+}
+
+void ut_skip_map_unpin(ut_skip_map_t *self)
+{
+	ut_skip_map_leave(ut_skip_map_record(self));
+}
+
+int ut_skip_map_insert(ut_skip_map_t *self, const void *key,
+		       const void *value)
+{
+	struct ut_skip_node *preds[UT_SKIP_MAX_LEVEL];
+	struct ut_skip_node *succs[UT_SKIP_MAX_LEVEL];
+	struct ut_skip_node *node = NULL;
+	struct ut_skip_record *rec;
+	uintptr_t expected, next;
+	int level, top;
+
+	if (!key || !value)
+		return UT_EINVAL;
+
+	rec = ut_skip_map_enter(self);
+	if (!rec)
+		return UT_ENOMEM;
+
+	/* Linking level 0 is what puts the key into the map. */
+	while (true) {
+		if (ut_skip_map_find(self, key, preds, succs)) {
+			free(node);
+			ut_skip_map_leave(rec);
+			return UT_EEXIST;
+		}
+
+		if (!node) {
+			node = ut_skip_node_new(self, rec, key, value);
+			if (!node) {
+				ut_skip_map_leave(rec);
+				return UT_ENOMEM;
+			}
+		}
+
+		for (level = 0; level < node->height; level++)
+			node->next[level] = (uintptr_t)succs[level];
+
+		expected = (uintptr_t)succs[0];
+		if (ut_skip_cas(preds[0], 0, &expected, (uintptr_t)node))
+			break;
+	}
+
+	__atomic_add_fetch(&self->len, 1, __ATOMIC_RELAXED);
+
+	top = __atomic_load_n(&self->level, __ATOMIC_RELAXED);
+	while (top < node->height &&
+	       !__atomic_compare_exchange_n(&self->level, &top, node->height,
+					    false, __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED))
+		;
+
+	/* The upper levels are only shortcuts, a removal may cut them off. */
+	for (level = 1; level < node->height; level++) {
+		while (true) {
+			next = ut_skip_load(node, level);
+			if (next & UT_SKIP_MARK)
+				goto done;
+
+			if (ut_skip_ptr(next) != succs[level] &&
+			    !ut_skip_cas(node, level, &next,
+					 (uintptr_t)succs[level]))
+				continue;
+
+			expected = (uintptr_t)succs[level];
+			if (ut_skip_cas(preds[level], level, &expected,
+					(uintptr_t)node))
+				break;
+
+			ut_skip_map_find(self, key, preds, succs);
+			if (succs[0] != node)
+				goto done;
+		}
+	}
+
+done:
+	/* A removal that raced with the linking may have missed a level. */
+	if (ut_skip_load(node, 0) & UT_SKIP_MARK)
+		ut_skip_map_find(self, key, preds, succs);
+
+	ut_skip_map_release(self, rec, node);
+	ut_skip_map_leave(rec);
+	return UT_OK;
+}
+
+bool ut_skip_map_remove(ut_skip_map_t *self, const void *key)
+{
+	struct ut_skip_node *preds[UT_SKIP_MAX_LEVEL];
+	struct ut_skip_node *succs[UT_SKIP_MAX_LEVEL];
+	struct ut_skip_node *node;
+	struct ut_skip_record *rec;
+	uintptr_t next;
+	int level;
+
+	if (!key)
+		return false;
+
+	rec = ut_skip_map_enter(self);
+	if (!rec)
+		return false;
+
+	if (!ut_skip_map_find(self, key, preds, succs)) {
+		ut_skip_map_leave(rec);
+		return false;
+	}
+
+	node = succs[0];
+
+	/* Mark from the top down, whoever marks level 0 removes the key. */
+	for (level = node->height - 1; level > 0; level--) {
+		next = ut_skip_load(node, level);
+		while (!(next & UT_SKIP_MARK) &&
+		       !ut_skip_cas(node, level, &next, next | UT_SKIP_MARK))
+			;
+	}
+
+	next = ut_skip_load(node, 0);
+	do {
+		if (next & UT_SKIP_MARK) {
+			ut_skip_map_leave(rec);
+			return false;
+		}
+	} while (!ut_skip_cas(node, 0, &next, next | UT_SKIP_MARK));
+
+	__atomic_sub_fetch(&self->len, 1, __ATOMIC_RELAXED);
+
+	/* Unlink the node from every level it is on. */
+	ut_skip_map_find(self, key, preds, succs);
+	ut_skip_map_release(self, rec, node);
+	ut_skip_map_leave(rec);
+	return true;
+}
+
+void *ut_skip_map_get(ut_skip_map_t *self, const void *key)
+{
+	struct ut_skip_record *rec;
+	struct ut_skip_node *node;
+
+	if (!key)
+		return NULL;
+
+	rec = ut_skip_map_enter(self);
+	if (!rec)
+		return NULL;
+
+	node = ut_skip_map_search(self, key);
+	ut_skip_map_leave(rec);
+	return !node ? NULL : ut_skip_node_value(node, self);
+}
+
+bool ut_skip_map_load(ut_skip_map_t *self, const void *key, void *value)
+{
+	struct ut_skip_record *rec;
+	struct ut_skip_node *node;
+
+	if (!key || !value)
+		return false;
+
+	rec = ut_skip_map_enter(self);
+	if (!rec)
+		return false;
+
+	node = ut_skip_map_search(self, key);
+	if (node) {
+		memcpy(value, ut_skip_node_value(node, self),
+		       self->value->size);
+	}
+
+	ut_skip_map_leave(rec);
+	return node != NULL;
+}
+
+size_t ut_skip_map_length(const ut_skip_map_t *self)
+{
+	return __atomic_load_n(&self->len, __ATOMIC_RELAXED);
+}
+
+bool ut_skip_map_is_empty(const ut_skip_map_t *self)
+{
+	return ut_skip_map_length(self) == 0;
+}
+
+static void *ut_skip_map_iter_next(struct __ut_skip_map_iter *self)
+{
+	struct ut_skip_node *curr = self->curr;
+	const ut_skip_map_t *map = self->map;
+	uintptr_t next;
+	void *key;
+
+	while (curr) {
+		next = ut_skip_load(curr, 0);
+		if (!(next & UT_SKIP_MARK))
+			break;
+		curr = ut_skip_ptr(next);
+	}
+
+	if (!curr)
+		return NULL;
+
+	key = ut_skip_node_key(curr);
+	if (self->to && map->key->compare(key, self->to) >= 0)
+		return NULL;
+
+	self->kv.key = key;
+	self->kv.value = ut_skip_node_value(curr, map);
+	self->curr = ut_skip_ptr(ut_skip_load(curr, 0));
+	return &self->kv;
+}
+
+struct ut_iter *ut_skip_map_iter_new(ut_skip_map_t *map)
+{
+	return ut_skip_map_range_iter_new(map, NULL, NULL);
+}
+
+struct ut_iter *ut_skip_map_range_iter_new(ut_skip_map_t *map,
+					   const void *from, const void *to)
+{
+	struct __ut_skip_map_iter *self;
+
+	if (!map)
+		return NULL;
+
+	self = malloc(sizeof(struct __ut_skip_map_iter));
+	if (!self)
+		return NULL;
+
+	if (!ut_skip_map_enter(map)) {
+		free(self);
+		return NULL;
+	}
+
+	self->base.next = (void *)&ut_skip_map_iter_next;
+	self->map = map;
+	self->curr = !from ? ut_skip_ptr(ut_skip_load(map->head, 0)) :
+			     ut_skip_map_seek(map, from);
+	self->to = to;
+	return (struct ut_iter *)self;
+}
+
+void ut_skip_map_iter_delete(struct ut_iter *self)
+{
+	struct __ut_skip_map_iter *iter = (struct __ut_skip_map_iter *)self;
+
+	ut_skip_map_unpin(iter->map);
+	free(iter);
+}
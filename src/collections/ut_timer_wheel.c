@@ -0,0 +1,319 @@
+#include "ut_timer_wheel.h"
+#include "ut_errno.h"
+#include "ut_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define UT_TIMER_WHEEL_BITS 6
+#define UT_TIMER_WHEEL_SLOTS (1 << UT_TIMER_WHEEL_BITS)
+
+/* Enough levels of 6 bits to cover every 64 bit tick. */
+#define UT_TIMER_WHEEL_LEVELS 11
+
+#define UT_TIMER_WHEEL_TOTAL (UT_TIMER_WHEEL_LEVELS * UT_TIMER_WHEEL_SLOTS)
+
+/*
+ * Timers of a slot are on a list whose links point back at the pointer to
+ * them, so a timer unlinks itself without knowing the head. slot is the
+ * index of the slot it is on, counting over all levels. The element
+ * follows the struct.
+ */
+struct ut_timer {
+	struct ut_timer *next;
+	struct ut_timer **pprev;
+	uint64_t expires;
+	size_t slot;
+};
+
+/*
+ * The slot of tick now on the lowest level has been expired already, timers
+ * put there are late and go with the next expire. occupied has a bit for
+ * each slot of a level with timers on it, to skip empty ones.
+ */
+struct __ut_timer_wheel {
+	struct ut_timer *slots[UT_TIMER_WHEEL_TOTAL];
+	uint64_t occupied[UT_TIMER_WHEEL_LEVELS];
+	uint64_t now;
+	size_t len;
+	ut_pool_t *pool;
+	const struct ut_type *element;
+};
+
+static inline void *ut_timer_data(struct ut_timer *timer)
+{
+	return timer + 1;
+}
+
+static inline unsigned ut_timer_wheel_digit(uint64_t tick, unsigned level)
+{
+	return (tick >> (level * UT_TIMER_WHEEL_BITS)) &
+	       (UT_TIMER_WHEEL_SLOTS - 1);
+}
+
+static void ut_timer_wheel_link(ut_timer_wheel_t *self, struct ut_timer *timer)
+{
+	uint64_t diff = timer->expires ^ self->now;
+	unsigned level = 0;
+	struct ut_timer **head;
+
+	if (timer->expires > self->now)
+		level = (63 - __builtin_clzll(diff)) / UT_TIMER_WHEEL_BITS;
+
+	if (timer->expires < self->now)
+		timer->slot = ut_timer_wheel_digit(self->now, 0);
+	else
+		timer->slot = level * UT_TIMER_WHEEL_SLOTS +
+			      ut_timer_wheel_digit(timer->expires, level);
+
+	head = &self->slots[timer->slot];
+	timer->next = *head;
+	if (*head)
+		(*head)->pprev = &timer->next;
+	timer->pprev = head;
+	*head = timer;
+
+	self->occupied[level] |= (uint64_t)1
+				 << (timer->slot % UT_TIMER_WHEEL_SLOTS);
+}
+
+static void ut_timer_wheel_unlink(ut_timer_wheel_t *self,
+				  struct ut_timer *timer)
+{
+	*timer->pprev = timer->next;
+	if (timer->next)
+		timer->next->pprev = timer->pprev;
+
+	if (!self->slots[timer->slot])
+		self->occupied[timer->slot / UT_TIMER_WHEEL_SLOTS] &=
+			~((uint64_t)1 << (timer->slot % UT_TIMER_WHEEL_SLOTS));
+}
+
+/* Moves the timers of a slot down now that the wheel has reached it. */
+static void ut_timer_wheel_cascade(ut_timer_wheel_t *self, size_t slot)
+{
+	struct ut_timer *timer, *next;
+
+	timer = self->slots[slot];
+	self->slots[slot] = NULL;
+	self->occupied[slot / UT_TIMER_WHEEL_SLOTS] &=
+		~((uint64_t)1 << (slot % UT_TIMER_WHEEL_SLOTS));
+
+	for (; timer; timer = next) {
+		next = timer->next;
+		ut_timer_wheel_link(self, timer);
+	}
+}
+
+/*
+ * The next tick at which a slot is due, to expire on the lowest level or
+ * to cascade on the others. A level only holds slots after the digit of
+ * now, and all of them come before any slot of the levels above.
+ */
+static uint64_t ut_timer_wheel_next_event(const ut_timer_wheel_t *self)
+{
+	unsigned level, digit, shift;
+	uint64_t bits, base;
+
+	for (level = 0; level < UT_TIMER_WHEEL_LEVELS; level++) {
+		digit = ut_timer_wheel_digit(self->now, level);
+		bits = self->occupied[level] & ~(((uint64_t)2 << digit) - 1);
+		if (!bits)
+			continue;
+
+		shift = level * UT_TIMER_WHEEL_BITS;
+		base = shift + UT_TIMER_WHEEL_BITS < 64 ?
+			       self->now >> (shift + UT_TIMER_WHEEL_BITS)
+					 << (shift + UT_TIMER_WHEEL_BITS) :
+			       0;
+		return base | (uint64_t)__builtin_ctzll(bits) << shift;
+	}
+
+	return UINT64_MAX;
+}
+
+/* Moves the timers of the current slot of the lowest level to expired. */
+static int ut_timer_wheel_fire(ut_timer_wheel_t *self, ut_array_t *expired)
+{
+	size_t slot = ut_timer_wheel_digit(self->now, 0);
+	struct ut_timer *timer;
+	int err;
+
+	while ((timer = self->slots[slot])) {
+		err = ut_array_push(expired, ut_timer_data(timer));
+		if (err)
+			return err;
+
+		ut_timer_wheel_unlink(self, timer);
+		ut_pool_free(self->pool, timer);
+		self->len--;
+	}
+
+	return UT_OK;
+}
+
+ut_timer_wheel_t *ut_timer_wheel_new(const struct ut_type *element,
+				     uint64_t now)
+{
+	ut_timer_wheel_t *self;
+
+	if (!element || !element->size)
+		return NULL;
+
+	self = malloc(sizeof(ut_timer_wheel_t));
+	if (!self)
+		return NULL;
+
+	self->pool = ut_pool_new(sizeof(struct ut_timer) + element->size);
+	if (!self->pool) {
+		free(self);
+		return NULL;
+	}
+
+	memset(self->slots, 0, sizeof(self->slots));
+	memset(self->occupied, 0, sizeof(self->occupied));
+	self->now = now;
+	self->len = 0;
+	self->element = element;
+	return self;
+}
+
+void ut_timer_wheel_delete(ut_timer_wheel_t *self)
+{
+	ut_timer_wheel_clear(self);
+	ut_pool_delete(self->pool);
+	free(self);
+}
+
+void ut_timer_wheel_clear(ut_timer_wheel_t *self)
+{
+	struct ut_timer *timer;
+	size_t i;
+
+	for (i = 0; self->element->drop && i < UT_TIMER_WHEEL_TOTAL; i++) {
+		for (timer = self->slots[i]; timer; timer = timer->next)
+			self->element->drop(ut_timer_data(timer));
+	}
+
+	memset(self->slots, 0, sizeof(self->slots));
+	memset(self->occupied, 0, sizeof(self->occupied));
+	ut_pool_clear(self->pool);
+	self->len = 0;
+}
+
+int ut_timer_wheel_schedule(ut_timer_wheel_t *self, uint64_t expires,
+			    const void *data, struct ut_timer **timer)
+{
+	struct ut_timer *new_timer;
+
+	if (!data)
+		return UT_EINVAL;
+
+	new_timer = ut_pool_alloc(self->pool);
+	if (!new_timer)
+		return UT_ENOMEM;
+
+	new_timer->expires = expires;
+	memcpy(ut_timer_data(new_timer), data, self->element->size);
+	ut_timer_wheel_link(self, new_timer);
+	self->len++;
+
+	if (timer)
+		*timer = new_timer;
+
+	return UT_OK;
+}
+
+void ut_timer_wheel_reschedule(ut_timer_wheel_t *self, struct ut_timer *timer,
+			       uint64_t expires)
+{
+	ut_timer_wheel_unlink(self, timer);
+	timer->expires = expires;
+	ut_timer_wheel_link(self, timer);
+}
+
+void ut_timer_wheel_cancel(ut_timer_wheel_t *self, struct ut_timer *timer)
+{
+	ut_timer_wheel_unlink(self, timer);
+
+	if (self->element->drop)
+		self->element->drop(ut_timer_data(timer));
+
+	ut_pool_free(self->pool, timer);
+	self->len--;
+}
+
+void *ut_timer_wheel_get(struct ut_timer *timer)
+{
+	return ut_timer_data(timer);
+}
+
+uint64_t ut_timer_wheel_expires(const struct ut_timer *timer)
+{
+	return timer->expires;
+}
+
+int ut_timer_wheel_expire(ut_timer_wheel_t *self, uint64_t now,
+			  ut_array_t *expired)
+{
+	uint64_t next, mask;
+	unsigned level, top;
+	size_t slot;
+	int err;
+
+	if (!expired)
+		return UT_EINVAL;
+
+	err = ut_timer_wheel_fire(self, expired);
+	if (err)
+		return err;
+
+	while (self->len && (next = ut_timer_wheel_next_event(self)) <= now) {
+		self->now = next;
+
+		/* Levels whose slot starts at next, the higher ones first. */
+		for (top = 1; top < UT_TIMER_WHEEL_LEVELS; top++) {
+			mask = ((uint64_t)1 << (top * UT_TIMER_WHEEL_BITS)) - 1;
+			if (next & mask)
+				break;
+		}
+
+		for (level = top - 1; level > 0; level--) {
+			slot = level * UT_TIMER_WHEEL_SLOTS +
+			       ut_timer_wheel_digit(next, level);
+			ut_timer_wheel_cascade(self, slot);
+		}
+
+		err = ut_timer_wheel_fire(self, expired);
+		if (err)
+			return err;
+	}
+
+	if (now > self->now)
+		self->now = now;
+
+	return UT_OK;
+}
+
+uint64_t ut_timer_wheel_now(const ut_timer_wheel_t *self)
+{
+	return self->now;
+}
+
+uint64_t ut_timer_wheel_next_tick(const ut_timer_wheel_t *self)
+{
+	if (self->occupied[0] &
+	    ((uint64_t)1 << ut_timer_wheel_digit(self->now, 0)))
+		return self->now;
+
+	return ut_timer_wheel_next_event(self);
+}
+
+size_t ut_timer_wheel_length(const ut_timer_wheel_t *self)
+{
+	return self->len;
+}
+
+bool ut_timer_wheel_is_empty(const ut_timer_wheel_t *self)
+{
+	return !self->len;
+}
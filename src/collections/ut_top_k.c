@@ -0,0 +1,115 @@
+#include "ut_top_k.h"
+#include "ut_errno.h"
+#include "ut_heap.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The kept elements are a heap with the worst on top, the opposite order
+ * of what is collected. scratch holds an offered element while pushpop
+ * trades it against the top.
+ */
+struct __ut_top_k {
+	ut_heap_t *heap;
+	size_t k;
+	const struct ut_type *element;
+	void *scratch;
+};
+
+static ut_top_k_t *ut_top_k_new_with(const struct ut_type *element,
+				     size_t k, bool min)
+{
+	ut_top_k_t *self;
+
+	if (!element || !element->size || !element->compare || !k)
+		return NULL;
+
+	self = malloc(sizeof(ut_top_k_t));
+	if (!self)
+		return NULL;
+
+	self->heap = min ? ut_heap_new(element) : ut_heap_new_min(element);
+	self->scratch = malloc(element->size);
+	if (!self->heap || !self->scratch) {
+		if (self->heap)
+			ut_heap_delete(self->heap);
+		free(self->scratch);
+		free(self);
+		return NULL;
+	}
+
+	self->k = k;
+	self->element = element;
+	return self;
+}
+
+ut_top_k_t *ut_top_k_new(const struct ut_type *element, size_t k)
+{
+	return ut_top_k_new_with(element, k, false);
+}
+
+ut_top_k_t *ut_top_k_new_min(const struct ut_type *element, size_t k)
+{
+	return ut_top_k_new_with(element, k, true);
+}
+
+void ut_top_k_delete(ut_top_k_t *self)
+{
+	ut_heap_delete(self->heap);
+	free(self->scratch);
+	free(self);
+}
+
+void ut_top_k_clear(ut_top_k_t *self)
+{
+	ut_heap_clear(self->heap);
+}
+
+int ut_top_k_push(ut_top_k_t *self, const void *data)
+{
+	if (!data)
+		return UT_EINVAL;
+
+	if (ut_heap_length(self->heap) < self->k)
+		return ut_heap_push(self->heap, data);
+
+	/* Comes back unchanged if it does not beat the threshold. */
+	memcpy(self->scratch, data, self->element->size);
+	ut_heap_pushpop(self->heap, self->scratch);
+
+	if (self->element->drop)
+		self->element->drop(self->scratch);
+
+	return UT_OK;
+}
+
+void *ut_top_k_threshold(ut_top_k_t *self)
+{
+	if (ut_heap_length(self->heap) < self->k)
+		return NULL;
+
+	return ut_heap_peek(self->heap);
+}
+
+size_t ut_top_k_length(const ut_top_k_t *self)
+{
+	return ut_heap_length(self->heap);
+}
+
+bool ut_top_k_is_empty(const ut_top_k_t *self)
+{
+	return ut_heap_is_empty(self->heap);
+}
+
+struct ut_iter *ut_top_k_drain_iter_new(ut_top_k_t *top_k)
+{
+	if (!top_k)
+		return NULL;
+
+	return ut_heap_drain_iter_new(top_k->heap);
+}
+
+void ut_top_k_iter_delete(struct ut_iter *self)
+{
+	ut_heap_iter_delete(self);
+}
@@ -1,37 +1,49 @@
 #include "ut_tree_map.h"
 #include "ut_errno.h"
-#include "ut_memswap.h"
+#include "ut_mem.h"
+#include "ut_pool.h"
+#include "ut_rb_tree.h"
 #include <stdlib.h>
 #include <string.h>
 
-#define UT_RED 0
-#define UT_BLACK 1
-
+/*
+ * All entries of a map are allocated from its own pool. The finger is the
+ * entry of the last insertion, where the next one is tried first.
+ * finger_last tells whether nothing comes after it.
+ */
 struct __ut_tree_map {
-	ut_tree_entry_t *root;
-	size_t len;
+	struct ut_rb_tree tree;
+	ut_pool_t *pool;
 	const struct ut_type *key;
 	const struct ut_type *value;
+	struct ut_rb_node *finger;
+	bool finger_last;
 };
 
 struct __ut_tree_entry {
-	int color;
-	ut_tree_entry_t *left;
-	ut_tree_entry_t *right;
-	ut_tree_entry_t *parent;
+	struct ut_rb_node node;
 	const struct ut_type *key;
 	const struct ut_type *value;
 };
 
+/* The key follows the entry at the alignment malloc would give it. */
+#define UT_TREE_KEY_OFFSET UT_MEM_ALIGN(sizeof(ut_tree_entry_t))
+
 struct __ut_tree_map_iter {
 	struct ut_iter base;
-	ut_tree_entry_t *curr;
+	struct ut_rb_node *curr;
+	struct ut_rb_node *end;
 	struct ut_pair kv;
 };
 
+static inline ut_tree_entry_t *ut_tree_entry_of(struct ut_rb_node *node)
+{
+	return !node ? NULL : ut_rb_entry(node, ut_tree_entry_t, node);
+}
+
 static inline void *ut_tree_entry_key(ut_tree_entry_t *self)
 {
-	return (uint8_t *)self + sizeof(ut_tree_entry_t);
+	return (uint8_t *)self + UT_TREE_KEY_OFFSET;
 }
 
 static inline void *ut_tree_entry_value(ut_tree_entry_t *self)
@@ -39,44 +51,37 @@ static inline void *ut_tree_entry_value(ut_tree_entry_t *self)
 	return (uint8_t *)ut_tree_entry_key(self) + self->key->size;
 }
 
-static inline bool ut_tree_entry_is_red(ut_tree_entry_t *self)
+static inline void *ut_tree_node_key(struct ut_rb_node *node)
 {
-	return !self ? false : self->color == UT_RED;
+	return ut_tree_entry_key(ut_tree_entry_of(node));
 }
 
-static inline bool ut_tree_entry_is_black(ut_tree_entry_t *self)
+/* The node of the entry that key points into, as the map handed it out. */
+static inline struct ut_rb_node *ut_tree_key_node(const void *key)
 {
-	return !self ? true : self->color == UT_BLACK;
+	return &((ut_tree_entry_t *)((uint8_t *)key -
+				     UT_TREE_KEY_OFFSET))->node;
 }
 
-static inline bool ut_tree_entry_is_root(ut_tree_entry_t *self)
+static inline struct ut_pair ut_tree_entry_pair(struct ut_rb_node *node)
 {
-	return !self ? false : self->parent == NULL;
-}
+	ut_tree_entry_t *self = ut_tree_entry_of(node);
+	struct ut_pair kv = { NULL, NULL };
 
-static inline void *ut_tree_entry_data(ut_tree_entry_t *self)
-{
-	return (uint8_t *)self + sizeof(ut_tree_entry_t);
+	if (self) {
+		kv.key = ut_tree_entry_key(self);
+		kv.value = ut_tree_entry_value(self);
+	}
+
+	return kv;
 }
 
-static ut_tree_entry_t *ut_tree_entry_new(const struct ut_type *key,
-					  const void *key_data,
-					  const struct ut_type *value,
-					  const void *value_data)
+static ut_tree_entry_t *ut_tree_entry_init(ut_tree_entry_t *self,
+					   const struct ut_type *key,
+					   const void *key_data,
+					   const struct ut_type *value,
+					   const void *value_data)
 {
-	ut_tree_entry_t *self;
-	size_t size;
-
-	size = sizeof(ut_tree_entry_t) + key->size + value->size;
-	self = malloc(size);
-
-	if (!self)
-		return NULL;
-
-	self->color = UT_RED;
-	self->left = NULL;
-	self->right = NULL;
-	self->parent = NULL;
 	self->key = key;
 	self->value = value;
 	memcpy(ut_tree_entry_key(self), key_data, key->size);
@@ -84,15 +89,13 @@ static ut_tree_entry_t *ut_tree_entry_new(const struct ut_type *key,
 	return self;
 }
 
-static void ut_tree_entry_delete(ut_tree_entry_t *self)
+static void ut_tree_entry_drop(ut_tree_entry_t *self)
 {
 	if (self->key->drop)
 		self->key->drop(ut_tree_entry_key(self));
 
 	if (self->value->drop)
 		self->value->drop(ut_tree_entry_value(self));
-
-	free(self);
 }
 
 static void ut_tree_entry_update(ut_tree_entry_t *self, const void *value)
@@ -103,317 +106,206 @@ static void ut_tree_entry_update(ut_tree_entry_t *self, const void *value)
 	memcpy(ut_tree_entry_value(self), value, self->value->size);
 }
 
-static void ut_tree_entry_swap(ut_tree_entry_t *self, ut_tree_entry_t *other)
+/*
+ * The search never turning left, and not ending on a node with a right
+ * child, means that key is (or goes) after every other. last is set to
+ * that if not NULL.
+ */
+static struct ut_rb_node **ut_tree_map_get_entry(ut_tree_map_t *self,
+						 const void *key,
+						 struct ut_rb_node **parent,
+						 bool *last)
 {
-	size_t size = self->key->size + self->value->size;
-	ut_memswap(ut_tree_entry_data(self), ut_tree_entry_data(other), size);
-}
+	int cmp;
+	struct ut_rb_node *curr_parent = NULL;
+	struct ut_rb_node **curr = &self->tree.root;
+	bool right = true;
 
-static void ut_tree_map_rotate_left(ut_tree_map_t *self, ut_tree_entry_t *x)
-{
-	ut_tree_entry_t *y;
+	while (*curr) {
+		cmp = self->key->compare(key, ut_tree_node_key(*curr));
 
-	/*
-	 *    x                y
-	 *   / \      -->     / \
-	 *  xl  y            x   yr
-	 *     / \          / \
-	 *    yl  yr       xl  yl
-	 */
+		if (cmp > 0) {
+			curr_parent = *curr;
+			curr = &((*curr)->right);
+		} else if (cmp < 0) {
+			curr_parent = *curr;
+			curr = &((*curr)->left);
+			right = false;
+		} else {
+			break;
+		}
+	}
 
-	y = x->right;
-	x->right = y->left;
+	if (parent)
+		*parent = curr_parent;
 
-	if (y->left)
-		y->left->parent = x;
+	if (last)
+		*last = right && (!*curr || !(*curr)->right);
 
-	y->parent = x->parent;
+	return curr;
+}
 
-	if (!x->parent)
-		self->root = y;
-	else if (x == x->parent->left)
-		x->parent->left = y;
-	else
-		x->parent->right = y;
+/* The child pointer that holds node. */
+static struct ut_rb_node **ut_tree_map_link_of(ut_tree_map_t *self,
+					       struct ut_rb_node *node)
+{
+	if (!node->parent)
+		return &self->tree.root;
 
-	y->left = x;
-	x->parent = y;
+	return node->parent->left == node ? &node->parent->left :
+					    &node->parent->right;
 }
 
-static void ut_tree_map_rotate_right(ut_tree_map_t *self, ut_tree_entry_t *x)
+/*
+ * Like get_entry, but only looks right next to node, with one or two
+ * compares and no descent from the root. Returns NULL if key is not equal
+ * or adjacent to node. node_last may say that nothing comes after node,
+ * which saves walking to its successor.
+ */
+static struct ut_rb_node **ut_tree_map_near_entry(ut_tree_map_t *self,
+						  struct ut_rb_node *node,
+						  bool node_last,
+						  const void *key,
+						  struct ut_rb_node **parent,
+						  bool *last)
 {
-	ut_tree_entry_t *y;
-
-	/*
-	 *      x            y
-	 *     / \    -->   / \
-	 *    y   xr       yl  x
-	 *   / \              / \
-	 *  yl  yr           yr  xr
-	 */
+	struct ut_rb_node *next, *prev;
+	int cmp;
 
-	y = x->left;
-	x->left = y->right;
+	cmp = self->key->compare(key, ut_tree_node_key(node));
 
-	if (y->right)
-		y->right->parent = x;
+	if (cmp == 0) {
+		*parent = node->parent;
+		*last = node_last || !ut_rb_tree_next(node);
+		return ut_tree_map_link_of(self, node);
+	}
 
-	y->parent = x->parent;
+	/*
+	 * Between two neighbours, either the first has no right child or the
+	 * second, the leftmost node of that child, has no left one.
+	 */
+	if (cmp > 0) {
+		next = node_last ? NULL : ut_rb_tree_next(node);
+		if (next &&
+		    self->key->compare(key, ut_tree_node_key(next)) >= 0)
+			return NULL;
+
+		*last = !next;
+		*parent = !node->right ? node : next;
+		return !node->right ? &node->right : &next->left;
+	}
 
-	if (!x->parent)
-		self->root = y;
-	else if (x == x->parent->left)
-		x->parent->left = y;
-	else
-		x->parent->right = y;
+	prev = ut_rb_tree_prev(node);
+	if (prev && self->key->compare(key, ut_tree_node_key(prev)) <= 0)
+		return NULL;
 
-	y->right = x;
-	x->parent = y;
+	*last = false;
+	*parent = !node->left ? node : prev;
+	return !node->left ? &node->left : &prev->right;
 }
 
-static void ut_tree_map_fix_insert(ut_tree_map_t *self, ut_tree_entry_t *node)
+/* Returns the first entry whose key is greater than (or equal to) key. */
+static struct ut_rb_node *ut_tree_map_lower_entry(ut_tree_map_t *self,
+						  const void *key, bool equal)
 {
-	ut_tree_entry_t *parent, *grandparent, *tmp;
-
-	while (true) {
-		if (ut_tree_entry_is_root(node)) {
-			node->color = UT_BLACK;
-			break;
-		}
+	int cmp;
+	struct ut_rb_node *curr = self->tree.root;
+	struct ut_rb_node *found = NULL;
 
-		if (ut_tree_entry_is_black(node->parent))
-			break;
+	while (curr) {
+		cmp = self->key->compare(key, ut_tree_node_key(curr));
 
-		parent = node->parent;
-		grandparent = parent->parent;
-		tmp = grandparent->left;
-
-		if (parent != tmp) { /* parent == grandparent->right */
-			if (ut_tree_entry_is_red(tmp)) {
-				/*
-				 * Case 1: Uncle is red.
-				 *
-				 *     g           G
-				 *    / \         / \
-				 *   U   P  -->  u   p
-				 *        \           \
-				 *         N           N
-				 */
-				parent->color = UT_BLACK;
-				tmp->color = UT_BLACK;
-				grandparent->color = UT_RED;
-				node = grandparent;
-				continue;
-			}
-
-			tmp = parent->right;
-
-			if (node != tmp) {
-				/*
-				 * Case 2: Uncle is black and node is parent's
-				 * left child.
-				 *
-				 *    g           g
-				 *   / \         / \
-				 *  u   P  -->  u   N
-				 *     /             \
-				 *    N               P
-				 */
-				ut_tree_map_rotate_right(self, parent);
-			}
-
-			/*
-			 * Case 3: Uncle is black and node is parent's right
-			 * child.
-			 *
-			 *    g               p
-			 *   / \             / \
-			 *  u   P    -->    G   N
-			 *       \         /
-			 *        N       u
-			 */
-			grandparent->right->color = UT_BLACK;
-			grandparent->color = UT_RED;
-			ut_tree_map_rotate_left(self, grandparent);
-			break;
-		} else { /* parent == grandparent->left */
-			tmp = grandparent->right;
+		if (cmp < 0 || (equal && cmp == 0)) {
+			found = curr;
+			curr = curr->left;
+		} else {
+			curr = curr->right;
+		}
+	}
 
-			if (ut_tree_entry_is_red(tmp)) {
-				parent->color = UT_BLACK;
-				tmp->color = UT_BLACK;
-				grandparent->color = UT_RED;
-				node = grandparent;
-				continue;
-			}
+	return found;
+}
 
-			tmp = parent->left;
+/* Returns the last entry whose key is less than (or equal to) key. */
+static struct ut_rb_node *ut_tree_map_upper_entry(ut_tree_map_t *self,
+						  const void *key, bool equal)
+{
+	int cmp;
+	struct ut_rb_node *curr = self->tree.root;
+	struct ut_rb_node *found = NULL;
 
-			if (node != tmp)
-				ut_tree_map_rotate_left(self, parent);
+	while (curr) {
+		cmp = self->key->compare(key, ut_tree_node_key(curr));
 
-			grandparent->left->color = UT_BLACK;
-			grandparent->color = UT_RED;
-			ut_tree_map_rotate_right(self, grandparent);
-			break;
+		if (cmp > 0 || (equal && cmp == 0)) {
+			found = curr;
+			curr = curr->right;
+		} else {
+			curr = curr->left;
 		}
 	}
+
+	return found;
 }
 
-static void ut_tree_map_fix_remove(ut_tree_map_t *self, ut_tree_entry_t *parent)
+static int ut_tree_map_compare_nodes(const struct ut_rb_node *a,
+				     const struct ut_rb_node *b)
 {
-	ut_tree_entry_t *sibling;
-	ut_tree_entry_t *node = NULL;
+	ut_tree_entry_t *entry = ut_tree_entry_of((struct ut_rb_node *)a);
 
-	while (true) {
-		if (ut_tree_entry_is_root(node))
-			break;
+	return entry->key->compare(ut_tree_entry_key(entry),
+				   ut_tree_node_key((struct ut_rb_node *)b));
+}
 
-		if (ut_tree_entry_is_red(node)) {
-			node->color = UT_BLACK;
-			break;
-		}
+/* Gives an entry that a set operation dropped back to its pool. */
+static void ut_tree_map_release(struct ut_rb_node *node, void *arg)
+{
+	ut_tree_map_t *self = arg;
+	ut_tree_entry_t *entry = ut_tree_entry_of(node);
 
-		if (node == parent->right) {
-			sibling = parent->left;
-
-			if (ut_tree_entry_is_red(sibling)) {
-				/*
-				 * Case 1: Sibling is red.
-				 *
-				 *      p            s
-				 *     / \          / \
-				 *    S   n  -->   sl  P
-				 *   / \              / \
-				 *  sl  sr           sr  n
-				 */
-				parent->color = UT_RED;
-				sibling->color = UT_BLACK;
-				ut_tree_map_rotate_right(self, parent);
-				continue;
-			}
-
-			/*
-			 * Case 2: Sibling is black and has no red children.
-			 *
-			 *      p?            p?
-			 *     / \   -->     / \
-			 *    s   n         S   n
-			 *   / \           / \
-			 *  sl  sr        sl  sr
-			 */
-			if (ut_tree_entry_is_black(sibling->left) &&
-			    ut_tree_entry_is_black(sibling->right)) {
-				sibling->color = UT_RED;
-				node = parent;
-				parent = node->parent;
-				continue;
-			}
-
-			if (ut_tree_entry_is_red(sibling->left)) {
-				/*
-				 * Case 3: Sibling is black and its left child
-				 * is red.
-				 *
-				 *      p?          s?
-				 *     / \         / \
-				 *    s   n  -->  sl  p
-				 *   / \             / \
-				 *  SL  sr?         sr? n
-				 */
-				sibling->left->color = sibling->color;
-				sibling->color = parent->color;
-				parent->color = UT_BLACK;
-				ut_tree_map_rotate_right(self, parent);
-				break;
-			} else {
-				/*
-				 * Case 4: Sibling is black and its right child
-				 * is red.
-				 *
-				 *      p?           sr?
-				 *     / \           / \
-				 *    s   n  -->    s   p
-				 *   / \           /     \
-				 *  sl  SR        sl      n
-				 */
-				sibling->right->color = parent->color;
-				parent->color = UT_BLACK;
-				ut_tree_map_rotate_left(self, sibling);
-				ut_tree_map_rotate_right(self, parent);
-				break;
-			}
-		} else { /* node == parent->left */
-			sibling = parent->right;
-
-			if (ut_tree_entry_is_red(sibling)) {
-				parent->color = UT_RED;
-				sibling->color = UT_BLACK;
-				ut_tree_map_rotate_left(self, parent);
-				continue;
-			}
-
-			if (ut_tree_entry_is_black(sibling->left) &&
-			    ut_tree_entry_is_black(sibling->right)) {
-				sibling->color = UT_RED;
-				node = parent;
-				parent = node->parent;
-				continue;
-			}
-
-			if (ut_tree_entry_is_red(sibling->right)) {
-				sibling->right->color = sibling->color;
-				sibling->color = parent->color;
-				parent->color = UT_BLACK;
-				ut_tree_map_rotate_left(self, parent);
-				break;
-			} else {
-				sibling->left->color = parent->color;
-				parent->color = UT_BLACK;
-				ut_tree_map_rotate_right(self, sibling);
-				ut_tree_map_rotate_left(self, parent);
-				break;
-			}
-		}
-	}
+	ut_tree_entry_drop(entry);
+	ut_pool_free(self->pool, entry);
 }
 
-static void ut_tree_map_remove_all(ut_tree_map_t *self, ut_tree_entry_t *entry)
+static bool ut_tree_map_is_compatible(const ut_tree_map_t *self,
+				      const ut_tree_map_t *other)
 {
-	if (!entry)
-		return;
-
-	ut_tree_map_remove_all(self, entry->left);
-	ut_tree_map_remove_all(self, entry->right);
-	ut_tree_entry_delete(entry);
+	return other && other != self && other->key == self->key &&
+	       other->value == self->value;
 }
 
-static ut_tree_entry_t **ut_tree_map_get_entry(ut_tree_map_t *self,
-					       const void *key,
-					       ut_tree_entry_t **parent)
+/*
+ * Entries are moved between maps in place, so two maps that trade entries
+ * must first allocate from the same pool.
+ */
+static int ut_tree_map_prepare_merge(ut_tree_map_t *self,
+				     ut_tree_map_t *other)
 {
-	int cmp;
-	ut_tree_entry_t *curr_parent = NULL;
-	ut_tree_entry_t **curr = &(self->root);
+	int err;
 
-	while (*curr) {
-		cmp = self->key->compare(key, ut_tree_entry_key(*curr));
+	if (!ut_tree_map_is_compatible(self, other))
+		return UT_EINVAL;
 
-		if (cmp > 0) {
-			curr_parent = *curr;
-			curr = &((*curr)->right);
-		} else if (cmp < 0) {
-			curr_parent = *curr;
-			curr = &((*curr)->left);
-		} else {
-			break;
-		}
+	err = ut_pool_merge(self->pool, other->pool);
+	if (!err) {
+		self->finger = NULL;
+		other->finger = NULL;
 	}
 
-	if (parent)
-		*parent = curr_parent;
+	return err;
+}
 
-	return curr;
+/* Unlinks the entry of node and frees it. */
+static void ut_tree_map_erase(ut_tree_map_t *self, struct ut_rb_node *node)
+{
+	ut_tree_entry_t *entry = ut_tree_entry_of(node);
+
+	if (node == self->finger)
+		self->finger = NULL;
+
+	ut_rb_tree_remove(&self->tree, node);
+	ut_tree_entry_drop(entry);
+	ut_pool_free(self->pool, entry);
 }
 
 ut_tree_map_t *ut_tree_map_new(const struct ut_type *key,
@@ -428,90 +320,272 @@ ut_tree_map_t *ut_tree_map_new(const struct ut_type *key,
 	if (!self)
 		return NULL;
 
-	self->root = NULL;
-	self->len = 0;
+	self->pool = ut_pool_new(UT_TREE_KEY_OFFSET + key->size + value->size);
+	if (!self->pool) {
+		free(self);
+		return NULL;
+	}
+
+	/* The map does its own searches, split and join need the comparator. */
+	ut_rb_tree_init(&self->tree, ut_tree_map_compare_nodes);
 	self->key = key;
 	self->value = value;
+	self->finger = NULL;
+	self->finger_last = false;
+	return self;
+}
+
+ut_tree_map_t *ut_tree_map_new_ranked(const struct ut_type *key,
+				      const struct ut_type *value)
+{
+	return ut_tree_map_new(key, value);
+}
+
+ut_tree_map_t *ut_tree_map_from_sorted(const struct ut_type *key,
+				       const struct ut_type *value,
+				       const void *keys, const void *values,
+				       size_t n)
+{
+	ut_tree_map_t *self;
+	uint8_t *base;
+	size_t stride, i;
+
+	if (!key || !key->size || !value || (n && (!keys || !values)))
+		return NULL;
+
+	for (i = 1; i < n; i++) {
+		if (key->compare((uint8_t *)keys + (i - 1) * key->size,
+				 (uint8_t *)keys + i * key->size) >= 0)
+			return NULL;
+	}
+
+	self = ut_tree_map_new(key, value);
+	if (!self || !n)
+		return self;
+
+	base = ut_pool_alloc_block(self->pool, n);
+	if (!base) {
+		ut_tree_map_delete(self);
+		return NULL;
+	}
+
+	stride = ut_pool_stride(self->pool);
+
+	for (i = 0; i < n; i++) {
+		ut_tree_entry_init((ut_tree_entry_t *)(base + i * stride), key,
+				   (uint8_t *)keys + i * key->size, value,
+				   (uint8_t *)values + i * value->size);
+	}
+
+	ut_rb_tree_build(&self->tree, base, stride, n);
 	return self;
 }
 
 void ut_tree_map_delete(ut_tree_map_t *self)
 {
 	ut_tree_map_clear(self);
+	ut_pool_delete(self->pool);
 	free(self);
 }
 
 void ut_tree_map_clear(ut_tree_map_t *self)
 {
-	if (!self->len)
+	struct ut_rb_node *node;
+
+	/*
+	 * Other maps still have entries in a shared pool. Freeing an entry
+	 * overwrites its parent link, so the walk must not climb.
+	 */
+	if (ut_pool_is_shared(self->pool)) {
+		ut_rb_tree_clear(&self->tree, ut_tree_map_release, self);
+		self->finger = NULL;
 		return;
+	}
 
-	ut_tree_map_remove_all(self, self->root);
-	self->root = NULL;
-	self->len = 0;
+	/* Without drops there is nothing to visit, the slabs just go away. */
+	if (self->key->drop || self->value->drop) {
+		node = ut_rb_tree_first(&self->tree);
+		for (; node; node = ut_rb_tree_next(node))
+			ut_tree_entry_drop(ut_tree_entry_of(node));
+	}
+
+	ut_pool_clear(self->pool);
+	self->tree.root = NULL;
+	self->tree.len = 0;
+	self->finger = NULL;
 }
 
-int ut_tree_map_insert(ut_tree_map_t *self, const void *key, const void *value)
+ut_tree_map_t *ut_tree_map_split(ut_tree_map_t *self, const void *key)
 {
-	ut_tree_entry_t **entry, *parent;
+	ut_tree_map_t *other;
 
-	if (!key || !value)
+	if (!key)
+		return NULL;
+
+	other = malloc(sizeof(ut_tree_map_t));
+	if (!other)
+		return NULL;
+
+	other->pool = ut_pool_share(self->pool);
+	other->key = self->key;
+	other->value = self->value;
+	other->finger = NULL;
+	other->finger_last = false;
+	self->finger = NULL;
+	ut_rb_tree_split(&self->tree, ut_tree_map_lower_entry(self, key, true),
+			 &other->tree);
+	return other;
+}
+
+int ut_tree_map_join(ut_tree_map_t *self, ut_tree_map_t *other)
+{
+	struct ut_rb_node *last, *first;
+	int err;
+
+	if (!ut_tree_map_is_compatible(self, other))
 		return UT_EINVAL;
 
-	entry = ut_tree_map_get_entry(self, key, &parent);
+	last = ut_rb_tree_last(&self->tree);
+	first = ut_rb_tree_first(&other->tree);
+	if (last && first && ut_tree_map_compare_nodes(last, first) >= 0)
+		return UT_EINVAL;
 
-	if (*entry) {
-		ut_tree_entry_update(*entry, value);
-		return UT_OK;
-	} else {
-		*entry = ut_tree_entry_new(self->key, key, self->value, value);
+	err = ut_tree_map_prepare_merge(self, other);
+	if (err)
+		return err;
 
-		if (!*entry)
-			return UT_ENOMEM;
+	ut_rb_tree_join(&self->tree, &other->tree);
+	return UT_OK;
+}
 
-		(*entry)->parent = parent;
-		ut_tree_map_fix_insert(self, *entry);
-		self->len++;
+int ut_tree_map_union(ut_tree_map_t *self, ut_tree_map_t *other)
+{
+	int err = ut_tree_map_prepare_merge(self, other);
+
+	if (err)
+		return err;
+
+	ut_rb_tree_union(&self->tree, &other->tree, ut_tree_map_release, self);
+	return UT_OK;
+}
+
+int ut_tree_map_intersection(ut_tree_map_t *self, ut_tree_map_t *other)
+{
+	int err = ut_tree_map_prepare_merge(self, other);
+
+	if (err)
+		return err;
+
+	ut_rb_tree_intersection(&self->tree, &other->tree, ut_tree_map_release,
+				self);
+	return UT_OK;
+}
+
+int ut_tree_map_difference(ut_tree_map_t *self, ut_tree_map_t *other)
+{
+	int err = ut_tree_map_prepare_merge(self, other);
+
+	if (err)
+		return err;
+
+	ut_rb_tree_difference(&self->tree, &other->tree, ut_tree_map_release,
+			      self);
+	return UT_OK;
+}
+
+/*
+ * Inserts key next to node if it goes there, searching from the root
+ * otherwise, and leaves the finger on its entry.
+ */
+static int ut_tree_map_insert_near(ut_tree_map_t *self,
+				   struct ut_rb_node *node, bool node_last,
+				   const void *key, const void *value)
+{
+	struct ut_rb_node **link = NULL, *parent;
+	ut_tree_entry_t *entry;
+	bool last;
+
+	if (node) {
+		link = ut_tree_map_near_entry(self, node, node_last, key,
+					      &parent, &last);
+	}
+
+	if (!link)
+		link = ut_tree_map_get_entry(self, key, &parent, &last);
+
+	if (*link) {
+		ut_tree_entry_update(ut_tree_entry_of(*link), value);
+		self->finger = *link;
+		self->finger_last = last;
 		return UT_OK;
 	}
+
+	entry = ut_pool_alloc(self->pool);
+	if (!entry)
+		return UT_ENOMEM;
+
+	ut_tree_entry_init(entry, self->key, key, self->value, value);
+	ut_rb_tree_link(&self->tree, &entry->node, parent, link);
+	self->finger = &entry->node;
+	self->finger_last = last;
+	return UT_OK;
 }
 
-void ut_tree_map_remove(ut_tree_map_t *self, const void *key)
+int ut_tree_map_insert(ut_tree_map_t *self, const void *key, const void *value)
 {
-	ut_tree_entry_t **entry, *tmp;
+	if (!key || !value)
+		return UT_EINVAL;
 
-	if (!key)
-		return;
+	return ut_tree_map_insert_near(self, self->finger, self->finger_last,
+				       key, value);
+}
+
+int ut_tree_map_insert_hint(ut_tree_map_t *self, struct ut_pair *hint,
+			    const void *key, const void *value)
+{
+	struct ut_rb_node *node = NULL;
+	int err;
+
+	if (!key || !value)
+		return UT_EINVAL;
 
-	entry = ut_tree_map_get_entry(self, key, 0);
+	if (hint && hint->key)
+		node = ut_tree_key_node(hint->key);
 
-	if (!*entry)
+	err = ut_tree_map_insert_near(self, node, false, key, value);
+	if (!err && hint)
+		*hint = ut_tree_entry_pair(self->finger);
+
+	return err;
+}
+
+void ut_tree_map_remove(ut_tree_map_t *self, const void *key)
+{
+	struct ut_rb_node *node;
+
+	if (!key)
 		return;
 
-	if ((*entry)->left && (*entry)->right) {
-		tmp = *entry;
-		entry = &((*entry)->right);
+	node = *ut_tree_map_get_entry(self, key, NULL, NULL);
 
-		while ((*entry)->left)
-			entry = &((*entry)->left);
+	if (node)
+		ut_tree_map_erase(self, node);
+}
 
-		ut_tree_entry_swap(*entry, tmp);
-	}
+void ut_tree_map_pop_first(ut_tree_map_t *self)
+{
+	struct ut_rb_node *node = ut_rb_tree_first(&self->tree);
 
-	tmp = *entry;
+	if (node)
+		ut_tree_map_erase(self, node);
+}
 
-	if ((*entry)->left || (*entry)->right) {
-		*entry = (*entry)->left ? (*entry)->left : (*entry)->right;
-		(*entry)->color = UT_BLACK;
-		(*entry)->parent = tmp->parent;
-	} else {
-		*entry = NULL;
-		if (tmp->color == UT_BLACK)
-			ut_tree_map_fix_remove(self, tmp->parent);
-	}
+void ut_tree_map_pop_last(ut_tree_map_t *self)
+{
+	struct ut_rb_node *node = ut_rb_tree_last(&self->tree);
 
-	self->len--;
-	ut_tree_entry_delete(tmp);
+	if (node)
+		ut_tree_map_erase(self, node);
 }
 
 void *ut_tree_map_get(ut_tree_map_t *self, const void *key)
@@ -521,78 +595,190 @@ void *ut_tree_map_get(ut_tree_map_t *self, const void *key)
 
 struct ut_pair ut_tree_map_get_key_value(ut_tree_map_t *self, const void *key)
 {
-	ut_tree_entry_t **entry, *parent;
 	struct ut_pair kv = { NULL, NULL };
 
 	if (!key)
 		return kv;
 
-	entry = ut_tree_map_get_entry(self, key, &parent);
+	return ut_tree_entry_pair(*ut_tree_map_get_entry(self, key, NULL,
+							 NULL));
+}
 
-	if (*entry) {
-		kv.key = ut_tree_entry_key(*entry);
-		kv.value = ut_tree_entry_value(*entry);
-	}
+struct ut_pair ut_tree_map_first(ut_tree_map_t *self)
+{
+	return ut_tree_entry_pair(ut_rb_tree_first(&self->tree));
+}
 
-	return kv;
+struct ut_pair ut_tree_map_last(ut_tree_map_t *self)
+{
+	return ut_tree_entry_pair(ut_rb_tree_last(&self->tree));
+}
+
+struct ut_pair ut_tree_map_lower_bound(ut_tree_map_t *self, const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	return ut_tree_entry_pair(ut_tree_map_lower_entry(self, key, true));
+}
+
+struct ut_pair ut_tree_map_upper_bound(ut_tree_map_t *self, const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	return ut_tree_entry_pair(ut_tree_map_lower_entry(self, key, false));
+}
+
+struct ut_pair ut_tree_map_floor(ut_tree_map_t *self, const void *key)
+{
+	struct ut_pair kv = { NULL, NULL };
+
+	if (!key)
+		return kv;
+
+	return ut_tree_entry_pair(ut_tree_map_upper_entry(self, key, true));
+}
+
+struct ut_pair ut_tree_map_ceiling(ut_tree_map_t *self, const void *key)
+{
+	return ut_tree_map_lower_bound(self, key);
+}
+
+struct ut_pair ut_tree_map_select(ut_tree_map_t *self, size_t index)
+{
+	return ut_tree_entry_pair(ut_rb_tree_select(&self->tree, index));
+}
+
+size_t ut_tree_map_rank(ut_tree_map_t *self, const void *key)
+{
+	struct ut_rb_node *node;
+
+	if (!key)
+		return 0;
+
+	node = ut_tree_map_lower_entry(self, key, true);
+	return !node ? self->tree.len : ut_rb_tree_rank(&self->tree, node);
+}
+
+size_t ut_tree_map_count_range(ut_tree_map_t *self, const void *from,
+			       const void *to)
+{
+	size_t begin, end;
+
+	begin = !from ? 0 : ut_tree_map_rank(self, from);
+	end = !to ? self->tree.len : ut_tree_map_rank(self, to);
+	return end > begin ? end - begin : 0;
 }
 
 size_t ut_tree_map_length(const ut_tree_map_t *self)
 {
-	return self->len;
+	return self->tree.len;
 }
 
 bool ut_tree_map_is_empty(const ut_tree_map_t *self)
 {
-	return self->len == 0;
+	return self->tree.len == 0;
 }
 
 static void *ut_tree_map_iter_next(struct __ut_tree_map_iter *self)
 {
-	ut_tree_entry_t *parent;
-
-	if (!self->curr)
+	if (self->curr == self->end)
 		return NULL;
 
-	self->kv.key = ut_tree_entry_key(self->curr);
-	self->kv.value = ut_tree_entry_value(self->curr);
-
-	if (self->curr->right) {
-		self->curr = self->curr->right;
-		while (self->curr->left)
-			self->curr = self->curr->left;
-	} else {
-		parent = self->curr->parent;
-		while (parent && self->curr == parent->right) {
-			self->curr = parent;
-			parent = parent->parent;
-		}
-		self->curr = parent;
-	}
+	self->kv = ut_tree_entry_pair(self->curr);
+	self->curr = ut_rb_tree_next(self->curr);
+	return &self->kv;
+}
 
+static void *ut_tree_map_iter_prev(struct __ut_tree_map_iter *self)
+{
+	if (self->curr == self->end)
+		return NULL;
+
+	self->kv = ut_tree_entry_pair(self->curr);
+	self->curr = ut_rb_tree_prev(self->curr);
 	return &self->kv;
 }
 
-struct ut_iter *ut_tree_map_iter_new(ut_tree_map_t *map)
+static struct ut_iter *ut_tree_map_iter_new_between(void *next,
+						    struct ut_rb_node *begin,
+						    struct ut_rb_node *end)
 {
 	struct __ut_tree_map_iter *self;
 
+	self = malloc(sizeof(struct __ut_tree_map_iter));
+	if (!self)
+		return NULL;
+
+	self->base.next = next;
+	self->curr = begin;
+	self->end = end;
+	return (struct ut_iter *)self;
+}
+
+struct ut_iter *ut_tree_map_iter_new(ut_tree_map_t *map)
+{
 	if (!map)
 		return NULL;
 
-	self = malloc(sizeof(struct __ut_tree_map_iter));
-	if (!self)
+	return ut_tree_map_iter_new_between((void *)&ut_tree_map_iter_next,
+					    ut_rb_tree_first(&map->tree),
+					    NULL);
+}
+
+struct ut_iter *ut_tree_map_rev_iter_new(ut_tree_map_t *map)
+{
+	if (!map)
 		return NULL;
 
-	self->base.next = (void *)&ut_tree_map_iter_next;
-	self->curr = map->root;
+	return ut_tree_map_iter_new_between((void *)&ut_tree_map_iter_prev,
+					    ut_rb_tree_last(&map->tree),
+					    NULL);
+}
 
-	if (self->curr) {
-		while (self->curr->left)
-			self->curr = self->curr->left;
-	}
+struct ut_iter *ut_tree_map_range_iter_new(ut_tree_map_t *map,
+					   const void *from, const void *to)
+{
+	struct ut_rb_node *begin, *end;
 
-	return (struct ut_iter *)self;
+	if (!map)
+		return NULL;
+
+	begin = !from ? ut_rb_tree_first(&map->tree) :
+			ut_tree_map_lower_entry(map, from, true);
+	end = !to ? NULL : ut_tree_map_lower_entry(map, to, true);
+
+	/* An empty range, from is not less than to. */
+	if (from && to && map->key->compare(from, to) >= 0)
+		begin = end;
+
+	return ut_tree_map_iter_new_between((void *)&ut_tree_map_iter_next,
+					    begin, end);
+}
+
+struct ut_iter *ut_tree_map_range_rev_iter_new(ut_tree_map_t *map,
+					       const void *from,
+					       const void *to)
+{
+	struct ut_rb_node *begin, *end;
+
+	if (!map)
+		return NULL;
+
+	begin = !to ? ut_rb_tree_last(&map->tree) :
+		      ut_tree_map_upper_entry(map, to, false);
+	end = !from ? NULL : ut_tree_map_upper_entry(map, from, false);
+
+	if (from && to && map->key->compare(from, to) >= 0)
+		begin = end;
+
+	return ut_tree_map_iter_new_between((void *)&ut_tree_map_iter_prev,
+					    begin, end);
 }
 
 void ut_tree_map_iter_delete(struct ut_iter *self)
@@ -1,21 +1,16 @@
 #include "ut_tree_set.h"
 #include "ut_tree_map.h"
+#include "ut_pool.h"
+#include "ut_rb_tree.h"
 #include <stdlib.h>
 
 struct __ut_tree_map {
-	ut_tree_entry_t *root;
-	size_t len;
-	const struct ut_type *key;
-	const struct ut_type *value;
-};
-
-struct __ut_tree_entry {
-	int color;
-	ut_tree_entry_t *left;
-	ut_tree_entry_t *right;
-	ut_tree_entry_t *parent;
+	struct ut_rb_tree tree;
+	ut_pool_t *pool;
 	const struct ut_type *key;
 	const struct ut_type *value;
+	struct ut_rb_node *finger;
+	bool finger_last;
 };
 
 struct __ut_tree_set {
@@ -36,20 +31,27 @@ static const struct ut_type __ut_null = {
 
 ut_tree_set_t *ut_tree_set_new(const struct ut_type *element)
 {
-	ut_tree_set_t *self;
-
 	if (!element || !element->size)
 		return NULL;
 
-	self = malloc(sizeof(ut_tree_set_t));
-	if (!self)
+	return (ut_tree_set_t *)ut_tree_map_new(element, &__ut_null);
+}
+
+ut_tree_set_t *ut_tree_set_new_ranked(const struct ut_type *element)
+{
+	return ut_tree_set_new(element);
+}
+
+ut_tree_set_t *ut_tree_set_from_sorted(const struct ut_type *element,
+				       const void *data, size_t n)
+{
+	ut_tree_map_t *map;
+
+	if (!element || !element->size)
 		return NULL;
 
-	self->map.root = NULL;
-	self->map.len = 0;
-	self->map.key = element;
-	self->map.value = &__ut_null;
-	return self;
+	map = ut_tree_map_from_sorted(element, &__ut_null, data, data, n);
+	return (ut_tree_set_t *)map;
 }
 
 void ut_tree_set_delete(ut_tree_set_t *self)
@@ -62,29 +64,126 @@ void ut_tree_set_clear(ut_tree_set_t *self)
 	ut_tree_map_clear(&self->map);
 }
 
+ut_tree_set_t *ut_tree_set_split(ut_tree_set_t *self, const void *data)
+{
+	return (ut_tree_set_t *)ut_tree_map_split(&self->map, data);
+}
+
+int ut_tree_set_join(ut_tree_set_t *self, ut_tree_set_t *other)
+{
+	return ut_tree_map_join(&self->map, other ? &other->map : NULL);
+}
+
+int ut_tree_set_union(ut_tree_set_t *self, ut_tree_set_t *other)
+{
+	return ut_tree_map_union(&self->map, other ? &other->map : NULL);
+}
+
+int ut_tree_set_intersection(ut_tree_set_t *self, ut_tree_set_t *other)
+{
+	return ut_tree_map_intersection(&self->map,
+					other ? &other->map : NULL);
+}
+
+int ut_tree_set_difference(ut_tree_set_t *self, ut_tree_set_t *other)
+{
+	return ut_tree_map_difference(&self->map, other ? &other->map : NULL);
+}
+
 int ut_tree_set_insert(ut_tree_set_t *self, const void *data)
 {
 	return ut_tree_map_insert(&self->map, data, data);
 }
 
+int ut_tree_set_insert_hint(ut_tree_set_t *self, void **hint, const void *data)
+{
+	struct ut_pair kv = { NULL, NULL };
+	int err;
+
+	if (hint)
+		kv.key = *hint;
+
+	err = ut_tree_map_insert_hint(&self->map, &kv, data, data);
+	if (!err && hint)
+		*hint = kv.key;
+
+	return err;
+}
+
 void ut_tree_set_remove(ut_tree_set_t *self, const void *data)
 {
 	ut_tree_map_remove(&self->map, data);
 }
 
+void ut_tree_set_pop_first(ut_tree_set_t *self)
+{
+	ut_tree_map_pop_first(&self->map);
+}
+
+void ut_tree_set_pop_last(ut_tree_set_t *self)
+{
+	ut_tree_map_pop_last(&self->map);
+}
+
 void *ut_tree_set_get(ut_tree_set_t *self, const void *data)
 {
 	return ut_tree_map_get_key_value(&self->map, data).key;
 }
 
+void *ut_tree_set_first(ut_tree_set_t *self)
+{
+	return ut_tree_map_first(&self->map).key;
+}
+
+void *ut_tree_set_last(ut_tree_set_t *self)
+{
+	return ut_tree_map_last(&self->map).key;
+}
+
+void *ut_tree_set_lower_bound(ut_tree_set_t *self, const void *data)
+{
+	return ut_tree_map_lower_bound(&self->map, data).key;
+}
+
+void *ut_tree_set_upper_bound(ut_tree_set_t *self, const void *data)
+{
+	return ut_tree_map_upper_bound(&self->map, data).key;
+}
+
+void *ut_tree_set_floor(ut_tree_set_t *self, const void *data)
+{
+	return ut_tree_map_floor(&self->map, data).key;
+}
+
+void *ut_tree_set_ceiling(ut_tree_set_t *self, const void *data)
+{
+	return ut_tree_map_ceiling(&self->map, data).key;
+}
+
+void *ut_tree_set_select(ut_tree_set_t *self, size_t index)
+{
+	return ut_tree_map_select(&self->map, index).key;
+}
+
+size_t ut_tree_set_rank(ut_tree_set_t *self, const void *data)
+{
+	return ut_tree_map_rank(&self->map, data);
+}
+
+size_t ut_tree_set_count_range(ut_tree_set_t *self, const void *from,
+			       const void *to)
+{
+	return ut_tree_map_count_range(&self->map, from, to);
+}
+
 size_t ut_tree_set_length(const ut_tree_set_t *self)
 {
-	return self->map.len;
+	return self->map.tree.len;
 }
 
 bool ut_tree_set_is_empty(const ut_tree_set_t *self)
 {
-	return self->map.len == 0;
+	return self->map.tree.len == 0;
 }
 
 static void *ut_tree_set_iter_next(struct __ut_tree_set_iter *self)
@@ -97,27 +196,61 @@ static void *ut_tree_set_iter_next(struct __ut_tree_set_iter *self)
 		return NULL;
 }
 
-struct ut_iter *ut_tree_set_iter_new(ut_tree_set_t *set)
+static struct ut_iter *ut_tree_set_iter_wrap(struct ut_iter *inner)
 {
 	struct __ut_tree_set_iter *self;
 
-	if (!set)
+	if (!inner)
 		return NULL;
 
 	self = malloc(sizeof(struct __ut_tree_set_iter));
-	if (!self)
-		return NULL;
-
-	self->inner = ut_tree_map_iter_new((ut_tree_map_t *)set);
-	if (!self->inner) {
-		free(self);
+	if (!self) {
+		ut_tree_map_iter_delete(inner);
 		return NULL;
 	}
 
 	self->base.next = (void *)&ut_tree_set_iter_next;
+	self->inner = inner;
 	return (struct ut_iter *)self;
 }
 
+struct ut_iter *ut_tree_set_iter_new(ut_tree_set_t *set)
+{
+	if (!set)
+		return NULL;
+
+	return ut_tree_set_iter_wrap(ut_tree_map_iter_new(&set->map));
+}
+
+struct ut_iter *ut_tree_set_rev_iter_new(ut_tree_set_t *set)
+{
+	if (!set)
+		return NULL;
+
+	return ut_tree_set_iter_wrap(ut_tree_map_rev_iter_new(&set->map));
+}
+
+struct ut_iter *ut_tree_set_range_iter_new(ut_tree_set_t *set,
+					   const void *from, const void *to)
+{
+	if (!set)
+		return NULL;
+
+	return ut_tree_set_iter_wrap(
+		ut_tree_map_range_iter_new(&set->map, from, to));
+}
+
+struct ut_iter *ut_tree_set_range_rev_iter_new(ut_tree_set_t *set,
+					       const void *from,
+					       const void *to)
+{
+	if (!set)
+		return NULL;
+
+	return ut_tree_set_iter_wrap(
+		ut_tree_map_range_rev_iter_new(&set->map, from, to));
+}
+
 void ut_tree_set_iter_delete(struct ut_iter *self)
 {
 	ut_tree_map_iter_delete(((struct __ut_tree_set_iter *)self)->inner);
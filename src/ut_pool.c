@@ -0,0 +1,332 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_pool.h"
+#include "ut_errno.h"
+#include "ut_mem.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* The number of objects in the first slab, later slabs double up to max. */
+#define UT_POOL_MIN_SLAB 16
+#define UT_POOL_MAX_SLAB 4096
+
+/*
+ * A merged pool forwards to the pool it was merged into, only the root of
+ * such a chain owns slabs. Every owner of a pool and every pool forwarding
+ * to it holds a reference. While a chain has more than one reference, the
+ * lock of the root guards its slabs and lists, and parent only changes with
+ * that lock held.
+ */
+struct __ut_pool {
+	pthread_mutex_t lock;
+	size_t stride;
+	size_t count;
+	size_t refs;
+	ut_pool_t *parent;
+	void *slabs;
+	void *last_slab;
+	void *free;
+	void *last_free;
+	uint8_t *cursor;
+	uint8_t *limit;
+};
+
+/*
+ * Each slab starts with the pointer to the previous slab, padded so that
+ * objects are aligned as malloc would align them.
+ */
+#define UT_POOL_HEADER UT_MEM_ALIGN(sizeof(void *))
+
+static ut_pool_t *ut_pool_parent(const ut_pool_t *self)
+{
+	return __atomic_load_n(&self->parent, __ATOMIC_ACQUIRE);
+}
+
+static ut_pool_t *ut_pool_root(ut_pool_t *self)
+{
+	ut_pool_t *parent;
+
+	while ((parent = ut_pool_parent(self)))
+		self = parent;
+
+	return self;
+}
+
+/* Locks the root of self, which a merge may move until it is locked. */
+static ut_pool_t *ut_pool_lock(ut_pool_t *self)
+{
+	ut_pool_t *root;
+
+	while (true) {
+		root = ut_pool_root(self);
+		pthread_mutex_lock(&root->lock);
+		if (!ut_pool_parent(root))
+			return root;
+
+		pthread_mutex_unlock(&root->lock);
+	}
+}
+
+static void *ut_pool_new_slab(ut_pool_t *self, size_t n)
+{
+	uint8_t *slab = malloc(UT_POOL_HEADER + n * self->stride);
+
+	if (!slab)
+		return NULL;
+
+	if (!self->slabs)
+		self->last_slab = slab;
+
+	*(void **)slab = self->slabs;
+	self->slabs = slab;
+	return slab + UT_POOL_HEADER;
+}
+
+static void ut_pool_free_slabs(ut_pool_t *self)
+{
+	void *slab;
+
+	while (self->slabs) {
+		slab = self->slabs;
+		self->slabs = *(void **)slab;
+		free(slab);
+	}
+
+	self->count = UT_POOL_MIN_SLAB;
+	self->last_slab = NULL;
+	self->free = NULL;
+	self->last_free = NULL;
+	self->cursor = NULL;
+	self->limit = NULL;
+}
+
+ut_pool_t *ut_pool_new(size_t size)
+{
+	ut_pool_t *self;
+
+	self = malloc(sizeof(ut_pool_t));
+	if (!self)
+		return NULL;
+
+	if (pthread_mutex_init(&self->lock, NULL)) {
+		free(self);
+		return NULL;
+	}
+
+	if (size < sizeof(void *))
+		size = sizeof(void *);
+
+	self->stride = UT_MEM_ALIGN(size);
+	self->count = UT_POOL_MIN_SLAB;
+	self->refs = 1;
+	self->parent = NULL;
+	self->slabs = NULL;
+	self->last_slab = NULL;
+	self->free = NULL;
+	self->last_free = NULL;
+	self->cursor = NULL;
+	self->limit = NULL;
+	return self;
+}
+
+void ut_pool_delete(ut_pool_t *self)
+{
+	ut_pool_t *parent;
+
+	while (self && !__atomic_sub_fetch(&self->refs, 1, __ATOMIC_ACQ_REL)) {
+		parent = self->parent;
+		ut_pool_free_slabs(self);
+		pthread_mutex_destroy(&self->lock);
+		free(self);
+		self = parent;
+	}
+}
+
+ut_pool_t *ut_pool_share(ut_pool_t *self)
+{
+	__atomic_add_fetch(&self->refs, 1, __ATOMIC_RELAXED);
+	return self;
+}
+
+/*
+ * Only an owner adds references, so a pool that is not shared stays so
+ * until its owner shares it.
+ */
+bool ut_pool_is_shared(const ut_pool_t *self)
+{
+	for (; self; self = ut_pool_parent(self)) {
+		if (__atomic_load_n(&self->refs, __ATOMIC_ACQUIRE) > 1)
+			return true;
+	}
+
+	return false;
+}
+
+/* Locks the roots of self and other in address order. */
+static void ut_pool_lock_pair(ut_pool_t **self, ut_pool_t **other)
+{
+	ut_pool_t *a, *b;
+
+	while (true) {
+		a = ut_pool_root(*self);
+		b = ut_pool_root(*other);
+		if (a == b) {
+			*self = *other = ut_pool_lock(a);
+			return;
+		}
+
+		pthread_mutex_lock(a < b ? &a->lock : &b->lock);
+		pthread_mutex_lock(a < b ? &b->lock : &a->lock);
+		if (!ut_pool_parent(a) && !ut_pool_parent(b)) {
+			*self = a;
+			*other = b;
+			return;
+		}
+
+		pthread_mutex_unlock(&a->lock);
+		pthread_mutex_unlock(&b->lock);
+	}
+}
+
+static void ut_pool_do_merge(ut_pool_t *root, ut_pool_t *other)
+{
+	if (other->slabs) {
+		*(void **)other->last_slab = root->slabs;
+		if (!root->slabs)
+			root->last_slab = other->last_slab;
+		root->slabs = other->slabs;
+	}
+
+	if (other->free) {
+		*(void **)other->last_free = root->free;
+		if (!root->free)
+			root->last_free = other->last_free;
+		root->free = other->free;
+	}
+
+	/* Keep whichever unused run is left, the other one is wasted. */
+	if (root->cursor == root->limit) {
+		root->cursor = other->cursor;
+		root->limit = other->limit;
+	}
+
+	if (root->count < other->count)
+		root->count = other->count;
+
+	other->slabs = NULL;
+	other->last_slab = NULL;
+	other->free = NULL;
+	other->last_free = NULL;
+	other->cursor = NULL;
+	other->limit = NULL;
+	__atomic_add_fetch(&root->refs, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&other->parent, root, __ATOMIC_RELEASE);
+}
+
+int ut_pool_merge(ut_pool_t *self, ut_pool_t *other)
+{
+	ut_pool_t *root = self;
+
+	if (ut_pool_stride(self) != ut_pool_stride(other))
+		return UT_EINVAL;
+
+	ut_pool_lock_pair(&root, &other);
+	if (root != other) {
+		ut_pool_do_merge(root, other);
+		pthread_mutex_unlock(&other->lock);
+	}
+
+	pthread_mutex_unlock(&root->lock);
+	return UT_OK;
+}
+
+void ut_pool_clear(ut_pool_t *self)
+{
+	ut_pool_free_slabs(ut_pool_root(self));
+}
+
+static void *ut_pool_do_alloc(ut_pool_t *self)
+{
+	void *ptr;
+
+	if (self->free) {
+		ptr = self->free;
+		self->free = *(void **)ptr;
+		return ptr;
+	}
+
+	if (self->cursor == self->limit) {
+		self->cursor = ut_pool_new_slab(self, self->count);
+		if (!self->cursor) {
+			self->limit = NULL;
+			return NULL;
+		}
+
+		self->limit = self->cursor + self->count * self->stride;
+		if (self->count < UT_POOL_MAX_SLAB)
+			self->count <<= 1;
+	}
+
+	ptr = self->cursor;
+	self->cursor += self->stride;
+	return ptr;
+}
+
+void *ut_pool_alloc(ut_pool_t *self)
+{
+	void *ptr;
+
+	if (!ut_pool_is_shared(self))
+		return ut_pool_do_alloc(ut_pool_root(self));
+
+	self = ut_pool_lock(self);
+	ptr = ut_pool_do_alloc(self);
+	pthread_mutex_unlock(&self->lock);
+	return ptr;
+}
+
+void *ut_pool_alloc_block(ut_pool_t *self, size_t n)
+{
+	void *ptr;
+
+	if (!n)
+		return NULL;
+
+	if (!ut_pool_is_shared(self))
+		return ut_pool_new_slab(ut_pool_root(self), n);
+
+	self = ut_pool_lock(self);
+	ptr = ut_pool_new_slab(self, n);
+	pthread_mutex_unlock(&self->lock);
+	return ptr;
+}
+
+static void ut_pool_do_free(ut_pool_t *self, void *ptr)
+{
+	if (!self->free)
+		self->last_free = ptr;
+
+	*(void **)ptr = self->free;
+	self->free = ptr;
+}
+
+void ut_pool_free(ut_pool_t *self, void *ptr)
+{
+	if (!ptr)
+		return;
+
+	if (!ut_pool_is_shared(self)) {
+		ut_pool_do_free(ut_pool_root(self), ptr);
+		return;
+	}
+
+	self = ut_pool_lock(self);
+	ut_pool_do_free(self, ptr);
+	pthread_mutex_unlock(&self->lock);
+}
+
+size_t ut_pool_stride(const ut_pool_t *self)
+{
+	return self->stride;
+}
@@ -0,0 +1,213 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_thread.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * The records a thread holds, most recently used first. Each holds a
+ * reference, as does the registry while it lives.
+ */
+struct ut_thread_table {
+	struct ut_thread_record **recs;
+	size_t len;
+	size_t cap;
+};
+
+static pthread_key_t ut_thread_key;
+static pthread_once_t ut_thread_once = PTHREAD_ONCE_INIT;
+static bool ut_thread_key_ok;
+
+static void ut_thread_record_put(struct ut_thread_record *rec)
+{
+	if (__atomic_sub_fetch(&rec->refs, 1, __ATOMIC_ACQ_REL) == 0)
+		free(rec);
+}
+
+static void ut_thread_exit(void *arg)
+{
+	struct ut_thread_table *table = arg;
+	size_t i;
+
+	for (i = 0; i < table->len; i++) {
+		__atomic_store_n(&table->recs[i]->in_use, 0, __ATOMIC_RELEASE);
+		ut_thread_record_put(table->recs[i]);
+	}
+
+	free(table->recs);
+	free(table);
+}
+
+static void ut_thread_init(void)
+{
+	ut_thread_key_ok = !pthread_key_create(&ut_thread_key, ut_thread_exit);
+}
+
+static struct ut_thread_table *ut_thread_table(void)
+{
+	struct ut_thread_table *table;
+
+	pthread_once(&ut_thread_once, ut_thread_init);
+	if (!ut_thread_key_ok)
+		return NULL;
+
+	table = pthread_getspecific(ut_thread_key);
+	if (table)
+		return table;
+
+	table = calloc(1, sizeof(struct ut_thread_table));
+	if (!table)
+		return NULL;
+
+	if (pthread_setspecific(ut_thread_key, table)) {
+		free(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+/* Lets go of the records whose registries are gone. */
+static void ut_thread_table_prune(struct ut_thread_table *self)
+{
+	struct ut_thread_record *rec;
+	size_t i, j;
+
+	for (i = j = 0; i < self->len; i++) {
+		rec = self->recs[i];
+		if (__atomic_load_n(&rec->dead, __ATOMIC_ACQUIRE))
+			ut_thread_record_put(rec);
+		else
+			self->recs[j++] = rec;
+	}
+
+	self->len = j;
+}
+
+static int ut_thread_table_reserve(struct ut_thread_table *self)
+{
+	struct ut_thread_record **recs;
+	size_t cap;
+
+	if (self->len < self->cap)
+		return 0;
+
+	cap = self->cap ? self->cap * 2 : 4;
+	recs = realloc(self->recs, cap * sizeof(struct ut_thread_record *));
+	if (!recs)
+		return -1;
+
+	self->recs = recs;
+	self->cap = cap;
+	return 0;
+}
+
+void ut_thread_registry_init(struct ut_thread_registry *self, size_t size)
+{
+	self->records = NULL;
+	self->size = size;
+}
+
+void ut_thread_registry_destroy(struct ut_thread_registry *self,
+				void (*fini)(struct ut_thread_record *rec,
+					     void *arg),
+				void *arg)
+{
+	struct ut_thread_record *rec, *next;
+
+	for (rec = self->records; rec; rec = next) {
+		next = rec->next;
+		if (fini)
+			fini(rec, arg);
+		__atomic_store_n(&rec->dead, 1, __ATOMIC_RELEASE);
+		ut_thread_record_put(rec);
+	}
+
+	self->records = NULL;
+}
+
+/* Takes over the record of an exited thread, or adds a new one. */
+static struct ut_thread_record *
+ut_thread_registry_claim(struct ut_thread_registry *self)
+{
+	struct ut_thread_record *rec;
+	int expected;
+
+	rec = __atomic_load_n(&self->records, __ATOMIC_ACQUIRE);
+	for (; rec; rec = rec->next) {
+		expected = 0;
+		if (__atomic_compare_exchange_n(&rec->in_use, &expected, 1,
+						false, __ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED)) {
+			__atomic_add_fetch(&rec->refs, 1, __ATOMIC_RELAXED);
+			return rec;
+		}
+	}
+
+	rec = calloc(1, self->size);
+	if (!rec)
+		return NULL;
+
+	rec->owner = self;
+	rec->seed = (uintptr_t)rec | 1;
+	rec->refs = 2;
+	rec->in_use = 1;
+	rec->next = __atomic_load_n(&self->records, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&self->records, &rec->next, rec,
+					    false, __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED))
+		;
+
+	return rec;
+}
+
+struct ut_thread_record *ut_thread_registry_get(struct ut_thread_registry *self)
+{
+	struct ut_thread_table *table = ut_thread_table();
+	struct ut_thread_record *rec;
+	size_t i;
+
+	if (!table)
+		return NULL;
+
+	/* A dead record may carry the address of a newer registry. */
+	for (i = 0; i < table->len; i++) {
+		rec = table->recs[i];
+		if (rec->owner != self ||
+		    __atomic_load_n(&rec->dead, __ATOMIC_ACQUIRE))
+			continue;
+
+		table->recs[i] = table->recs[0];
+		table->recs[0] = rec;
+		return rec;
+	}
+
+	ut_thread_table_prune(table);
+	if (ut_thread_table_reserve(table))
+		return NULL;
+
+	rec = ut_thread_registry_claim(self);
+	if (!rec)
+		return NULL;
+
+	table->recs[table->len++] = rec;
+	return rec;
+}
+
+struct ut_thread_record *
+ut_thread_registry_first(struct ut_thread_registry *self)
+{
+	return __atomic_load_n(&self->records, __ATOMIC_ACQUIRE);
+}
+
+uint64_t ut_thread_random(struct ut_thread_record *rec)
+{
+	uint64_t x = rec->seed;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	rec->seed = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
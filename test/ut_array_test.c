@@ -1,6 +1,8 @@
 #include "ut_array.h"
+#include "ut_errno.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void print_int_array(ut_array_t *a)
 {
@@ -83,9 +85,458 @@ static void test2()
 	ut_array_delete(a);
 }
 
+static int compare_int(const void *a, const void *b)
+{
+	return ut_type_int()->compare(a, b);
+}
+
+/* Random values, many equal values, and already sorted runs. */
+static void fill(ut_array_t *a, int *data, int n, int pattern)
+{
+	int i;
+
+	ut_array_clear(a);
+	for (i = 0; i < n; i++) {
+		if (pattern == 0)
+			data[i] = rand();
+		else if (pattern == 1)
+			data[i] = rand() % 3;
+		else
+			data[i] = pattern == 2 ? i : n - i;
+		ut_array_push(a, &data[i]);
+	}
+	qsort(data, n, sizeof(int), compare_int);
+}
+
+static void test3()
+{
+	ut_array_t *a = ut_array_new(ut_type_int());
+	int data[3000], n, k, pattern, i, x, *p;
+
+	srand(3);
+	for (pattern = 0; pattern < 4; pattern++) {
+		for (n = 1; n <= 3000; n += 457) {
+			k = rand() % n;
+			fill(a, data, n, pattern);
+			ut_array_nth_element(a, k);
+			p = ut_array_get(a, k);
+			for (i = 0; i < n; i++) {
+				x = *(int *)ut_array_get(a, i);
+				if (*p == data[k] && (i >= k || x <= *p) &&
+				    (i <= k || x >= *p))
+					continue;
+				printf("Error! Wrong nth element %d!\n", k);
+				abort();
+			}
+
+			fill(a, data, n, pattern);
+			ut_array_partial_sort(a, k);
+			for (i = 0; i < k; i++) {
+				if (*(int *)ut_array_get(a, i) == data[i])
+					continue;
+				printf("Error! Wrong partial sort %d!\n", k);
+				abort();
+			}
+		}
+	}
+
+	ut_array_delete(a);
+}
+
+static int compare_int_by(const void *a, const void *b, void *ctx)
+{
+	int *calls = ctx;
+
+	(*calls)++;
+	return compare_int(a, b);
+}
+
+static void abort_if_not_sorted(ut_array_t *a, int *data, int n,
+				const char *msg)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (*(int *)ut_array_get(a, i) == data[i])
+			continue;
+		printf("Error! %s %d!\n", msg, n);
+		abort();
+	}
+}
+
+/* Every pattern, by the radix sort, pdqsort and the merge sort. */
+static void test4()
+{
+	ut_array_t *a = ut_array_new(ut_type_int());
+	int data[3000], n, pattern, calls;
+
+	srand(4);
+	for (pattern = 0; pattern < 4; pattern++) {
+		for (n = 0; n <= 3000; n += 157) {
+			fill(a, data, n, pattern);
+			ut_array_sort(a);
+			abort_if_not_sorted(a, data, n, "Wrong sort");
+
+			fill(a, data, n, pattern);
+			calls = 0;
+			ut_array_sort_by(a, compare_int_by, &calls);
+			abort_if_not_sorted(a, data, n, "Wrong sort by");
+			if (pattern >= 2 && n && calls > 4 * n) {
+				printf("Error! Sorted input is not linear!\n");
+				abort();
+			}
+
+			fill(a, data, n, pattern);
+			if (ut_array_sort_stable(a) != UT_OK)
+				abort();
+			abort_if_not_sorted(a, data, n, "Wrong stable sort");
+		}
+	}
+
+	ut_array_delete(a);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int compare_long(const void *a, const void *b)
+{
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Negative, positive and zero values through the radix sort keys. */
+static void test5()
+{
+	static double doubles[1000];
+	static long longs[1000];
+	ut_array_t *d = ut_array_new(ut_type_double());
+	ut_array_t *l = ut_array_new(ut_type_long());
+	ut_array_t *f = ut_array_new(ut_type_float());
+	ut_array_t *u = ut_array_new(ut_type_uint());
+	unsigned ux, uprev;
+	float fx;
+	int i;
+
+	srand(5);
+	for (i = 0; i < 1000; i++) {
+		doubles[i] = (rand() - RAND_MAX / 2) * 1e3 / (i + 1);
+		longs[i] = ((long)rand() << 16) - ((long)rand() << 16);
+		if (i % 10 == 0)
+			doubles[i] = longs[i] = 0;
+		fx = (float)doubles[i];
+		ux = (unsigned)rand() * 3;
+		ut_array_push(d, &doubles[i]);
+		ut_array_push(l, &longs[i]);
+		ut_array_push(f, &fx);
+		ut_array_push(u, &ux);
+	}
+
+	qsort(doubles, 1000, sizeof(double), compare_double);
+	qsort(longs, 1000, sizeof(long), compare_long);
+	ut_array_sort(d);
+	ut_array_sort(l);
+	ut_array_sort(f);
+	ut_array_sort_stable(u);
+
+	for (i = 0; i < 1000; i++) {
+		fx = (float)doubles[i];
+		ux = *(unsigned *)ut_array_get(u, i);
+		if (*(double *)ut_array_get(d, i) != doubles[i] ||
+		    *(long *)ut_array_get(l, i) != longs[i] ||
+		    *(float *)ut_array_get(f, i) != fx ||
+		    (i && ux < uprev)) {
+			printf("Error! Wrong radix sort at %d!\n", i);
+			abort();
+		}
+		uprev = ux;
+	}
+
+	ut_array_delete(u);
+	ut_array_delete(f);
+	ut_array_delete(l);
+	ut_array_delete(d);
+}
+
+struct entry {
+	int key;
+	int order;
+};
+
+static int compare_entry(const void *a, const void *b)
+{
+	return ((const struct entry *)a)->key - ((const struct entry *)b)->key;
+}
+
+/* Equal keys keep the order they were pushed in. */
+static void test6()
+{
+	static const struct ut_type entry_type = {
+		.size = sizeof(struct entry),
+		.compare = compare_entry,
+	};
+	ut_array_t *a = ut_array_new(&entry_type);
+	struct entry e, *p, *q;
+	int i;
+
+	srand(6);
+	for (i = 0; i < 5000; i++) {
+		e.key = rand() % 50;
+		e.order = i;
+		ut_array_push(a, &e);
+	}
+
+	if (ut_array_sort_stable(a) != UT_OK)
+		abort();
+
+	for (i = 1; i < 5000; i++) {
+		p = ut_array_get(a, i - 1);
+		q = ut_array_get(a, i);
+		if (p->key < q->key ||
+		    (p->key == q->key && p->order < q->order))
+			continue;
+		printf("Error! Stable sort moved equal keys at %d!\n", i);
+		abort();
+	}
+
+	ut_array_delete(a);
+}
+
+/* Thread counts that do not split evenly, radix sorted and merged. */
+static void test7()
+{
+	static const struct ut_type entry_type = {
+		.size = sizeof(struct entry),
+		.compare = compare_entry,
+	};
+	static int data[20000];
+	static long longs[20000];
+	static char seen[20000];
+	ut_array_t *a = ut_array_new(ut_type_int());
+	ut_array_t *l = ut_array_new(ut_type_long());
+	ut_array_t *e = ut_array_new(&entry_type);
+	struct entry x, *p, *q;
+	unsigned threads;
+	int i;
+
+	srand(7);
+	for (threads = 2; threads <= 7; threads++) {
+		fill(a, data, 20000, threads % 4);
+		ut_array_sort_parallel(a, threads, 1000);
+		abort_if_not_sorted(a, data, 20000, "Wrong parallel sort");
+
+		ut_array_clear(l);
+		ut_array_clear(e);
+		for (i = 0; i < 20000; i++) {
+			longs[i] = ((long)rand() << 20) - ((long)rand() << 20);
+			x.key = rand() % 1000;
+			x.order = i;
+			ut_array_push(l, &longs[i]);
+			ut_array_push(e, &x);
+		}
+
+		qsort(longs, 20000, sizeof(long), compare_long);
+		ut_array_sort_parallel(l, threads, 1000);
+		ut_array_sort_parallel(e, threads, 1000);
+
+		memset(seen, 0, sizeof(seen));
+		for (i = 0; i < 20000; i++) {
+			p = ut_array_get(e, i > 0 ? i - 1 : 0);
+			q = ut_array_get(e, i);
+			if (*(long *)ut_array_get(l, i) == longs[i] &&
+			    p->key <= q->key && !seen[q->order]++)
+				continue;
+			printf("Error! Wrong parallel sort at %d!\n", i);
+			abort();
+		}
+	}
+
+	ut_array_delete(e);
+	ut_array_delete(l);
+	ut_array_delete(a);
+}
+
+/* Bounds against a linear scan, for inline and called compares. */
+static void test8()
+{
+	static const struct ut_type entry_type = {
+		.size = sizeof(struct entry),
+		.compare = compare_entry,
+	};
+	ut_array_t *a = ut_array_new(ut_type_int());
+	ut_array_t *e = ut_array_new(&entry_type);
+	size_t lo, hi, first, last, many[104];
+	int keys[104], sorted[300], n, i, k;
+	struct entry x;
+
+	srand(8);
+	for (n = 0; n < 300; n += 37) {
+		ut_array_clear(a);
+		ut_array_clear(e);
+		for (i = 0; i < n; i++) {
+			x.key = rand() % 100 - 50;
+			ut_array_push(a, &x.key);
+			ut_array_push(e, &x);
+		}
+		ut_array_sort(a);
+		ut_array_sort(e);
+		for (i = 0; i < n; i++)
+			sorted[i] = *(int *)ut_array_get(a, i);
+
+		for (k = -52; k < 52; k++) {
+			keys[k + 52] = k;
+			for (lo = 0; lo < (size_t)n && sorted[lo] < k; lo++)
+				;
+			for (hi = lo; hi < (size_t)n && sorted[hi] == k; hi++)
+				;
+
+			x.key = k;
+			ut_array_equal_range(a, &k, &first, &last);
+			if (ut_array_lower_bound(a, &k) == lo &&
+			    ut_array_upper_bound(a, &k) == hi &&
+			    first == lo && last == hi &&
+			    ut_array_lower_bound(e, &x) == lo &&
+			    ut_array_upper_bound(e, &x) == hi)
+				continue;
+			printf("Error! Wrong bounds of %d!\n", k);
+			abort();
+		}
+
+		ut_array_lower_bound_many(a, keys, 104, many);
+		if (ut_array_to_eytzinger(a) != UT_OK)
+			abort();
+
+		for (i = 0; i < 104; i++) {
+			k = keys[i];
+			for (lo = 0; lo < (size_t)n && sorted[lo] < k; lo++)
+				;
+			if (many[i] != lo) {
+				printf("Error! Wrong batched bound!\n");
+				abort();
+			}
+
+			hi = ut_array_eytzinger_lower_bound(a, &k);
+			if (lo == (size_t)n ? hi == lo :
+			    hi < (size_t)n &&
+			    *(int *)ut_array_get(a, hi) == sorted[lo])
+				continue;
+			printf("Error! Wrong Eytzinger bound!\n");
+			abort();
+		}
+
+		ut_array_from_eytzinger(a);
+		for (i = 0; i < n; i++) {
+			if (*(int *)ut_array_get(a, i) == sorted[i])
+				continue;
+			printf("Error! Not sorted back from Eytzinger!\n");
+			abort();
+		}
+	}
+
+	ut_array_delete(e);
+	ut_array_delete(a);
+}
+
+/* Range operations against a plain array. */
+static void test9()
+{
+	ut_array_t *a = ut_array_new(ut_type_int());
+	static int model[4096];
+	int data[64], len = 0, i, j, n, index, zero = 0;
+
+	srand(9);
+	for (i = 0; i < 20000; i++) {
+		n = rand() % 64;
+		index = rand() % (len + 1);
+		for (j = 0; j < n; j++)
+			data[j] = rand();
+
+		switch (rand() % 6) {
+		case 0:
+			if (len + n > 4096)
+				break;
+			ut_array_insert_range(a, index, data, n);
+			memmove(model + index + n, model + index,
+				(len - index) * sizeof(int));
+			memcpy(model + index, data, n * sizeof(int));
+			len += n;
+			break;
+		case 1:
+			if (len + n > 4096)
+				break;
+			ut_array_extend(a, data, n);
+			memcpy(model + len, data, n * sizeof(int));
+			len += n;
+			break;
+		case 2:
+			ut_array_remove_range(a, index, n);
+			if (n > len - index)
+				n = len - index;
+			memmove(model + index, model + index + n,
+				(len - index - n) * sizeof(int));
+			len -= n;
+			break;
+		case 3:
+			j = rand() % 64;
+			if (len - j + n > 4096)
+				break;
+			ut_array_splice(a, index, j, data, n);
+			if (j > len - index)
+				j = len - index;
+			memmove(model + index + n, model + index + j,
+				(len - index - j) * sizeof(int));
+			memcpy(model + index, data, n * sizeof(int));
+			len += n - j;
+			break;
+		case 4:
+			if (index == len)
+				break;
+			ut_array_swap_remove(a, index);
+			model[index] = model[--len];
+			break;
+		default:
+			j = index + rand() % 64;
+			if (j > 4096)
+				break;
+			ut_array_resize(a, j, rand() % 2 ? &zero : NULL);
+			for (; len < j; len++)
+				model[len] = 0;
+			len = j;
+			break;
+		}
+
+		if (ut_array_length(a) == (size_t)len &&
+		    (!len || !memcmp(ut_array_get(a, 0), model,
+				     len * sizeof(int))))
+			continue;
+		printf("Error! Wrong range operation at %d!\n", i);
+		abort();
+	}
+
+	if (ut_array_splice(a, len + 1, 0, data, 1) != UT_ERANGE ||
+	    ut_array_extend(a, NULL, 1) != UT_EINVAL) {
+		printf("Error! Bad range accepted!\n");
+		abort();
+	}
+
+	ut_array_delete(a);
+}
+
 int main()
 {
 	test1();
 	test2();
+	test3();
+	test4();
+	test5();
+	test6();
+	test7();
+	test8();
+	test9();
 	return 0;
 }
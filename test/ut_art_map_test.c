@@ -0,0 +1,259 @@
+#include "ut_art_map.h"
+#include "ut_string.h"
+#include "ut_tree_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+/* Both maps hold the same keys in the same order with the same values. */
+static void check_same(ut_art_map_t *art, ut_tree_map_t *tree,
+		       const struct ut_type *key)
+{
+	struct ut_iter *a, *b;
+	struct ut_pair *x, *y;
+
+	abort_if(ut_art_map_length(art) != ut_tree_map_length(tree),
+		 "Wrong length!");
+
+	a = ut_art_map_iter_new(art);
+	b = ut_tree_map_iter_new(tree);
+
+	while ((x = a->next(a))) {
+		y = b->next(b);
+		abort_if(!y, "Extra key!");
+		abort_if(key->compare(x->key, y->key) != 0, "Wrong order!");
+		abort_if(*(int *)x->value != *(int *)y->value, "Wrong value!");
+	}
+	abort_if(b->next(b) != NULL, "Missing key!");
+
+	ut_art_map_iter_delete(a);
+	ut_tree_map_iter_delete(b);
+}
+
+static void test1()
+{
+	ut_art_map_t *art;
+	ut_tree_map_t *tree;
+	int i, key;
+
+	art = ut_art_map_new(ut_type_int(), ut_type_int());
+	tree = ut_tree_map_new(ut_type_int(), ut_type_int());
+
+	srand(1);
+	for (i = 0; i < 20000; i++) {
+		key = rand() % 20000 - 10000;
+		ut_art_map_insert(art, &key, &i);
+		ut_tree_map_insert(tree, &key, &i);
+	}
+	check_same(art, tree, ut_type_int());
+
+	abort_if(*(int *)ut_art_map_first(art).key !=
+			 *(int *)ut_tree_map_first(tree).key,
+		 "Wrong first!");
+	abort_if(*(int *)ut_art_map_last(art).key !=
+			 *(int *)ut_tree_map_last(tree).key,
+		 "Wrong last!");
+
+	for (i = 0; i < 30000; i++) {
+		key = rand() % 20000 - 10000;
+		ut_art_map_remove(art, &key);
+		ut_tree_map_remove(tree, &key);
+		abort_if(ut_art_map_get(art, &key) != NULL,
+			 "Removed key was found!");
+	}
+	check_same(art, tree, ut_type_int());
+
+	abort_if(ut_art_map_new(ut_type_double(), ut_type_int()) != NULL,
+		 "A key without byte order was accepted!");
+
+	ut_art_map_delete(art);
+	ut_tree_map_delete(tree);
+}
+
+static void make_key(char *buf, int r)
+{
+	static const char *bases[] = {
+		"",
+		"a",
+		"ab",
+		"abc",
+		"a long shared prefix/",
+		"a long shared prefix/with more",
+	};
+	int i, n;
+
+	strcpy(buf, bases[r % 6]);
+	r /= 6;
+	n = strlen(buf);
+
+	/* Sometimes a single byte of any value, for the widest nodes. */
+	if (r % 3 == 0) {
+		buf[n++] = 1 + (r / 3) % 255;
+	} else {
+		for (i = 0; i < r % 4; i++) {
+			buf[n++] = 'a' + r % 7;
+			r /= 7;
+		}
+	}
+	buf[n] = '\0';
+}
+
+static void test2()
+{
+	ut_art_map_t *art;
+	ut_tree_map_t *tree;
+	struct ut_string s, t;
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	char buf[64];
+	const char *prefix = "a long shared prefix/";
+	int i, r, count;
+
+	art = ut_art_map_new(ut_type_string(), ut_type_int());
+	tree = ut_tree_map_new(ut_type_string(), ut_type_int());
+
+	srand(2);
+	for (i = 0; i < 20000; i++) {
+		r = rand();
+		make_key(buf, r);
+		ut_string_init(&t, buf);
+
+		/* The maps only take the key if it is new. */
+		if (ut_tree_map_get(tree, &t)) {
+			ut_art_map_insert(art, &t, &i);
+			ut_tree_map_insert(tree, &t, &i);
+			abort_if(*(int *)ut_art_map_get(art, &t) != i,
+				 "Wrong value after update!");
+			ut_string_drop(&t);
+			continue;
+		}
+
+		ut_string_init(&s, buf);
+		ut_art_map_insert(art, &s, &i);
+		ut_tree_map_insert(tree, &t, &i);
+		abort_if(*(int *)ut_art_map_get(art, &t) != i,
+			 "Wrong value after insert!");
+	}
+	check_same(art, tree, ut_type_string());
+
+	count = 0;
+	iter = ut_art_map_prefix_iter_new(art, prefix, strlen(prefix));
+	while ((kv = iter->next(iter))) {
+		abort_if(strncmp(((struct ut_string *)kv->key)->ptr, prefix,
+				 strlen(prefix)) != 0,
+			 "Key without the prefix!");
+		count++;
+	}
+	ut_art_map_iter_delete(iter);
+
+	iter = ut_tree_map_iter_new(tree);
+	while ((kv = iter->next(iter))) {
+		if (!strncmp(((struct ut_string *)kv->key)->ptr, prefix,
+			     strlen(prefix)))
+			count--;
+	}
+	ut_tree_map_iter_delete(iter);
+	abort_if(count != 0, "Wrong prefix scan!");
+
+	iter = ut_art_map_prefix_iter_new(art, "zzz", 3);
+	abort_if(iter->next(iter) != NULL, "Prefix scan is not empty!");
+	ut_art_map_iter_delete(iter);
+
+	for (i = 0; i < 30000; i++) {
+		make_key(buf, rand());
+		s.ptr = buf;
+		s.len = strlen(buf);
+		s.cap = s.len;
+		ut_art_map_remove(art, &s);
+		ut_tree_map_remove(tree, &s);
+	}
+	check_same(art, tree, ut_type_string());
+
+	ut_art_map_clear(art);
+	abort_if(!ut_art_map_is_empty(art), "Not cleared!");
+
+	ut_art_map_delete(art);
+	ut_tree_map_delete(tree);
+}
+
+static void test3()
+{
+	ut_art_map_t *map;
+	struct ut_string s;
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	char buf[64];
+	const char *keys[] = {
+		"0123456789abcdefXYZ",
+		"0123456789abcdefQ",
+		"0123456789abQ",
+		"0123456789abcdefXYZ0123456789",
+	};
+	long big[] = { -5000000000L, 7, -1, 5000000000L };
+	int i;
+
+	map = ut_art_map_new(ut_type_string(), ut_type_int());
+
+	/* Every key is a prefix of the next, one node per key. */
+	for (i = 1; i <= 40; i++) {
+		memset(buf, 'x', i);
+		buf[i] = '\0';
+		ut_art_map_insert(map, ut_string_init(&s, buf), &i);
+	}
+
+	/* Keys that part after more prefix bytes than a node stores. */
+	for (i = 0; i < 4; i++)
+		ut_art_map_insert(map, ut_string_init(&s, keys[i]), &i);
+
+	iter = ut_art_map_prefix_iter_new(map, "0123456789abcd", 14);
+	for (i = 0; (kv = iter->next(iter)); i++)
+		;
+	ut_art_map_iter_delete(iter);
+	abort_if(i != 3, "Wrong long prefix scan!");
+
+	iter = ut_art_map_iter_new(map);
+	for (i = 0; (kv = iter->next(iter)); i++) {
+		if (i < 4)
+			continue;
+		abort_if(((struct ut_string *)kv->key)->len != (size_t)i - 3,
+			 "Wrong deep order!");
+	}
+	ut_art_map_iter_delete(iter);
+	abort_if(i != 44, "Wrong deep length!");
+
+	for (i = 0; i < 4; i++) {
+		s.ptr = (char *)keys[i];
+		s.len = s.cap = strlen(keys[i]);
+		abort_if(*(int *)ut_art_map_get(map, &s) != i,
+			 "Long key is lost!");
+		ut_art_map_remove(map, &s);
+	}
+	ut_art_map_delete(map);
+
+	map = ut_art_map_new(ut_type_long(), ut_type_int());
+	for (i = 0; i < 4; i++)
+		ut_art_map_insert(map, &big[i], &i);
+	abort_if(*(long *)ut_art_map_first(map).key != big[0] ||
+			 *(long *)ut_art_map_last(map).key != big[3],
+		 "Wrong order of longs!");
+	for (i = 0; i < 4; i++)
+		ut_art_map_remove(map, &big[i]);
+	abort_if(!ut_art_map_is_empty(map), "Not empty!");
+	ut_art_map_delete(map);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	return 0;
+}
@@ -0,0 +1,170 @@
+#include "ut_btree_map.h"
+#include "ut_mem.h"
+#include "ut_string.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N 4096
+
+static void abort_if_not_equal1(ut_btree_map_t *map, char *key, int value)
+{
+	size_t len = strlen(key);
+	struct ut_string s = {
+		.ptr = key,
+		.cap = len,
+		.len = len,
+	};
+	int *pvalue = ut_btree_map_get(map, &s);
+	if (!pvalue || *pvalue != value) {
+		printf("Error! No %s or the value of %s is not %d!\n", s.ptr,
+		       s.ptr, value);
+		abort();
+	}
+}
+
+static void test1()
+{
+	ut_btree_map_t *map;
+	struct ut_string tmp;
+	char buf[16];
+	int i;
+
+	map = ut_btree_map_new(ut_type_string(), ut_type_int());
+
+	for (i = 0; i < 1000; i++) {
+		sprintf(buf, "key%d", i);
+		ut_btree_map_insert(map, ut_string_init(&tmp, buf), &i);
+	}
+
+	for (i = 0; i < 1000; i++) {
+		sprintf(buf, "key%d", i);
+		abort_if_not_equal1(map, buf, i);
+	}
+
+	/* Remove the even keys, which also retires many separators. */
+	for (i = 0; i < 1000; i += 2) {
+		sprintf(buf, "key%d", i);
+		ut_string_init(&tmp, buf);
+		ut_btree_map_remove(map, &tmp);
+		ut_string_drop(&tmp);
+	}
+
+	for (i = 1; i < 1000; i += 2) {
+		sprintf(buf, "key%d", i);
+		abort_if_not_equal1(map, buf, i);
+	}
+
+	if (ut_btree_map_length(map) != 500) {
+		puts("Error! The length is not 500!");
+		abort();
+	}
+
+	ut_btree_map_delete(map);
+}
+
+static void test2()
+{
+	ut_btree_map_t *map;
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	static int shadow[N];
+	size_t len = 0, i;
+	int key, value, prev, *p;
+
+	map = ut_btree_map_new(ut_type_int(), ut_type_int());
+
+	srand(1);
+	for (i = 0; i < 200000; i++) {
+		key = rand() % N;
+		if (rand() % 3) {
+			value = rand() | 1;
+			ut_btree_map_insert(map, &key, &value);
+			len += !shadow[key];
+			shadow[key] = value;
+		} else {
+			ut_btree_map_remove(map, &key);
+			len -= !!shadow[key];
+			shadow[key] = 0;
+		}
+
+		if (ut_btree_map_length(map) != len) {
+			printf("Error! The length is not %zu!\n", len);
+			abort();
+		}
+	}
+
+	for (key = 0; key < N; key++) {
+		p = ut_btree_map_get(map, &key);
+		if (shadow[key] ? !p || *p != shadow[key] : !!p) {
+			printf("Error! The entry of %d is wrong!\n", key);
+			abort();
+		}
+	}
+
+	prev = -1;
+	iter = ut_btree_map_iter_new(map);
+	while ((kv = iter->next(iter))) {
+		if (*(int *)kv->key <= prev) {
+			puts("Error! The keys are not in order!");
+			abort();
+		}
+		prev = *(int *)kv->key;
+		len--;
+	}
+	ut_btree_map_iter_delete(iter);
+
+	if (len) {
+		puts("Error! The iterator missed some keys!");
+		abort();
+	}
+
+	ut_btree_map_delete(map);
+}
+
+static int compare_long_double(const void *a, const void *b)
+{
+	long double x = *(const long double *)a, y = *(const long double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Keys in every node are aligned for any type. */
+static void test3()
+{
+	static const struct ut_type key = { sizeof(long double), NULL,
+					    compare_long_double, NULL };
+	static const struct ut_type value = { 12, NULL, NULL, NULL };
+	ut_btree_map_t *map;
+	struct ut_pair kv;
+	char buf[12] = { 0 };
+	long double x;
+	int i;
+
+	map = ut_btree_map_new(&key, &value);
+	for (i = 0; i < N; i++) {
+		x = (i * 7919) % N;
+		ut_btree_map_insert(map, &x, buf);
+	}
+
+	for (i = 0; i < N; i++) {
+		x = i;
+		kv = ut_btree_map_get_key_value(map, &x);
+		if (!kv.key || (uintptr_t)kv.key % UT_MEM_MAX_ALIGN ||
+		    *(long double *)kv.key != x) {
+			printf("Error! Key %d is misaligned!\n", i);
+			abort();
+		}
+	}
+
+	ut_btree_map_delete(map);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include "ut_deque.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void print_int_deque(ut_deque_t *d)
 {
@@ -142,10 +143,80 @@ static void test3()
 	ut_deque_delete(d);
 }
 
+/* Range operations on a deque that wraps around, against a plain array. */
+static void test4()
+{
+	ut_deque_t *d = ut_deque_new(ut_type_int());
+	static int model[4096];
+	int data[64], len = 0, i, j, n, index;
+
+	srand(4);
+	for (i = 0; i < 20000; i++) {
+		n = rand() % 64;
+		index = rand() % (len + 1);
+		for (j = 0; j < n; j++)
+			data[j] = rand();
+
+		switch (rand() % 6) {
+		case 0:
+		case 1:
+			if (len + n > 4096)
+				break;
+			ut_deque_insert_range(d, index, data, n);
+			memmove(model + index + n, model + index,
+				(len - index) * sizeof(int));
+			memcpy(model + index, data, n * sizeof(int));
+			len += n;
+			break;
+		case 2:
+			if (len + n > 4096)
+				break;
+			if (rand() % 2) {
+				ut_deque_extend(d, data, n);
+				memcpy(model + len, data, n * sizeof(int));
+			} else {
+				ut_deque_extend_front(d, data, n);
+				memmove(model + n, model, len * sizeof(int));
+				memcpy(model, data, n * sizeof(int));
+			}
+			len += n;
+			break;
+		case 3:
+		case 4:
+			ut_deque_remove_range(d, index, n);
+			if (n > len - index)
+				n = len - index;
+			memmove(model + index, model + index + n,
+				(len - index - n) * sizeof(int));
+			len -= n;
+			break;
+		default:
+			if (rand() % 2) {
+				ut_deque_truncate(d, index);
+			} else {
+				ut_deque_truncate_front(d, index);
+				memmove(model, model + len - index,
+					index * sizeof(int));
+			}
+			len = index;
+			break;
+		}
+
+		if (ut_deque_length(d) != (size_t)len) {
+			puts("Error! Wrong length after a range operation!");
+			abort();
+		}
+		abort_if_not_equal1(d, model);
+	}
+
+	ut_deque_delete(d);
+}
+
 int main()
 {
 	test1();
 	test2();
 	test3();
+	test4();
 	return 0;
 }
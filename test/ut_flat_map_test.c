@@ -0,0 +1,257 @@
+#include "ut_flat_map.h"
+#include "ut_string.h"
+#include "ut_tree_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+/* Both maps hold the same keys in the same order with the same values. */
+static void check_same(ut_flat_map_t *flat, ut_tree_map_t *tree,
+		       const struct ut_type *key)
+{
+	struct ut_iter *a, *b;
+	struct ut_pair *x, *y;
+
+	abort_if(ut_flat_map_length(flat) != ut_tree_map_length(tree),
+		 "Wrong length!");
+
+	a = ut_flat_map_iter_new(flat);
+	b = ut_tree_map_iter_new(tree);
+
+	while ((x = a->next(a))) {
+		y = b->next(b);
+		abort_if(!y, "Extra key!");
+		abort_if(key->compare(x->key, y->key) != 0, "Wrong order!");
+		abort_if(*(int *)x->value != *(int *)y->value, "Wrong value!");
+	}
+	abort_if(b->next(b) != NULL, "Missing key!");
+
+	ut_flat_map_iter_delete(a);
+	ut_tree_map_iter_delete(b);
+}
+
+static int key_of(struct ut_pair kv)
+{
+	return kv.key ? *(int *)kv.key : -1;
+}
+
+static void test1()
+{
+	ut_flat_map_t *flat;
+	ut_tree_map_t *tree;
+	int i, key;
+
+	flat = ut_flat_map_new(ut_type_int(), ut_type_int());
+	tree = ut_tree_map_new_ranked(ut_type_int(), ut_type_int());
+
+	srand(1);
+	for (i = 0; i < 20000; i++) {
+		key = rand() % 10000;
+		ut_flat_map_insert(flat, &key, &i);
+		ut_tree_map_insert(tree, &key, &i);
+		abort_if(*(int *)ut_flat_map_get(flat, &key) != i,
+			 "Wrong value after insert!");
+	}
+	check_same(flat, tree, ut_type_int());
+
+	/* Queries on keys in and out of the map, lookups in the tail too. */
+	for (i = 0; i < 2000; i++) {
+		key = rand() % 12000 - 1000;
+		if (i % 2) {
+			ut_flat_map_insert(flat, &key, &i);
+			ut_tree_map_insert(tree, &key, &i);
+		}
+
+		abort_if(key_of(ut_flat_map_lower_bound(flat, &key)) !=
+				 key_of(ut_tree_map_lower_bound(tree, &key)),
+			 "Wrong lower bound!");
+		abort_if(key_of(ut_flat_map_upper_bound(flat, &key)) !=
+				 key_of(ut_tree_map_upper_bound(tree, &key)),
+			 "Wrong upper bound!");
+		abort_if(key_of(ut_flat_map_floor(flat, &key)) !=
+				 key_of(ut_tree_map_floor(tree, &key)),
+			 "Wrong floor!");
+		abort_if(key_of(ut_flat_map_ceiling(flat, &key)) !=
+				 key_of(ut_tree_map_ceiling(tree, &key)),
+			 "Wrong ceiling!");
+		abort_if(ut_flat_map_rank(flat, &key) !=
+				 ut_tree_map_rank(tree, &key),
+			 "Wrong rank!");
+		abort_if(key_of(ut_flat_map_select(flat, i)) !=
+				 key_of(ut_tree_map_select(tree, i)),
+			 "Wrong select!");
+	}
+
+	for (i = 0; i < 15000; i++) {
+		key = rand() % 12000 - 1000;
+		ut_flat_map_remove(flat, &key);
+		ut_tree_map_remove(tree, &key);
+		abort_if(ut_flat_map_get(flat, &key) != NULL,
+			 "Removed key was found!");
+
+		/* Keep a few entries in the tail while removing. */
+		if (i % 3 == 0) {
+			ut_flat_map_insert(flat, &i, &key);
+			ut_tree_map_insert(tree, &i, &key);
+		}
+	}
+	check_same(flat, tree, ut_type_int());
+
+	ut_flat_map_pop_first(flat);
+	ut_tree_map_pop_first(tree);
+	ut_flat_map_pop_last(flat);
+	ut_tree_map_pop_last(tree);
+	abort_if(key_of(ut_flat_map_first(flat)) !=
+			 key_of(ut_tree_map_first(tree)),
+		 "Wrong first!");
+	abort_if(key_of(ut_flat_map_last(flat)) !=
+			 key_of(ut_tree_map_last(tree)),
+		 "Wrong last!");
+
+	ut_flat_map_clear(flat);
+	abort_if(!ut_flat_map_is_empty(flat), "Not cleared!");
+	abort_if(ut_flat_map_first(flat).key != NULL, "Empty map has first!");
+	abort_if(ut_flat_map_floor(flat, &key).key != NULL,
+		 "Empty map has floor!");
+
+	ut_flat_map_delete(flat);
+	ut_tree_map_delete(tree);
+}
+
+static void test2()
+{
+	ut_flat_map_t *flat;
+	ut_tree_map_t *tree;
+	int keys[5000], values[5000], i, j, from, to;
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	size_t count;
+
+	flat = ut_flat_map_new(ut_type_int(), ut_type_int());
+	tree = ut_tree_map_new_ranked(ut_type_int(), ut_type_int());
+
+	/* Batches overlap the map and repeat keys, the last value wins. */
+	srand(2);
+	for (j = 0; j < 20; j++) {
+		for (i = 0; i < 5000; i++) {
+			keys[i] = rand() % 30000;
+			values[i] = j * 5000 + i;
+			ut_tree_map_insert(tree, &keys[i], &values[i]);
+		}
+		abort_if(ut_flat_map_insert_many(flat, keys, values, 5000 - j),
+			 "Batch failed!");
+		for (i = 5000 - j; i < 5000; i++)
+			ut_flat_map_insert(flat, &keys[i], &values[i]);
+	}
+	check_same(flat, tree, ut_type_int());
+
+	from = 1000;
+	to = 2000;
+	count = ut_flat_map_count_range(flat, &from, &to);
+	abort_if(count != ut_tree_map_count_range(tree, &from, &to),
+		 "Wrong range count!");
+
+	iter = ut_flat_map_range_rev_iter_new(flat, &from, &to);
+	for (j = to; (kv = iter->next(iter)); count--) {
+		abort_if(*(int *)kv->key >= j || *(int *)kv->key < from,
+			 "Wrong reverse range!");
+		j = *(int *)kv->key;
+	}
+	ut_flat_map_iter_delete(iter);
+	abort_if(count != 0, "Wrong reverse range length!");
+
+	iter = ut_flat_map_range_iter_new(flat, &to, &from);
+	abort_if(iter->next(iter) != NULL, "Inverted range is not empty!");
+	ut_flat_map_iter_delete(iter);
+
+	ut_flat_map_delete(flat);
+	ut_tree_map_delete(tree);
+
+	for (i = 0; i < 100; i++)
+		keys[i] = i * 2;
+	flat = ut_flat_map_from_sorted(ut_type_int(), ut_type_int(), keys,
+				       keys, 100);
+	abort_if(ut_flat_map_length(flat) != 100, "Wrong sorted length!");
+	abort_if(key_of(ut_flat_map_select(flat, 50)) != 100,
+		 "Wrong sorted select!");
+	ut_flat_map_delete(flat);
+
+	keys[10] = keys[9];
+	abort_if(ut_flat_map_from_sorted(ut_type_int(), ut_type_int(), keys,
+					 keys, 100) != NULL,
+		 "Unsorted keys were accepted!");
+}
+
+static void test3()
+{
+	ut_flat_map_t *flat;
+	ut_tree_map_t *tree;
+	struct ut_string keys[300], t;
+	int values[300], i, j, r;
+	char buf[32];
+
+	flat = ut_flat_map_new(ut_type_string(), ut_type_int());
+	tree = ut_tree_map_new(ut_type_string(), ut_type_int());
+
+	/* The flat map drops every key it does not keep. */
+	srand(3);
+	for (j = 0; j < 20; j++) {
+		for (i = 0; i < 300; i++) {
+			r = rand() % 2000;
+			snprintf(buf, sizeof(buf), "key:%d", r);
+			ut_string_init(&keys[i], buf);
+			values[i] = j * 300 + i;
+
+			ut_string_init(&t, buf);
+			if (ut_tree_map_get(tree, &t)) {
+				ut_tree_map_insert(tree, &t, &values[i]);
+				ut_string_drop(&t);
+			} else {
+				ut_tree_map_insert(tree, &t, &values[i]);
+			}
+		}
+
+		if (j % 2) {
+			ut_flat_map_insert_many(flat, keys, values, 300);
+			continue;
+		}
+
+		for (i = 0; i < 300; i++) {
+			if (ut_flat_map_get(flat, &keys[i])) {
+				ut_flat_map_insert(flat, &keys[i], &values[i]);
+				ut_string_drop(&keys[i]);
+			} else {
+				ut_flat_map_insert(flat, &keys[i], &values[i]);
+			}
+		}
+	}
+	check_same(flat, tree, ut_type_string());
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(buf, sizeof(buf), "key:%d", rand() % 2000);
+		t.ptr = buf;
+		t.len = t.cap = strlen(buf);
+		ut_flat_map_remove(flat, &t);
+		ut_tree_map_remove(tree, &t);
+	}
+	check_same(flat, tree, ut_type_string());
+
+	ut_flat_map_delete(flat);
+	ut_tree_map_delete(tree);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	return 0;
+}
@@ -1,4 +1,6 @@
+#include "ut_errno.h"
 #include "ut_heap.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -39,8 +41,200 @@ static void test1()
 	ut_heap_delete(heap);
 }
 
+/* Pops every element, each must not be above the one before. */
+static void check_pops(ut_heap_t *heap, size_t n, int sign)
+{
+	int prev = 0, curr;
+	size_t i;
+
+	if (ut_heap_length(heap) != n) {
+		puts("Error! Wrong length!");
+		abort();
+	}
+
+	for (i = 0; i < n; i++) {
+		curr = *(int *)ut_heap_peek(heap);
+		if (i && (curr - prev) * sign > 0) {
+			printf("Error! %d comes after %d!\n", curr, prev);
+			abort();
+		}
+		prev = curr;
+		ut_heap_pop(heap);
+	}
+
+	if (!ut_heap_is_empty(heap)) {
+		puts("Error! Not empty!");
+		abort();
+	}
+}
+
+/* Orders by the last decimal digit only. */
+static int compare_digit(const void *a, const void *b)
+{
+	return *(const int *)a % 10 - *(const int *)b % 10;
+}
+
+static void test2()
+{
+	ut_heap_t *heap;
+	int data[3000], i, element, prev;
+
+	srand(1);
+	for (i = 0; i < 3000; i++)
+		data[i] = rand() % 10000;
+
+	heap = ut_heap_new(ut_type_int());
+	for (i = 0; i < 1000; i++)
+		ut_heap_push(heap, &data[i]);
+	check_pops(heap, 1000, 1);
+
+	/* A batch smaller and one larger than the heap. */
+	ut_heap_push_many(heap, data, 1000);
+	ut_heap_push_many(heap, data + 1000, 500);
+	ut_heap_push_many(heap, data + 1500, 1500);
+	check_pops(heap, 3000, 1);
+	ut_heap_delete(heap);
+
+	heap = ut_heap_from_array(ut_type_int(), data, 3000);
+	check_pops(heap, 3000, 1);
+	ut_heap_delete(heap);
+
+	heap = ut_heap_new_min(ut_type_int());
+	ut_heap_push_many(heap, data, 2000);
+	for (i = 2000; i < 3000; i++) {
+		ut_heap_replace_top(heap, &data[i]);
+		element = data[i - 1000];
+		prev = element;
+		ut_heap_pushpop(heap, &element);
+		if (element > prev || element > *(int *)ut_heap_peek(heap)) {
+			puts("Error! Wrong pushpop!");
+			abort();
+		}
+	}
+	check_pops(heap, 2000, -1);
+	ut_heap_delete(heap);
+
+	heap = ut_heap_new_by(ut_type_int(), compare_digit);
+	ut_heap_push_many(heap, data, 3000);
+	for (i = 0; i < 3000; i++) {
+		element = *(int *)ut_heap_peek(heap) % 10;
+		data[i] = element;
+		ut_heap_pop(heap);
+	}
+	for (i = 1; i < 3000; i++) {
+		if (data[i] > data[i - 1]) {
+			puts("Error! Wrong custom order!");
+			abort();
+		}
+	}
+	ut_heap_delete(heap);
+}
+
+static void test3()
+{
+	static const size_t arities[] = { 2, 3, 4, 8, 16, 64 };
+	ut_heap_t *heap;
+	int data[5000], i;
+	size_t j;
+
+	srand(3);
+	for (i = 0; i < 5000; i++)
+		data[i] = rand();
+
+	for (j = 0; j < sizeof(arities) / sizeof(arities[0]); j++) {
+		heap = ut_heap_new_min(ut_type_int());
+		ut_heap_push_many(heap, data, 2000);
+		if (ut_heap_set_arity(heap, arities[j]) != UT_OK ||
+		    ut_heap_arity(heap) != arities[j]) {
+			puts("Error! Arity was not set!");
+			abort();
+		}
+		for (i = 2000; i < 5000; i++)
+			ut_heap_push(heap, &data[i]);
+
+		/* The first group of children starts on a cache line. */
+		if ((uintptr_t)((int *)ut_heap_peek(heap) + 1) % 64) {
+			puts("Error! Children are not aligned!");
+			abort();
+		}
+		check_pops(heap, 5000, -1);
+		ut_heap_delete(heap);
+	}
+
+	heap = ut_heap_new(ut_type_int());
+	if (ut_heap_set_arity(heap, 1) != UT_EINVAL ||
+	    ut_heap_set_arity(heap, 65) != UT_EINVAL) {
+		puts("Error! Wrong arity was accepted!");
+		abort();
+	}
+	ut_heap_delete(heap);
+}
+
+static void test4()
+{
+	ut_heap_t *heap;
+	struct ut_iter *iter;
+	int data[1000], i, *p, element, prev = -1;
+
+	srand(4);
+	for (i = 0; i < 1000; i++)
+		data[i] = rand() % 500;
+
+	heap = ut_heap_new_min(ut_type_int());
+	ut_heap_push_many(heap, data, 1000);
+
+	iter = ut_heap_drain_iter_new(heap);
+	for (i = 0; (p = iter->next(iter)); i++) {
+		if (*p < prev) {
+			puts("Error! Drain is out of order!");
+			abort();
+		}
+		prev = *p;
+	}
+	ut_heap_iter_delete(iter);
+
+	if (i != 1000 || !ut_heap_is_empty(heap)) {
+		puts("Error! Heap is not drained!");
+		abort();
+	}
+
+	ut_heap_push_many(heap, data, 1000);
+	for (i = 0, prev = -1; ut_heap_pop_into(heap, &element); i++) {
+		if (element < prev) {
+			puts("Error! Pop into is out of order!");
+			abort();
+		}
+		prev = element;
+	}
+
+	if (i != 1000) {
+		puts("Error! Pop into lost some!");
+		abort();
+	}
+
+	/* NULL data is rejected on an empty heap and a full one alike. */
+	if (ut_heap_push(heap, NULL) != UT_EINVAL ||
+	    ut_heap_replace_top(heap, NULL) != UT_EINVAL) {
+		puts("Error! NULL accepted by an empty heap!");
+		abort();
+	}
+	ut_heap_push(heap, &data[0]);
+	if (ut_heap_push(heap, NULL) != UT_EINVAL ||
+	    ut_heap_replace_top(heap, NULL) != UT_EINVAL ||
+	    ut_heap_length(heap) != 1 ||
+	    *(int *)ut_heap_peek(heap) != data[0]) {
+		puts("Error! NULL accepted by a heap!");
+		abort();
+	}
+
+	ut_heap_delete(heap);
+}
+
 int main()
 {
 	test1();
+	test2();
+	test3();
+	test4();
 	return 0;
 }
@@ -0,0 +1,204 @@
+#include "ut_errno.h"
+#include "ut_indexed_heap.h"
+#include "ut_string.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+/* Random changes checked against a plain array of what each handle holds. */
+static void test1()
+{
+	ut_indexed_heap_t *heap;
+	int shadow[512], i, j, value, best;
+	size_t h;
+
+	heap = ut_indexed_heap_new_min(ut_type_int());
+	for (i = 0; i < 512; i++)
+		shadow[i] = -1;
+
+	srand(1);
+	for (i = 0; i < 50000; i++) {
+		h = rand() % 512;
+		value = rand() % 100000;
+
+		switch (rand() % 5) {
+		case 0:
+		case 1:
+			if (ut_indexed_heap_length(heap) == 512)
+				break;
+			ut_indexed_heap_push(heap, &value, &h);
+			abort_if(h >= 512 || shadow[h] != -1,
+				 "A live handle was given out!");
+			shadow[h] = value;
+			break;
+		case 2:
+			if (ut_indexed_heap_replace(heap, h, &value)) {
+				abort_if(shadow[h] != -1, "Handle is lost!");
+				break;
+			}
+			shadow[h] = value;
+			break;
+		case 3:
+			if (!ut_indexed_heap_contains(heap, h))
+				break;
+			*(int *)ut_indexed_heap_get(heap, h) = value;
+			ut_indexed_heap_update(heap, h);
+			shadow[h] = value;
+			break;
+		default:
+			ut_indexed_heap_remove(heap, h);
+			shadow[h] = -1;
+			break;
+		}
+
+		if (ut_indexed_heap_is_empty(heap))
+			continue;
+
+		best = 100000;
+		for (j = 0; j < 512; j++) {
+			if (shadow[j] != -1 && shadow[j] < best)
+				best = shadow[j];
+		}
+		abort_if(*(int *)ut_indexed_heap_peek(heap) != best,
+			 "Wrong top!");
+
+		h = ut_indexed_heap_peek_handle(heap);
+		abort_if(shadow[h] != best, "Wrong top handle!");
+		if (i % 7 == 0) {
+			ut_indexed_heap_pop(heap);
+			shadow[h] = -1;
+			abort_if(ut_indexed_heap_contains(heap, h),
+				 "Popped handle is still there!");
+		}
+	}
+
+	ut_indexed_heap_clear(heap);
+	abort_if(ut_indexed_heap_peek_handle(heap) != SIZE_MAX, "Not cleared!");
+	ut_indexed_heap_delete(heap);
+}
+
+struct vertex {
+	int dist;
+	int id;
+};
+
+static int compare_dist(const void *a, const void *b)
+{
+	return ((const struct vertex *)b)->dist -
+	       ((const struct vertex *)a)->dist;
+}
+
+/* Dijkstra with decrease-key against the O(V^2) version. */
+static void test2()
+{
+	static int weight[200][200];
+	static const struct ut_type vertex_type = {
+		.size = sizeof(struct vertex),
+	};
+	ut_indexed_heap_t *heap;
+	struct vertex v, *pv;
+	size_t handles[200];
+	int dist[200], slow[200], done[200], n = 200, i, j, u;
+
+	srand(2);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n; j++)
+			weight[i][j] = rand() % 4 ? 0 : 1 + rand() % 100;
+	}
+
+	heap = ut_indexed_heap_new_by(&vertex_type, compare_dist);
+	for (i = 0; i < n; i++) {
+		v.dist = i ? INT32_MAX : 0;
+		v.id = i;
+		ut_indexed_heap_push(heap, &v, &handles[i]);
+	}
+
+	while (!ut_indexed_heap_is_empty(heap)) {
+		v = *(struct vertex *)ut_indexed_heap_peek(heap);
+		ut_indexed_heap_pop(heap);
+		dist[v.id] = v.dist;
+		if (v.dist == INT32_MAX)
+			continue;
+
+		for (j = 0; j < n; j++) {
+			pv = ut_indexed_heap_get(heap, handles[j]);
+			if (!pv || !weight[v.id][j] ||
+			    v.dist + weight[v.id][j] >= pv->dist)
+				continue;
+			pv->dist = v.dist + weight[v.id][j];
+			ut_indexed_heap_update(heap, handles[j]);
+		}
+	}
+	ut_indexed_heap_delete(heap);
+
+	for (i = 0; i < n; i++) {
+		slow[i] = i ? INT32_MAX : 0;
+		done[i] = 0;
+	}
+	for (i = 0; i < n; i++) {
+		for (u = -1, j = 0; j < n; j++) {
+			if (!done[j] && (u < 0 || slow[j] < slow[u]))
+				u = j;
+		}
+		done[u] = 1;
+		for (j = 0; j < n && slow[u] != INT32_MAX; j++) {
+			if (weight[u][j] && slow[u] + weight[u][j] < slow[j])
+				slow[j] = slow[u] + weight[u][j];
+		}
+	}
+
+	abort_if(memcmp(dist, slow, sizeof(dist)) != 0, "Wrong distances!");
+}
+
+/* Handles of dropped strings are reused and nothing leaks. */
+static void test3()
+{
+	ut_indexed_heap_t *heap;
+	struct ut_string s;
+	char buf[16];
+	size_t h, first;
+	int i;
+
+	heap = ut_indexed_heap_new(ut_type_string());
+	for (i = 0; i < 100; i++) {
+		snprintf(buf, sizeof(buf), "s%03d", i);
+		ut_indexed_heap_push(heap, ut_string_init(&s, buf), &h);
+	}
+
+	first = ut_indexed_heap_peek_handle(heap);
+	abort_if(strcmp(((struct ut_string *)ut_indexed_heap_peek(heap))->ptr,
+			"s099") != 0,
+		 "Wrong string top!");
+	ut_indexed_heap_remove(heap, first);
+
+	ut_indexed_heap_push(heap, ut_string_init(&s, "a"), &h);
+	abort_if(h != first, "Free handle was not reused!");
+	ut_indexed_heap_replace(heap, h, ut_string_init(&s, "zzz"));
+	abort_if(ut_indexed_heap_peek_handle(heap) != h, "Wrong new top!");
+	abort_if(ut_indexed_heap_replace(heap, 1000, &s) != UT_EINVAL,
+		 "Unknown handle was replaced!");
+
+	h = 1000;
+	abort_if(ut_indexed_heap_push(heap, NULL, &h) != UT_EINVAL || h != 1000,
+		 "NULL was pushed!");
+	abort_if(ut_indexed_heap_length(heap) != 100, "Wrong length!");
+
+	ut_indexed_heap_delete(heap);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	return 0;
+}
@@ -0,0 +1,189 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_multi_queue.h"
+#include "ut_string.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 4
+#define PER_THREAD 20000
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+/* Relaxed pops hand out everything once and stay near the top. */
+static void test1()
+{
+	ut_multi_queue_t *queue;
+	static int seen[10000];
+	int i, x, prev;
+
+	queue = ut_multi_queue_new_min(ut_type_int(), 8);
+	for (i = 0; i < 10000; i++) {
+		x = (i * 7919) % 10000;
+		ut_multi_queue_push(queue, &x);
+	}
+	abort_if(ut_multi_queue_length(queue) != 10000, "Wrong length!");
+
+	/* The least left is the least not seen yet, x is never far above. */
+	for (i = 0, prev = 0; ut_multi_queue_pop(queue, &x); i++) {
+		abort_if(x < 0 || x >= 10000 || seen[x], "Popped twice!");
+		seen[x] = 1;
+		while (prev < 10000 && seen[prev])
+			prev++;
+		abort_if(x - prev > 1000, "Too far from the top!");
+	}
+	abort_if(i != 10000 || !ut_multi_queue_is_empty(queue), "Not drained!");
+
+	for (i = 0; i < 1000; i++) {
+		x = (i * 7919) % 1000;
+		ut_multi_queue_push(queue, &x);
+	}
+	for (i = 0; ut_multi_queue_pop_strict(queue, &x); i++)
+		abort_if(x != i, "Strict pop is out of order!");
+	abort_if(i != 1000, "Strict pops lost some!");
+
+	ut_multi_queue_delete(queue);
+
+	/* With one heap every pop is strict. */
+	queue = ut_multi_queue_new(ut_type_int(), 1);
+	for (i = 0; i < 1000; i++) {
+		x = (i * 7919) % 1000;
+		ut_multi_queue_push(queue, &x);
+	}
+	for (i = 999; ut_multi_queue_pop(queue, &x); i--)
+		abort_if(x != i, "Single heap is out of order!");
+	ut_multi_queue_delete(queue);
+
+	abort_if(ut_multi_queue_new(ut_type_int(), 0) != NULL,
+		 "No heaps accepted!");
+}
+
+struct worker {
+	ut_multi_queue_t *queue;
+	int id;
+	int *seen;
+};
+
+static void *worker(void *arg)
+{
+	struct worker *w = arg;
+	int i, x;
+
+	for (i = 0; i < PER_THREAD; i++) {
+		x = w->id * PER_THREAD + i;
+		ut_multi_queue_push(w->queue, &x);
+		if (i % 2 && ut_multi_queue_pop(w->queue, &x))
+			__atomic_fetch_add(&w->seen[x], 1, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+/* Threads push and pop at once, nothing is lost or handed out twice. */
+static void test2()
+{
+	static int seen[THREADS * PER_THREAD];
+	struct worker workers[THREADS];
+	pthread_t ids[THREADS];
+	ut_multi_queue_t *queue;
+	int i, x;
+
+	queue = ut_multi_queue_new(ut_type_int(), 2 * THREADS);
+	for (i = 0; i < THREADS; i++) {
+		workers[i].queue = queue;
+		workers[i].id = i;
+		workers[i].seen = seen;
+		pthread_create(&ids[i], NULL, worker, &workers[i]);
+	}
+	for (i = 0; i < THREADS; i++)
+		pthread_join(ids[i], NULL);
+
+	while (ut_multi_queue_pop(queue, &x))
+		seen[x]++;
+
+	for (i = 0; i < THREADS * PER_THREAD; i++)
+		abort_if(seen[i] != 1, "Lost or popped twice!");
+
+	ut_multi_queue_delete(queue);
+}
+
+/* Popped strings belong to the caller, the rest go with the queue. */
+static void test3()
+{
+	ut_multi_queue_t *queue;
+	struct ut_string s;
+	char buf[16];
+	int i;
+
+	queue = ut_multi_queue_new(ut_type_string(), 4);
+	for (i = 0; i < 100; i++) {
+		snprintf(buf, sizeof(buf), "s%03d", i);
+		ut_multi_queue_push(queue, ut_string_init(&s, buf));
+	}
+
+	ut_multi_queue_pop_strict(queue, &s);
+	abort_if(strcmp(s.ptr, "s099") != 0, "Wrong string top!");
+	ut_string_drop(&s);
+
+	ut_multi_queue_pop(queue, &s);
+	ut_string_drop(&s);
+	abort_if(ut_multi_queue_length(queue) != 98, "Wrong string length!");
+
+	ut_multi_queue_delete(queue);
+}
+
+#define QUEUES 2000
+
+static void *use_queues(void *arg)
+{
+	ut_multi_queue_t **queues = arg;
+	int i;
+
+	for (i = 0; i < QUEUES; i++)
+		abort_if(ut_multi_queue_push(queues[i], &i),
+			 "Push failed on a thread!");
+
+	return NULL;
+}
+
+/* Queues share one thread key, so there may be more than keys allow. */
+static void test4()
+{
+	static ut_multi_queue_t *queues[QUEUES];
+	pthread_t thread;
+	int i, x;
+
+	for (i = 0; i < QUEUES; i++) {
+		queues[i] = ut_multi_queue_new(ut_type_int(), 2);
+		abort_if(!queues[i], "Queue not created!");
+		abort_if(ut_multi_queue_push(queues[i], &i), "Push failed!");
+	}
+
+	pthread_create(&thread, NULL, use_queues, queues);
+	pthread_join(thread, NULL);
+
+	for (i = 0; i < QUEUES; i++) {
+		abort_if(ut_multi_queue_length(queues[i]) != 2,
+			 "Wrong length!");
+		abort_if(!ut_multi_queue_pop(queues[i], &x) || x != i,
+			 "Wrong top!");
+		ut_multi_queue_delete(queues[i]);
+	}
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	test4();
+	return 0;
+}
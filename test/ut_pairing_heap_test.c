@@ -0,0 +1,203 @@
+#include "ut_errno.h"
+#include "ut_mem.h"
+#include "ut_pairing_heap.h"
+#include "ut_string.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+/* Random changes checked against a plain array of what each node holds. */
+static void test1()
+{
+	static struct ut_pairing_node *nodes[512];
+	ut_pairing_heap_t *heap;
+	int shadow[512], i, j, value, best;
+	void *top;
+
+	heap = ut_pairing_heap_new_min(ut_type_int());
+	for (i = 0; i < 512; i++)
+		shadow[i] = -1;
+
+	srand(1);
+	for (i = 0; i < 50000; i++) {
+		j = rand() % 512;
+		value = rand() % 100000;
+
+		switch (rand() % 5) {
+		case 0:
+		case 1:
+			if (shadow[j] != -1)
+				break;
+			ut_pairing_heap_push(heap, &value, &nodes[j]);
+			shadow[j] = value;
+			break;
+		case 2:
+		case 3:
+			/* A decrease key, the only way update goes. */
+			if (shadow[j] == -1 || value >= shadow[j])
+				break;
+			*(int *)ut_pairing_heap_get(nodes[j]) = value;
+			ut_pairing_heap_update(heap, nodes[j]);
+			shadow[j] = value;
+			break;
+		default:
+			if (shadow[j] == -1)
+				break;
+			ut_pairing_heap_remove(heap, nodes[j]);
+			shadow[j] = -1;
+			break;
+		}
+
+		if (ut_pairing_heap_is_empty(heap))
+			continue;
+
+		best = 100000;
+		for (j = 0; j < 512; j++) {
+			if (shadow[j] != -1 && shadow[j] < best)
+				best = shadow[j];
+		}
+		abort_if(*(int *)ut_pairing_heap_peek(heap) != best,
+			 "Wrong top!");
+
+		if (i % 7)
+			continue;
+
+		/* The top is one of the nodes, found by where it lives. */
+		top = ut_pairing_heap_peek(heap);
+		for (j = 0; j < 512; j++) {
+			if (shadow[j] != -1 &&
+			    ut_pairing_heap_get(nodes[j]) == top)
+				break;
+		}
+		abort_if(j == 512 || shadow[j] != best, "Top is not a node!");
+		ut_pairing_heap_pop(heap);
+		shadow[j] = -1;
+	}
+
+	ut_pairing_heap_delete(heap);
+}
+
+/* Two heaps melded into one come out in order, and both stay usable. */
+static void test2()
+{
+	ut_pairing_heap_t *a, *b, *c;
+	int i, x, prev;
+
+	a = ut_pairing_heap_new(ut_type_int());
+	b = ut_pairing_heap_new(ut_type_int());
+	c = ut_pairing_heap_new_min(ut_type_int());
+
+	for (i = 0; i < 10000; i++) {
+		x = (i * 7919) % 10000;
+		ut_pairing_heap_push(x % 2 ? a : b, &x, NULL);
+	}
+
+	abort_if(ut_pairing_heap_meld(a, c) != UT_EINVAL,
+		 "Melded opposite orders!");
+	abort_if(ut_pairing_heap_meld(a, b) != UT_OK, "Meld failed!");
+	abort_if(ut_pairing_heap_length(a) != 10000 ||
+			 !ut_pairing_heap_is_empty(b),
+		 "Wrong lengths after meld!");
+
+	/* b allocates from the pool of a now. */
+	x = 20000;
+	ut_pairing_heap_push(b, &x, NULL);
+	ut_pairing_heap_meld(a, b);
+
+	for (i = 0, prev = 20001; !ut_pairing_heap_is_empty(a); i++) {
+		x = *(int *)ut_pairing_heap_peek(a);
+		abort_if(x >= prev, "Melded heap is out of order!");
+		prev = x;
+		ut_pairing_heap_pop(a);
+	}
+	abort_if(i != 10001, "Lost some in the meld!");
+
+	ut_pairing_heap_delete(b);
+	ut_pairing_heap_delete(a);
+	ut_pairing_heap_delete(c);
+}
+
+/* Strings are dropped on pop, remove, clear and delete of shared pools. */
+static void test3()
+{
+	ut_pairing_heap_t *a, *b;
+	struct ut_pairing_node *node;
+	struct ut_string s;
+	char buf[16];
+	int i;
+
+	a = ut_pairing_heap_new(ut_type_string());
+	b = ut_pairing_heap_new(ut_type_string());
+
+	for (i = 0; i < 100; i++) {
+		snprintf(buf, sizeof(buf), "s%03d", i);
+		ut_pairing_heap_push(i % 2 ? a : b, ut_string_init(&s, buf),
+				     &node);
+		if (i % 10 == 5)
+			ut_pairing_heap_remove(a, node);
+	}
+
+	ut_pairing_heap_meld(a, b);
+	abort_if(strcmp(((struct ut_string *)ut_pairing_heap_peek(a))->ptr,
+			"s099") != 0,
+		 "Wrong string top!");
+	ut_pairing_heap_pop(a);
+
+	ut_pairing_heap_push(b, ut_string_init(&s, "b"), NULL);
+	ut_pairing_heap_clear(a);
+	abort_if(ut_pairing_heap_length(b) != 1, "Cleared the other heap!");
+
+	ut_pairing_heap_push(a, ut_string_init(&s, "a"), NULL);
+	ut_pairing_heap_delete(a);
+	ut_pairing_heap_delete(b);
+}
+
+static int compare_long_double(const void *a, const void *b)
+{
+	long double x = *(const long double *)a, y = *(const long double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Elements are aligned for any type. */
+static void test4()
+{
+	static const struct ut_type element = { sizeof(long double), NULL,
+						compare_long_double, NULL };
+	ut_pairing_heap_t *heap;
+	long double x, *top;
+	int i;
+
+	heap = ut_pairing_heap_new_min(&element);
+	for (i = 0; i < 100; i++) {
+		x = (i * 37) % 100;
+		ut_pairing_heap_push(heap, &x, NULL);
+	}
+
+	for (i = 0; i < 100; i++) {
+		top = ut_pairing_heap_peek(heap);
+		abort_if((uintptr_t)top % UT_MEM_MAX_ALIGN, "Misaligned!");
+		abort_if(*top != i, "Wrong top!");
+		ut_pairing_heap_pop(heap);
+	}
+
+	ut_pairing_heap_delete(heap);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	test4();
+	return 0;
+}
@@ -0,0 +1,204 @@
+#include "ut_mem.h"
+#include "ut_persistent_map.h"
+#include "ut_string.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void abort_if_not_equal1(ut_persistent_map_t *map, char *key,
+				int value)
+{
+	size_t len = strlen(key);
+	struct ut_string s = {
+		.ptr = key,
+		.cap = len,
+		.len = len,
+	};
+	int *pvalue = ut_persistent_map_get(map, &s);
+	if (value < 0 ? pvalue != NULL : !pvalue || *pvalue != value) {
+		printf("Error! The value of %s is not %d!\n", s.ptr, value);
+		abort();
+	}
+}
+
+static void test1()
+{
+	ut_persistent_map_t *v0, *v1, *v2, *v3, *tmp;
+	struct ut_string s;
+	char *fruits[] = { "Apple", "Grape", "Orange", "Pear", "Banana" };
+	int i;
+
+	v0 = ut_persistent_map_new(ut_type_string(), ut_type_int());
+
+	/* Each insert makes a new version and the old one is let go. */
+	v1 = ut_persistent_map_snapshot(v0);
+	for (i = 0; i < 5; i++) {
+		ut_string_init(&s, fruits[i]);
+		tmp = ut_persistent_map_insert(v1, &s, &(int){ i * 10 });
+		ut_persistent_map_delete(v1);
+		v1 = tmp;
+	}
+
+	v2 = ut_persistent_map_insert(v1, ut_string_init(&s, "Pear"),
+				      &(int){ 99 });
+	v3 = ut_persistent_map_remove(v2, &(struct ut_string){ "Apple", 5, 5 });
+
+	if (ut_persistent_map_length(v0) != 0 ||
+	    ut_persistent_map_length(v1) != 5 ||
+	    ut_persistent_map_length(v2) != 5 ||
+	    ut_persistent_map_length(v3) != 4) {
+		printf("Error! Wrong lengths!\n");
+		abort();
+	}
+
+	ut_persistent_map_delete(v2);
+
+	abort_if_not_equal1(v0, "Apple", -1);
+	abort_if_not_equal1(v1, "Apple", 0);
+	abort_if_not_equal1(v1, "Pear", 30);
+	abort_if_not_equal1(v3, "Apple", -1);
+	abort_if_not_equal1(v3, "Pear", 99);
+	abort_if_not_equal1(v3, "Banana", 40);
+
+	ut_persistent_map_delete(v1);
+	abort_if_not_equal1(v3, "Grape", 10);
+
+	ut_persistent_map_delete(v3);
+	ut_persistent_map_delete(v0);
+}
+
+#define N 256
+#define VERSIONS 64
+
+/* Every version must keep exactly the keys it had when it was made. */
+static void check_version(ut_persistent_map_t *map, bool *shadow, int *values)
+{
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	int key, prev = -1;
+	size_t len = 0;
+
+	iter = ut_persistent_map_iter_new(map);
+	while ((kv = iter->next(iter))) {
+		key = *(int *)kv->key;
+		if (key <= prev || !shadow[key] ||
+		    *(int *)kv->value != values[key]) {
+			printf("Error! Version has changed at %d!\n", key);
+			abort();
+		}
+		prev = key;
+		len++;
+	}
+	ut_persistent_map_iter_delete(iter);
+
+	for (key = 0; key < N; key++) {
+		if (shadow[key] != (ut_persistent_map_get(map, &key) != NULL)) {
+			printf("Error! Version has changed at %d!\n", key);
+			abort();
+		}
+	}
+
+	if (len != ut_persistent_map_length(map)) {
+		printf("Error! Wrong length!\n");
+		abort();
+	}
+}
+
+static void test2()
+{
+	static bool shadow[VERSIONS][N];
+	static int values[VERSIONS][N];
+	ut_persistent_map_t *versions[VERSIONS];
+	ut_persistent_map_t *curr, *next;
+	int i, j, key;
+
+	srand(1);
+	curr = ut_persistent_map_new(ut_type_int(), ut_type_int());
+
+	for (i = 0; i < VERSIONS; i++) {
+		if (i) {
+			memcpy(shadow[i], shadow[i - 1], sizeof(shadow[i]));
+			memcpy(values[i], values[i - 1], sizeof(values[i]));
+		}
+
+		for (j = 0; j < 50; j++) {
+			key = rand() % N;
+			if (rand() % 3) {
+				values[i][key] = rand();
+				shadow[i][key] = true;
+				next = ut_persistent_map_insert(
+					curr, &key, &values[i][key]);
+			} else {
+				shadow[i][key] = false;
+				next = ut_persistent_map_remove(curr, &key);
+			}
+			ut_persistent_map_delete(curr);
+			curr = next;
+		}
+
+		versions[i] = ut_persistent_map_snapshot(curr);
+	}
+
+	ut_persistent_map_delete(curr);
+
+	for (i = 0; i < VERSIONS; i++)
+		check_version(versions[i], shadow[i], values[i]);
+
+	/* Releasing versions out of order must keep the others intact. */
+	for (i = 0; i < VERSIONS; i += 2)
+		ut_persistent_map_delete(versions[i]);
+
+	for (i = 1; i < VERSIONS; i += 2) {
+		check_version(versions[i], shadow[i], values[i]);
+		ut_persistent_map_delete(versions[i]);
+	}
+}
+
+static int compare_long_double(const void *a, const void *b)
+{
+	long double x = *(const long double *)a, y = *(const long double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Keys are aligned for any type. */
+static void test3()
+{
+	static const struct ut_type key = { sizeof(long double), NULL,
+					    compare_long_double, NULL };
+	static const struct ut_type value = { 12, NULL, NULL, NULL };
+	ut_persistent_map_t *map, *next;
+	struct ut_pair kv;
+	char buf[12] = { 0 };
+	long double x;
+	int i;
+
+	map = ut_persistent_map_new(&key, &value);
+	for (i = 0; i < 100; i++) {
+		x = i;
+		next = ut_persistent_map_insert(map, &x, buf);
+		ut_persistent_map_delete(map);
+		map = next;
+	}
+
+	for (i = 0; i < 100; i++) {
+		x = i;
+		kv = ut_persistent_map_get_key_value(map, &x);
+		if (!kv.key || (uintptr_t)kv.key % UT_MEM_MAX_ALIGN ||
+		    *(long double *)kv.key != x) {
+			printf("Error! Key %d is misaligned!\n", i);
+			abort();
+		}
+	}
+
+	ut_persistent_map_delete(map);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	return 0;
+}
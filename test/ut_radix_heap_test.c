@@ -0,0 +1,120 @@
+#include "ut_errno.h"
+#include "ut_heap.h"
+#include "ut_radix_heap.h"
+#include "ut_string.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Monotone pushes and pops against a min heap of the same keys. */
+static void test1()
+{
+	static const struct ut_type u64_type = {
+		.size = sizeof(uint64_t),
+		.compare = compare_u64,
+	};
+	ut_radix_heap_t *radix;
+	ut_heap_t *heap;
+	uint64_t key, top, *p;
+	int i, n;
+
+	radix = ut_radix_heap_new(&u64_type);
+	heap = ut_heap_new_min(&u64_type);
+
+	srand(1);
+	for (i = 0; i < 100000; i++) {
+		if (rand() % 3) {
+			n = rand() % 4;
+			key = ut_radix_heap_last(radix);
+			if (n == 1)
+				key += rand() % 16;
+			else if (n == 2)
+				key += rand();
+			else if (n == 3)
+				key += (uint64_t)rand() << 32;
+			abort_if(ut_radix_heap_push(radix, key, &key) != UT_OK,
+				 "Push failed!");
+			ut_heap_push(heap, &key);
+		} else if (!ut_heap_is_empty(heap)) {
+			p = ut_radix_heap_peek(radix, &top);
+			abort_if(!p || *p != top, "Key and element differ!");
+			abort_if(top != *(uint64_t *)ut_heap_peek(heap),
+				 "Wrong top!");
+			ut_radix_heap_pop(radix);
+			ut_heap_pop(heap);
+		}
+
+		abort_if(ut_radix_heap_length(radix) != ut_heap_length(heap),
+			 "Wrong length!");
+	}
+
+	while (!ut_heap_is_empty(heap)) {
+		ut_radix_heap_peek(radix, &top);
+		abort_if(top != *(uint64_t *)ut_heap_peek(heap),
+			 "Wrong top while draining!");
+		ut_radix_heap_pop(radix);
+		ut_heap_pop(heap);
+	}
+	abort_if(!ut_radix_heap_is_empty(radix) ||
+			 ut_radix_heap_peek(radix, NULL),
+		 "Not drained!");
+
+	key = ut_radix_heap_last(radix);
+	if (key) {
+		key--;
+		abort_if(ut_radix_heap_push(radix, key, &key) != UT_ERANGE,
+			 "Pushed below the last key!");
+	}
+
+	ut_heap_delete(heap);
+	ut_radix_heap_delete(radix);
+}
+
+/* Elements are dropped on pop, clear and delete. */
+static void test2()
+{
+	ut_radix_heap_t *heap;
+	struct ut_string s, *top;
+	char buf[16];
+	uint64_t key;
+	int i;
+
+	heap = ut_radix_heap_new(ut_type_string());
+	for (i = 0; i < 100; i++) {
+		snprintf(buf, sizeof(buf), "s%03d", i);
+		ut_radix_heap_push(heap, 1000 - i * 7, ut_string_init(&s, buf));
+	}
+
+	top = ut_radix_heap_peek(heap, &key);
+	abort_if(strcmp(top->ptr, "s099") != 0 || key != 307,
+		 "Wrong string top!");
+	ut_radix_heap_pop(heap);
+
+	ut_radix_heap_clear(heap);
+	abort_if(ut_radix_heap_last(heap) != 0, "Not cleared!");
+	ut_radix_heap_push(heap, 5, ut_string_init(&s, "again"));
+	ut_radix_heap_delete(heap);
+}
+
+int main()
+{
+	test1();
+	test2();
+	return 0;
+}
@@ -0,0 +1,324 @@
+#include "ut_rb_tree.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Every object is kept in two trees, by id and by score. */
+struct object {
+	int id;
+	int score;
+	struct ut_rb_node by_id;
+	struct ut_rb_node by_score;
+};
+
+static int compare_id(const struct ut_rb_node *a, const struct ut_rb_node *b)
+{
+	int x = ut_rb_entry(a, struct object, by_id)->id;
+	int y = ut_rb_entry(b, struct object, by_id)->id;
+
+	return (x > y) - (x < y);
+}
+
+static int search_id(const void *key, const struct ut_rb_node *node)
+{
+	int x = *(const int *)key;
+	int y = ut_rb_entry(node, struct object, by_id)->id;
+
+	return (x > y) - (x < y);
+}
+
+/* Scores may repeat, ties are broken by id. */
+static int compare_score(const struct ut_rb_node *a,
+			 const struct ut_rb_node *b)
+{
+	struct object *x = ut_rb_entry(a, struct object, by_score);
+	struct object *y = ut_rb_entry(b, struct object, by_score);
+
+	if (x->score != y->score)
+		return (x->score > y->score) - (x->score < y->score);
+
+	return (x->id > y->id) - (x->id < y->id);
+}
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+/* Returns the black height of node, aborting on a broken invariant. */
+static int check_node(const struct ut_rb_node *node)
+{
+	int left, right;
+	size_t size;
+
+	if (!node)
+		return 1;
+
+	if (node->color == 0) {
+		abort_if(node->left && node->left->color == 0, "Red red!");
+		abort_if(node->right && node->right->color == 0, "Red red!");
+	}
+
+	abort_if(node->left && node->left->parent != node, "Bad parent!");
+	abort_if(node->right && node->right->parent != node, "Bad parent!");
+
+	left = check_node(node->left);
+	right = check_node(node->right);
+	abort_if(left != right, "Unbalanced black height!");
+
+	size = (node->left ? node->left->size : 0) +
+	       (node->right ? node->right->size : 0) + 1;
+	abort_if(node->size != size, "Bad subtree size!");
+
+	return left + (node->color != 0);
+}
+
+static void check_tree(const struct ut_rb_tree *tree)
+{
+	abort_if(tree->root && tree->root->color == 0, "Red root!");
+	abort_if(tree->root && tree->root->parent, "Root has a parent!");
+	check_node(tree->root);
+}
+
+static void test1()
+{
+	static struct object objects[1000];
+	struct ut_rb_tree ids, scores;
+	struct ut_rb_node *node, *prev;
+	struct object *obj;
+	int i, key, count;
+
+	ut_rb_tree_init(&ids, compare_id);
+	ut_rb_tree_init_ranked(&scores, compare_score);
+
+	srand(1);
+	for (i = 0; i < 1000; i++) {
+		objects[i].id = i * 7 % 1000;
+		objects[i].score = rand() % 100;
+		abort_if(ut_rb_tree_insert(&ids, &objects[i].by_id) != NULL,
+			 "Unique id was rejected!");
+		abort_if(ut_rb_tree_insert(&scores, &objects[i].by_score) !=
+				 NULL,
+			 "Unique score was rejected!");
+	}
+
+	abort_if(ut_rb_tree_insert(&ids, &objects[0].by_id) !=
+			 &objects[0].by_id,
+		 "Duplicate id was accepted!");
+	abort_if(ut_rb_tree_length(&ids) != 1000, "Wrong length!");
+	check_tree(&ids);
+	check_tree(&scores);
+
+	/* Drop every third object from both indexes. */
+	for (i = 0; i < 1000; i += 3) {
+		ut_rb_tree_remove(&ids, &objects[i].by_id);
+		ut_rb_tree_remove(&scores, &objects[i].by_score);
+	}
+
+	check_tree(&ids);
+	check_tree(&scores);
+	abort_if(ut_rb_tree_length(&scores) != 666, "Wrong length!");
+
+	for (i = 0; i < 1000; i++) {
+		key = objects[i].id;
+		node = ut_rb_tree_find(&ids, &key, search_id);
+		if (i % 3 == 0) {
+			abort_if(node != NULL, "Removed object was found!");
+		} else {
+			abort_if(node != &objects[i].by_id, "Object is lost!");
+			obj = ut_rb_entry(node, struct object, by_id);
+			abort_if(obj->score != objects[i].score,
+				 "Object was changed!");
+		}
+	}
+
+	/* Both orders see the same objects, each in its own order. */
+	count = 0;
+	prev = NULL;
+	for (node = ut_rb_tree_first(&scores); node;
+	     node = ut_rb_tree_next(node)) {
+		abort_if(prev && compare_score(prev, node) >= 0,
+			 "Scores out of order!");
+		abort_if(ut_rb_tree_rank(&scores, node) != (size_t)count,
+			 "Wrong rank!");
+		abort_if(ut_rb_tree_select(&scores, count) != node,
+			 "Wrong select!");
+		prev = node;
+		count++;
+	}
+	abort_if(count != 666, "Wrong number of scores!");
+
+	count = 0;
+	for (node = ut_rb_tree_last(&ids); node; node = ut_rb_tree_prev(node))
+		count++;
+	abort_if(count != 666, "Wrong number of ids!");
+
+	key = 500;
+	node = ut_rb_tree_lower_bound(&ids, &key, search_id);
+	abort_if(ut_rb_entry(node, struct object, by_id)->id != 500,
+		 "Wrong lower bound!");
+	node = ut_rb_tree_upper_bound(&ids, &key, search_id);
+	abort_if(ut_rb_entry(node, struct object, by_id)->id != 501,
+		 "Wrong upper bound!");
+}
+
+static void test2()
+{
+	static struct object objects[101];
+	struct ut_rb_tree ids;
+	struct ut_rb_node *node;
+	int i, n, key = 1;
+
+	for (n = 0; n <= 100; n += 11) {
+		for (i = 0; i < n; i++)
+			objects[i].id = i * 2;
+
+		ut_rb_tree_init_ranked(&ids, compare_id);
+		ut_rb_tree_build(&ids, &objects[0].by_id,
+				 sizeof(struct object), n);
+		check_tree(&ids);
+
+		for (i = 0; i < n; i++) {
+			node = ut_rb_tree_select(&ids, i);
+			abort_if(node != &objects[i].by_id, "Wrong build!");
+		}
+
+		/* A built tree takes further changes like any other. */
+		objects[100].id = 1;
+		ut_rb_tree_insert(&ids, &objects[100].by_id);
+		node = ut_rb_tree_find(&ids, &key, search_id);
+		abort_if(node != &objects[100].by_id, "Object is lost!");
+
+		for (i = 0; i < n; i += 2)
+			ut_rb_tree_remove(&ids, &objects[i].by_id);
+		check_tree(&ids);
+	}
+}
+
+/* Fills tree with the objects whose bit is set in mask, by id. */
+static void fill(struct ut_rb_tree *tree, struct object *objects,
+		 const bool *mask, int n)
+{
+	int i;
+
+	ut_rb_tree_init(tree, compare_id);
+
+	for (i = 0; i < n; i++) {
+		objects[i].id = i;
+		if (mask[i])
+			ut_rb_tree_insert(tree, &objects[i].by_id);
+	}
+}
+
+static void check_ids(const struct ut_rb_tree *tree, const bool *mask, int n)
+{
+	struct ut_rb_node *node = ut_rb_tree_first(tree);
+	size_t len = 0;
+	int i;
+
+	check_tree(tree);
+
+	for (i = 0; i < n; i++) {
+		if (!mask[i])
+			continue;
+		abort_if(!node, "Object is lost!");
+		abort_if(ut_rb_entry(node, struct object, by_id)->id != i,
+			 "Wrong object!");
+		node = ut_rb_tree_next(node);
+		len++;
+	}
+
+	abort_if(node != NULL, "Extra object!");
+	abort_if(ut_rb_tree_length(tree) != len, "Wrong length!");
+}
+
+static void release(struct ut_rb_node *node, void *arg)
+{
+	(*(int *)arg)++;
+	node->parent = node->left = node->right = NULL;
+}
+
+static void test3()
+{
+	static struct object xs[500], ys[500];
+	bool a[500], b[500], all[500], expect[500];
+	struct ut_rb_tree x, y, right;
+	int i, n, op, released, len;
+
+	srand(2);
+	for (n = 0; n <= 500; n += n < 10 ? 1 : 97) {
+		for (i = 0; i < n; i++) {
+			a[i] = rand() % 3 != 0;
+			b[i] = rand() % 2;
+			all[i] = true;
+		}
+
+		/* Split at every third position and join back. */
+		for (i = 0; i <= n; i += 3) {
+			fill(&x, xs, all, n);
+			ut_rb_tree_split(&x, ut_rb_tree_select(&x, i), &right);
+			check_tree(&x);
+			check_tree(&right);
+			abort_if(ut_rb_tree_length(&x) != (size_t)i ||
+					 ut_rb_tree_length(&right) !=
+						 (size_t)(n - i),
+				 "Wrong split!");
+			ut_rb_tree_join(&x, &right);
+			check_ids(&x, all, n);
+			abort_if(!ut_rb_tree_is_empty(&right), "Not joined!");
+		}
+
+		for (op = 0; op < 3; op++) {
+			fill(&x, xs, a, n);
+			fill(&y, ys, b, n);
+			released = 0;
+
+			for (i = 0; i < n; i++) {
+				if (op == 0)
+					expect[i] = a[i] || b[i];
+				else if (op == 1)
+					expect[i] = a[i] && b[i];
+				else
+					expect[i] = a[i] && !b[i];
+			}
+
+			if (op == 0)
+				ut_rb_tree_union(&x, &y, release, &released);
+			else if (op == 1)
+				ut_rb_tree_intersection(&x, &y, release,
+							&released);
+			else
+				ut_rb_tree_difference(&x, &y, release,
+						      &released);
+
+			check_ids(&x, expect, n);
+			abort_if(!ut_rb_tree_is_empty(&y), "Other not empty!");
+
+			/* Of two equal objects, the one of x is kept. */
+			for (i = 0; i < n; i++) {
+				if (expect[i] && a[i])
+					abort_if(ut_rb_tree_find(&x, &i,
+								 search_id) !=
+							 &xs[i].by_id,
+						 "Kept the wrong object!");
+			}
+
+			/* release wipes the links, as freeing would. */
+			released = 0;
+			len = ut_rb_tree_length(&x);
+			ut_rb_tree_clear(&x, release, &released);
+			abort_if(released != len || !ut_rb_tree_is_empty(&x),
+				 "Not cleared!");
+		}
+	}
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	return 0;
+}
@@ -0,0 +1,245 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_errno.h"
+#include "ut_mem.h"
+#include "ut_skip_map.h"
+#include "ut_string.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+static void test1()
+{
+	ut_skip_map_t *map;
+	struct ut_string s;
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	char *fruits[] = { "Apple", "Banana", "Cherry", "Grape", "Lemon" };
+	int i, value;
+
+	map = ut_skip_map_new(ut_type_string(), ut_type_int());
+
+	for (i = 4; i >= 0; i--) {
+		ut_string_init(&s, fruits[i]);
+		abort_if(ut_skip_map_insert(map, &s, &i) != UT_OK,
+			 "Insert failed!");
+	}
+
+	ut_string_init(&s, "Cherry");
+	abort_if(ut_skip_map_insert(map, &s, &(int){ 9 }) != UT_EEXIST,
+		 "Duplicate was inserted!");
+	abort_if(!ut_skip_map_load(map, &s, &value) || value != 2,
+		 "Wrong value!");
+	abort_if(!ut_skip_map_remove(map, &s), "Remove failed!");
+	abort_if(ut_skip_map_remove(map, &s), "Removed twice!");
+	abort_if(ut_skip_map_load(map, &s, &value), "Removed key was found!");
+	abort_if(ut_skip_map_insert(map, &s, &(int){ 9 }) != UT_OK,
+		 "Insert after remove failed!");
+	abort_if(ut_skip_map_length(map) != 5, "Wrong length!");
+
+	iter = ut_skip_map_range_iter_new(map,
+					  &(struct ut_string){ "B", 1, 1 },
+					  &(struct ut_string){ "H", 1, 1 });
+	for (i = 1; (kv = iter->next(iter)); i++) {
+		abort_if(strcmp(((struct ut_string *)kv->key)->ptr,
+				fruits[i]) != 0,
+			 "Wrong range!");
+	}
+	abort_if(i != 4, "Wrong range length!");
+	ut_skip_map_iter_delete(iter);
+
+	ut_skip_map_delete(map);
+}
+
+#define THREADS 4
+#define KEYS 20000
+
+struct worker {
+	ut_skip_map_t *map;
+	int id;
+};
+
+/* Each writer owns every THREADS-th key, readers check what they see. */
+static void *writer(void *arg)
+{
+	struct worker *w = arg;
+	int i, key;
+
+	for (i = 0; i < KEYS; i++) {
+		key = i * THREADS + w->id;
+		abort_if(ut_skip_map_insert(w->map, &key, &key) != UT_OK,
+			 "Concurrent insert failed!");
+	}
+
+	for (i = 0; i < KEYS; i += 2) {
+		key = i * THREADS + w->id;
+		abort_if(!ut_skip_map_remove(w->map, &key),
+			 "Concurrent remove failed!");
+	}
+
+	return NULL;
+}
+
+static void *reader(void *arg)
+{
+	struct worker *w = arg;
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	int i, key, prev, value;
+
+	for (i = 0; i < KEYS; i++) {
+		key = rand() % (KEYS * THREADS);
+		if (ut_skip_map_load(w->map, &key, &value))
+			abort_if(value != key, "Wrong concurrent value!");
+	}
+
+	for (i = 0; i < 10; i++) {
+		prev = -1;
+		iter = ut_skip_map_iter_new(w->map);
+		while ((kv = iter->next(iter))) {
+			abort_if(*(int *)kv->key <= prev, "Out of order!");
+			abort_if(*(int *)kv->value != *(int *)kv->key,
+				 "Wrong concurrent value!");
+			prev = *(int *)kv->key;
+		}
+		ut_skip_map_iter_delete(iter);
+	}
+
+	return NULL;
+}
+
+static void test2()
+{
+	ut_skip_map_t *map;
+	pthread_t threads[THREADS * 2];
+	struct worker workers[THREADS];
+	int i, key;
+
+	map = ut_skip_map_new(ut_type_int(), ut_type_int());
+
+	for (i = 0; i < THREADS; i++) {
+		workers[i].map = map;
+		workers[i].id = i;
+		pthread_create(&threads[i], NULL, writer, &workers[i]);
+		pthread_create(&threads[THREADS + i], NULL, reader,
+			       &workers[i]);
+	}
+
+	for (i = 0; i < THREADS * 2; i++)
+		pthread_join(threads[i], NULL);
+
+	abort_if(ut_skip_map_length(map) != KEYS * THREADS / 2,
+		 "Wrong final length!");
+
+	for (key = 0; key < KEYS * THREADS; key++) {
+		abort_if((ut_skip_map_get(map, &key) != NULL) !=
+				 (key / THREADS % 2 == 1),
+			 "Wrong final content!");
+	}
+
+	ut_skip_map_delete(map);
+}
+
+#define MAPS 2000
+
+static void *use_maps(void *arg)
+{
+	ut_skip_map_t **maps = arg;
+	int i, key;
+
+	for (i = 0; i < MAPS; i++) {
+		key = MAPS + i;
+		abort_if(ut_skip_map_insert(maps[i], &key, &i),
+			 "Insert failed on a thread!");
+	}
+
+	return NULL;
+}
+
+/* Maps share one thread key, so there may be more than keys allow. */
+static void test3()
+{
+	static ut_skip_map_t *maps[MAPS];
+	pthread_t thread;
+	int i, *value;
+
+	for (i = 0; i < MAPS; i++) {
+		maps[i] = ut_skip_map_new(ut_type_int(), ut_type_int());
+		abort_if(!maps[i], "Map not created!");
+		abort_if(ut_skip_map_insert(maps[i], &i, &i), "Insert failed!");
+	}
+
+	pthread_create(&thread, NULL, use_maps, maps);
+	pthread_join(thread, NULL);
+
+	/* New maps may take the addresses of deleted ones. */
+	for (i = 0; i < MAPS; i += 2) {
+		ut_skip_map_delete(maps[i]);
+		maps[i] = ut_skip_map_new(ut_type_int(), ut_type_int());
+		abort_if(!maps[i], "Map not created again!");
+		abort_if(ut_skip_map_length(maps[i]) != 0, "Not empty!");
+	}
+
+	for (i = 0; i < MAPS; i++) {
+		value = ut_skip_map_get(maps[i], &i);
+		abort_if(i % 2 ? !value || *value != i : value != NULL,
+			 "Wrong value!");
+		ut_skip_map_delete(maps[i]);
+	}
+}
+
+static int compare_long_double(const void *a, const void *b)
+{
+	long double x = *(const long double *)a, y = *(const long double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Keys are aligned for any type, whatever the height of their node. */
+static void test4()
+{
+	static const struct ut_type key = { sizeof(long double), NULL,
+					    compare_long_double, NULL };
+	static const struct ut_type value = { 12, NULL, NULL, NULL };
+	ut_skip_map_t *map;
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	char buf[12] = { 0 };
+	long double x;
+	int i;
+
+	map = ut_skip_map_new(&key, &value);
+	for (i = 0; i < 1000; i++) {
+		x = (i * 7919) % 1000;
+		ut_skip_map_insert(map, &x, buf);
+	}
+
+	iter = ut_skip_map_iter_new(map);
+	for (i = 0; (kv = iter->next(iter)); i++) {
+		abort_if((uintptr_t)kv->key % UT_MEM_MAX_ALIGN, "Misaligned!");
+		abort_if(*(long double *)kv->key != i, "Wrong key!");
+	}
+	abort_if(i != 1000, "Wrong length!");
+	ut_skip_map_iter_delete(iter);
+
+	ut_skip_map_delete(map);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	test4();
+	return 0;
+}
@@ -0,0 +1,203 @@
+#include "ut_array.h"
+#include "ut_string.h"
+#include "ut_timer_wheel.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMERS 4096
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+static uint64_t random_delay(void)
+{
+	switch (rand() % 4) {
+	case 0:
+		return rand() % 64;
+	case 1:
+		return rand() % 5000;
+	case 2:
+		return (uint64_t)rand() * 1000;
+	default:
+		return (uint64_t)rand() << 20;
+	}
+}
+
+/* Random changes checked against what each id is scheduled for. */
+static void test1()
+{
+	static struct ut_timer *timers[TIMERS];
+	static uint64_t due[TIMERS];
+	static int live[TIMERS];
+	ut_timer_wheel_t *wheel;
+	ut_array_t *expired;
+	uint64_t now = 1000, next, least;
+	size_t len = 0, j;
+	int i, id;
+
+	wheel = ut_timer_wheel_new(ut_type_int(), now);
+	expired = ut_array_new(ut_type_int());
+
+	srand(1);
+	for (i = 0; i < 200000; i++) {
+		id = rand() % TIMERS;
+
+		switch (rand() % 8) {
+		case 0:
+		case 1:
+		case 2:
+			if (live[id])
+				break;
+			due[id] = now + random_delay();
+			ut_timer_wheel_schedule(wheel, due[id], &id,
+						&timers[id]);
+			live[id] = 1;
+			len++;
+			break;
+		case 3:
+			if (!live[id])
+				break;
+			abort_if(ut_timer_wheel_expires(timers[id]) != due[id],
+				 "Wrong expiry!");
+			abort_if(*(int *)ut_timer_wheel_get(timers[id]) != id,
+				 "Wrong timer!");
+			ut_timer_wheel_cancel(wheel, timers[id]);
+			live[id] = 0;
+			len--;
+			break;
+		case 4:
+			if (!live[id])
+				break;
+			due[id] = now + random_delay();
+			ut_timer_wheel_reschedule(wheel, timers[id],
+						  due[id]);
+			break;
+		default:
+			if (rand() % 3)
+				now += rand() % 100;
+			else
+				now += rand();
+			ut_array_clear(expired);
+			ut_timer_wheel_expire(wheel, now, expired);
+
+			for (j = 0; j < ut_array_length(expired); j++) {
+				id = *(int *)ut_array_get(expired, j);
+				abort_if(!live[id] || due[id] > now,
+					 "Expired too early!");
+				live[id] = 0;
+				len--;
+			}
+
+			least = UINT64_MAX;
+			for (id = 0; id < TIMERS; id++) {
+				abort_if(live[id] && due[id] <= now,
+					 "Missed a timer!");
+				if (live[id] && due[id] < least)
+					least = due[id];
+			}
+
+			next = ut_timer_wheel_next_tick(wheel);
+			abort_if(next > least || next <= now,
+				 "Wrong next tick!");
+			break;
+		}
+
+		abort_if(ut_timer_wheel_length(wheel) != len, "Wrong length!");
+	}
+
+	ut_array_delete(expired);
+	ut_timer_wheel_delete(wheel);
+}
+
+/* Late timers, ticks in the far future and skipping an idle wheel. */
+static void test2()
+{
+	ut_timer_wheel_t *wheel;
+	ut_array_t *expired;
+	uint64_t ticks[] = { 5, 100, 163, 164, 4095, 4096, UINT64_MAX - 1,
+			     (uint64_t)1 << 40 };
+	int i;
+
+	wheel = ut_timer_wheel_new(ut_type_int(), 100);
+	expired = ut_array_new(ut_type_int());
+
+	for (i = 0; i < 8; i++)
+		ut_timer_wheel_schedule(wheel, ticks[i], &i, NULL);
+
+	/* Already due, but only for the next expire. */
+	abort_if(ut_timer_wheel_next_tick(wheel) != 100, "Late timer lost!");
+	ut_timer_wheel_expire(wheel, 100, expired);
+	abort_if(ut_array_length(expired) != 2, "Late timers not expired!");
+
+	ut_timer_wheel_expire(wheel, 4095, expired);
+	abort_if(ut_array_length(expired) != 5, "Wrong expiry at 4095!");
+	abort_if(*(int *)ut_array_get(expired, 4) != 4,
+		 "Wrong timer at 4095!");
+
+	ut_timer_wheel_expire(wheel, (uint64_t)1 << 40, expired);
+	abort_if(ut_array_length(expired) != 7 ||
+			 *(int *)ut_array_get(expired, 6) != 7,
+		 "Wrong far expiry!");
+	abort_if(ut_timer_wheel_now(wheel) != (uint64_t)1 << 40,
+		 "Wrong current tick!");
+
+	ut_timer_wheel_expire(wheel, UINT64_MAX, expired);
+	abort_if(ut_array_length(expired) != 8 ||
+			 !ut_timer_wheel_is_empty(wheel),
+		 "Not all expired!");
+	abort_if(ut_timer_wheel_next_tick(wheel) != UINT64_MAX,
+		 "Empty wheel has a next tick!");
+
+	ut_array_delete(expired);
+	ut_timer_wheel_delete(wheel);
+}
+
+/* Cancelled and cleared strings are dropped, expired ones are moved out. */
+static void test3()
+{
+	ut_timer_wheel_t *wheel;
+	ut_array_t *expired;
+	struct ut_timer *timer;
+	struct ut_string s;
+	char buf[16];
+	int i;
+
+	wheel = ut_timer_wheel_new(ut_type_string(), 0);
+	expired = ut_array_new(ut_type_string());
+
+	for (i = 0; i < 300; i++) {
+		snprintf(buf, sizeof(buf), "t%03d", i);
+		ut_timer_wheel_schedule(wheel, i, ut_string_init(&s, buf),
+					&timer);
+		if (i % 3 == 0)
+			ut_timer_wheel_cancel(wheel, timer);
+	}
+
+	ut_timer_wheel_expire(wheel, 99, expired);
+	abort_if(ut_array_length(expired) != 66, "Wrong string expiry!");
+	abort_if(strcmp(((struct ut_string *)ut_array_last(expired))->ptr,
+			"t098") != 0,
+		 "Wrong last string!");
+
+	ut_timer_wheel_clear(wheel);
+	abort_if(!ut_timer_wheel_is_empty(wheel), "Not cleared!");
+	ut_timer_wheel_schedule(wheel, 5, ut_string_init(&s, "again"), NULL);
+
+	ut_array_delete(expired);
+	ut_timer_wheel_delete(wheel);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	return 0;
+}
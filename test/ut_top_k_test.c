@@ -0,0 +1,89 @@
+#include "ut_array.h"
+#include "ut_string.h"
+#include "ut_top_k.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void abort_if(int cond, const char *msg)
+{
+	if (cond) {
+		printf("Error! %s\n", msg);
+		abort();
+	}
+}
+
+static void test1()
+{
+	ut_top_k_t *top;
+	ut_array_t *all;
+	struct ut_iter *iter;
+	int i, x, *p;
+
+	top = ut_top_k_new(ut_type_int(), 100);
+	all = ut_array_new(ut_type_int());
+
+	srand(1);
+	for (i = 0; i < 100000; i++) {
+		x = rand() % 50000;
+		ut_top_k_push(top, &x);
+		ut_array_push(all, &x);
+		abort_if(ut_top_k_length(top) > 100, "Too many kept!");
+	}
+
+	/* The kept ones are the last hundred after a sort. */
+	ut_array_partial_sort(all, 100000);
+	abort_if(*(int *)ut_top_k_threshold(top) !=
+			 *(int *)ut_array_get(all, 99900),
+		 "Wrong threshold!");
+
+	iter = ut_top_k_drain_iter_new(top);
+	for (i = 99900; (p = iter->next(iter)); i++)
+		abort_if(*p != *(int *)ut_array_get(all, i), "Wrong top k!");
+	ut_top_k_iter_delete(iter);
+	abort_if(i != 100000 || !ut_top_k_is_empty(top), "Not drained!");
+
+	ut_top_k_delete(top);
+
+	top = ut_top_k_new_min(ut_type_int(), 10);
+	for (i = 0; i < 100000; i++)
+		ut_top_k_push(top, ut_array_get(all, 99999 - i));
+	iter = ut_top_k_drain_iter_new(top);
+	for (i = 9; (p = iter->next(iter)); i--)
+		abort_if(*p != *(int *)ut_array_get(all, i), "Wrong bottom k!");
+	ut_top_k_iter_delete(iter);
+	ut_top_k_delete(top);
+
+	ut_array_delete(all);
+	abort_if(ut_top_k_new(ut_type_int(), 0) != NULL, "Empty k accepted!");
+}
+
+/* Turned away and pushed out strings are dropped, kept ones are not. */
+static void test2()
+{
+	ut_top_k_t *top;
+	struct ut_string s;
+	char buf[16];
+	int i;
+
+	top = ut_top_k_new(ut_type_string(), 5);
+	for (i = 0; i < 1000; i++) {
+		snprintf(buf, sizeof(buf), "%04d", (i * 7919) % 1000);
+		ut_top_k_push(top, ut_string_init(&s, buf));
+	}
+
+	abort_if(strcmp(((struct ut_string *)ut_top_k_threshold(top))->ptr,
+			"0995") != 0,
+		 "Wrong string threshold!");
+
+	ut_top_k_clear(top);
+	abort_if(ut_top_k_threshold(top) != NULL, "Not cleared!");
+	ut_top_k_delete(top);
+}
+
+int main()
+{
+	test1();
+	test2();
+	return 0;
+}
@@ -1,5 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ut_errno.h"
+#include "ut_mem.h"
 #include "ut_string.h"
 #include "ut_tree_map.h"
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,6 +50,22 @@ static void test1()
 	ut_tree_map_t *map;
 
 	struct ut_string tmp;
+	int i, j;
+
+	/* Removing the last entry leaves an empty map that still works. */
+	map = ut_tree_map_new(ut_type_int(), ut_type_int());
+	for (i = 1; i <= 100; i++) {
+		for (j = 0; j < i; j++)
+			ut_tree_map_insert(map, &j, &j);
+		for (j = 0; j < i; j++)
+			ut_tree_map_remove(map, &j);
+
+		if (ut_tree_map_length(map) != 0 || ut_tree_map_get(map, &i)) {
+			printf("Error! The map is not empty!\n");
+			abort();
+		}
+	}
+	ut_tree_map_delete(map);
 
 	map = ut_tree_map_new(ut_type_string(), ut_type_int());
 
@@ -73,8 +95,560 @@ static void test1()
 	ut_tree_map_delete(map);
 }
 
+static void abort_if_not_key2(struct ut_pair kv, int key)
+{
+	if (key < 0 ? kv.key != NULL : !kv.key || *(int *)kv.key != key) {
+		printf("Error! The key is not %d!\n", key);
+		abort();
+	}
+}
+
+static void abort_if_not_equal2(struct ut_iter *iter, int *keys, size_t n)
+{
+	struct ut_pair *kv;
+	size_t i = 0;
+
+	while ((kv = iter->next(iter))) {
+		if (i >= n || *(int *)kv->key != keys[i]) {
+			printf("Error! The key %zu is not %d!\n", i, keys[i]);
+			abort();
+		}
+		i++;
+	}
+
+	if (i != n) {
+		puts("Error! The iterator stopped early!");
+		abort();
+	}
+
+	ut_tree_map_iter_delete(iter);
+}
+
+static void test2()
+{
+	ut_tree_map_t *map;
+	int i;
+
+	map = ut_tree_map_new(ut_type_int(), ut_type_int());
+
+	for (i = 0; i < 100; i += 10)
+		ut_tree_map_insert(map, &i, &i);
+
+	abort_if_not_key2(ut_tree_map_first(map), 0);
+	abort_if_not_key2(ut_tree_map_last(map), 90);
+	abort_if_not_key2(ut_tree_map_lower_bound(map, &(int){ 25 }), 30);
+	abort_if_not_key2(ut_tree_map_lower_bound(map, &(int){ 30 }), 30);
+	abort_if_not_key2(ut_tree_map_upper_bound(map, &(int){ 30 }), 40);
+	abort_if_not_key2(ut_tree_map_upper_bound(map, &(int){ 90 }), -1);
+	abort_if_not_key2(ut_tree_map_floor(map, &(int){ 25 }), 20);
+	abort_if_not_key2(ut_tree_map_floor(map, &(int){ -5 }), -1);
+	abort_if_not_key2(ut_tree_map_ceiling(map, &(int){ 91 }), -1);
+
+	abort_if_not_equal2(
+		ut_tree_map_range_iter_new(map, &(int){ 20 }, &(int){ 50 }),
+		(int[]){ 20, 30, 40 }, 3);
+	abort_if_not_equal2(
+		ut_tree_map_range_iter_new(map, &(int){ 75 }, NULL),
+		(int[]){ 80, 90 }, 2);
+	abort_if_not_equal2(
+		ut_tree_map_range_iter_new(map, &(int){ 50 }, &(int){ 20 }),
+		NULL, 0);
+	abort_if_not_equal2(
+		ut_tree_map_range_rev_iter_new(map, &(int){ 20 }, &(int){ 50 }),
+		(int[]){ 40, 30, 20 }, 3);
+	abort_if_not_equal2(
+		ut_tree_map_range_rev_iter_new(map, NULL, &(int){ 15 }),
+		(int[]){ 10, 0 }, 2);
+
+	ut_tree_map_pop_first(map);
+	ut_tree_map_pop_last(map);
+	abort_if_not_equal2(ut_tree_map_rev_iter_new(map),
+			    (int[]){ 80, 70, 60, 50, 40, 30, 20, 10 }, 8);
+
+	while (!ut_tree_map_is_empty(map))
+		ut_tree_map_pop_first(map);
+	abort_if_not_key2(ut_tree_map_first(map), -1);
+
+	ut_tree_map_delete(map);
+}
+
+static void test3()
+{
+	ut_tree_map_t *map;
+	static bool shadow[1000];
+	size_t i, index;
+	int key;
+
+	map = ut_tree_map_new_ranked(ut_type_int(), ut_type_int());
+
+	srand(1);
+	for (i = 0; i < 20000; i++) {
+		key = rand() % 1000;
+		if (rand() % 3) {
+			ut_tree_map_insert(map, &key, &key);
+			shadow[key] = true;
+		} else {
+			ut_tree_map_remove(map, &key);
+			shadow[key] = false;
+		}
+	}
+
+	index = 0;
+	for (key = 0; key < 1000; key++) {
+		if (ut_tree_map_rank(map, &key) != index) {
+			printf("Error! The rank of %d is not %zu!\n", key,
+			       index);
+			abort();
+		}
+
+		if (!shadow[key])
+			continue;
+
+		abort_if_not_key2(ut_tree_map_select(map, index), key);
+		index++;
+	}
+
+	abort_if_not_key2(ut_tree_map_select(map, index), -1);
+
+	if (ut_tree_map_count_range(map, NULL, NULL) != index ||
+	    ut_tree_map_count_range(map, &(int){ 500 }, &(int){ 100 }) != 0 ||
+	    ut_tree_map_count_range(map, &(int){ 100 }, &(int){ 500 }) !=
+		    ut_tree_map_rank(map, &(int){ 500 }) -
+			    ut_tree_map_rank(map, &(int){ 100 })) {
+		puts("Error! The range counts are wrong!");
+		abort();
+	}
+
+	ut_tree_map_delete(map);
+}
+
+static void test4()
+{
+	ut_tree_map_t *map;
+	int keys[1000], values[1000];
+	int i, *p;
+
+	for (i = 0; i < 1000; i++) {
+		keys[i] = i * 2;
+		values[i] = i;
+	}
+
+	map = ut_tree_map_from_sorted(ut_type_int(), ut_type_int(), keys,
+				      values, 1000);
+
+	/* Mix the bulk loaded entries with ones inserted one by one. */
+	for (i = 0; i < 1000; i += 2) {
+		ut_tree_map_remove(map, &keys[i]);
+		ut_tree_map_insert(map, &(int){ keys[i] + 1 }, &values[i]);
+	}
+
+	for (i = 0; i < 1000; i++) {
+		p = ut_tree_map_get(map, &(int){ keys[i] + (i % 2 ? 0 : 1) });
+		if (!p || *p != values[i]) {
+			printf("Error! The value of %d is not %d!\n", keys[i],
+			       values[i]);
+			abort();
+		}
+	}
+
+	ut_tree_map_delete(map);
+
+	keys[500] = keys[499];
+	if (ut_tree_map_from_sorted(ut_type_int(), ut_type_int(), keys, values,
+				    1000)) {
+		puts("Error! Duplicate keys were accepted!");
+		abort();
+	}
+}
+
+static void test5()
+{
+	ut_tree_map_t *map;
+	int *values[1000];
+	int i;
+
+	map = ut_tree_map_new(ut_type_int(), ut_type_int());
+
+	for (i = 0; i < 1000; i++) {
+		ut_tree_map_insert(map, &i, &i);
+		values[i] = ut_tree_map_get(map, &i);
+	}
+
+	/* Removing entries with two children must not move the others. */
+	for (i = 0; i < 1000; i += 3)
+		ut_tree_map_remove(map, &i);
+
+	for (i = 0; i < 1000; i++) {
+		if (i % 3 && *values[i] != i) {
+			printf("Error! The value of %d has moved!\n", i);
+			abort();
+		}
+	}
+
+	ut_tree_map_delete(map);
+}
+
+static void insert_key(ut_tree_map_t *map, int i, int value)
+{
+	struct ut_string s;
+	char buf[8];
+
+	snprintf(buf, sizeof(buf), "k%03d", i);
+	ut_string_init(&s, buf);
+	ut_tree_map_insert(map, &s, &value);
+}
+
+static void test6()
+{
+	ut_tree_map_t *left, *right, *other;
+	int i;
+
+	left = ut_tree_map_new(ut_type_string(), ut_type_int());
+	for (i = 0; i < 100; i++)
+		insert_key(left, i, i);
+
+	right = ut_tree_map_split(left, &(struct ut_string){ "k050", 4, 4 });
+	if (ut_tree_map_length(left) != 50 || ut_tree_map_length(right) != 50) {
+		puts("Error! Wrong split!");
+		abort();
+	}
+	abort_if_not_equal1(left, "k049", 49);
+	abort_if_not_equal1(right, "k050", 50);
+
+	/* Both halves keep working on the shared pool. */
+	insert_key(left, 100, 100);
+	if (ut_tree_map_join(left, right) != UT_EINVAL) {
+		puts("Error! Overlapping maps were joined!");
+		abort();
+	}
+	ut_tree_map_remove(left, &(struct ut_string){ "k100", 4, 4 });
+	insert_key(right, 100, 100);
+
+	if (ut_tree_map_join(left, right) != UT_OK ||
+	    ut_tree_map_length(left) != 101 || !ut_tree_map_is_empty(right)) {
+		puts("Error! Wrong join!");
+		abort();
+	}
+	ut_tree_map_delete(right);
+	abort_if_not_equal1(left, "k100", 100);
+
+	/* Set operations on maps with pools of their own. */
+	other = ut_tree_map_new(ut_type_string(), ut_type_int());
+	for (i = 0; i < 200; i += 2)
+		insert_key(other, i, -i);
+
+	ut_tree_map_union(left, other);
+	ut_tree_map_delete(other);
+	if (ut_tree_map_length(left) != 150) {
+		puts("Error! Wrong union!");
+		abort();
+	}
+	abort_if_not_equal1(left, "k050", 50);
+	abort_if_not_equal1(left, "k150", -150);
+
+	other = ut_tree_map_new(ut_type_string(), ut_type_int());
+	for (i = 0; i < 200; i += 3)
+		insert_key(other, i, -i);
+
+	ut_tree_map_intersection(left, other);
+	ut_tree_map_delete(other);
+	if (ut_tree_map_length(left) != 51) {
+		puts("Error! Wrong intersection!");
+		abort();
+	}
+	abort_if_not_equal1(left, "k003", 3);
+	abort_if_not_equal1(left, "k102", -102);
+
+	other = ut_tree_map_new(ut_type_string(), ut_type_int());
+	for (i = 0; i < 200; i += 9)
+		insert_key(other, i, -i);
+
+	ut_tree_map_difference(left, other);
+	ut_tree_map_delete(other);
+	if (ut_tree_map_length(left) != 33 ||
+	    ut_tree_map_get(left, &(struct ut_string){ "k198", 4, 4 })) {
+		puts("Error! Wrong difference!");
+		abort();
+	}
+	abort_if_not_equal1(left, "k102", -102);
+
+	ut_tree_map_delete(left);
+}
+
+/* The keys are 0, 2, 4, ... in order, every subtree size is right. */
+static void check_evens(ut_tree_map_t *map, int n)
+{
+	struct ut_iter *iter;
+	struct ut_pair *kv;
+	int i = 0;
+
+	iter = ut_tree_map_iter_new(map);
+	while ((kv = iter->next(iter))) {
+		if (*(int *)kv->key != i * 2 ||
+		    *(int *)ut_tree_map_select(map, i).key != i * 2) {
+			printf("Error! Key %d is out of place!\n", i * 2);
+			abort();
+		}
+		i++;
+	}
+	ut_tree_map_iter_delete(iter);
+
+	if (i != n || ut_tree_map_length(map) != (size_t)n) {
+		puts("Error! Wrong length after hinted inserts!");
+		abort();
+	}
+}
+
+static void test7()
+{
+	ut_tree_map_t *map;
+	struct ut_pair hint;
+	int i, key;
+
+	map = ut_tree_map_new_ranked(ut_type_int(), ut_type_int());
+
+	/* Ascending, descending, then near-sorted keys that hit old ones. */
+	for (i = 500; i < 1000; i++) {
+		key = i * 2;
+		ut_tree_map_insert(map, &key, &i);
+	}
+	for (i = 499; i >= 0; i--) {
+		key = i * 2;
+		ut_tree_map_insert(map, &key, &i);
+	}
+	for (i = 0; i < 1000; i++) {
+		key = (i ^ 3) * 2;
+		ut_tree_map_insert(map, &key, &key);
+	}
+	check_evens(map, 1000);
+
+	/* The finger goes away with its entry. */
+	key = 1998;
+	ut_tree_map_insert(map, &key, &key);
+	for (i = 0; i < 400; i++)
+		ut_tree_map_pop_last(map);
+	for (i = 550; i < 600; i++) {
+		key = i * 2;
+		ut_tree_map_insert(map, &key, &key);
+	}
+	check_evens(map, 600);
+
+	/* Hints that are right, wrong and missing. */
+	hint = ut_tree_map_first(map);
+	for (i = 600; i < 800; i++) {
+		key = i * 2;
+		ut_tree_map_insert_hint(map, &hint, &key, &key);
+		if (*(int *)hint.key != key) {
+			puts("Error! Wrong hint after insert!");
+			abort();
+		}
+	}
+	for (i = 0; i < 800; i += 7) {
+		key = i * 2;
+		hint = ut_tree_map_select(map, 799 - i);
+		ut_tree_map_insert_hint(map, i % 2 ? &hint : NULL, &key, &i);
+		if (*(int *)ut_tree_map_get(map, &key) != i) {
+			puts("Error! Wrong value after hinted update!");
+			abort();
+		}
+	}
+	check_evens(map, 800);
+
+	ut_tree_map_delete(map);
+}
+
+static int drops;
+
+static void drop_counted(void *p)
+{
+	(void)p;
+	drops++;
+}
+
+static int compare_counted(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+static const struct ut_type counted_type = {
+	.size = sizeof(int),
+	.drop = drop_counted,
+	.compare = compare_counted,
+};
+
+/* Maps that share a pool are deleted in either order, every key dropped. */
+static void test8()
+{
+	ut_tree_map_t *a, *b;
+	struct ut_string s;
+	char buf[16];
+	int i, key, round;
+
+	for (round = 0; round < 2; round++) {
+		a = ut_tree_map_new(ut_type_string(), ut_type_int());
+		for (i = 0; i < 100; i++) {
+			snprintf(buf, sizeof(buf), "key-%03d", i);
+			ut_tree_map_insert(a, ut_string_init(&s, buf), &i);
+		}
+
+		ut_string_init(&s, "key-050");
+		b = ut_tree_map_split(a, &s);
+		ut_string_drop(&s);
+		if (ut_tree_map_length(a) != 50 ||
+		    ut_tree_map_length(b) != 50) {
+			puts("Error! Wrong lengths after split!");
+			abort();
+		}
+
+		ut_tree_map_delete(round ? a : b);
+		ut_tree_map_delete(round ? b : a);
+	}
+
+	for (round = 0; round < 2; round++) {
+		a = ut_tree_map_new(&counted_type, ut_type_int());
+		b = ut_tree_map_new(&counted_type, ut_type_int());
+		srand(8 + round);
+		for (i = 0; i < 24; i++) {
+			key = rand() % 1000 * 2;
+			ut_tree_map_insert(a, &key, &i);
+			key = rand() % 1000 * 2 + 1;
+			ut_tree_map_insert(b, &key, &i);
+		}
+		key = 5000;
+		ut_tree_map_insert(a, &key, &key);
+		ut_tree_map_insert(b, &key, &key);
+		i = ut_tree_map_length(a) + ut_tree_map_length(b);
+		drops = 0;
+
+		ut_tree_map_union(a, b);
+		ut_tree_map_delete(round ? b : a);
+		ut_tree_map_delete(round ? a : b);
+		if (drops != i) {
+			printf("Error! %d of %d keys dropped!\n", drops, i);
+			abort();
+		}
+	}
+}
+
+static int compare_long_double(const void *a, const void *b)
+{
+	long double x = *(const long double *)a, y = *(const long double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Keys are aligned for any type, whatever the value size. */
+static void test9()
+{
+	static const struct ut_type key = { sizeof(long double), NULL,
+					    compare_long_double, NULL };
+	static const struct ut_type value = { 12, NULL, NULL, NULL };
+	ut_tree_map_t *map;
+	struct ut_pair kv;
+	char buf[12] = { 0 };
+	long double x;
+	int i;
+
+	map = ut_tree_map_new(&key, &value);
+	for (i = 0; i < 100; i++) {
+		x = i;
+		ut_tree_map_insert(map, &x, buf);
+	}
+
+	for (i = 0; i < 100; i++) {
+		x = i;
+		kv = ut_tree_map_get_key_value(map, &x);
+		if (!kv.key || (uintptr_t)kv.key % UT_MEM_MAX_ALIGN ||
+		    *(long double *)kv.key != x) {
+			printf("Error! Key %d is misaligned!\n", i);
+			abort();
+		}
+	}
+
+	ut_tree_map_delete(map);
+}
+
+#define SHARDS 4
+#define SHARD_KEYS 1000
+
+/* Removes and inserts every other key of a shard, a few times over. */
+static void *churn_shard(void *arg)
+{
+	ut_tree_map_t *map = arg;
+	struct ut_pair first = ut_tree_map_first(map);
+	int i, key, round, lo = *(int *)first.key;
+
+	for (round = 0; round < 20; round++) {
+		for (i = 0; i < SHARD_KEYS; i += 2) {
+			key = lo + i;
+			ut_tree_map_remove(map, &key);
+		}
+		for (i = 0; i < SHARD_KEYS; i += 2) {
+			key = lo + i;
+			ut_tree_map_insert(map, &key, &round);
+		}
+	}
+
+	return NULL;
+}
+
+/* Maps split off one pool are used from their own threads. */
+static void test10()
+{
+	ut_tree_map_t *shards[SHARDS];
+	pthread_t threads[SHARDS];
+	int i, key, *value;
+
+	shards[0] = ut_tree_map_new(ut_type_int(), ut_type_int());
+	for (key = 0; key < SHARDS * SHARD_KEYS; key++)
+		ut_tree_map_insert(shards[0], &key, &key);
+
+	for (i = SHARDS - 1; i > 0; i--) {
+		key = i * SHARD_KEYS;
+		shards[i] = ut_tree_map_split(shards[0], &key);
+	}
+
+	for (i = 0; i < SHARDS; i++)
+		pthread_create(&threads[i], NULL, churn_shard, shards[i]);
+
+	for (i = 0; i < SHARDS; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 1; i < SHARDS; i++) {
+		if (ut_tree_map_join(shards[0], shards[i])) {
+			puts("Error! Shards do not join!");
+			abort();
+		}
+		ut_tree_map_delete(shards[i]);
+	}
+
+	for (key = 0; key < SHARDS * SHARD_KEYS; key++) {
+		value = ut_tree_map_get(shards[0], &key);
+		if (!value || *value != (key % 2 ? key : 19)) {
+			printf("Error! Wrong value for %d!\n", key);
+			abort();
+		}
+	}
+
+	if (ut_tree_map_length(shards[0]) != SHARDS * SHARD_KEYS) {
+		puts("Error! Wrong length after join!");
+		abort();
+	}
+
+	ut_tree_map_delete(shards[0]);
+}
+
 int main()
 {
 	test1();
+	test2();
+	test3();
+	test4();
+	test5();
+	test6();
+	test7();
+	test8();
+	test9();
+	test10();
 	return 0;
 }
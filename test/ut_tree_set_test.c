@@ -1,3 +1,5 @@
+#include "ut_errno.h"
+#include "ut_string.h"
 #include "ut_tree_set.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,8 +45,237 @@ static void test1()
 	ut_tree_set_delete(set);
 }
 
+static void test2()
+{
+	int *p;
+	size_t i;
+	ut_tree_set_t *set;
+	struct ut_iter *iter;
+	int raw_data[] = { 874, 638, 5321, 96, 705, 1423, 3689 };
+	int sorted[] = { 96, 638, 705, 874, 1423, 3689, 5321 };
+
+	set = ut_tree_set_new(ut_type_int());
+
+	for (i = 0; i < sizeof(raw_data) / sizeof(raw_data[0]); i++)
+		ut_tree_set_insert(set, &raw_data[i]);
+
+	p = ut_tree_set_lower_bound(set, &(int){ 700 });
+	if (!p || *p != 705) {
+		puts("Error: the lower bound of 700 is not 705");
+		abort();
+	}
+
+	p = ut_tree_set_floor(set, &(int){ 700 });
+	if (!p || *p != 638) {
+		puts("Error: the floor of 700 is not 638");
+		abort();
+	}
+
+	i = 2;
+	iter = ut_tree_set_range_iter_new(set, &(int){ 700 }, &(int){ 3689 });
+	while ((p = iter->next(iter))) {
+		if (*p != sorted[i++]) {
+			printf("Error: %d != %d\n", *p, sorted[i - 1]);
+			abort();
+		}
+	}
+	ut_tree_set_iter_delete(iter);
+
+	if (i != 5) {
+		puts("Error: the range is not [705, 3689)");
+		abort();
+	}
+
+	i = 7;
+	iter = ut_tree_set_rev_iter_new(set);
+	while ((p = iter->next(iter))) {
+		if (*p != sorted[--i]) {
+			printf("Error: %d != %d\n", *p, sorted[i]);
+			abort();
+		}
+	}
+	ut_tree_set_iter_delete(iter);
+
+	ut_tree_set_pop_first(set);
+	ut_tree_set_pop_last(set);
+	if (*(int *)ut_tree_set_first(set) != 638 ||
+	    *(int *)ut_tree_set_last(set) != 3689) {
+		puts("Error: the first and last are not 638 and 3689");
+		abort();
+	}
+
+	ut_tree_set_delete(set);
+}
+
+static void test3()
+{
+	int *p;
+	size_t i;
+	ut_tree_set_t *set;
+	int raw_data[] = { 874, 638, 5321, 96, 705, 1423, 3689 };
+	int sorted[] = { 96, 638, 705, 874, 1423, 3689, 5321 };
+
+	set = ut_tree_set_new_ranked(ut_type_int());
+
+	for (i = 0; i < sizeof(raw_data) / sizeof(raw_data[0]); i++)
+		ut_tree_set_insert(set, &raw_data[i]);
+
+	for (i = 0; i < sizeof(sorted) / sizeof(sorted[0]); i++) {
+		p = ut_tree_set_select(set, i);
+		if (!p || *p != sorted[i] ||
+		    ut_tree_set_rank(set, &sorted[i]) != i) {
+			printf("Error: %d is not at %zu\n", sorted[i], i);
+			abort();
+		}
+	}
+
+	if (ut_tree_set_count_range(set, &(int){ 700 }, &(int){ 3689 }) != 3) {
+		puts("Error: there are not 3 elements in [700, 3689)");
+		abort();
+	}
+
+	ut_tree_set_delete(set);
+}
+
+static void test4()
+{
+	int *p;
+	size_t i;
+	ut_tree_set_t *set;
+	int raw_data[] = { 874, 638, 5321, 96, 705, 1423, 3689 };
+	int sorted[] = { 96, 638, 705, 874, 1423, 3689, 5321 };
+
+	set = ut_tree_set_from_sorted(ut_type_int(), raw_data, 7);
+	if (set) {
+		puts("Error: unsorted elements were accepted");
+		abort();
+	}
+
+	set = ut_tree_set_from_sorted(ut_type_int(), sorted, 7);
+
+	for (i = 0; i < sizeof(raw_data) / sizeof(raw_data[0]); i++) {
+		p = ut_tree_set_get(set, &raw_data[i]);
+		if (!p || *p != raw_data[i]) {
+			printf("Error: %d is missing\n", raw_data[i]);
+			abort();
+		}
+	}
+
+	print_int_tree_set(set);
+
+	ut_tree_set_delete(set);
+}
+
+static void test5()
+{
+	ut_tree_set_t *set, *right, *other;
+	int i;
+
+	set = ut_tree_set_new_ranked(ut_type_int());
+	other = ut_tree_set_new_ranked(ut_type_int());
+	for (i = 0; i < 1000; i++) {
+		ut_tree_set_insert(set, &i);
+		if (i % 7 == 0)
+			ut_tree_set_insert(other, &i);
+	}
+
+	right = ut_tree_set_split(set, &(int){ 400 });
+	if (ut_tree_set_length(set) != 400 ||
+	    *(int *)ut_tree_set_first(right) != 400 ||
+	    ut_tree_set_rank(right, &(int){ 500 }) != 100) {
+		puts("Error: wrong split at 400");
+		abort();
+	}
+
+	if (ut_tree_set_join(right, set) != UT_EINVAL ||
+	    ut_tree_set_join(set, right) != UT_OK ||
+	    ut_tree_set_length(set) != 1000) {
+		puts("Error: wrong join");
+		abort();
+	}
+	ut_tree_set_delete(right);
+
+	ut_tree_set_difference(set, other);
+	if (ut_tree_set_length(set) != 857 ||
+	    ut_tree_set_get(set, &(int){ 7 })) {
+		puts("Error: wrong difference");
+		abort();
+	}
+
+	for (i = 0; i < 1000; i += 7)
+		ut_tree_set_insert(other, &i);
+	ut_tree_set_union(set, other);
+	if (ut_tree_set_length(set) != 1000 ||
+	    *(int *)ut_tree_set_select(set, 700) != 700) {
+		puts("Error: wrong union");
+		abort();
+	}
+
+	ut_tree_set_delete(other);
+	ut_tree_set_delete(set);
+}
+
+static void test6()
+{
+	ut_tree_set_t *set;
+	void *hint = NULL;
+	int i;
+
+	set = ut_tree_set_new_ranked(ut_type_int());
+
+	for (i = 1000; i > 0; i -= 2)
+		ut_tree_set_insert_hint(set, &hint, &i);
+	for (i = 1; i < 1000; i += 2)
+		ut_tree_set_insert(set, &i);
+
+	for (i = 0; i < 1000; i++) {
+		if (*(int *)ut_tree_set_select(set, i) != i + 1) {
+			puts("Error: wrong order after hinted inserts");
+			abort();
+		}
+	}
+
+	ut_tree_set_delete(set);
+}
+
+/* Sets that share a pool drop every string, whichever goes first. */
+static void test7()
+{
+	ut_tree_set_t *a, *b;
+	struct ut_string s;
+	char buf[16];
+	int i, round;
+
+	for (round = 0; round < 4; round++) {
+		a = ut_tree_set_new(ut_type_string());
+		for (i = 0; i < 100; i++) {
+			snprintf(buf, sizeof(buf), "key-%03d", i);
+			ut_tree_set_insert(a, ut_string_init(&s, buf));
+		}
+
+		ut_string_init(&s, "key-050");
+		b = ut_tree_set_split(a, &s);
+		ut_string_drop(&s);
+
+		/* Puts back one key that a union has to release. */
+		if (round >= 2) {
+			ut_tree_set_insert(b, ut_string_init(&s, "key-000"));
+			ut_tree_set_union(a, b);
+		}
+
+		ut_tree_set_delete(round % 2 ? a : b);
+		ut_tree_set_delete(round % 2 ? b : a);
+	}
+}
+
 int main()
 {
 	test1();
+	test2();
+	test3();
+	test4();
+	test5();
+	test6();
+	test7();
 	return 0;
 }